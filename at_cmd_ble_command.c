@@ -38,7 +38,7 @@
 
 #include "mico_ble_lib.h"
 
-#define BT_MAGIC_NUMBER         0x672b123e
+#define BT_MAGIC_NUMBER         0x672b1249
 #define BT_DEVICE_NAME_LEN      31
 
 /* Log api */
@@ -53,6 +53,24 @@ typedef struct {
     mico_bool_t is_enable_event;
     char        device_name[BT_DEVICE_NAME_LEN];    // c-style string
     char        whitelist_name[BT_DEVICE_NAME_LEN];     // c-style string
+    mico_bool_t is_framing;
+    mico_bool_t is_compress;
+    uint8_t     conn_profile;
+    mico_bool_t is_conn_auto;
+    uint8_t     transport;
+    mico_bool_t is_reliable;
+    mico_ble_scan_config_t scan_cfg;
+    uint8_t     nearby_order;
+    mico_bool_t is_report;      /* +LEREPORT per scan result, or poll AT+LELIST only */
+    mico_bool_t is_raw_report;
+    uint8_t     gatt_cache_count;
+    mico_ble_gatt_cache_entry_t gatt_cache[BLE_GATT_CACHE_MAX];     /* most recently used first */
+    mico_ble_reconn_config_t reconn_cfg;
+    mico_bool_t has_last_peer;
+    mico_ble_peer_t last_peer;
+    uint8_t     accept_count;
+    mico_bt_device_address_t accept_list[BLE_ACCEPT_LIST_MAX];
+    mico_bool_t is_accept_filter;
 } at_cmd_ble_config_t;
 #pragma pack()
 
@@ -66,20 +84,59 @@ typedef struct {
 static OSStatus ble_event_handle(mico_ble_event_t  event, const mico_ble_evt_params_t  *params);
 
 static mico_bt_result_t ble_default_config(at_cmd_ble_config_t *config);
+static void ble_save_accept_list(void);
 static void ble_set_device_name(at_cmd_driver_t *driver, at_cmd_para_t *para);
 static void ble_get_device_name(at_cmd_driver_t *driver);
 static void ble_get_device_addr(at_cmd_driver_t *driver);
 static void ble_send_rawdata(at_cmd_driver_t *driver);
 static void ble_send_data_packet(at_cmd_driver_t *driver, at_cmd_para_t *para);
 static void ble_set_scan_mode(at_cmd_driver_t *driver);
+static void ble_set_scan_state(at_cmd_driver_t *driver, at_cmd_para_t *para);
 static void ble_set_advertisement_mode(at_cmd_driver_t *driver);
+static void ble_set_advertisement_state(at_cmd_driver_t *driver, at_cmd_para_t *para);
 static void ble_gap_connect(at_cmd_driver_t *driver, at_cmd_para_t *para);
+static void ble_set_auto_connect(at_cmd_driver_t *driver, at_cmd_para_t *para);
+static void ble_get_auto_connect(at_cmd_driver_t *driver);
 static void ble_gap_disconnect(at_cmd_driver_t *driver, at_cmd_para_t *para);
 static void ble_get_state(at_cmd_driver_t *driver);
 static void ble_set_event_mask(at_cmd_driver_t *driver, at_cmd_para_t *para);
 static void ble_get_event_mask(at_cmd_driver_t *driver);
 static void ble_get_whitelist_name(at_cmd_driver_t *driver);
 static void ble_set_whitelist_name(at_cmd_driver_t *driver, at_cmd_para_t *para);
+static void ble_add_whitelist(at_cmd_driver_t *driver, at_cmd_para_t *para);
+static void ble_del_whitelist(at_cmd_driver_t *driver, at_cmd_para_t *para);
+static void ble_clear_whitelist(at_cmd_driver_t *driver);
+static void ble_add_accept_list(at_cmd_driver_t *driver, at_cmd_para_t *para);
+static void ble_del_accept_list(at_cmd_driver_t *driver, at_cmd_para_t *para);
+static void ble_clear_accept_list(at_cmd_driver_t *driver);
+static void ble_set_accept_list_filter(at_cmd_driver_t *driver, at_cmd_para_t *para);
+static void ble_get_accept_list_filter(at_cmd_driver_t *driver);
+static void ble_set_scan_config(at_cmd_driver_t *driver, at_cmd_para_t *para);
+static void ble_get_scan_config(at_cmd_driver_t *driver);
+static void ble_set_nearby(at_cmd_driver_t *driver, at_cmd_para_t *para);
+static void ble_get_nearby(at_cmd_driver_t *driver);
+static void ble_list_nearby(at_cmd_driver_t *driver);
+static void ble_set_raw_report(at_cmd_driver_t *driver, at_cmd_para_t *para);
+static void ble_get_raw_report(at_cmd_driver_t *driver);
+static void ble_list_conn_timing(at_cmd_driver_t *driver);
+static void ble_get_conn_hist(at_cmd_driver_t *driver);
+static void ble_clear_conn_timing(at_cmd_driver_t *driver);
+static void ble_get_tx_stats(at_cmd_driver_t *driver);
+static void ble_get_gatt_cache(at_cmd_driver_t *driver);
+static void ble_clear_gatt_cache(at_cmd_driver_t *driver);
+static void ble_set_framing(at_cmd_driver_t *driver, at_cmd_para_t *para);
+static void ble_get_framing(at_cmd_driver_t *driver);
+static void ble_set_compression(at_cmd_driver_t *driver, at_cmd_para_t *para);
+static void ble_get_compression(at_cmd_driver_t *driver);
+static void ble_set_conn_profile(at_cmd_driver_t *driver, at_cmd_para_t *para);
+static void ble_get_conn_profile(at_cmd_driver_t *driver);
+static void ble_set_transport(at_cmd_driver_t *driver, at_cmd_para_t *para);
+static void ble_get_transport(at_cmd_driver_t *driver);
+static void ble_set_reliable(at_cmd_driver_t *driver, at_cmd_para_t *para);
+static void ble_get_reliable(at_cmd_driver_t *driver);
+static void ble_set_reconnect(at_cmd_driver_t *driver, at_cmd_para_t *para);
+static void ble_get_reconnect(at_cmd_driver_t *driver);
+static void ble_get_worker_stats(at_cmd_driver_t *driver);
 
 static at_cmd_ble_context_t g_ble_context;
 
@@ -90,16 +147,39 @@ static const struct at_cmd_command g_ble_cmds[] = {
         { "AT+LEEVENT",     NULL,                   ble_set_event_mask,             ble_get_event_mask,         NULL },                     /* AT+LEEVENT?\r or AT+LEEVENT=<ON/OFF>\r*/
         { "AT+LESTATE",     NULL,                   NULL,                           ble_get_state,              NULL },                     /* AT+LESTATE?\r */
         { "AT+LESENDRAW",   NULL,                   NULL,                           NULL,                       ble_send_rawdata },         /* AT+LESENDRAW\r */
-        { "AT+LESEND",      NULL,                   ble_send_data_packet,           NULL,                       NULL },                     /* AT+LESEND=<length>\r  ...  <xxxxxx> */
+        { "AT+LESEND",      NULL,                   ble_send_data_packet,           NULL,                       NULL },                     /* AT+LESEND=<length>[,<handle>]\r  ...  <xxxxxx> */
         { "AT+LEDISCONN",   NULL,                   ble_gap_disconnect,             NULL,                       NULL },                     /* AT+LEDISCONN=<handle>\r */
+        { "AT+LETXSTAT",    NULL,                   NULL,                           ble_get_tx_stats,           NULL },                     /* AT+LETXSTAT?\r */
+        { "AT+LEGATTC",     NULL,                   NULL,                           ble_get_gatt_cache,         NULL },                     /* AT+LEGATTC?\r */
+        { "AT+LEGATTCLR",   NULL,                   NULL,                           NULL,                       ble_clear_gatt_cache },     /* AT+LEGATTCLR\r */
+        { "AT+LEFRAME",     NULL,                   ble_set_framing,                ble_get_framing,            NULL },                     /* AT+LEFRAME?\r or AT+LEFRAME=<ON/OFF>\r */
+        { "AT+LECOMP",      NULL,                   ble_set_compression,            ble_get_compression,        NULL },                     /* AT+LECOMP?\r or AT+LECOMP=<ON/OFF>\r */
+        { "AT+LECONNPRF",   NULL,                   ble_set_conn_profile,           ble_get_conn_profile,       NULL },                     /* AT+LECONNPRF?\r or AT+LECONNPRF=<DEFAULT/THROUGHPUT/IDLE/AUTO>\r */
+        { "AT+LETRANS",     NULL,                   ble_set_transport,              ble_get_transport,          NULL },                     /* AT+LETRANS?\r or AT+LETRANS=<GATT/COC>\r */
+        { "AT+LEREL",       NULL,                   ble_set_reliable,               ble_get_reliable,           NULL },                     /* AT+LEREL?\r or AT+LEREL=<ON/OFF>\r */
+        { "AT+LERECONN",    NULL,                   ble_set_reconnect,              ble_get_reconnect,          NULL },                     /* AT+LERECONN?\r or AT+LERECONN=<ON/OFF>[,<min>,<max>]\r */
+        { "AT+LEWORKER",    NULL,                   NULL,                           ble_get_worker_stats,       NULL },                     /* AT+LEWORKER?\r */
 
         /* BLE Central */
         { "AT+LEWLNAME",    ble_get_whitelist_name, ble_set_whitelist_name,         NULL,                       NULL },                     /* AT+LEWLNAME=? or AT+LEWLNAME=<name>\r */
-        { "AT+LESCAN",      NULL,                   NULL,                           NULL,                       ble_set_scan_mode },        /* AT+LESCAN\r */
+        { "AT+LEWLADD",     NULL,                   ble_add_whitelist,              NULL,                       NULL },                     /* AT+LEWLADD=<prefix>\r */
+        { "AT+LEWLDEL",     NULL,                   ble_del_whitelist,              NULL,                       NULL },                     /* AT+LEWLDEL=<prefix>\r */
+        { "AT+LEWLCLR",     NULL,                   NULL,                           NULL,                       ble_clear_whitelist },      /* AT+LEWLCLR\r */
+        { "AT+LEALADD",     NULL,                   ble_add_accept_list,            NULL,                       NULL },                     /* AT+LEALADD=<addr>\r */
+        { "AT+LEALDEL",     NULL,                   ble_del_accept_list,            NULL,                       NULL },                     /* AT+LEALDEL=<addr>\r */
+        { "AT+LEALCLR",     NULL,                   NULL,                           NULL,                       ble_clear_accept_list },    /* AT+LEALCLR\r */
+        { "AT+LEALFLT",     NULL,                   ble_set_accept_list_filter,     ble_get_accept_list_filter, NULL },                     /* AT+LEALFLT?\r or AT+LEALFLT=<ON/OFF>\r */
+        { "AT+LESCAN",      NULL,                   ble_set_scan_state,             NULL,                       ble_set_scan_mode },        /* AT+LESCAN\r or AT+LESCAN=<ON/OFF>\r */
+        { "AT+LESCANCFG",   NULL,                   ble_set_scan_config,            ble_get_scan_config,        NULL },                     /* AT+LESCANCFG?\r or AT+LESCANCFG=<ACTIVE/PASSIVE>,<interval>,<window>,<duration>[,<duty>,<period>]\r */
+        { "AT+LELIST",      NULL,                   ble_set_nearby,                 ble_get_nearby,             ble_list_nearby },          /* AT+LELIST\r, AT+LELIST?\r or AT+LELIST=<RSSI/RECENT>[,<ON/OFF>]\r */
+        { "AT+LERAWRPT",    NULL,                   ble_set_raw_report,             ble_get_raw_report,         NULL },                     /* AT+LERAWRPT?\r or AT+LERAWRPT=<ON/OFF>\r */
         { "AT+LECONN",      NULL,                   ble_gap_connect,                NULL,                       NULL },                     /* AT+LECONN=<addr>\r */
+        { "AT+LEAUTOCONN",  NULL,                   ble_set_auto_connect,           ble_get_auto_connect,       NULL },                     /* AT+LEAUTOCONN?\r or AT+LEAUTOCONN=<name-prefix|uuid>[,<min_rssi>[,<window>]]\r */
+        { "AT+LECONNTIME",  NULL,                   NULL,                           ble_get_conn_hist,          ble_list_conn_timing },     /* AT+LECONNTIME\r or AT+LECONNTIME?\r */
+        { "AT+LECONNTCLR",  NULL,                   NULL,                           NULL,                       ble_clear_conn_timing },    /* AT+LECONNTCLR\r */
 
         /* BLE Peripheral */
-        { "AT+LEADV",       NULL,                   NULL,                           NULL,                       ble_set_advertisement_mode }, /* AT+LEADV\r */
+        { "AT+LEADV",       NULL,                   ble_set_advertisement_state,    NULL,                       ble_set_advertisement_mode }, /* AT+LEADV\r or AT+LEADV=<ON/OFF>\r */
 };
 
 
@@ -107,6 +187,7 @@ OSStatus at_cmd_register_ble_component(void)
 {
     OSStatus err = kNoErr;
     mico_bt_result_t result;
+    uint8_t i;
 
     char response[50] = {0};
 
@@ -132,6 +213,28 @@ OSStatus at_cmd_register_ble_component(void)
                            ble_event_handle);
 
     if (result == MICO_BT_SUCCESS) {
+        if (g_ble_context.p_config->is_framing) {
+            mico_ble_set_framing(MICO_TRUE);
+            mico_ble_set_compression(g_ble_context.p_config->is_compress);
+        }
+        mico_ble_set_conn_profile((mico_ble_conn_profile_t)g_ble_context.p_config->conn_profile,
+                                  g_ble_context.p_config->is_conn_auto);
+        mico_ble_set_transport((mico_ble_transport_t)g_ble_context.p_config->transport);
+        mico_ble_set_reliable(g_ble_context.p_config->is_reliable);
+        mico_ble_set_scan_config(&g_ble_context.p_config->scan_cfg);
+        mico_ble_set_nearby_order((mico_ble_nearby_order_t)g_ble_context.p_config->nearby_order);
+        mico_ble_set_raw_report(g_ble_context.p_config->is_raw_report);
+        mico_ble_set_gatt_cache(g_ble_context.p_config->gatt_cache, g_ble_context.p_config->gatt_cache_count);
+        mico_ble_set_reconnect(&g_ble_context.p_config->reconn_cfg);
+        for (i = 0; i < g_ble_context.p_config->accept_count && i < BLE_ACCEPT_LIST_MAX; i++) {
+            mico_ble_accept_list_add(g_ble_context.p_config->accept_list[i]);
+        }
+        mico_ble_set_accept_list_filter(g_ble_context.p_config->is_accept_filter);
+        if (g_ble_context.p_config->has_last_peer) {
+            mico_ble_set_last_peer(&g_ble_context.p_config->last_peer);
+            mico_ble_reconnect();
+        }
+
         /* Register BLE Commands. */
         err = at_cmd_register_commands(g_ble_cmds, sizeof(g_ble_cmds) / sizeof(g_ble_cmds[0]));
         require_noerr_string(err, exit, "Registering AT Command for BLE failed");
@@ -167,8 +270,10 @@ exit:
 static OSStatus ble_event_handle(mico_ble_event_t  event, const mico_ble_evt_params_t  *params)
 {
     OSStatus err = kNoErr;
-    char response[100] = {0};
+    char response[160] = {0};
     char str_addr[BDADDR_NTOA_SIZE] = {0};
+    uint8_t i;
+    int n;
 
     switch (event) {
         case BLE_EVT_INIT:
@@ -257,17 +362,27 @@ static OSStatus ble_event_handle(mico_ble_event_t  event, const mico_ble_evt_par
         case BLE_EVT_CENTRAL_DISCONNECTED:
             at_ble_log("A remote device is disconnected");
             if (g_ble_context.p_config->is_enable_event) {
-                /* +LESCONN:ON */
-                sprintf(response, "%s+LESCONN:OFF%s", AT_PROMPT, AT_PROMPT);
+                /* +LESCONN:OFF,<addr>,<handle> */
+                sprintf(response, "%s+LESCONN:OFF,%s,0x%04x%s", AT_PROMPT,
+                        bdaddr_ntoa(params->bd_addr, str_addr),
+                        params->u.disconn.handle, AT_PROMPT);
                 uart_driver_struct_get()->write((uint8_t *)response, strlen(response));
             }
             break;
         case BLE_EVT_DATA:
             // at_ble_log("Remote data: len = %d", params->u.data.length);
-            if (mico_ble_get_device_state() == BLE_STATE_PERIPHERAL_CONNECTED
-                || mico_ble_get_device_state() == BLE_STATE_CENTRAL_CONNECTED) {
-
-                if (g_ble_context.p_config->is_at_mode && g_ble_context.p_config->is_enable_event) {
+            /* Central links may be up while the central role scans or connects */
+            if (mico_ble_get_spp_handle() != 0) {
+
+                /* Other central links are only reported in AT mode, transparent mode is the SPP channel */
+                if (params->u.data.handle != mico_ble_get_spp_handle()) {
+                    if (!g_ble_context.p_config->is_at_mode || !g_ble_context.p_config->is_enable_event) {
+                        break;
+                    }
+                    /* +LELDATA:<handle>,<length>,xxxx */
+                    sprintf(response, "%s+LELDATA:0x%04x,%d,", AT_PROMPT, params->u.data.handle, params->u.data.length);
+                    uart_driver_struct_get()->write((uint8_t *) response, strlen(response));
+                } else if (g_ble_context.p_config->is_at_mode && g_ble_context.p_config->is_enable_event) {
                     /* +LEDATA:<length>,xxxx */
                     sprintf(response, "%s+LEDATA:%d,", AT_PROMPT, params->u.data.length);
                     uart_driver_struct_get()->write((uint8_t *) response, strlen(response));
@@ -283,14 +398,32 @@ static OSStatus ble_event_handle(mico_ble_event_t  event, const mico_ble_evt_par
                         params->u.report.name, 
                         str_addr,
                         params->u.report.rssi);
-            if (g_ble_context.p_config->is_at_mode && g_ble_context.p_config->is_enable_event) {
-                /* +LEREPORT:<name>,<addr>,<rssi> */
-                sprintf(response, "%s+LEREPORT:%s,%s,%d%s", AT_PROMPT,
-                        params->u.report.name, str_addr,
-                        params->u.report.rssi, AT_PROMPT);
+            if (g_ble_context.p_config->is_at_mode && g_ble_context.p_config->is_enable_event
+                && g_ble_context.p_config->is_report) {
+                /* +LEREPORT:<name>,<addr>,<rssi>[,<adv data>] */
+                n = sprintf(response, "%s+LEREPORT:%s,%s,%d", AT_PROMPT,
+                            params->u.report.name, str_addr,
+                            params->u.report.rssi);
+                if (params->u.report.p_adv_data) {
+                    n += sprintf(response + n, ",");
+                    for (i = 0; i < params->u.report.adv_data_length; i++) {
+                        n += sprintf(response + n, "%02X", params->u.report.p_adv_data[i]);
+                    }
+                }
+                sprintf(response + n, "%s", AT_PROMPT);
                 uart_driver_struct_get()->write((uint8_t *)response, strlen(response));
             }
             break;
+        case BLE_EVT_LAST_PEER_CHANGED:
+            g_ble_context.p_config->has_last_peer =
+                (mico_ble_get_last_peer(&g_ble_context.p_config->last_peer) == MICO_BT_SUCCESS);
+            at_cmd_config_data_write();
+            break;
+        case BLE_EVT_GATT_CACHE_CHANGED:
+            g_ble_context.p_config->gatt_cache_count = mico_ble_get_gatt_cache(g_ble_context.p_config->gatt_cache,
+                                                                               BLE_GATT_CACHE_MAX);
+            at_cmd_config_data_write();
+            break;
         default:
             at_ble_log("Unhandled event");
             break;
@@ -466,7 +599,7 @@ exit:
 }
 
 /**
- * AT+LESEND=<length>
+ * AT+LESEND=<length>[,<handle>]
  * >
  * <xxxxxxxx>
  * OK
@@ -476,8 +609,10 @@ static void ble_send_data_packet(at_cmd_driver_t *driver, at_cmd_para_t *para)
     char             response[50];
     uint8_t         *msg = NULL;
     uint32_t         timeout;
+    uint16_t         handle = 0;
+    mico_bt_result_t ret;
 
-    if (para->para_num != 1) {
+    if (para->para_num != 1 && para->para_num != 2) {
         sprintf(response, "%s", AT_RESPONSE_ERR);
         goto exit;
     }
@@ -485,6 +620,11 @@ static void ble_send_data_packet(at_cmd_driver_t *driver, at_cmd_para_t *para)
     int len = at_cmd_parse_get_digital(para->para, 1);
     require(len > 0 && len < 256, exit);
 
+    if (para->para_num == 2) {
+        handle = (uint16_t)at_cmd_parse_get_digital(para->para, 2);
+        require(handle > 0x0000 && handle < 0xffff, exit);
+    }
+
     msg = (uint8_t *)malloc((size_t)len);
     require_string(msg != NULL, exit, "No resource for malloc");
 
@@ -493,7 +633,14 @@ static void ble_send_data_packet(at_cmd_driver_t *driver, at_cmd_para_t *para)
 
     driver->ioctl(AT_GET_CMD_READ_TIMEOUT, &timeout);
     uint32_t real_len = at_cmd_driver_read(driver, msg, (uint32_t)len, timeout);
-    if (real_len > 0 && mico_ble_send_data(msg, real_len, 500) == MICO_BT_SUCCESS) {
+    if (real_len == 0) {
+        ret = MICO_BT_BADARG;
+    } else if (handle != 0) {
+        ret = mico_ble_send_data_to(handle, msg, real_len, 500);
+    } else {
+        ret = mico_ble_send_data(msg, real_len, 500);
+    }
+    if (ret == MICO_BT_SUCCESS) {
         sprintf(response, "%s", AT_RESPONSE_OK);
     } else {
         sprintf(response, "%s", AT_RESPONSE_ERR);
@@ -522,174 +669,1371 @@ static void ble_set_scan_mode(at_cmd_driver_t *driver)
 }
 
 /**
- * AT+LEADV
+ * AT+LESCAN=<ON/OFF>
  * OK or ERR
  */
-static void ble_set_advertisement_mode(at_cmd_driver_t *driver)
+static void ble_set_scan_state(at_cmd_driver_t *driver, at_cmd_para_t *para)
 {
     char response[50];
+    mico_bt_result_t ret;
 
-    if (MICO_BT_SUCCESS != mico_ble_start_device_discovery()) {
-        sprintf(response, "%s", AT_RESPONSE_ERR);
+    if (para->para_num != 1) {
+        goto err_exit;
+    }
+
+    char *param = at_cmd_parse_get_string(para->para, 1);
+    if (strcmp(param, "ON") == 0) {
+        ret = mico_ble_start_device_scan();
+    } else if (strcmp(param, "OFF") == 0) {
+        ret = mico_ble_stop_device_scan();
     } else {
-        sprintf(response, "%s", AT_RESPONSE_OK);
+        goto err_exit;
+    }
+
+    if (ret != MICO_BT_SUCCESS) {
+        goto err_exit;
     }
+    sprintf(response, "%s", AT_RESPONSE_OK);
+    goto exit;
+
+err_exit:
+    sprintf(response, "%s", AT_RESPONSE_ERR);
 
+exit:
     driver->write((uint8_t *)response, strlen(response));
 }
 
 /**
- * AT+LECONN=<addr>
+ * AT+LESCANCFG=<ACTIVE/PASSIVE>,<interval>,<window>,<duration>[,<duty>,<period>]
  * OK or ERR
- * +LECONN:<YES/NO>
- *
- * @param driver
- * @param para
  */
-static void ble_gap_connect(at_cmd_driver_t *driver, at_cmd_para_t *para)
+static void ble_set_scan_config(at_cmd_driver_t *driver, at_cmd_para_t *para)
 {
-    char response[50], *params;
-    mico_bt_device_address_t addr = {0};
+    char response[50];
+    mico_ble_scan_config_t cfg;
 
-    if (para->para_num != 1) {
-        sprintf(response, "%s", AT_RESPONSE_ERR);
-        goto exit;
+    if (para->para_num != 4 && para->para_num != 6) {
+        goto err_exit;
     }
 
-    params = at_cmd_parse_get_string(para->para, 1);
-    bdaddr_aton(params, addr);
-
-    if (MICO_BT_SUCCESS != mico_ble_connect(addr)) {
-        sprintf(response, "%s", AT_RESPONSE_ERR);
+    char *type = at_cmd_parse_get_string(para->para, 1);
+    if (strcmp(type, "ACTIVE") == 0) {
+        cfg.is_active = MICO_TRUE;
+    } else if (strcmp(type, "PASSIVE") == 0) {
+        cfg.is_active = MICO_FALSE;
     } else {
-        sprintf(response, "%s", AT_RESPONSE_OK);
+        goto err_exit;
+    }
+
+    cfg.interval = (uint16_t)at_cmd_parse_get_digital(para->para, 2);
+    cfg.window = (uint16_t)at_cmd_parse_get_digital(para->para, 3);
+    cfg.duration_second = (uint16_t)at_cmd_parse_get_digital(para->para, 4);
+    cfg.duty_percent = 100;
+    cfg.duty_period_second = 0;
+    if (para->para_num == 6) {
+        cfg.duty_percent = (uint8_t)at_cmd_parse_get_digital(para->para, 5);
+        cfg.duty_period_second = (uint16_t)at_cmd_parse_get_digital(para->para, 6);
+    }
+
+    if (mico_ble_set_scan_config(&cfg) != MICO_BT_SUCCESS) {
+        goto err_exit;
     }
 
+    memcpy(&g_ble_context.p_config->scan_cfg, &cfg, sizeof(cfg));
+    at_cmd_config_data_write();
+    sprintf(response, "%s", AT_RESPONSE_OK);
+    goto exit;
+
+err_exit:
+    sprintf(response, "%s", AT_RESPONSE_ERR);
+
 exit:
     driver->write((uint8_t *)response, strlen(response));
 }
 
 /**
- * AT+LEDISCONN=<handle>
+ * AT+LESCANCFG?
+ * +LESCANCFG:<ACTIVE/PASSIVE>,<interval>,<window>,<duration>,<duty>,<period>
+ * OK
+ */
+static void ble_get_scan_config(at_cmd_driver_t *driver)
+{
+    char response[80];
+    mico_ble_scan_config_t cfg;
+
+    mico_ble_get_scan_config(&cfg);
+    sprintf(response, "%s+LESCANCFG:%s,%u,%u,%u,%u,%u%s",
+            AT_PROMPT,
+            cfg.is_active ? "ACTIVE" : "PASSIVE",
+            cfg.interval,
+            cfg.window,
+            cfg.duration_second,
+            cfg.duty_percent,
+            cfg.duty_period_second,
+            AT_RESPONSE_OK);
+    driver->write((uint8_t *)response, strlen(response));
+}
+
+static const char *g_nearby_order_names[] = { "RSSI", "RECENT" };
+
+/**
+ * AT+LELIST=<RSSI/RECENT>[,<ON/OFF>]
  * OK or ERR
- * +LEDISCONN:<YES/NO>
- *
- * @param driver
- * @param para
  */
-static void ble_gap_disconnect(at_cmd_driver_t *driver, at_cmd_para_t *para)
+static void ble_set_nearby(at_cmd_driver_t *driver, at_cmd_para_t *para)
 {
     char response[50];
-    uint16_t handle;
+    mico_bool_t is_report = g_ble_context.p_config->is_report;
+    uint8_t order;
 
-    if (para->para_num != 1) {
-        sprintf(response, "%s", AT_RESPONSE_ERR);
-        goto exit;
+    if (para->para_num != 1 && para->para_num != 2) {
+        goto err_exit;
     }
 
-    handle = (uint16_t)at_cmd_parse_get_digital(para->para, 1);
-    require(handle > 0x0000 && handle < 0xffff, exit);
+    char *param = at_cmd_parse_get_string(para->para, 1);
+    for (order = 0; order < sizeof(g_nearby_order_names) / sizeof(g_nearby_order_names[0]); order++) {
+        if (strcmp(param, g_nearby_order_names[order]) == 0) {
+            break;
+        }
+    }
+    if (order == sizeof(g_nearby_order_names) / sizeof(g_nearby_order_names[0])) {
+        goto err_exit;
+    }
 
-    if (MICO_BT_SUCCESS != mico_ble_disconnect(handle)) {
-        sprintf(response, "%s", AT_RESPONSE_ERR);
-    } else {
-        sprintf(response, "%s", AT_RESPONSE_OK);
+    if (para->para_num == 2) {
+        param = at_cmd_parse_get_string(para->para, 2);
+        if (strcmp(param, "ON") == 0) {
+            is_report = MICO_TRUE;
+        } else if (strcmp(param, "OFF") == 0) {
+            is_report = MICO_FALSE;
+        } else {
+            goto err_exit;
+        }
+    }
+
+    if (mico_ble_set_nearby_order((mico_ble_nearby_order_t)order) != MICO_BT_SUCCESS) {
+        goto err_exit;
     }
 
+    g_ble_context.p_config->nearby_order = order;
+    g_ble_context.p_config->is_report = is_report;
+    at_cmd_config_data_write();
+    sprintf(response, "%s", AT_RESPONSE_OK);
+    goto exit;
+
+err_exit:
+    sprintf(response, "%s", AT_RESPONSE_ERR);
+
 exit:
     driver->write((uint8_t *)response, strlen(response));
 }
 
 /**
- * AT+LESTATE?
- *
- * +LESTATE:<state>
+ * AT+LELIST?
+ * +LELIST:<RSSI/RECENT>,<ON/OFF>
  * OK
  */
-static void ble_get_state(at_cmd_driver_t *driver)
+static void ble_get_nearby(at_cmd_driver_t *driver)
 {
     char response[50];
-    int  idx = 0;
 
-    switch (mico_ble_get_device_state()) {
-        case BLE_STATE_PERIPHERAL_ADVERTISING:
-            idx = sprintf(response, "%s+LESTATE:ADV%s", AT_PROMPT, AT_PROMPT);
-            break;
-        case BLE_STATE_PERIPHERAL_CONNECTED:
-            idx = sprintf(response, "%s+LESTATE:CONN%s", AT_PROMPT, AT_PROMPT);
-            break;
-        case BLE_STATE_CENTRAL_CONNECTED:
-            idx = sprintf(response, "%s+LESTATE:CONN%s", AT_PROMPT, AT_PROMPT);
-            break;
-        case BLE_STATE_CENTRAL_SCANNING:
-            idx = sprintf(response, "%s+LESTATE:SCAN%s", AT_PROMPT, AT_PROMPT);
-            break;
-        case BLE_STATE_CENTRAL_CONNECTING:
-            idx = sprintf(response, "%s+LESTATE:CONNING%s", AT_PROMPT, AT_PROMPT);
-            break;
-        default:
-            at_ble_log("Unknown state");
-            return;
+    sprintf(response, "%s+LELIST:%s,%s%s",
+            AT_PROMPT,
+            g_nearby_order_names[mico_ble_get_nearby_order()],
+            g_ble_context.p_config->is_report ? "ON" : "OFF",
+            AT_RESPONSE_OK);
+    driver->write((uint8_t *)response, strlen(response));
+}
+
+/**
+ * AT+LELIST
+ *
+ * +LELIST:<count>
+ * +LELIST:<name>,<addr>,<rssi>,<age>
+ * ...
+ * OK or ERR
+ */
+static void ble_list_nearby(at_cmd_driver_t *driver)
+{
+    char response[100];
+    char str_addr[BDADDR_NTOA_SIZE] = {0};
+    mico_ble_nearby_t *list;
+    uint8_t count, i;
+
+    list = (mico_ble_nearby_t *)malloc(BLE_NEARBY_MAX * sizeof(mico_ble_nearby_t));
+    if (!list) {
+        sprintf(response, "%s", AT_RESPONSE_ERR);
+        driver->write((uint8_t *)response, strlen(response));
+        return;
+    }
+
+    count = mico_ble_get_nearby(list, BLE_NEARBY_MAX);
+    sprintf(response, "%s+LELIST:%u", AT_PROMPT, count);
+    driver->write((uint8_t *)response, strlen(response));
+
+    for (i = 0; i < count; i++) {
+        sprintf(response, "%s+LELIST:%s,%s,%d,%lu", AT_PROMPT,
+                list[i].name,
+                bdaddr_ntoa(list[i].bd_addr, str_addr),
+                list[i].rssi,
+                (unsigned long)list[i].age_ms);
+        driver->write((uint8_t *)response, strlen(response));
+    }
+    free(list);
+
+    sprintf(response, "%s", AT_RESPONSE_OK);
+    driver->write((uint8_t *)response, strlen(response));
+}
+
+static const char *g_conn_phase_names[BLE_CONN_PHASE_MAX] = { "QUEUE", "SECURITY", "CONNECT", "SERVICE", "CHAR" };
+
+/**
+ * AT+LECONNTIME
+ *
+ * +LECONNTIME:<count>
+ * +LECONNTIME:<addr>,<OK/FAIL>,<phase>,<age>,<queue>,<security>,<connect>,<service>,<char>
+ * ...
+ * OK
+ */
+static void ble_list_conn_timing(at_cmd_driver_t *driver)
+{
+    char response[120];
+    char str_addr[BDADDR_NTOA_SIZE] = {0};
+    mico_ble_conn_timing_t list[BLE_CONN_TIMING_MAX];
+    uint8_t count, i;
+
+    count = mico_ble_get_conn_timing(list, BLE_CONN_TIMING_MAX);
+    sprintf(response, "%s+LECONNTIME:%u", AT_PROMPT, count);
+    driver->write((uint8_t *)response, strlen(response));
+
+    for (i = 0; i < count; i++) {
+        sprintf(response, "%s+LECONNTIME:%s,%s,%s,%lu,%lu,%lu,%lu,%lu,%lu", AT_PROMPT,
+                bdaddr_ntoa(list[i].bd_addr, str_addr),
+                list[i].is_ready ? "OK" : "FAIL",
+                g_conn_phase_names[list[i].last_phase],
+                (unsigned long)list[i].age_ms,
+                (unsigned long)list[i].phase_ms[BLE_CONN_PHASE_QUEUE],
+                (unsigned long)list[i].phase_ms[BLE_CONN_PHASE_SECURITY],
+                (unsigned long)list[i].phase_ms[BLE_CONN_PHASE_CONNECT],
+                (unsigned long)list[i].phase_ms[BLE_CONN_PHASE_SERVICE],
+                (unsigned long)list[i].phase_ms[BLE_CONN_PHASE_CHARACTERISTIC]);
+        driver->write((uint8_t *)response, strlen(response));
     }
 
-    if (idx == 0) {
+    sprintf(response, "%s", AT_RESPONSE_OK);
+    driver->write((uint8_t *)response, strlen(response));
+}
+
+/**
+ * AT+LECONNTIME?
+ *
+ * +LECONNTIME:<phase>,<count0>,<count1>,...,<count13>
+ * ...
+ * OK or ERR
+ */
+static void ble_get_conn_hist(at_cmd_driver_t *driver)
+{
+    char response[150];
+    mico_ble_conn_hist_t hist;
+    uint8_t phase, b;
+    int len;
+
+    if (mico_ble_get_conn_hist(&hist) != MICO_BT_SUCCESS) {
         sprintf(response, "%s", AT_RESPONSE_ERR);
+        driver->write((uint8_t *)response, strlen(response));
+        return;
+    }
+
+    for (phase = 0; phase < BLE_CONN_PHASE_MAX; phase++) {
+        len = sprintf(response, "%s+LECONNTIME:%s", AT_PROMPT, g_conn_phase_names[phase]);
+        for (b = 0; b < BLE_CONN_HIST_BUCKETS; b++) {
+            len += sprintf(response + len, ",%u", hist.counts[phase][b]);
+        }
+        driver->write((uint8_t *)response, len);
+    }
+
+    sprintf(response, "%s", AT_RESPONSE_OK);
+    driver->write((uint8_t *)response, strlen(response));
+}
+
+/**
+ * AT+LECONNTCLR
+ * OK
+ */
+static void ble_clear_conn_timing(at_cmd_driver_t *driver)
+{
+    char response[50];
+
+    mico_ble_clear_conn_timing();
+    sprintf(response, "%s", AT_RESPONSE_OK);
+    driver->write((uint8_t *) response, strlen(response));
+}
+
+/**
+ * AT+LERAWRPT=<ON/OFF>
+ * OK
+ */
+static void ble_set_raw_report(at_cmd_driver_t *driver, at_cmd_para_t *para)
+{
+    char response[50];
+    mico_bool_t enable;
+
+    if (para->para_num != 1) {
+        goto err_exit;
+    }
+
+    char *param = at_cmd_parse_get_string(para->para, 1);
+    if (strcmp(param, "ON") == 0) {
+        enable = MICO_TRUE;
+    } else if (strcmp(param, "OFF") == 0) {
+        enable = MICO_FALSE;
     } else {
-        sprintf(response + idx, "%s", AT_RESPONSE_OK);
+        goto err_exit;
+    }
+
+    if (mico_ble_set_raw_report(enable) != MICO_BT_SUCCESS) {
+        goto err_exit;
     }
+
+    g_ble_context.p_config->is_raw_report = enable;
+    at_cmd_config_data_write();
+    sprintf(response, "%s", AT_RESPONSE_OK);
+    goto exit;
+
+err_exit:
+    sprintf(response, "%s", AT_RESPONSE_ERR);
+
+exit:
     driver->write((uint8_t *)response, strlen(response));
 }
 
 /**
- * AT+LEWLNAME=?
- * 
- * +LEWLNAME:<name>
+ * AT+LERAWRPT?
+ * +LERAWRPT:<ON/OFF>
  * OK
  */
-static void ble_get_whitelist_name(at_cmd_driver_t *driver)
+static void ble_get_raw_report(at_cmd_driver_t *driver)
 {
     char response[50];
 
-    sprintf(response, "%s+LEWLNAME:%s%s",
+    sprintf(response, "%s+LERAWRPT:%s%s",
             AT_PROMPT,
-            mico_ble_get_device_whitelist_name(),
+            mico_ble_get_raw_report() ? "ON" : "OFF",
             AT_RESPONSE_OK);
-    driver->write((uint8_t *) response, strlen(response));
+    driver->write((uint8_t *)response, strlen(response));
 }
 
 /**
- * AT+LEWLNAME=<name>
- * 
+ * AT+LEADV
  * OK or ERR
  */
-static void ble_set_whitelist_name(at_cmd_driver_t *driver, at_cmd_para_t *para)
+static void ble_set_advertisement_mode(at_cmd_driver_t *driver)
 {
     char response[50];
 
-    if (para->para_num != 1) {
+    if (MICO_BT_SUCCESS != mico_ble_start_device_discovery()) {
         sprintf(response, "%s", AT_RESPONSE_ERR);
-        goto exit;
+    } else {
+        sprintf(response, "%s", AT_RESPONSE_OK);
     }
 
-    char *name = at_cmd_parse_get_string(para->para, 1);
-    if (strlen(name) > BT_DEVICE_NAME_LEN - 1) {
-        sprintf(response, "%s", AT_RESPONSE_ERR);
-        goto exit;
+    driver->write((uint8_t *)response, strlen(response));
+}
+
+/**
+ * AT+LEADV=<ON/OFF>
+ * OK or ERR
+ */
+static void ble_set_advertisement_state(at_cmd_driver_t *driver, at_cmd_para_t *para)
+{
+    char response[50];
+    mico_bt_result_t ret;
+
+    if (para->para_num != 1) {
+        goto err_exit;
     }
 
-    if (mico_ble_set_device_whitelist_name(name) != MICO_BT_SUCCESS) {
-        sprintf(response, "%s", AT_RESPONSE_ERR);
+    char *param = at_cmd_parse_get_string(para->para, 1);
+    if (strcmp(param, "ON") == 0) {
+        ret = mico_ble_start_device_discovery();
+    } else if (strcmp(param, "OFF") == 0) {
+        ret = mico_ble_stop_device_discovery();
     } else {
-        strcpy(g_ble_context.p_config->whitelist_name, name);
-        at_cmd_config_data_write();
+        goto err_exit;
+    }
 
-        sprintf(response, "%s", AT_RESPONSE_OK);
+    if (ret != MICO_BT_SUCCESS) {
+        goto err_exit;
     }
+    sprintf(response, "%s", AT_RESPONSE_OK);
+    goto exit;
+
+err_exit:
+    sprintf(response, "%s", AT_RESPONSE_ERR);
 
 exit:
+    driver->write((uint8_t *)response, strlen(response));
+}
+
+/**
+ * AT+LECONN=<addr>
+ * OK or ERR
+ * +LECONN:<YES/NO>
+ *
+ * @param driver
+ * @param para
+ */
+static void ble_gap_connect(at_cmd_driver_t *driver, at_cmd_para_t *para)
+{
+    char response[50], *params;
+    mico_bt_device_address_t addr = {0};
+
+    if (para->para_num != 1) {
+        sprintf(response, "%s", AT_RESPONSE_ERR);
+        goto exit;
+    }
+
+    params = at_cmd_parse_get_string(para->para, 1);
+    bdaddr_aton(params, addr);
+
+    if (MICO_BT_SUCCESS != mico_ble_connect(addr)) {
+        sprintf(response, "%s", AT_RESPONSE_ERR);
+    } else {
+        sprintf(response, "%s", AT_RESPONSE_OK);
+    }
+
+exit:
+    driver->write((uint8_t *)response, strlen(response));
+}
+
+/* Value of a hex digit, -1 if it is not one */
+static int ble_hex_value(char c)
+{
+    if (c >= '0' && c <= '9') {
+        return c - '0';
+    } else if (c >= 'A' && c <= 'F') {
+        return c - 'A' + 10;
+    } else if (c >= 'a' && c <= 'f') {
+        return c - 'a' + 10;
+    }
+    return -1;
+}
+
+/*
+ * A 16-bit, 32-bit or 128-bit UUID written as 4, 8 or 32 hex digits, most
+ * significant first, dashes allowed. Anything else is not a UUID.
+ */
+static mico_bool_t ble_parse_uuid(const char *str, mico_bt_uuid_t *uuid)
+{
+    uint8_t bytes[LEN_UUID_128];
+    uint8_t count = 0;
+    int hi, lo;
+
+    while (*str) {
+        if (*str == '-') {
+            str++;
+            continue;
+        }
+        hi = ble_hex_value(str[0]);
+        lo = (hi < 0) ? -1 : ble_hex_value(str[1]);
+        if (lo < 0 || count == LEN_UUID_128) {
+            return MICO_FALSE;
+        }
+        bytes[count++] = (uint8_t)(hi << 4 | lo);
+        str += 2;
+    }
+
+    memset(uuid, 0, sizeof(mico_bt_uuid_t));
+    if (count == LEN_UUID_16) {
+        uuid->len = LEN_UUID_16;
+        uuid->uu.uuid16 = (uint16_t)(bytes[0] << 8 | bytes[1]);
+    } else if (count == LEN_UUID_32) {
+        uuid->len = LEN_UUID_32;
+        uuid->uu.uuid32 = (uint32_t)bytes[0] << 24 | (uint32_t)bytes[1] << 16 | (uint32_t)bytes[2] << 8 | bytes[3];
+    } else if (count == LEN_UUID_128) {
+        uuid->len = LEN_UUID_128;
+        for (count = 0; count < LEN_UUID_128; count++) {
+            uuid->uu.uuid128[count] = bytes[LEN_UUID_128 - 1 - count];
+        }
+    } else {
+        return MICO_FALSE;
+    }
+    return MICO_TRUE;
+}
+
+/**
+ * AT+LEAUTOCONN=<name-prefix|uuid>[,<min_rssi>[,<window>]]
+ * OK or ERR
+ *
+ * @param driver
+ * @param para
+ */
+static void ble_set_auto_connect(at_cmd_driver_t *driver, at_cmd_para_t *para)
+{
+    char response[50];
+    char *param;
+    mico_ble_auto_conn_t cond;
+
+    if (para->para_num < 1 || para->para_num > 3) {
+        goto err_exit;
+    }
+
+    memset(&cond, 0, sizeof(cond));
+    cond.min_rssi = -127;
+
+    param = at_cmd_parse_get_string(para->para, 1);
+    if (!ble_parse_uuid(param, &cond.service_uuid)) {
+        if (strlen(param) == 0 || strlen(param) > BLE_AUTO_CONN_NAME_MAX) {
+            goto err_exit;
+        }
+        strcpy(cond.name_prefix, param);
+    }
+
+    if (para->para_num >= 2) {
+        int rssi = atoi(at_cmd_parse_get_string(para->para, 2));
+        if (rssi < -127 || rssi >= 0) {
+            goto err_exit;
+        }
+        cond.min_rssi = (int8_t)rssi;
+    }
+    if (para->para_num == 3) {
+        int window = at_cmd_parse_get_digital(para->para, 3);
+        if (window < 0 || window > 0xFFFF) {
+            goto err_exit;
+        }
+        cond.window_ms = (uint16_t)window;
+    }
+
+    if (mico_ble_auto_connect(&cond) != MICO_BT_SUCCESS) {
+        goto err_exit;
+    }
+    sprintf(response, "%s", AT_RESPONSE_OK);
+    goto exit;
+
+err_exit:
+    sprintf(response, "%s", AT_RESPONSE_ERR);
+
+exit:
+    driver->write((uint8_t *)response, strlen(response));
+}
+
+/**
+ * AT+LEAUTOCONN?
+ * +LEAUTOCONN:<ON/OFF>[,<name-prefix|uuid>,<min_rssi>,<window>]
+ * OK
+ */
+static void ble_get_auto_connect(at_cmd_driver_t *driver)
+{
+    char response[100];
+    mico_ble_auto_conn_t cond;
+    int len, i;
+
+    if (!mico_ble_get_auto_connect(&cond)) {
+        sprintf(response, "%s+LEAUTOCONN:OFF%s", AT_PROMPT, AT_RESPONSE_OK);
+        driver->write((uint8_t *)response, strlen(response));
+        return;
+    }
+
+    len = sprintf(response, "%s+LEAUTOCONN:ON,", AT_PROMPT);
+    if (cond.service_uuid.len == LEN_UUID_16) {
+        len += sprintf(response + len, "%04X", cond.service_uuid.uu.uuid16);
+    } else if (cond.service_uuid.len == LEN_UUID_32) {
+        len += sprintf(response + len, "%08lX", (unsigned long)cond.service_uuid.uu.uuid32);
+    } else if (cond.service_uuid.len == LEN_UUID_128) {
+        for (i = LEN_UUID_128 - 1; i >= 0; i--) {
+            len += sprintf(response + len, "%02X", cond.service_uuid.uu.uuid128[i]);
+        }
+    } else {
+        len += sprintf(response + len, "%s", cond.name_prefix);
+    }
+    sprintf(response + len, ",%d,%u%s", cond.min_rssi, cond.window_ms, AT_RESPONSE_OK);
+    driver->write((uint8_t *)response, strlen(response));
+}
+
+/**
+ * AT+LEDISCONN=<handle>
+ * OK or ERR
+ * +LEDISCONN:<YES/NO>
+ *
+ * @param driver
+ * @param para
+ */
+static void ble_gap_disconnect(at_cmd_driver_t *driver, at_cmd_para_t *para)
+{
+    char response[50];
+    uint16_t handle;
+
+    if (para->para_num != 1) {
+        sprintf(response, "%s", AT_RESPONSE_ERR);
+        goto exit;
+    }
+
+    handle = (uint16_t)at_cmd_parse_get_digital(para->para, 1);
+    require(handle > 0x0000 && handle < 0xffff, exit);
+
+    if (MICO_BT_SUCCESS != mico_ble_disconnect(handle)) {
+        sprintf(response, "%s", AT_RESPONSE_ERR);
+    } else {
+        sprintf(response, "%s", AT_RESPONSE_OK);
+    }
+
+exit:
+    driver->write((uint8_t *)response, strlen(response));
+}
+
+/* Name of a state in +LESTATE, NULL for BLE_STATE_IDLE. */
+static const char *ble_state_name(mico_ble_state_t state)
+{
+    switch (state) {
+        case BLE_STATE_PERIPHERAL_ADVERTISING:
+            return "ADV";
+        case BLE_STATE_PERIPHERAL_CONNECTED:
+        case BLE_STATE_CENTRAL_CONNECTED:
+            return "CONN";
+        case BLE_STATE_CENTRAL_SCANNING:
+            return "SCAN";
+        case BLE_STATE_CENTRAL_CONNECTING:
+            return "CONNING";
+        default:
+            return NULL;
+    }
+}
+
+/**
+ * AT+LESTATE?
+ *
+ * +LESTATE:<state>[,<state>]
+ * OK
+ *
+ * With both roles active, the peripheral state comes first. With both idle,
+ * the state is IDLE.
+ */
+static void ble_get_state(at_cmd_driver_t *driver)
+{
+    char response[50];
+    const char *periph = ble_state_name(mico_ble_get_role_state(BLE_ROLE_PERIPHERAL));
+    const char *central = ble_state_name(mico_ble_get_role_state(BLE_ROLE_CENTRAL));
+
+    if (periph && central) {
+        sprintf(response, "%s+LESTATE:%s,%s%s%s", AT_PROMPT, periph, central, AT_PROMPT, AT_RESPONSE_OK);
+    } else if (periph || central) {
+        sprintf(response, "%s+LESTATE:%s%s%s", AT_PROMPT, periph ? periph : central, AT_PROMPT, AT_RESPONSE_OK);
+    } else {
+        sprintf(response, "%s+LESTATE:IDLE%s%s", AT_PROMPT, AT_PROMPT, AT_RESPONSE_OK);
+    }
+    driver->write((uint8_t *)response, strlen(response));
+}
+
+/**
+ * AT+LETXSTAT?
+ *
+ * +LETXSTAT:<handle>,<bytes>,<packets>,<retries>,<bytes_per_sec>,<retransmits>
+ * OK
+ */
+static void ble_get_tx_stats(at_cmd_driver_t *driver)
+{
+    char response[100];
+    mico_ble_tx_stats_t stats;
+
+    if (mico_ble_get_tx_stats(&stats) != MICO_BT_SUCCESS) {
+        sprintf(response, "%s", AT_RESPONSE_ERR);
+    } else {
+        sprintf(response, "%s+LETXSTAT:0x%04x,%lu,%lu,%lu,%lu,%lu%s", AT_PROMPT,
+                stats.handle,
+                (unsigned long)stats.bytes,
+                (unsigned long)stats.packets,
+                (unsigned long)stats.retries,
+                (unsigned long)stats.bytes_per_sec,
+                (unsigned long)stats.retransmits,
+                AT_RESPONSE_OK);
+    }
+    driver->write((uint8_t *)response, strlen(response));
+}
+
+/**
+ * AT+LEGATTC?
+ *
+ * +LEGATTC:<entries>,<hits>,<misses>,<hit_ready_ms>,<miss_ready_ms>
+ * OK
+ */
+static void ble_get_gatt_cache(at_cmd_driver_t *driver)
+{
+    char response[100];
+    mico_ble_gatt_cache_stats_t stats;
+
+    if (mico_ble_get_gatt_cache_stats(&stats) != MICO_BT_SUCCESS) {
+        sprintf(response, "%s", AT_RESPONSE_ERR);
+    } else {
+        sprintf(response, "%s+LEGATTC:%u,%lu,%lu,%lu,%lu%s", AT_PROMPT,
+                stats.entries,
+                (unsigned long)stats.hits,
+                (unsigned long)stats.misses,
+                (unsigned long)stats.hit_ready_ms,
+                (unsigned long)stats.miss_ready_ms,
+                AT_RESPONSE_OK);
+    }
+    driver->write((uint8_t *)response, strlen(response));
+}
+
+/**
+ * AT+LEGATTCLR
+ * OK
+ */
+static void ble_clear_gatt_cache(at_cmd_driver_t *driver)
+{
+    char response[50];
+
+    mico_ble_clear_gatt_cache();
+    g_ble_context.p_config->gatt_cache_count = 0;
+    at_cmd_config_data_write();
+    sprintf(response, "%s", AT_RESPONSE_OK);
+    driver->write((uint8_t *) response, strlen(response));
+}
+
+/**
+ * AT+LEFRAME=<ON/OFF>
+ * OK
+ */
+static void ble_set_framing(at_cmd_driver_t *driver, at_cmd_para_t *para)
+{
+    char response[50];
+    mico_bool_t enable;
+
+    if (para->para_num != 1) {
+        goto err_exit;
+    }
+
+    char *param = at_cmd_parse_get_string(para->para, 1);
+    if (strcmp(param, "ON") == 0) {
+        enable = MICO_TRUE;
+    } else if (strcmp(param, "OFF") == 0) {
+        enable = MICO_FALSE;
+    } else {
+        goto err_exit;
+    }
+
+    if (mico_ble_set_framing(enable) != MICO_BT_SUCCESS) {
+        goto err_exit;
+    }
+
+    g_ble_context.p_config->is_framing = enable;
+    at_cmd_config_data_write();
+    sprintf(response, "%s", AT_RESPONSE_OK);
+    goto exit;
+
+err_exit:
+    sprintf(response, "%s", AT_RESPONSE_ERR);
+
+exit:
+    driver->write((uint8_t *)response, strlen(response));
+}
+
+/**
+ * AT+LEFRAME?
+ * +LEFRAME:<ON/OFF>
+ * OK
+ */
+static void ble_get_framing(at_cmd_driver_t *driver)
+{
+    char response[50];
+
+    sprintf(response, "%s+LEFRAME:%s%s",
+            AT_PROMPT,
+            mico_ble_get_framing() ? "ON" : "OFF",
+            AT_RESPONSE_OK);
+    driver->write((uint8_t *)response, strlen(response));
+}
+
+/**
+ * AT+LECOMP=<ON/OFF>
+ * OK
+ */
+static void ble_set_compression(at_cmd_driver_t *driver, at_cmd_para_t *para)
+{
+    char response[50];
+    mico_bool_t enable;
+
+    if (para->para_num != 1) {
+        goto err_exit;
+    }
+
+    char *param = at_cmd_parse_get_string(para->para, 1);
+    if (strcmp(param, "ON") == 0) {
+        enable = MICO_TRUE;
+    } else if (strcmp(param, "OFF") == 0) {
+        enable = MICO_FALSE;
+    } else {
+        goto err_exit;
+    }
+
+    if (mico_ble_set_compression(enable) != MICO_BT_SUCCESS) {
+        goto err_exit;
+    }
+
+    g_ble_context.p_config->is_compress = enable;
+    at_cmd_config_data_write();
+    sprintf(response, "%s", AT_RESPONSE_OK);
+    goto exit;
+
+err_exit:
+    sprintf(response, "%s", AT_RESPONSE_ERR);
+
+exit:
+    driver->write((uint8_t *)response, strlen(response));
+}
+
+/**
+ * AT+LECOMP?
+ * +LECOMP:<ON/OFF>,<ACTIVE/INACTIVE>
+ * OK
+ */
+static void ble_get_compression(at_cmd_driver_t *driver)
+{
+    char response[50];
+    mico_bool_t active = MICO_FALSE;
+    mico_bool_t enable = mico_ble_get_compression(&active);
+
+    sprintf(response, "%s+LECOMP:%s,%s%s",
+            AT_PROMPT,
+            enable ? "ON" : "OFF",
+            active ? "ACTIVE" : "INACTIVE",
+            AT_RESPONSE_OK);
+    driver->write((uint8_t *)response, strlen(response));
+}
+
+/* Indexed by mico_ble_conn_profile_t */
+static const char *g_conn_profile_names[BLE_CONN_PROFILE_MAX] = { "DEFAULT", "THROUGHPUT", "IDLE" };
+
+/**
+ * AT+LECONNPRF=<DEFAULT/THROUGHPUT/IDLE/AUTO>
+ * OK
+ *
+ * AUTO switches between THROUGHPUT and IDLE by TX backlog.
+ */
+static void ble_set_conn_profile(at_cmd_driver_t *driver, at_cmd_para_t *para)
+{
+    char response[50];
+    uint8_t profile;
+    mico_bool_t is_auto = MICO_FALSE;
+
+    if (para->para_num != 1) {
+        goto err_exit;
+    }
+
+    char *param = at_cmd_parse_get_string(para->para, 1);
+    if (strcmp(param, "AUTO") == 0) {
+        profile = BLE_CONN_PROFILE_IDLE;
+        is_auto = MICO_TRUE;
+    } else {
+        for (profile = 0; profile < BLE_CONN_PROFILE_MAX; profile++) {
+            if (strcmp(param, g_conn_profile_names[profile]) == 0) {
+                break;
+            }
+        }
+    }
+
+    if (mico_ble_set_conn_profile((mico_ble_conn_profile_t)profile, is_auto) != MICO_BT_SUCCESS) {
+        goto err_exit;
+    }
+
+    g_ble_context.p_config->conn_profile = profile;
+    g_ble_context.p_config->is_conn_auto = is_auto;
+    at_cmd_config_data_write();
+    sprintf(response, "%s", AT_RESPONSE_OK);
+    goto exit;
+
+err_exit:
+    sprintf(response, "%s", AT_RESPONSE_ERR);
+
+exit:
+    driver->write((uint8_t *)response, strlen(response));
+}
+
+/**
+ * AT+LECONNPRF?
+ * +LECONNPRF:<DEFAULT/THROUGHPUT/IDLE/AUTO>,<active profile>
+ * OK
+ */
+static void ble_get_conn_profile(at_cmd_driver_t *driver)
+{
+    char response[60];
+    mico_bool_t is_auto = MICO_FALSE;
+    mico_ble_conn_profile_t active = BLE_CONN_PROFILE_DEFAULT;
+    mico_ble_conn_profile_t profile = mico_ble_get_conn_profile(&is_auto, &active);
+
+    sprintf(response, "%s+LECONNPRF:%s,%s%s",
+            AT_PROMPT,
+            is_auto ? "AUTO" : g_conn_profile_names[profile],
+            g_conn_profile_names[active],
+            AT_RESPONSE_OK);
+    driver->write((uint8_t *)response, strlen(response));
+}
+
+/**
+ * AT+LETRANS=<GATT/COC>
+ * OK
+ */
+static void ble_set_transport(at_cmd_driver_t *driver, at_cmd_para_t *para)
+{
+    char response[50];
+    mico_ble_transport_t transport;
+
+    if (para->para_num != 1) {
+        goto err_exit;
+    }
+
+    char *param = at_cmd_parse_get_string(para->para, 1);
+    if (strcmp(param, "GATT") == 0) {
+        transport = BLE_TRANSPORT_GATT;
+    } else if (strcmp(param, "COC") == 0) {
+        transport = BLE_TRANSPORT_L2CAP_COC;
+    } else {
+        goto err_exit;
+    }
+
+    if (mico_ble_set_transport(transport) != MICO_BT_SUCCESS) {
+        goto err_exit;
+    }
+
+    g_ble_context.p_config->transport = (uint8_t)transport;
+    at_cmd_config_data_write();
+    sprintf(response, "%s", AT_RESPONSE_OK);
+    goto exit;
+
+err_exit:
+    sprintf(response, "%s", AT_RESPONSE_ERR);
+
+exit:
+    driver->write((uint8_t *)response, strlen(response));
+}
+
+/**
+ * AT+LETRANS?
+ * +LETRANS:<GATT/COC>,<OPEN/CLOSED>
+ * OK
+ */
+static void ble_get_transport(at_cmd_driver_t *driver)
+{
+    char response[50];
+    mico_bool_t is_open = MICO_FALSE;
+    mico_ble_transport_t transport = mico_ble_get_transport(&is_open);
+
+    sprintf(response, "%s+LETRANS:%s,%s%s",
+            AT_PROMPT,
+            transport == BLE_TRANSPORT_L2CAP_COC ? "COC" : "GATT",
+            is_open ? "OPEN" : "CLOSED",
+            AT_RESPONSE_OK);
+    driver->write((uint8_t *)response, strlen(response));
+}
+
+/**
+ * AT+LEREL=<ON/OFF>
+ * OK
+ */
+static void ble_set_reliable(at_cmd_driver_t *driver, at_cmd_para_t *para)
+{
+    char response[50];
+    mico_bool_t enable;
+
+    if (para->para_num != 1) {
+        goto err_exit;
+    }
+
+    char *param = at_cmd_parse_get_string(para->para, 1);
+    if (strcmp(param, "ON") == 0) {
+        enable = MICO_TRUE;
+    } else if (strcmp(param, "OFF") == 0) {
+        enable = MICO_FALSE;
+    } else {
+        goto err_exit;
+    }
+
+    if (mico_ble_set_reliable(enable) != MICO_BT_SUCCESS) {
+        goto err_exit;
+    }
+
+    g_ble_context.p_config->is_reliable = enable;
+    at_cmd_config_data_write();
+    sprintf(response, "%s", AT_RESPONSE_OK);
+    goto exit;
+
+err_exit:
+    sprintf(response, "%s", AT_RESPONSE_ERR);
+
+exit:
+    driver->write((uint8_t *)response, strlen(response));
+}
+
+/**
+ * AT+LERECONN=<ON/OFF>[,<min>,<max>]
+ * OK
+ */
+static void ble_set_reconnect(at_cmd_driver_t *driver, at_cmd_para_t *para)
+{
+    char response[50];
+    mico_ble_reconn_config_t cfg;
+
+    if (para->para_num != 1 && para->para_num != 3) {
+        goto err_exit;
+    }
+
+    mico_ble_get_reconnect(&cfg);
+
+    char *param = at_cmd_parse_get_string(para->para, 1);
+    if (strcmp(param, "ON") == 0) {
+        cfg.enable = MICO_TRUE;
+    } else if (strcmp(param, "OFF") == 0) {
+        cfg.enable = MICO_FALSE;
+    } else {
+        goto err_exit;
+    }
+
+    if (para->para_num == 3) {
+        cfg.backoff_min_ms = (uint32_t)at_cmd_parse_get_digital(para->para, 2);
+        cfg.backoff_max_ms = (uint32_t)at_cmd_parse_get_digital(para->para, 3);
+    }
+
+    if (mico_ble_set_reconnect(&cfg) != MICO_BT_SUCCESS) {
+        goto err_exit;
+    }
+
+    memcpy(&g_ble_context.p_config->reconn_cfg, &cfg, sizeof(cfg));
+    at_cmd_config_data_write();
+    sprintf(response, "%s", AT_RESPONSE_OK);
+    goto exit;
+
+err_exit:
+    sprintf(response, "%s", AT_RESPONSE_ERR);
+
+exit:
+    driver->write((uint8_t *)response, strlen(response));
+}
+
+/**
+ * AT+LERECONN?
+ * +LERECONN:<ON/OFF>,<min>,<max>,<NONE/CENTRAL/PERIPHERAL>[,<addr>]
+ * OK
+ */
+static void ble_get_reconnect(at_cmd_driver_t *driver)
+{
+    char response[100];
+    char str_addr[BDADDR_NTOA_SIZE] = {0};
+    mico_ble_reconn_config_t cfg;
+    mico_ble_peer_t peer;
+    int len;
+
+    mico_ble_get_reconnect(&cfg);
+    len = sprintf(response, "%s+LERECONN:%s,%lu,%lu", AT_PROMPT,
+                  cfg.enable ? "ON" : "OFF",
+                  (unsigned long)cfg.backoff_min_ms,
+                  (unsigned long)cfg.backoff_max_ms);
+    if (mico_ble_get_last_peer(&peer) == MICO_BT_SUCCESS) {
+        len += sprintf(response + len, ",%s,%s",
+                       peer.role == BLE_ROLE_CENTRAL ? "CENTRAL" : "PERIPHERAL",
+                       bdaddr_ntoa(peer.bd_addr, str_addr));
+    } else {
+        len += sprintf(response + len, ",NONE");
+    }
+    sprintf(response + len, "%s", AT_RESPONSE_OK);
+    driver->write((uint8_t *)response, strlen(response));
+}
+
+static const char *g_worker_names[BLE_WORKER_MAX] = { "TASK", "EVENT" };
+
+/**
+ * AT+LEWORKER?
+ * +LEWORKER:<TASK/EVENT>,<RUNNING/IDLE>,<OWN/SHARED>,<stack>,<stack_free>,<queue>,<dropped>
+ * OK
+ */
+static void ble_get_worker_stats(at_cmd_driver_t *driver)
+{
+    char response[100];
+    char stack_free[12];
+    mico_ble_worker_stats_t stats;
+    uint8_t id;
+    int len;
+
+    for (id = 0; id < BLE_WORKER_MAX; id++) {
+        /* A single thread runs both */
+        if (mico_ble_get_worker_stats((mico_ble_worker_id_t)id, &stats) != MICO_BT_SUCCESS) {
+            continue;
+        }
+        if (stats.stack_free == BLE_WORKER_STACK_UNKNOWN) {
+            strcpy(stack_free, "-");
+        } else {
+            sprintf(stack_free, "%lu", (unsigned long)stats.stack_free);
+        }
+        len = sprintf(response, "%s+LEWORKER:%s,%s,%s,%lu,%s,%lu,%lu", AT_PROMPT,
+                      g_worker_names[id],
+                      stats.is_running ? "RUNNING" : "IDLE",
+                      stats.is_shared ? "SHARED" : "OWN",
+                      (unsigned long)stats.stack_size,
+                      stack_free,
+                      (unsigned long)stats.queue_depth,
+                      (unsigned long)stats.dropped);
+        driver->write((uint8_t *)response, len);
+    }
+
+    sprintf(response, "%s", AT_RESPONSE_OK);
+    driver->write((uint8_t *)response, strlen(response));
+}
+
+/**
+ * AT+LEREL?
+ * +LEREL:<ON/OFF>,<ACTIVE/INACTIVE>
+ * OK
+ */
+static void ble_get_reliable(at_cmd_driver_t *driver)
+{
+    char response[50];
+    mico_bool_t is_active = MICO_FALSE;
+    mico_bool_t is_enabled = mico_ble_get_reliable(&is_active);
+
+    sprintf(response, "%s+LEREL:%s,%s%s",
+            AT_PROMPT,
+            is_enabled ? "ON" : "OFF",
+            is_active ? "ACTIVE" : "INACTIVE",
+            AT_RESPONSE_OK);
+    driver->write((uint8_t *)response, strlen(response));
+}
+
+/**
+ * AT+LEWLNAME=?
+ * 
+ * +LEWLNAME:<name>
+ * OK
+ */
+static void ble_get_whitelist_name(at_cmd_driver_t *driver)
+{
+    char response[50];
+
+    sprintf(response, "%s+LEWLNAME:%s%s",
+            AT_PROMPT,
+            mico_ble_get_device_whitelist_name(),
+            AT_RESPONSE_OK);
+    driver->write((uint8_t *) response, strlen(response));
+}
+
+/**
+ * AT+LEWLNAME=<name>
+ * 
+ * OK or ERR
+ */
+static void ble_set_whitelist_name(at_cmd_driver_t *driver, at_cmd_para_t *para)
+{
+    char response[50];
+
+    if (para->para_num != 1) {
+        sprintf(response, "%s", AT_RESPONSE_ERR);
+        goto exit;
+    }
+
+    char *name = at_cmd_parse_get_string(para->para, 1);
+    if (strlen(name) > BT_DEVICE_NAME_LEN - 1) {
+        sprintf(response, "%s", AT_RESPONSE_ERR);
+        goto exit;
+    }
+
+    if (mico_ble_set_device_whitelist_name(name) != MICO_BT_SUCCESS) {
+        sprintf(response, "%s", AT_RESPONSE_ERR);
+    } else {
+        strcpy(g_ble_context.p_config->whitelist_name, name);
+        at_cmd_config_data_write();
+
+        sprintf(response, "%s", AT_RESPONSE_OK);
+    }
+
+exit:
+    driver->write((uint8_t *) response, strlen(response));
+}
+
+/**
+ * AT+LEWLADD=<prefix>
+ *
+ * +LEWLADD:<count>
+ * OK or ERR
+ */
+static void ble_add_whitelist(at_cmd_driver_t *driver, at_cmd_para_t *para)
+{
+    char response[50];
+
+    if (para->para_num != 1
+        || mico_ble_whitelist_add(at_cmd_parse_get_string(para->para, 1)) != MICO_BT_SUCCESS) {
+        sprintf(response, "%s", AT_RESPONSE_ERR);
+    } else {
+        sprintf(response, "%s+LEWLADD:%u%s", AT_PROMPT, mico_ble_whitelist_count(), AT_RESPONSE_OK);
+    }
+
+    driver->write((uint8_t *) response, strlen(response));
+}
+
+/**
+ * AT+LEWLDEL=<prefix>
+ *
+ * OK or ERR
+ */
+static void ble_del_whitelist(at_cmd_driver_t *driver, at_cmd_para_t *para)
+{
+    char response[50];
+
+    if (para->para_num != 1
+        || mico_ble_whitelist_remove(at_cmd_parse_get_string(para->para, 1)) != MICO_BT_SUCCESS) {
+        sprintf(response, "%s", AT_RESPONSE_ERR);
+    } else {
+        sprintf(response, "%s", AT_RESPONSE_OK);
+    }
+
+    driver->write((uint8_t *) response, strlen(response));
+}
+
+/**
+ * AT+LEWLCLR
+ *
+ * OK or ERR
+ */
+static void ble_clear_whitelist(at_cmd_driver_t *driver)
+{
+    char response[50];
+
+    if (mico_ble_whitelist_clear() != MICO_BT_SUCCESS) {
+        sprintf(response, "%s", AT_RESPONSE_ERR);
+    } else {
+        sprintf(response, "%s", AT_RESPONSE_OK);
+    }
+
+    driver->write((uint8_t *) response, strlen(response));
+}
+
+/* Keep the accept list across reboots. */
+static void ble_save_accept_list(void)
+{
+    g_ble_context.p_config->accept_count = mico_ble_get_accept_list(g_ble_context.p_config->accept_list,
+                                                                    BLE_ACCEPT_LIST_MAX);
+    at_cmd_config_data_write();
+}
+
+/**
+ * AT+LEALADD=<addr>
+ *
+ * +LEALADD:<count>
+ * OK or ERR
+ */
+static void ble_add_accept_list(at_cmd_driver_t *driver, at_cmd_para_t *para)
+{
+    char response[50];
+    mico_bt_device_address_t addr = {0};
+
+    if (para->para_num != 1) {
+        sprintf(response, "%s", AT_RESPONSE_ERR);
+        goto exit;
+    }
+
+    bdaddr_aton(at_cmd_parse_get_string(para->para, 1), addr);
+
+    if (mico_ble_accept_list_add(addr) != MICO_BT_SUCCESS) {
+        sprintf(response, "%s", AT_RESPONSE_ERR);
+    } else {
+        ble_save_accept_list();
+        sprintf(response, "%s+LEALADD:%u%s", AT_PROMPT, mico_ble_accept_list_count(), AT_RESPONSE_OK);
+    }
+
+exit:
+    driver->write((uint8_t *) response, strlen(response));
+}
+
+/**
+ * AT+LEALDEL=<addr>
+ *
+ * OK or ERR
+ */
+static void ble_del_accept_list(at_cmd_driver_t *driver, at_cmd_para_t *para)
+{
+    char response[50];
+    mico_bt_device_address_t addr = {0};
+
+    if (para->para_num != 1) {
+        sprintf(response, "%s", AT_RESPONSE_ERR);
+        goto exit;
+    }
+
+    bdaddr_aton(at_cmd_parse_get_string(para->para, 1), addr);
+
+    if (mico_ble_accept_list_remove(addr) != MICO_BT_SUCCESS) {
+        sprintf(response, "%s", AT_RESPONSE_ERR);
+    } else {
+        ble_save_accept_list();
+        sprintf(response, "%s", AT_RESPONSE_OK);
+    }
+
+exit:
+    driver->write((uint8_t *) response, strlen(response));
+}
+
+/**
+ * AT+LEALCLR
+ *
+ * OK
+ */
+static void ble_clear_accept_list(at_cmd_driver_t *driver)
+{
+    char response[50];
+
+    mico_ble_accept_list_clear();
+    ble_save_accept_list();
+    sprintf(response, "%s", AT_RESPONSE_OK);
     driver->write((uint8_t *) response, strlen(response));
 }
 
+/**
+ * AT+LEALFLT=<ON/OFF>
+ * OK
+ */
+static void ble_set_accept_list_filter(at_cmd_driver_t *driver, at_cmd_para_t *para)
+{
+    char response[50];
+
+    if (para->para_num != 1) {
+        goto err_exit;
+    }
+
+    char *param = at_cmd_parse_get_string(para->para, 1);
+    if (strcmp(param, "ON") == 0) {
+        mico_ble_set_accept_list_filter(MICO_TRUE);
+    } else if (strcmp(param, "OFF") == 0) {
+        mico_ble_set_accept_list_filter(MICO_FALSE);
+    } else {
+        goto err_exit;
+    }
+
+    g_ble_context.p_config->is_accept_filter = mico_ble_get_accept_list_filter();
+    at_cmd_config_data_write();
+    sprintf(response, "%s", AT_RESPONSE_OK);
+    goto exit;
+
+err_exit:
+    sprintf(response, "%s", AT_RESPONSE_ERR);
+
+exit:
+    driver->write((uint8_t *)response, strlen(response));
+}
+
+/**
+ * AT+LEALFLT?
+ * +LEALFLT:<ON/OFF>,<count>
+ * OK
+ */
+static void ble_get_accept_list_filter(at_cmd_driver_t *driver)
+{
+    char response[50];
+
+    sprintf(response, "%s+LEALFLT:%s,%u%s",
+            AT_PROMPT,
+            mico_ble_get_accept_list_filter() ? "ON" : "OFF",
+            mico_ble_accept_list_count(),
+            AT_RESPONSE_OK);
+    driver->write((uint8_t *)response, strlen(response));
+}
+
 /**
  *
  * @param config
@@ -707,5 +2051,27 @@ static mico_bt_result_t ble_default_config(at_cmd_ble_config_t *config)
     config->is_central = MICO_FALSE; /* Default into periphreal */
     config->is_at_mode = MICO_TRUE; /* AT Command Mode for default configuration */
     config->is_enable_event = MICO_TRUE;
+    config->is_framing = MICO_FALSE;
+    config->is_compress = MICO_FALSE;
+    config->conn_profile = BLE_CONN_PROFILE_DEFAULT;
+    config->is_conn_auto = MICO_FALSE;
+    config->transport = BLE_TRANSPORT_GATT;
+    config->is_reliable = MICO_FALSE;
+    config->scan_cfg.is_active = MICO_FALSE;
+    config->scan_cfg.interval = 128;
+    config->scan_cfg.window = 64;
+    config->scan_cfg.duration_second = 5;
+    config->scan_cfg.duty_percent = 100;
+    config->scan_cfg.duty_period_second = 0;
+    config->nearby_order = BLE_NEARBY_BY_RSSI;
+    config->is_report = MICO_TRUE;
+    config->is_raw_report = MICO_FALSE;
+    config->gatt_cache_count = 0;
+    config->reconn_cfg.enable = MICO_FALSE;
+    config->reconn_cfg.backoff_min_ms = 100;
+    config->reconn_cfg.backoff_max_ms = 30000;
+    config->has_last_peer = MICO_FALSE;
+    config->accept_count = 0;
+    config->is_accept_filter = MICO_FALSE;
     return MICO_BT_SUCCESS;
 }
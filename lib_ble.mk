@@ -27,6 +27,7 @@ NAME := Lib_BLE_Component
 $(NAME)_INCLUDES += .
 
 $(NAME)_SOURCES :=  mico_ble_lib.c \
+                    mico_ble_lz.c \
                     at_cmd_ble_command.c \
                     statemachine.c 
 
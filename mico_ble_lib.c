@@ -6,11 +6,13 @@
 #include "mico_bt_cfg.h"
 #include "mico_bt_smartbridge.h"
 #include "mico_bt_peripheral.h"
+#include "mico_bt_l2c.h"
 #include "sdpdefs.h"
 
 #include "statemachine.h"
 
 #include "mico_ble_lib.h"
+#include "mico_ble_lz.h"
 
 #define mico_ble_log(M, ...) custom_log("BLE", M, ##__VA_ARGS__)
 
@@ -19,6 +21,105 @@
  */
 #define BLUETOOTH_PRINT_SERVICE_UUID    0x18F0
 #define BLUETOOTH_PRINT_CHAR_CMD_UUID   0x2AF1
+#define BLUETOOTH_PRINT_CHAR_NOTIFY_UUID 0x2AF0
+
+/* ATT MTU bounds used to size notification chunks (ATT header is 3 bytes) */
+#define BLE_ATT_MTU_DEFAULT             23
+#define BLE_ATT_MTU_MAX                 247
+#define BLE_ATT_HDR_SIZE                3
+
+/* Peripheral TX scheduler: notifications queued back-to-back before yielding to the controller */
+#define BLE_TX_NOTIFY_CREDITS           4
+/* Time to wait for the controller to free a buffer, roughly one connection event */
+#define BLE_TX_CREDIT_WAIT_MS           10
+
+/*
+ * SPP framing. Every fragment starts with a header byte: bit7 marks the first
+ * fragment of a message, bits 0-6 carry a fragment sequence number. The first
+ * fragment additionally carries the message type and the 16-bit little-endian
+ * message length.
+ */
+#define BLE_FRAME_HDR_FIRST             0x80
+#define BLE_FRAME_HDR_SEQ_MASK          0x7F
+#define BLE_FRAME_HDR_SIZE              1
+#define BLE_FRAME_FIRST_HDR_SIZE        4
+#define BLE_FRAME_TYPE_DATA             0x00
+#define BLE_FRAME_TYPE_DATA_LZ          0x01    /* data compressed by mico_ble_lz */
+#define BLE_FRAME_TYPE_CAPS             0x02    /* one capability byte, exchanged after connection */
+#define BLE_FRAME_TYPE_SACK             0x03    /* next expected sequence + bitmap of the 8 fragments after it */
+
+/* Capability bits */
+#define BLE_CAPS_LZ                     0x01
+#define BLE_CAPS_REL                    0x02
+
+/*
+ * Reliable notifications: fragments not yet acknowledged by the central, must
+ * stay well below the 7-bit sequence space. The central acknowledges every
+ * BLE_REL_ACK_EVERY fragments, or BLE_REL_ACK_DELAY_MS after the last one.
+ */
+#define BLE_REL_WINDOW                  8
+#define BLE_REL_RTO_MS                  200
+#define BLE_REL_MAX_RETRIES             10
+#define BLE_REL_ACK_EVERY               4
+#define BLE_REL_ACK_DELAY_MS            20
+
+/* LE credit based L2CAP channel, an alternative SPP transport. PSM is in the dynamic range. */
+#define BLE_COC_PSM                     0x0081
+#define BLE_COC_MTU                     512
+
+/* Long write to SPP IN: the largest value gathered from prepared segments (ATT limit) */
+#define BLE_PREP_WRITE_MAX_SIZE         512
+
+/* Automatic connection profile: fall back to the idle profile after this long without TX */
+#define BLE_CONN_IDLE_TIMEOUT_MS        2000
+
+/* Inbound SPP data ring, power of 2. Event mode stores the length and the connection handle before each record. */
+#define BLE_RX_RING_SIZE                2048
+#define BLE_RX_RING_REC_HDR_SIZE        4
+
+/* Buckets of the central links by connection handle, power of 2 */
+#define BLE_LINK_HASH_SIZE              8
+
+/* Automatic reconnect: high duty directed advertising ends after 1.28s, undirected advertising follows */
+#define BLE_RECONN_DIRECTED_MS          1280
+
+/*
+ * Scan result cache: reports of a known device are suppressed until its
+ * smoothed RSSI moves by BLE_SCAN_RSSI_DELTA or BLE_SCAN_REFRESH_MS passes.
+ * An entry not seen for BLE_SCAN_ENTRY_TTL_MS is free for reuse.
+ */
+#define BLE_SCAN_CACHE_SIZE             128     /* power of 2 */
+#define BLE_SCAN_CACHE_PROBE_MAX        8
+#define BLE_SCAN_RSSI_DELTA             6       /* dB */
+#define BLE_SCAN_RSSI_SHIFT             2       /* EWMA weight of a new sample is 1/4 */
+#define BLE_SCAN_REFRESH_MS             5000
+#define BLE_SCAN_ENTRY_TTL_MS           30000
+#define BLE_NEARBY_PURGE_MS             1000    /* least interval between sweeps of expired devices when full */
+
+/* AD types of the advertising data parser, Core Specification Supplement Part A */
+#define BLE_AD_TYPE_16BIT_UUID_INCOMPLETE       0x02
+#define BLE_AD_TYPE_16BIT_UUID_COMPLETE         0x03
+#define BLE_AD_TYPE_32BIT_UUID_INCOMPLETE       0x04
+#define BLE_AD_TYPE_32BIT_UUID_COMPLETE         0x05
+#define BLE_AD_TYPE_128BIT_UUID_INCOMPLETE      0x06
+#define BLE_AD_TYPE_128BIT_UUID_COMPLETE        0x07
+#define BLE_AD_TYPE_MANUFACTURER                0xFF
+
+/* Scan engine: one scan of a continuous scan lasts this long, then restarts at once */
+#define BLE_SCAN_CONTINUOUS_CHUNK_S     60
+
+/* Whitelist prefix trie, grown by doubling from BLE_WL_NODE_INIT nodes */
+#define BLE_WL_NODE_INIT                64
+#define BLE_WL_NODE_MAX                 4096
+#define BLE_WL_PATTERN_MAX              30      /* longest advertised name kept by the smartbridge */
+
+/* Reassembly pool: the largest framed message is one pool block */
+#define BLE_FRAME_POOL_BLOCK_SIZE       512
+#define BLE_FRAME_POOL_BLOCK_COUNT      4
+
+/* Raw advertising data handed to BLE_EVT_CENTRAL_REPORT, see mico_ble_set_raw_report() */
+#define BLE_ADV_DATA_MAX                31
+#define BLE_ADV_POOL_BLOCK_COUNT        16
 
 /*------------------------------------------------------------------------------------------
  * GATT Service UUID & Handle
@@ -69,41 +170,388 @@ enum {
 #define BLE_SM_EVT_CENTRAL_DISCONNECTED			    10
 #define BLE_SM_EVT_CENTRAL_SCANNED				    11
 
+/* Central link states and events, one state machine per link */
+#define BLE_LINK_STATE_IDLE                     1
+#define BLE_LINK_STATE_CONNECTING               2
+#define BLE_LINK_STATE_CONNECTED                3
+
+#define BLE_LINK_EVT_CONNECT                    1
+#define BLE_LINK_EVT_CONNECTED                  2
+#define BLE_LINK_EVT_CONNECTION_FAIL            3
+#define BLE_LINK_EVT_DISCONNECTED               4
+
 /*------------------------------------------------------------------------------------------
  * Local defined type 
  */
+
+/* Fixed-size block pool, used to hand data to the user layer without malloc() */
+typedef struct {
+    uint8_t             *m_storage;
+    uint16_t             m_block_size;
+    uint8_t              m_block_count;
+    uint32_t             m_free_mask;
+    mico_mutex_t         m_mutex;
+} mico_ble_pool_t;
+
+/*
+ * Byte ring for inbound SPP data, written by the BT stack and read by either
+ * the event worker thread or mico_ble_read(). One producer and one consumer,
+ * so each index is written by one side only. Indexes run freely and are
+ * masked on access. The consumer side holds m_mutex, mico_ble_set_rx_mode()
+ * takes it to move the tail too. The mutex is not held while the user's
+ * callback has a record, a mode switch meanwhile is left to the event worker.
+ */
+typedef struct {
+    uint8_t             *m_buf;
+    uint32_t             m_size;
+    volatile uint32_t    m_head;        /* producer */
+    volatile uint32_t    m_tail;        /* consumer */
+    mico_mutex_t         m_mutex;       /* consumer */
+    mico_bool_t          m_busy;        /* a record is in the user's callback */
+    mico_bool_t          m_reset;       /* mode switched meanwhile, release up to m_reset_tail */
+    uint32_t             m_reset_tail;
+    mico_semaphore_t     m_sem;         /* stream mode: new data arrived */
+    uint32_t             m_dropped;     /* bytes lost because the ring was full */
+} mico_ble_ring_t;
+
+/* Owners of a whitelist pattern, a node is terminal if any is set */
+#define BLE_WL_FLAG_USER                0x01    /* mico_ble_whitelist_add() */
+#define BLE_WL_FLAG_NAME                0x02    /* mico_ble_set_device_whitelist_name() */
+
+/* A node of the whitelist trie, linked by index. Index 0 is the root, so 0 also means none. */
+typedef struct {
+    uint8_t              m_label;
+    uint8_t              m_flags;
+    uint16_t             m_child;           /* first child */
+    uint16_t             m_sibling;         /* next sibling, or next free node */
+} mico_ble_wl_node_t;
+
+/* Prefix trie of the whitelisted device names, matched in one pass over a name */
+typedef struct {
+    mico_ble_wl_node_t  *m_nodes;
+    uint16_t             m_capacity;
+    uint16_t             m_used;            /* nodes ever handed out, including the root */
+    uint16_t             m_free;            /* free list */
+    uint16_t             m_patterns;        /* terminal nodes */
+    mico_mutex_t         m_mutex;
+} mico_ble_wl_t;
+
+/* A device in the scan result cache */
+typedef struct {
+    mico_bt_device_address_t m_addr;
+    mico_bool_t          m_used;
+    int8_t               m_reported_rssi;
+    int16_t              m_rssi;            /* EWMA, dBm << BLE_SCAN_RSSI_SHIFT */
+    uint32_t             m_last_seen;
+    uint32_t             m_last_report;
+    uint8_t              m_nearby;          /* slot in the nearby table + 1, 0 if not in it */
+    uint32_t             m_ad_hash;         /* raw reports: advertising data last reported */
+} mico_ble_scan_entry_t;
+
+/* A device in the nearby table */
+typedef struct {
+    mico_bt_device_address_t m_addr;
+    char                 m_name[31];
+    int8_t               m_rssi;            /* smoothed */
+    uint8_t              m_entry;           /* owner in the scan result cache */
+    uint32_t             m_last_seen;
+} mico_ble_nearby_slot_t;
+
+/*
+ * The BLE_NEARBY_MAX best devices, in a binary min-heap of slot indexes so
+ * the one to replace is at the root. m_pos maps a slot back to its heap
+ * position, so a device is re-sifted in place when its key changes. m_heap
+ * is a permutation of all slots, those past m_count are free.
+ */
+typedef struct {
+    mico_ble_nearby_slot_t m_slots[BLE_NEARBY_MAX];
+    uint8_t              m_heap[BLE_NEARBY_MAX];
+    uint8_t              m_pos[BLE_NEARBY_MAX];
+    uint8_t              m_count;
+    mico_ble_nearby_order_t m_order;
+    uint32_t             m_purged_at;
+    mico_mutex_t         m_mutex;
+} mico_ble_nearby_table_t;
+
+/* SPP handles of known peers, m_entries[0] is the most recently used. */
+typedef struct {
+    mico_ble_gatt_cache_entry_t m_entries[BLE_GATT_CACHE_MAX];
+    uint8_t              m_count;
+    uint32_t             m_hits;
+    uint32_t             m_misses;
+    uint32_t             m_hit_ms;          /* total connect-to-ready time of the hits */
+    uint32_t             m_miss_ms;
+    mico_mutex_t         m_mutex;
+} mico_ble_gatt_cache_t;
+
+/* Phase timing of the recent connect attempts, m_ring[m_next - 1] is the latest. */
+typedef struct {
+    mico_ble_conn_timing_t m_ring[BLE_CONN_TIMING_MAX];   /* age_ms holds the request time */
+    uint8_t              m_next;
+    uint8_t              m_count;
+    mico_ble_conn_hist_t m_hist;
+    mico_mutex_t         m_mutex;
+} mico_ble_conn_timing_log_t;
+
+/* Automatic reconnect to the peer of a connection lost without mico_ble_disconnect() */
+typedef struct {
+    mico_ble_reconn_config_t m_cfg;
+    mico_ble_peer_t      m_last;            /* peer of the last connection */
+    mico_bool_t          m_has_last;
+    mico_bt_device_address_t m_target;      /* central: the peer being reconnected */
+    mico_bool_t          m_is_pending;      /* central: m_target is not connected yet */
+    uint32_t             m_backoff_ms;      /* central: next delay, 0 until the immediate attempt failed */
+    uint32_t             m_timer_ms;        /* central: period of m_timer, 0 if not initialized */
+    mico_timer_t         m_timer;
+    mico_bool_t          m_is_closing;      /* peripheral: disconnected by mico_ble_disconnect() */
+    mico_bt_device_address_t m_direct_addr; /* peripheral: the central being reconnected */
+    mico_bool_t          m_direct_next;     /* peripheral: direct the next advertising toward m_direct_addr */
+    mico_bool_t          m_is_directed;     /* peripheral: directed advertising is on */
+    mico_timer_t         m_directed_timer;
+} mico_ble_reconn_t;
+
+/* Automatic connect, the best match so far is connected when the window ends */
+typedef struct {
+    mico_ble_auto_conn_t m_cond;
+    mico_ble_ad_filter_t m_filter;          /* m_cond.service_uuid as a scan filter */
+    volatile mico_bool_t m_is_armed;
+    mico_bool_t          m_has_best;
+    mico_bt_device_address_t m_best;
+    int8_t               m_best_rssi;
+    uint32_t             m_timer_ms;        /* period of m_timer, 0 if not initialized */
+    mico_timer_t         m_timer;
+} mico_ble_auto_conn_state_t;
+
+/* A worker thread, created at init unless the application's is shared */
+typedef struct {
+    mico_ble_worker_config_t m_cfg;
+    mico_worker_thread_t m_own;
+    mico_worker_thread_t *m_thread;             /* m_own or m_cfg.shared, NULL if not created */
+    uint32_t             m_dropped;
+} mico_ble_worker_t;
+
+/* Reassembly state of the framed SPP channel */
+typedef struct {
+    uint8_t             *m_buf;         /* pool block being filled, NULL if idle */
+    uint16_t             m_length;      /* message length announced by the first fragment */
+    uint16_t             m_received;
+    uint8_t              m_next_seq;
+    uint8_t              m_type;
+} mico_ble_frame_rx_t;
+
+/* Connection parameters of a profile, in HCI units */
+typedef struct {
+    uint16_t             interval_min;          /* 1.25 ms */
+    uint16_t             interval_max;          /* 1.25 ms */
+    uint16_t             latency;               /* connection events */
+    uint16_t             supervision_timeout;   /* 10 ms */
+    uint16_t             ce_length_min;         /* 0.625 ms, only applied when the central connects */
+    uint16_t             ce_length_max;
+} mico_ble_conn_params_t;
+
+/* A fragment held by the reliable notification layer */
+typedef struct {
+    mico_bool_t          m_used;
+    mico_bool_t          m_due;         /* TX: reported missing, retransmit at once */
+    uint8_t              m_seq;
+    uint8_t              m_retries;
+    uint16_t             m_length;
+    uint32_t             m_sent_at;     /* TX: time of the last transmission */
+    uint8_t              m_data[BLE_ATT_MTU_MAX - BLE_ATT_HDR_SIZE];
+} mico_ble_rel_slot_t;
+
+/*
+ * Reliable notification state. The peripheral keeps sent fragments until the
+ * central acknowledges them, the central keeps out-of-order fragments until
+ * the gap is filled. Only the SPP channel is reliable, so the slots are shared.
+ */
+typedef struct {
+    mico_ble_rel_slot_t *m_slots;       /* indexed by seq % BLE_REL_WINDOW */
+    mico_bool_t          m_active;      /* both sides agreed, sequence tracking started */
+    uint8_t              m_base;        /* TX: oldest unacknowledged seq, RX: next expected seq */
+    uint8_t              m_unacked;     /* RX: fragments delivered since the last SACK */
+    mico_bool_t          m_sack_pending;
+    mico_mutex_t         m_mutex;
+    mico_timer_t         m_rtx_timer;
+    mico_timer_t         m_ack_timer;
+} mico_ble_rel_t;
+
+/*
+ * Connection carrying the SPP channel: framing, compression, reliable
+ * notifications and the L2CAP channel. The first connection of either role
+ * takes it, other connections exchange raw data on the SPP characteristics.
+ */
+typedef enum {
+    BLE_SPP_OWNER_NONE,
+    BLE_SPP_OWNER_PERIPHERAL,
+    BLE_SPP_OWNER_CENTRAL,              /* m_primary */
+} mico_ble_spp_owner_t;
+
+/* A central link, the primary one is the link owning the SPP channel. */
+typedef struct {
+    StateMachine         m_sm;              /* instance of the link template */
+    mico_bt_smartbridge_socket_t m_socket;
+    mico_bt_smart_device_t m_peer;
+    uint16_t             m_handle;          /* connection handle, valid while connected */
+    uint32_t             m_request_time;    /* of the connect request */
+    uint16_t             m_attr_handle;     /* value handle of the peer SPP IN */
+    uint16_t             m_notify_handle;   /* value handle of the subscribed characteristic, 0 if none */
+    uint8_t              m_hash_next;       /* next link of the same bucket + 1, 0 if last */
+    mico_bool_t          m_is_closing;      /* disconnected by mico_ble_disconnect(), no reconnect */
+    mico_mutex_t         m_tx_mutex;        /* one message on air per secondary link */
+} mico_ble_link_t;
+
+/*
+ * The peripheral and the central roles are orthogonal regions of the device
+ * state, each one has its own state machine and both may be active at once.
+ */
 typedef struct {
-    StateMachine         m_sm;
-    SmRule               m_rules[20];
+    StateMachine         m_periph_sm;
+    SmRule               m_periph_rules[8];
+    StateMachine         m_central_sm;
+    SmRule               m_central_rules[12];
+    StateMachine         m_link_tmpl;
+    SmRule               m_link_rules[6];
     mico_bool_t          m_is_central;
     mico_bool_t          m_is_initialized;
     mico_ble_evt_cback_t m_cback;
 
     char                *m_wl_name;
-    uint16_t             m_central_attr_handle;
+    mico_ble_wl_t        m_wl;
+    mico_ble_scan_entry_t m_scan_cache[BLE_SCAN_CACHE_SIZE];
+    mico_ble_nearby_table_t m_nearby;
+    mico_bool_t          m_ad_filter_on;
+    mico_bool_t          m_is_raw_report;
+    mico_ble_pool_t      m_adv_pool;        /* raw advertising data of queued reports */
+    mico_ble_scan_config_t m_scan_cfg;
+    mico_bool_t          m_scan_cycling;    /* continuous scan: restart when one scan completes */
+    mico_timer_t         m_scan_rest_timer; /* off period of a duty cycle */
+    uint32_t             m_scan_rest_ms;    /* off period of a duty cycle, 0 if the scan does not rest */
+    uint32_t             m_scan_rest_timer_ms; /* period of m_scan_rest_timer, 0 if not initialized */
+    mico_bt_device_address_t m_accept_list[BLE_ACCEPT_LIST_MAX];
+    uint8_t              m_accept_count;
+    mico_bool_t          m_accept_filter;   /* scan with FILTER_POLICY_WHITE_LIST */
+    mico_ble_ad_filter_t m_ad_filter;
+    mico_mutex_t         m_ad_filter_mutex; /* m_ad_filter and m_ad_filter_on */
+
+    mico_ble_link_t      m_links[BLE_CENTRAL_LINK_MAX];
+    uint8_t              m_link_buckets[BLE_LINK_HASH_SIZE];   /* first link + 1 by connection handle */
+    uint8_t              m_link_count;      /* connected links */
+    mico_ble_gatt_cache_t m_gatt_cache;
+    mico_ble_conn_timing_log_t m_conn_timing;
+    mico_ble_reconn_t    m_reconn;
+    mico_ble_auto_conn_state_t m_auto_conn;
+    mico_ble_link_t     *m_primary;
+    mico_ble_spp_owner_t m_spp_owner;
 
     uint16_t             m_spp_out_cccd_value;
+    uint8_t             *m_prep_buf;    /* prepared write segments of SPP IN, malloc()ed on first use */
+    uint16_t             m_prep_len;
     mico_bt_ext_attribute_value_t *m_spp_out_attribute;
-
-    mico_worker_thread_t m_worker_thread;
-    mico_worker_thread_t m_evt_worker_thread;
-    mico_bt_smartbridge_socket_t m_central_socket;
+    mico_semaphore_t     m_spp_out_conf_sem;    /* the client confirmed an indication */
+
+    uint16_t             m_att_mtu;         /* of the peripheral connection, see mico_ble_set_att_mtu() */
+    mico_ble_tx_stats_t  m_tx_stats;
+
+    mico_ble_rx_mode_t   m_rx_mode;
+    mico_ble_ring_t      m_rx_ring;
+
+    mico_bool_t          m_is_framing;
+    mico_bool_t          m_is_compress;
+    mico_bool_t          m_caps_sent;
+    uint8_t              m_peer_caps;
+    uint8_t              m_frame_tx_seq;
+    mico_ble_frame_rx_t  m_frame_rx;
+    mico_ble_pool_t      m_frame_pool;
+
+    mico_bool_t          m_is_reliable;
+    mico_ble_rel_t       m_rel;
+    mico_mutex_t         m_tx_mutex;    /* one message on air at a time */
+
+    mico_ble_conn_profile_t m_conn_profile;
+    mico_ble_conn_profile_t m_conn_profile_active;
+    mico_bool_t          m_conn_auto;
+    mico_timer_t         m_conn_idle_timer;
+
+    mico_ble_transport_t m_transport;
+    uint16_t             m_coc_cid;         /* local CID of the open channel, 0 if none */
+    uint16_t             m_coc_peer_mtu;
+    volatile mico_bool_t m_coc_congested;   /* out of credits */
+
+    uint8_t              m_thread_count;
+    mico_ble_worker_t    m_workers[BLE_WORKER_MAX];
+    uint32_t           (*m_stack_free)(mico_worker_thread_t *thread);
     mico_bt_peripheral_socket_t  m_peripheral_socket;
 } mico_ble_context_t;
 
+/* Read position in a scatter-gather list */
+typedef struct {
+    const mico_ble_iovec_t *vec;
+    uint32_t                count;
+    uint32_t                index;
+    uint32_t                offset;
+} mico_ble_iov_cursor_t;
+
+/* An outgoing message being cut into chunks */
+typedef struct {
+    mico_ble_iov_cursor_t   cursor;
+    uint32_t                length;
+    uint32_t                remaining;
+    uint8_t                 type;
+    mico_bool_t             is_framed;
+} mico_ble_tx_msg_t;
+
+/* A packaged event posted to the event worker thread */
+typedef struct {
+    mico_ble_event_t        evt;
+    mico_ble_evt_params_t   params;
+    mico_ble_pool_t        *pool;   /* owner of params.u.data.p_data or params.u.report.p_adv_data */
+} mico_ble_evt_msg_t;
+
 /*--------------------------------------------------------------------------------------------
  * Local function prototype
  */
 
-// static mico_bool_t mico_ble_check_uuid(const mico_bt_uuid_t *uuid);
+static mico_bool_t mico_ble_check_uuid(const mico_bt_uuid_t *uuid);
+static OSStatus mico_ble_worker_send(mico_ble_worker_id_t id, event_handler_t handler, void *arg);
 static mico_bool_t mico_ble_post_evt(mico_ble_event_t evt, mico_ble_evt_params_t *parms);
+static mico_bool_t mico_ble_post_data_evt(uint8_t *p_data, uint16_t length, mico_ble_pool_t *pool);
+static mico_bool_t mico_ble_post_rx_evt(uint16_t handle, const uint8_t *p_data, uint16_t length);
+static mico_bool_t mico_ble_post_evt_msg(mico_ble_event_t evt, mico_ble_evt_params_t *parms, mico_ble_pool_t *pool);
+static mico_bt_result_t mico_ble_send_msg(uint8_t type, const mico_ble_iovec_t *vec, uint32_t count, uint32_t timeout_ms);
+static mico_bt_result_t mico_ble_do_send_msg(uint8_t type, const mico_ble_iovec_t *vec, uint32_t count, uint32_t timeout_ms);
+static mico_bt_result_t mico_ble_link_write(mico_ble_link_t *link, mico_ble_tx_msg_t *msg);
+static uint16_t mico_ble_spp_handle(void);
+static void mico_ble_spp_attach(mico_ble_link_t *link);
+static void mico_ble_spp_detach(mico_ble_link_t *leaving);
 static mico_bt_result_t mico_ble_set_device_discovery(mico_bool_t start);
 static mico_bt_result_t mico_ble_set_device_scan(mico_bool_t start);
-
+static OSStatus mico_ble_central_scan_complete_handler(void *arg);
+static OSStatus mico_ble_central_scan_result_handler(const mico_bt_smart_advertising_report_t *scan_result);
+static void mico_ble_reconn_schedule(void);
+static void mico_ble_reconn_on_connected(mico_ble_role_t role, const uint8_t *bdaddr);
+static void mico_ble_reconn_on_lost(mico_ble_role_t role, const uint8_t *bdaddr);
+static mico_bool_t mico_ble_reconn_start_directed(void);
+static void mico_ble_auto_conn_check(const mico_bt_smart_advertising_report_t *scan_result);
+static void mico_ble_auto_conn_cancel(void);
+
+static uint32_t mico_ble_iov_length(const mico_ble_iovec_t *vec, uint32_t count);
+static const uint8_t *mico_ble_iov_gather(const mico_ble_iov_cursor_t *cursor, uint8_t *staging, uint32_t length);
+static uint32_t mico_ble_iov_copy(mico_ble_iov_cursor_t *cursor, uint8_t *dst, uint32_t length);
+static void mico_ble_iov_advance(mico_ble_iov_cursor_t *cursor, uint32_t length);
+
+static void mico_ble_rel_reset(void);
+static void mico_ble_rel_start(void);
+static void mico_ble_rel_on_sack(uint8_t next_seq, uint8_t bitmap);
+static void mico_ble_rel_rx(const uint8_t *p_data, uint16_t length);
+
+static OSStatus mico_ble_peripheral_send_chunk(const uint8_t *p_data, uint16_t length);
 static mico_bt_gatt_status_t mico_ble_periphreal_spp_data_in_callback(mico_bt_ext_attribute_value_t *attribute, 
                                                                       mico_bt_gatt_request_type_t op);
 static mico_bt_gatt_status_t mico_ble_periphreal_spp_cccd_callback(mico_bt_ext_attribute_value_t *attribute, 
                                                                    mico_bt_gatt_request_type_t op);
+static mico_bt_gatt_status_t mico_ble_periphreal_spp_out_callback(mico_bt_ext_attribute_value_t *attribute,
+                                                                  mico_bt_gatt_request_type_t op);
 
 /*---------------------------------------------------------------------------------------------
  * Central local resource
@@ -119,6 +567,12 @@ static mico_bt_uuid_t g_central_whitelist_char_uuid = {
     .uu.uuid16 = BLUETOOTH_PRINT_CHAR_CMD_UUID,
 };
 
+/* Characteristic subscribed for peer data, in the same service as the whitelist characteristic */
+static mico_bt_uuid_t g_central_notify_char_uuid = {
+    .len = LEN_UUID_16,
+    .uu.uuid16 = BLUETOOTH_PRINT_CHAR_NOTIFY_UUID,
+};
+
 static const mico_bt_smart_security_settings_t g_central_security_settings = {
     .timeout_second = 10,
     .io_capabilities = BT_SMART_IO_NO_INPUT_NO_OUTPUT,
@@ -141,16 +595,70 @@ static const mico_bt_smart_connection_settings_t g_central_connection_settings =
     .attribute_protocol_timeout_ms = 1000,
 };
 
-/* SmartBridge auto scan settings */
+/* Indexed by mico_ble_conn_profile_t */
+static const mico_ble_conn_params_t g_conn_profiles[BLE_CONN_PROFILE_MAX] = {
+    [BLE_CONN_PROFILE_DEFAULT] = {
+        .interval_min = MICO_BT_CFG_DEFAULT_CONN_MIN_INTERVAL,
+        .interval_max = MICO_BT_CFG_DEFAULT_CONN_MAX_INTERVAL,
+        .latency = MICO_BT_CFG_DEFAULT_CONN_LATENCY,
+        .supervision_timeout = MICO_BT_CFG_DEFAULT_CONN_SUPERVISION_TIMEOUT,
+        .ce_length_min = 0,
+        .ce_length_max = 0,
+    },
+    /* 7.5 ~ 15 ms, the connection event may fill the whole interval */
+    [BLE_CONN_PROFILE_THROUGHPUT] = {
+        .interval_min = 6,
+        .interval_max = 12,
+        .latency = 0,
+        .supervision_timeout = MICO_BT_CFG_DEFAULT_CONN_SUPERVISION_TIMEOUT,
+        .ce_length_min = 12,
+        .ce_length_max = 24,
+    },
+    /* 400 ~ 500 ms, the peripheral may skip 4 events: supervision must exceed 2 * 5 * 500 ms */
+    [BLE_CONN_PROFILE_IDLE] = {
+        .interval_min = 320,
+        .interval_max = 400,
+        .latency = 4,
+        .supervision_timeout = 600,
+        .ce_length_min = 0,
+        .ce_length_max = 0,
+    },
+};
+
+/* SmartBridge auto scan settings, the rest comes from mico_ble_scan_config_t */
 static const mico_bt_smart_scan_settings_t g_central_scan_settings = {
    .type              = BT_SMART_PASSIVE_SCAN,
    .filter_policy     = FILTER_POLICY_NONE,
-   .filter_duplicates = DUPLICATES_FILTER_ENABLED,
+   .filter_duplicates = DUPLICATES_FILTER_DISABLED,    /* see mico_ble_scan_cache_update() */
    .interval          = 128,
    .window            = 64,
    .duration_second   = 5,
 };
 
+static const mico_ble_scan_config_t g_scan_config_default = {
+    .is_active          = MICO_FALSE,
+    .interval           = 128,
+    .window             = 64,
+    .duration_second    = 5,
+    .duty_percent       = 100,
+    .duty_period_second = 0,
+};
+
+static const mico_ble_reconn_config_t g_reconn_config_default = {
+    .enable             = MICO_FALSE,
+    .backoff_min_ms     = 100,
+    .backoff_max_ms     = 30000,
+};
+
+static const mico_ble_executor_config_t g_executor_config_default = {
+    .thread_count       = 2,
+    .workers            = {
+        [BLE_WORKER_TASK]  = { NULL, MICO_APPLICATION_PRIORITY, 2048, 10 },
+        [BLE_WORKER_EVENT] = { NULL, MICO_APPLICATION_PRIORITY, 2048, 10 },
+    },
+    .stack_free         = NULL,
+};
+
 /*--------------------------------------------------------------------------------------------
  * Peripheral local resource
  * 
@@ -199,7 +707,8 @@ static const uint8_t g_peripheral_gatt_database[] = {
                                         HDLC_SPP_IN_VALUE,
                                         UUID_SPP_SERVICE_CHARACTERISTIC_IN,
                                         LEGATTDB_CHAR_PROP_WRITE, 
-                                        LEGATTDB_PERM_WRITE_CMD | LEGATTDB_PERM_WRITE_REQ),
+                                        LEGATTDB_PERM_VARIABLE_LENGTH | LEGATTDB_PERM_WRITE_CMD |
+                                        LEGATTDB_PERM_WRITE_REQ | LEGATTDB_PERM_RELIABLE_WRITE),
 
         CHAR_DESCRIPTOR_UUID16(HDLC_SPP_IN_DESCRIPTION, 
                                GATT_UUID_CHAR_DESCRIPTION,
@@ -246,930 +755,5625 @@ static const char *g_eventTypeNameTabl[] = {
     "BLE_SM_EVT_CENTRAL_SCANNED"
 };
 
+static const char *g_linkStateNameTab[] = {
+    "",
+    "BLE_LINK_STATE_IDLE",
+    "BLE_LINK_STATE_CONNECTING",
+    "BLE_LINK_STATE_CONNECTED"
+};
+
+static const char *g_linkEventTypeNameTab[] = {
+    "",
+    "BLE_LINK_EVT_CONNECT",
+    "BLE_LINK_EVT_CONNECTED",
+    "BLE_LINK_EVT_CONNECTION_FAIL",
+    "BLE_LINK_EVT_DISCONNECTED"
+};
+
 static mico_ble_context_t g_ble_context;
 
 /*---------------------------------------------------------------------------------------------
- * Peripheral function definition 
+ * SPP data channel function definition
  */
 
-static void mico_ble_peripheral_create_attribute_db(void)
+static OSStatus mico_ble_pool_init(mico_ble_pool_t *pool, uint16_t block_size, uint8_t block_count)
 {
-    extern mico_bt_cfg_settings_t   mico_bt_cfg_settings;
+    OSStatus err = kNoErr;
 
-    /* Create BLE GATT value database */
-    // ***** Primary service 'Generic Attribute'
-    mico_bt_peripheral_ext_attribute_add(HDLC_GENERIC_ATTRIBUTE_SERVICE_CHANGED_VALUE, 0, NULL, NULL);
+    if (pool->m_storage) {
+        return kNoErr;
+    }
 
-    // ***** Primary service 'Generic Access'
-    mico_bt_peripheral_ext_attribute_add(HDLC_GENERIC_ACCESS_DEVICE_NAME_VALUE, 
-                                         (uint16_t)strlen((char *)mico_bt_cfg_settings.device_name),
-                                         mico_bt_cfg_settings.device_name, 
-                                         NULL);
-    mico_bt_peripheral_ext_attribute_add(HDLC_GENERIC_ACCESS_APPEARANCE_VALUE, 
-                                         sizeof(g_peripheral_appearance_name), 
-                                         g_peripheral_appearance_name, 
-                                         NULL);
+    err = mico_rtos_init_mutex(&pool->m_mutex);
+    require_noerr(err, exit);
 
-    // ***** Primary service 'SPP' (Vender specific)
-    mico_bt_peripheral_ext_attribute_add(HDLC_SPP_IN_VALUE, 0, NULL, mico_ble_periphreal_spp_data_in_callback);
-    mico_bt_peripheral_ext_attribute_add(HDLC_SPP_IN_DESCRIPTION,
-                                         (uint16_t)strlen("SPP Data IN"),
-                                         (uint8_t *)"SPP Data IN", NULL);
+    pool->m_storage = (uint8_t *)malloc((size_t)block_size * block_count);
+    require_action(pool->m_storage, exit, mico_rtos_deinit_mutex(&pool->m_mutex); err = kNoMemoryErr);
 
-    g_ble_context.m_spp_out_attribute = mico_bt_peripheral_ext_attribute_add(HDLC_SPP_OUT_VALUE, 0, NULL, NULL );
-    mico_bt_peripheral_ext_attribute_add(HDLC_SPP_OUT_CCC_DESCRIPTION, 2,
-                                         (uint8_t *)&g_ble_context.m_spp_out_cccd_value,
-                                         mico_ble_periphreal_spp_cccd_callback);
-    mico_bt_peripheral_ext_attribute_add(HDLC_SPP_OUT_DESCRIPTION,
-                                         (uint16_t)strlen("SPP Data OUT"),
-                                         (uint8_t *)"SPP Data OUT",
-                                         NULL);
+    pool->m_block_size = block_size;
+    pool->m_block_count = block_count;
+    pool->m_free_mask = (block_count >= 32) ? 0xFFFFFFFF : ((1UL << block_count) - 1);
 
-    mico_bt_peripheral_ext_attribute_find_by_handle(HDLC_SPP_OUT_VALUE, &g_ble_context.m_spp_out_attribute);
+exit:
+    return err;
 }
 
-static mico_bt_result_t mico_ble_peripheral_set_advertisement_data(void)
+static uint8_t *mico_ble_pool_alloc(mico_ble_pool_t *pool)
 {
-    OSStatus err;
-    mico_bt_ble_advert_data_t adv_data;
+    uint8_t *block = NULL;
+    uint8_t i;
 
-     mico_bt_ble_128service_t adver_services_128 = {
-         .list_cmpl = false,
-         .uuid128 = { UUID_SPP_SERVICE },
-     };
-
-    adv_data.flag = BTM_BLE_GENERAL_DISCOVERABLE_FLAG | BTM_BLE_BREDR_NOT_SUPPORTED;
-    adv_data.p_services_128b = &adver_services_128;
-    
-    err = mico_bt_ble_set_advertisement_data(BTM_BLE_ADVERT_BIT_DEV_NAME 
-                                             | BTM_BLE_ADVERT_BIT_SERVICE_128
-                                             | BTM_BLE_ADVERT_BIT_FLAGS, 
-                                             &adv_data);
-    require_noerr_string(err, exit, "Set Advertisement Data failed");
-
-    err = mico_bt_ble_set_scan_response_data(BTM_BLE_ADVERT_BIT_DEV_NAME, &adv_data);
-    require_noerr_string(err, exit, "Set Advertisement ScanRsp Data failed");
+    if (!pool->m_storage) {
+        return NULL;
+    }
 
-exit:
-    return (mico_bt_result_t)err;
+    mico_rtos_lock_mutex(&pool->m_mutex);
+    for (i = 0; i < pool->m_block_count; i++) {
+        if (pool->m_free_mask & (1UL << i)) {
+            pool->m_free_mask &= ~(1UL << i);
+            block = pool->m_storage + (uint32_t)i * pool->m_block_size;
+            break;
+        }
+    }
+    mico_rtos_unlock_mutex(&pool->m_mutex);
+    return block;
 }
 
-static OSStatus mico_ble_peripheral_advertisement_complete_handler(void *arg)
+static void mico_ble_pool_free(mico_ble_pool_t *pool, uint8_t *block)
 {
-    UNUSED_PARAMETER(arg);
+    uint32_t i = (uint32_t)(block - pool->m_storage) / pool->m_block_size;
 
-    if (SM_InState(&g_ble_context.m_sm, BLE_STATE_PERIPHERAL_ADVERTISING)) {
-        return mico_ble_set_device_discovery(MICO_TRUE);
-    }
-    return kNoErr;
+    mico_rtos_lock_mutex(&pool->m_mutex);
+    pool->m_free_mask |= (1UL << i);
+    mico_rtos_unlock_mutex(&pool->m_mutex);
 }
 
-static OSStatus mico_ble_peripheral_connect_handler(mico_bt_peripheral_socket_t *socket)
+static OSStatus mico_ble_ring_init(mico_ble_ring_t *ring, uint32_t size)
 {
-    UNUSED_PARAMETER(socket);
+    OSStatus err = kNoErr;
 
-    mico_ble_log("Connection up [peripheral]");
+    err = mico_rtos_init_semaphore(&ring->m_sem, 1);
+    require_noerr(err, exit);
+    err = mico_rtos_init_mutex(&ring->m_mutex);
+    require_noerr_action(err, exit, mico_rtos_deinit_semaphore(&ring->m_sem));
 
-    mico_bt_peripheral_stop_advertisements();
+    ring->m_buf = (uint8_t *)malloc(size);
+    require_action(ring->m_buf, exit,
+                   mico_rtos_deinit_mutex(&ring->m_mutex); mico_rtos_deinit_semaphore(&ring->m_sem); err = kNoMemoryErr);
 
-    if (SM_InState(&g_ble_context.m_sm, BLE_STATE_PERIPHERAL_ADVERTISING)) {
-        SM_Handle(&g_ble_context.m_sm, BLE_SM_EVT_PERIPHERAL_CONNECTED);
-    }
+    ring->m_size = size;
+    ring->m_head = 0;
+    ring->m_tail = 0;
 
-    return kNoErr;
+exit:
+    return err;
 }
 
-static OSStatus mico_ble_peripheral_disconnect_handler(mico_bt_peripheral_socket_t *socket)
+static void mico_ble_ring_deinit(mico_ble_ring_t *ring)
 {
-    UNUSED_PARAMETER(socket);
-
-    mico_ble_log("Connection down [periphreal]");
-
-    if (SM_InState(&g_ble_context.m_sm, BLE_STATE_PERIPHERAL_CONNECTED)) {
-        SM_Handle(&g_ble_context.m_sm, BLE_SM_EVT_PERIPHERAL_DISCONNECTED);
-    }
-
-    return kNoErr;
+    free(ring->m_buf);
+    ring->m_buf = NULL;
+    mico_rtos_deinit_mutex(&ring->m_mutex);
+    mico_rtos_deinit_semaphore(&ring->m_sem);
 }
 
-static mico_bt_gatt_status_t mico_ble_periphreal_spp_data_in_callback(mico_bt_ext_attribute_value_t *attribute, 
-                                                                      mico_bt_gatt_request_type_t op)
+/* Producer: copy as many bytes as fit, wrapping around the end. */
+static uint32_t mico_ble_ring_write(mico_ble_ring_t *ring, const uint8_t *p_data, uint32_t length)
 {
-    mico_ble_evt_params_t evt;
-
-    if (op == GATTS_REQ_TYPE_WRITE) {
-        evt.u.data.length = attribute->value_length;
-        evt.u.data.p_data = attribute->p_value;
-        mico_ble_post_evt(BLE_EVT_DATA, &evt);
-        return MICO_BT_GATT_SUCCESS;
-    } else {
-        return MICO_BT_GATT_ERROR;
-    }
+    uint32_t head = ring->m_head;
+    uint32_t offset = head & (ring->m_size - 1);
+    uint32_t n = MIN(length, ring->m_size - (head - ring->m_tail));
+    uint32_t first = MIN(n, ring->m_size - offset);
+
+    memcpy(ring->m_buf + offset, p_data, first);
+    memcpy(ring->m_buf, p_data + first, n - first);
+    ring->m_head = head + n;
+    return n;
 }
 
-static mico_bt_gatt_status_t mico_ble_periphreal_spp_cccd_callback(mico_bt_ext_attribute_value_t *attribute, 
-                                                                   mico_bt_gatt_request_type_t op)
+/* Consumer: copy out as many bytes as are available, up to length. */
+static uint32_t mico_ble_ring_read(mico_ble_ring_t *ring, uint8_t *p_data, uint32_t length)
 {
-    if (op == GATTS_REQ_TYPE_READ) {
-        return MICO_BT_GATT_SUCCESS;
-    } else if (op == GATTS_REQ_TYPE_WRITE) {
-        if (attribute->value_length != 2) {
-            return MICO_BT_GATT_INVALID_ATTR_LEN;
-        }
-        g_ble_context.m_spp_out_cccd_value = attribute->p_value[0] | (attribute->p_value[1] << 8);
-        return MICO_BT_GATT_SUCCESS;
-    } else {
-        return MICO_BT_GATT_ERROR;
-    }
+    uint32_t tail = ring->m_tail;
+    uint32_t offset = tail & (ring->m_size - 1);
+    uint32_t n = MIN(length, ring->m_head - tail);
+    uint32_t first = MIN(n, ring->m_size - offset);
+
+    memcpy(p_data, ring->m_buf + offset, first);
+    memcpy(p_data + first, ring->m_buf, n - first);
+    ring->m_tail = tail + n;
+    return n;
 }
 
-static mico_bt_result_t mico_ble_peripheral_device_init(void)
+/*
+ * Producer: store a record to be handed to the user in place, so it never
+ * wraps. If it does not fit before the end, the tail of the ring is skipped
+ * and released together with the record by the consumer.
+ */
+static mico_bool_t mico_ble_ring_put_record(mico_ble_ring_t *ring, uint16_t handle, const uint8_t *p_data, uint16_t length, uint32_t *offset)
 {
-    OSStatus err = mico_bt_peripheral_init(&g_ble_context.m_peripheral_socket, 
-                                           &g_central_security_settings, 
-                                           mico_ble_peripheral_connect_handler,
-                                           mico_ble_peripheral_disconnect_handler,
-                                           NULL);
-    require_noerr(err, exit);
+    uint32_t head = ring->m_head;
+    uint32_t need = BLE_RX_RING_REC_HDR_SIZE + (uint32_t)length;
+    uint32_t contig = ring->m_size - (head & (ring->m_size - 1));
+    uint8_t *rec;
 
-    /* Build BT Stack layer GATT database */
-    err = mico_bt_gatt_db_init(g_peripheral_gatt_database, sizeof(g_peripheral_gatt_database));
-    require_noerr(err, exit);
-
-    /* Build BT Application layer GATT database */
-    mico_ble_peripheral_create_attribute_db();
+    if (need > contig) {
+        head += contig;
+    }
+    if (head - ring->m_tail + need > ring->m_size) {
+        return MICO_FALSE;
+    }
 
-    /* Set advertisement parameters and data payload */
-    mico_ble_peripheral_set_advertisement_data();
+    rec = ring->m_buf + (head & (ring->m_size - 1));
+    rec[0] = (uint8_t)(length & 0xFF);
+    rec[1] = (uint8_t)(length >> 8);
+    rec[2] = (uint8_t)(handle & 0xFF);
+    rec[3] = (uint8_t)(handle >> 8);
+    memcpy(rec + BLE_RX_RING_REC_HDR_SIZE, p_data, length);
 
-exit:
-    return (mico_bt_result_t)err;
+    *offset = head;
+    ring->m_head = head + need;
+    return MICO_TRUE;
 }
 
-/* State translate action. */
-static mico_bool_t app_peripheral_start_advertising(void *context)
+/* Stream mode: queue data for mico_ble_read(). */
+static void mico_ble_rx_stream_put(const uint8_t *p_data, uint32_t length)
 {
-    UNUSED_PARAMETER(context);
+    mico_ble_ring_t *ring = &g_ble_context.m_rx_ring;
+    uint32_t n = mico_ble_ring_write(ring, p_data, length);
 
-    /* Start advertising proceudre */
-    mico_bt_result_t err = mico_ble_set_device_discovery(MICO_TRUE);
-    if (err != MICO_BT_SUCCESS) {
-        return MICO_FALSE;
+    if (n < length) {
+        ring->m_dropped += length - n;
+        mico_ble_log("RX ring full, %lu bytes dropped", (unsigned long)(length - n));
+    }
+    if (n > 0) {
+        mico_rtos_set_semaphore(&ring->m_sem);
     }
-    
-    /* notify user latyer */
-    mico_ble_post_evt(BLE_EVT_PERIPHREAL_ADV_START, NULL);
-
-    return MICO_TRUE;
 }
 
-static mico_bool_t app_peripheral_connected(void *context)
+/* Drop any partially received message and restart both sequence counters. */
+static void mico_ble_frame_reset(void)
 {
-    mico_ble_evt_params_t evt_params;
-
-    UNUSED_PARAMETER(context);
-
-    /* 发送LEADV=OFF消息 */
-    mico_ble_post_evt(BLE_EVT_PERIPHERAL_ADV_STOP, NULL);
-    
-    /* 发送LECONN=SLAVE,ON消息 */
-    memcpy(evt_params.bd_addr, g_ble_context.m_peripheral_socket.remote_device.address, 6);
-    evt_params.u.conn.handle = g_ble_context.m_peripheral_socket.connection_handle;
-    mico_ble_post_evt(BLE_EVT_PERIPHERAL_CONNECTED, &evt_params);
-    
-    return TRUE;
+    if (g_ble_context.m_frame_rx.m_buf) {
+        mico_ble_pool_free(&g_ble_context.m_frame_pool, g_ble_context.m_frame_rx.m_buf);
+    }
+    memset(&g_ble_context.m_frame_rx, 0, sizeof(g_ble_context.m_frame_rx));
+    g_ble_context.m_frame_tx_seq = 0;
+    g_ble_context.m_peer_caps = 0;
+    g_ble_context.m_caps_sent = MICO_FALSE;
+    mico_ble_rel_reset();
 }
 
-static mico_bool_t app_peripheral_disconnected(void *context)
+static mico_bool_t mico_ble_compress_is_active(void)
 {
-    /* 发送LECONN=SLAVE,OFF消息 */
-    mico_ble_evt_params_t evt_params;
-
-    UNUSED_PARAMETER(context);
-
-    memcpy(evt_params.bd_addr, g_ble_context.m_peripheral_socket.remote_device.address, 6);
-    evt_params.u.disconn.handle = g_ble_context.m_peripheral_socket.connection_handle;
-    mico_ble_post_evt(BLE_EVT_PERIPHERAL_DISCONNECTED, &evt_params);
-    return TRUE;
+    return g_ble_context.m_is_framing && g_ble_context.m_is_compress
+           && (g_ble_context.m_peer_caps & BLE_CAPS_LZ);
 }
 
-/*----------------------------------------------------------------------------------------------
- * Central function definition 
+/*
+ * Send local capability byte to the peer, executed in worker thread. The
+ * peer may have announced its capabilities before ours changed and will not
+ * answer again, so reliable mode is started from what it sent last.
  */
-
-static OSStatus mico_ble_central_scan_complete_handler(void *arg)
+static OSStatus mico_ble_caps_send_handler(void *arg)
 {
+    uint8_t caps = (g_ble_context.m_is_compress ? BLE_CAPS_LZ : 0)
+                   | (g_ble_context.m_is_reliable ? BLE_CAPS_REL : 0);
+    mico_ble_iovec_t vec = {
+        .p_data = &caps,
+        .length = 1,
+    };
+
     UNUSED_PARAMETER(arg);
 
-    if (SM_InState(&g_ble_context.m_sm, BLE_STATE_CENTRAL_SCANNING)) {
-        SM_Handle(&g_ble_context.m_sm, BLE_SM_EVT_CENTRAL_SCANNED);
+    if (g_ble_context.m_is_framing && !g_ble_context.m_caps_sent
+        && mico_ble_send_msg(BLE_FRAME_TYPE_CAPS, &vec, 1, 1000) == MICO_BT_SUCCESS) {
+        g_ble_context.m_caps_sent = MICO_TRUE;
+        mico_ble_rel_start();
     }
     return kNoErr;
 }
 
-static OSStatus mico_ble_central_scan_result_handler(const mico_bt_smart_advertising_report_t *scan_result)
+/*
+ * Start the capability exchange. Either side may begin once it is able to
+ * send; the receiver of a capability byte answers with its own.
+ */
+static void mico_ble_caps_exchange(void)
 {
-    char str_addr[BDADDR_NTOA_SIZE] = {0};
-    mico_ble_evt_params_t evt_params;
-
-    if (scan_result->signal_strength >= 0) {
-        return kUnknownErr;
+    if (g_ble_context.m_is_framing && !g_ble_context.m_caps_sent) {
+        mico_ble_worker_send(BLE_WORKER_TASK, mico_ble_caps_send_handler, NULL);
     }
+}
 
-    if (scan_result->event == BT_SMART_CONNECTABLE_UNDIRECTED_ADVERTISING_EVENT) {
+/* Handle a complete framed message, the pool block is consumed. */
+static void mico_ble_frame_dispatch(uint8_t type, uint8_t *buf, uint16_t length)
+{
+    uint8_t *out = NULL;
+    uint32_t out_len = 0;
+
+    switch (type) {
+        case BLE_FRAME_TYPE_DATA:
+            /* The pool block is owned by the event from now on. */
+            if (mico_ble_post_data_evt(buf, length, &g_ble_context.m_frame_pool)) {
+                buf = NULL;
+            }
+            break;
+        case BLE_FRAME_TYPE_DATA_LZ:
+            out = mico_ble_pool_alloc(&g_ble_context.m_frame_pool);
+            if (!out) {
+                mico_ble_log("Frame: no free buffer for decompression, message dropped");
+                break;
+            }
+            out_len = mico_ble_lz_decompress(buf, length, out, g_ble_context.m_frame_pool.m_block_size);
+            if (out_len == 0) {
+                mico_ble_log("Frame: corrupted compressed message dropped");
+                mico_ble_pool_free(&g_ble_context.m_frame_pool, out);
+            } else if (!mico_ble_post_data_evt(out, (uint16_t)out_len, &g_ble_context.m_frame_pool)) {
+                mico_ble_pool_free(&g_ble_context.m_frame_pool, out);
+            }
+            break;
+        case BLE_FRAME_TYPE_CAPS:
+            g_ble_context.m_peer_caps = buf[0];
+            mico_ble_log("Frame: peer capabilities 0x%02x", g_ble_context.m_peer_caps);
+            mico_ble_rel_start();
+            mico_ble_caps_exchange();
+            break;
+        case BLE_FRAME_TYPE_SACK:
+            if (length >= 2) {
+                mico_ble_rel_on_sack(buf[0], buf[1]);
+            }
+            break;
+        default:
+            break;
+    }
 
-        mico_ble_log("Scan result: %s", bdaddr_ntoa(scan_result->remote_device.address, str_addr));
-        memset(&evt_params, 0, sizeof(evt_params));
+    if (buf) {
+        mico_ble_pool_free(&g_ble_context.m_frame_pool, buf);
+    }
+}
 
-        if ((!g_ble_context.m_wl_name && strlen(scan_result->remote_device.name) > 0)
-            || (g_ble_context.m_wl_name 
-                && memcmp(g_ble_context.m_wl_name, scan_result->remote_device.name, strlen(g_ble_context.m_wl_name)) == 0)) {
+/*
+ * Cut the next chunk (at most chunk_size bytes on air) out of an outgoing
+ * message. Without framing, a chunk inside one fragment is returned by
+ * pointer; otherwise it is built in staging. NULL if a framed chunk has no
+ * room for payload after its header, the message is left untouched then.
+ */
+static const uint8_t *mico_ble_tx_next_chunk(mico_ble_tx_msg_t *msg, uint8_t *staging, uint16_t chunk_size, uint16_t *chunk_len)
+{
+    const uint8_t *chunk = staging;
+    uint16_t hdr_len = 0;
+    uint16_t n;
+
+    if (msg->is_framed) {
+        hdr_len = (msg->remaining == msg->length) ? BLE_FRAME_FIRST_HDR_SIZE : BLE_FRAME_HDR_SIZE;
+        if (chunk_size <= hdr_len) {
+            *chunk_len = 0;
+            return NULL;
+        }
 
-            memcpy(evt_params.bd_addr, scan_result->remote_device.address, 6);
-            strcpy(evt_params.u.report.name, scan_result->remote_device.name);
-            evt_params.u.report.rssi = scan_result->signal_strength;
-            mico_ble_post_evt(BLE_EVT_CENTRAL_REPORT, &evt_params);
+        staging[0] = (uint8_t)(g_ble_context.m_frame_tx_seq++ & BLE_FRAME_HDR_SEQ_MASK);
+        if (msg->remaining == msg->length) {
+            staging[0] |= BLE_FRAME_HDR_FIRST;
+            staging[1] = msg->type;
+            staging[2] = (uint8_t)(msg->length & 0xFF);
+            staging[3] = (uint8_t)(msg->length >> 8);
         }
+        n = (uint16_t)MIN((uint32_t)(chunk_size - hdr_len), msg->remaining);
+        mico_ble_iov_copy(&msg->cursor, staging + hdr_len, n);
+    } else {
+        n = (uint16_t)MIN(chunk_size, msg->remaining);
+        chunk = mico_ble_iov_gather(&msg->cursor, staging, n);
+        mico_ble_iov_advance(&msg->cursor, n);
     }
-    return kNoErr;
+
+    msg->remaining -= n;
+    *chunk_len = (uint16_t)(hdr_len + n);
+    return chunk;
 }
 
-static OSStatus mico_ble_central_disconnection_handler(mico_bt_smartbridge_socket_t *socket)
+/* Account the time spent in a send into the throughput statistics. */
+static void mico_ble_tx_stats_account(uint32_t start)
 {
-    UNUSED_PARAMETER(socket);
-
-    mico_ble_log("smartbridge device disconnected.");
-
-    if (SM_InState(&g_ble_context.m_sm, BLE_STATE_CENTRAL_CONNECTED)) {
-        SM_Handle(&g_ble_context.m_sm, BLE_SM_EVT_CENTRAL_DISCONNECTED);
+    g_ble_context.m_tx_stats.elapsed_ms += mico_rtos_get_time() - start;
+    if (g_ble_context.m_tx_stats.elapsed_ms > 0) {
+        g_ble_context.m_tx_stats.bytes_per_sec = (uint32_t)((uint64_t)g_ble_context.m_tx_stats.bytes * 1000
+                                                            / g_ble_context.m_tx_stats.elapsed_ms);
     }
-    return kNoErr;
 }
 
-static OSStatus mico_ble_central_connect_handler(void *arg)
+/* Reassemble one fragment of the framed SPP channel. */
+static void mico_ble_frame_rx(const uint8_t *p_data, uint16_t length)
 {
-    OSStatus ret = MICO_BT_BADOPTION;
-    mico_bt_smartbridge_socket_status_t status;
-    mico_bt_smart_device_t *remote_device = (mico_bt_smart_device_t *)arg;
+    mico_ble_frame_rx_t *rx = &g_ble_context.m_frame_rx;
+    uint8_t hdr;
+    uint16_t n;
 
-    if (SM_InState(&g_ble_context.m_sm, BLE_STATE_CENTRAL_CONNECTING)) {
-        mico_bt_smartbridge_get_socket_status(&g_ble_context.m_central_socket, &status);
-        if (status == SMARTBRIDGE_SOCKET_DISCONNECTED) {
-            if (g_central_security_settings.authentication_requirements != BT_SMART_AUTH_REQ_NONE) {
-                if (mico_bt_dev_find_bonded_device((uint8_t *)remote_device->address) == MICO_FALSE) {
-                    mico_ble_log("Bond info not found. Initiate pairing request.");
-                    mico_bt_smartbridge_enable_pairing(&g_ble_context.m_central_socket, &g_central_security_settings, NULL);
-                } else {
-                    mico_ble_log("Bond info found. Encrypt use bond info.");
-                    mico_bt_smartbridge_set_bond_info(&g_ble_context.m_central_socket, &g_central_security_settings, NULL);
-                }
-            }
+    if (length < BLE_FRAME_HDR_SIZE) {
+        return;
+    }
+    hdr = p_data[0];
 
-            /* Connecting */
-            ret = mico_bt_smartbridge_connect(&g_ble_context.m_central_socket, 
-                                              remote_device,
-                                              &g_central_connection_settings, 
-                                              mico_ble_central_disconnection_handler, 
-                                              NULL);
-            require_noerr_string(ret, exit, "Connect to the peer device failed.");
+    if (hdr & BLE_FRAME_HDR_FIRST) {
+        if (rx->m_buf) {
+            mico_ble_log("Frame: message truncated, %d/%d bytes dropped", rx->m_received, rx->m_length);
+            mico_ble_pool_free(&g_ble_context.m_frame_pool, rx->m_buf);
+            rx->m_buf = NULL;
+        }
+        if (length < BLE_FRAME_FIRST_HDR_SIZE) {
+            return;
+        }
+        rx->m_type = p_data[1];
+        rx->m_length = (uint16_t)(p_data[2] | (p_data[3] << 8));
+        rx->m_received = 0;
+        if (rx->m_length == 0 || rx->m_length > g_ble_context.m_frame_pool.m_block_size) {
+            mico_ble_log("Frame: invalid message length %d", rx->m_length);
+            return;
+        }
+        rx->m_buf = mico_ble_pool_alloc(&g_ble_context.m_frame_pool);
+        if (!rx->m_buf) {
+            mico_ble_log("Frame: no free reassembly buffer, message dropped");
+            return;
+        }
+        p_data += BLE_FRAME_FIRST_HDR_SIZE;
+        length -= BLE_FRAME_FIRST_HDR_SIZE;
+    } else {
+        if (!rx->m_buf) {
+            return;
+        }
+        if ((hdr & BLE_FRAME_HDR_SEQ_MASK) != rx->m_next_seq) {
+            mico_ble_log("Frame: fragment lost, message dropped");
+            mico_ble_pool_free(&g_ble_context.m_frame_pool, rx->m_buf);
+            rx->m_buf = NULL;
+            return;
+        }
+        p_data += BLE_FRAME_HDR_SIZE;
+        length -= BLE_FRAME_HDR_SIZE;
+    }
+    rx->m_next_seq = (uint8_t)((hdr + 1) & BLE_FRAME_HDR_SEQ_MASK);
 
-            /* Find service */
-            uint8_t attribute_buffer[100];
-            mico_bt_smart_attribute_t *attribute = (mico_bt_smart_attribute_t *)attribute_buffer;
-            ret = mico_bt_smartbridge_get_service_from_attribute_cache_by_uuid(&g_ble_context.m_central_socket, 
-                                                                               &g_central_whitelist_serv_uuid, 
-                                                                               0x00, 0xffff, attribute, 100);
-            require_noerr_action_string(ret, exit, mico_bt_smartbridge_disconnect(&g_ble_context.m_central_socket, MICO_FALSE), 
-                                         "The specified GATT Service not found, disconnect.");
+    n = (uint16_t)MIN(length, rx->m_length - rx->m_received);
+    memcpy(rx->m_buf + rx->m_received, p_data, n);
+    rx->m_received += n;
 
-            /* Find characteristic, and save characteristic value handle */
-            ret = mico_bt_smartbridge_get_characteritics_from_attribute_cache_by_uuid(&g_ble_context.m_central_socket, 
-                                                                                       &g_central_whitelist_char_uuid, 
-                                                                                       attribute->value.service.start_handle, 
-                                                                                       attribute->value.service.end_handle, 
-                                                                                       (mico_bt_smart_attribute_t *)attribute_buffer, 
-                                                                                       100);
-            if (ret != kNoErr) {
-                mico_ble_log("The specified characteristic not found, remove cache and disconnect");
-                mico_bt_smartbridge_remove_attribute_cache(&g_ble_context.m_central_socket);
-                mico_bt_smartbridge_disconnect(&g_ble_context.m_central_socket, MICO_FALSE);
-                goto exit;
-            }
-            g_ble_context.m_central_attr_handle = attribute->value.characteristic.value_handle;
-        }
+    if (rx->m_received == rx->m_length) {
+        uint8_t *buf = rx->m_buf;
+
+        rx->m_buf = NULL;
+        mico_ble_frame_dispatch(rx->m_type, buf, rx->m_length);
     }
+}
 
-exit:
-    if (ret != MICO_BT_SUCCESS) {
-        SM_Handle(&g_ble_context.m_sm, BLE_SM_EVT_CENTRAL_CONNECTION_FAIL);
-        /* 发送LECONN=CENTRAL,OFF消息 */
-        mico_ble_evt_params_t params;
-        memcpy(params.bd_addr, g_ble_context.m_central_socket.remote_device.address, 6);
-        mico_ble_post_evt(BLE_EVT_CENTRAL_DISCONNECTED, &params);
+/* Entry of all data received on the SPP channel. */
+static void mico_ble_rx_input(const uint8_t *p_data, uint16_t length)
+{
+    if (g_ble_context.m_is_framing) {
+        if (g_ble_context.m_rel.m_active && g_ble_context.m_spp_owner == BLE_SPP_OWNER_CENTRAL) {
+            mico_ble_rel_rx(p_data, length);
+        } else {
+            mico_ble_frame_rx(p_data, length);
+        }
+    } else if (g_ble_context.m_rx_mode == BLE_RX_MODE_STREAM) {
+        mico_ble_rx_stream_put(p_data, length);
     } else {
-        SM_Handle(&g_ble_context.m_sm, BLE_SM_EVT_CENTRAL_CONNECTED);
+        mico_ble_post_rx_evt(mico_ble_spp_handle(), p_data, length);
     }
-    if (remote_device) free(remote_device);
-    return ret;
 }
 
-static mico_bt_result_t mico_ble_central_device_init(void)
+/* Entry of data received on another connection, these are not framed and data is handed over as is. */
+static void mico_ble_rx_raw_input(uint16_t handle, const uint8_t *p_data, uint16_t length)
 {
-    OSStatus err = mico_bt_smartbridge_init(1);
-    require_noerr(err, exit);
+    if (g_ble_context.m_rx_mode == BLE_RX_MODE_EVENT) {
+        mico_ble_post_rx_evt(handle, p_data, length);
+    } else {
+        /* The stream is the SPP channel only */
+        g_ble_context.m_rx_ring.m_dropped += length;
+        mico_ble_log("Stream mode, %u bytes from connection 0x%04x dropped", length, handle);
+    }
+}
 
-    err = mico_bt_smartbridge_enable_attribute_cache(1, &g_central_whitelist_serv_uuid, 1);
-    require_noerr(err, exit);
+/*---------------------------------------------------------------------------------------------
+ * Reliable notification function definition
+ *
+ * Notifications are not acknowledged and may be dropped by a busy stack on
+ * either side. When both sides enable it, the peripheral keeps every sent
+ * fragment until the central returns a SACK over SPP IN, and retransmits
+ * the fragments reported missing or not acknowledged within BLE_REL_RTO_MS.
+ * The framing header sequence number identifies the fragments.
+ */
 
-    err = mico_bt_smartbridge_create_socket(&g_ble_context.m_central_socket);
-    require_noerr(err, exit);
+#define REL_SLOT(seq)   (&g_ble_context.m_rel.m_slots[(seq) % BLE_REL_WINDOW])
+#define REL_SEQ(seq)    ((uint8_t)((seq) & BLE_FRAME_HDR_SEQ_MASK))
 
-    err = mico_rtos_create_worker_thread(&g_ble_context.m_evt_worker_thread, MICO_APPLICATION_PRIORITY, 2048, 10);
-    require_noerr(err, exit);
+/* Drop all held fragments, for a new connection. */
+static void mico_ble_rel_reset(void)
+{
+    mico_ble_rel_t *rel = &g_ble_context.m_rel;
 
-    err = mico_rtos_create_worker_thread(&g_ble_context.m_worker_thread, MICO_APPLICATION_PRIORITY, 2048, 10);
-    require_noerr_action(err, exit, mico_rtos_delete_worker_thread(&g_ble_context.m_evt_worker_thread));
+    if (!rel->m_slots) {
+        return;
+    }
 
-exit:
-    return (mico_bt_result_t)err;
+    mico_rtos_stop_timer(&rel->m_rtx_timer);
+    mico_rtos_stop_timer(&rel->m_ack_timer);
+
+    mico_rtos_lock_mutex(&rel->m_mutex);
+    memset(rel->m_slots, 0, sizeof(mico_ble_rel_slot_t) * BLE_REL_WINDOW);
+    rel->m_active = MICO_FALSE;
+    rel->m_base = 0;
+    rel->m_unacked = 0;
+    rel->m_sack_pending = MICO_FALSE;
+    mico_rtos_unlock_mutex(&rel->m_mutex);
 }
 
-static mico_bool_t app_central_start_scanning(void *context)
+/* Build and send a SACK, executed in worker thread. */
+static OSStatus mico_ble_rel_sack_handler(void *arg)
 {
-    UNUSED_PARAMETER(context);
+    mico_ble_rel_t *rel = &g_ble_context.m_rel;
+    uint8_t sack[2];
+    mico_ble_iovec_t vec = {
+        .p_data = sack,
+        .length = sizeof(sack),
+    };
+    uint8_t i;
 
-    /* 如果没有SCAN，则开启SCAN */
-    if (!mico_bt_smartbridge_is_scanning()) {
-        mico_ble_set_device_scan(MICO_TRUE);
+    UNUSED_PARAMETER(arg);
+
+    mico_rtos_lock_mutex(&rel->m_mutex);
+    rel->m_sack_pending = MICO_FALSE;
+    rel->m_unacked = 0;
+    sack[0] = rel->m_base;
+    sack[1] = 0;
+    for (i = 0; i < 8; i++) {
+        uint8_t seq = REL_SEQ(rel->m_base + 1 + i);
+        if (REL_SLOT(seq)->m_used && REL_SLOT(seq)->m_seq == seq) {
+            sack[1] |= (uint8_t)(1 << i);
+        }
     }
-    
-    /* 发送LESCAN=ON消息 */
-    mico_ble_post_evt(BLE_EVT_CENTRAL_SCAN_START, NULL);
-    return TRUE;
+    mico_rtos_unlock_mutex(&rel->m_mutex);
+
+    mico_ble_send_msg(BLE_FRAME_TYPE_SACK, &vec, 1, BLE_REL_RTO_MS);
+    return kNoErr;
 }
 
-static mico_bool_t app_central_scanning_stoped(void *context)
+static void mico_ble_rel_sack_post(void)
 {
-    UNUSED_PARAMETER(context);
+    mico_ble_rel_t *rel = &g_ble_context.m_rel;
 
-    /* 发送LESCAN=OFF消息 */
-    mico_ble_post_evt(BLE_EVT_CENTRAL_SCAN_STOP, NULL);
-    return TRUE;
+    mico_rtos_stop_timer(&rel->m_ack_timer);
+    if (!rel->m_sack_pending) {
+        rel->m_sack_pending = MICO_TRUE;
+        mico_ble_worker_send(BLE_WORKER_TASK, mico_ble_rel_sack_handler, NULL);
+    }
 }
 
-static mico_bool_t app_central_connected(void *context)
+static void mico_ble_rel_ack_timeout(void *arg)
 {
-    mico_ble_evt_params_t params;
+    UNUSED_PARAMETER(arg);
 
-    UNUSED_PARAMETER(context);
+    mico_ble_rel_sack_post();
+}
 
-    /* 发送LECONN=CENTRAL,ON消息 */
-    memcpy(params.bd_addr, g_ble_context.m_central_socket.remote_device.address, 6);
-    params.u.conn.handle = g_ble_context.m_central_socket.connection_handle;
-    mico_ble_post_evt(BLE_EVT_CENTRAL_CONNECTED, &params);
-    return TRUE;
+/*
+ * Retransmit the fragments reported missing or overdue. Called with the TX
+ * mutex held. Return MICO_FALSE if a fragment ran out of retries.
+ */
+static mico_bool_t mico_ble_rel_tx_resend(void)
+{
+    mico_ble_rel_t *rel = &g_ble_context.m_rel;
+    uint32_t now = mico_rtos_get_time();
+    mico_bool_t alive = MICO_TRUE;
+    uint8_t outstanding, i;
+
+    mico_rtos_lock_mutex(&rel->m_mutex);
+    outstanding = REL_SEQ(g_ble_context.m_frame_tx_seq - rel->m_base);
+    for (i = 0; i < outstanding; i++) {
+        uint8_t seq = REL_SEQ(rel->m_base + i);
+        mico_ble_rel_slot_t *slot = REL_SLOT(seq);
+
+        if (!slot->m_used || slot->m_seq != seq) {
+            continue;
+        }
+        if (!slot->m_due && now - slot->m_sent_at < BLE_REL_RTO_MS) {
+            continue;
+        }
+        if (slot->m_retries >= BLE_REL_MAX_RETRIES) {
+            alive = MICO_FALSE;
+            break;
+        }
+        if (mico_ble_peripheral_send_chunk(slot->m_data, slot->m_length) != kNoErr) {
+            break;  /* controller busy, try again later */
+        }
+        slot->m_retries++;
+        slot->m_due = MICO_FALSE;
+        slot->m_sent_at = now;
+        g_ble_context.m_tx_stats.retransmits++;
+    }
+    mico_rtos_unlock_mutex(&rel->m_mutex);
+    return alive;
 }
 
-static mico_bool_t app_central_disconnected(void *context)
+/* Retransmit for the tail of a burst, executed in worker thread. */
+static OSStatus mico_ble_rel_rtx_handler(void *arg)
 {
-    mico_ble_evt_params_t params;
+    mico_ble_rel_t *rel = &g_ble_context.m_rel;
+    mico_bool_t alive;
 
-    UNUSED_PARAMETER(context);
+    UNUSED_PARAMETER(arg);
 
-    /* 发送LECONN=CENTRAL,OFF消息 */
-    memcpy(params.bd_addr, g_ble_context.m_central_socket.remote_device.address, 6);
-    params.u.disconn.handle = g_ble_context.m_central_socket.connection_handle;
-    mico_ble_post_evt(BLE_EVT_CENTRAL_DISCONNECTED, &params);
-    return TRUE;
+    mico_rtos_lock_mutex(&g_ble_context.m_tx_mutex);
+    if (rel->m_active && g_ble_context.m_spp_owner == BLE_SPP_OWNER_PERIPHERAL) {
+        alive = mico_ble_rel_tx_resend();
+        if (!alive) {
+            mico_ble_log("Reliable: peer stopped acknowledging, disconnect");
+            mico_bt_peripheral_disconnect();
+        } else if (REL_SEQ(g_ble_context.m_frame_tx_seq - rel->m_base) > 0) {
+            mico_rtos_reload_timer(&rel->m_rtx_timer);
+        } else {
+            mico_rtos_stop_timer(&rel->m_rtx_timer);
+        }
+    }
+    mico_rtos_unlock_mutex(&g_ble_context.m_tx_mutex);
+    return kNoErr;
 }
 
-static void mico_ble_state_machine_init(StateMachine *sm, uint8_t init_state)
+static void mico_ble_rel_rtx_timeout(void *arg)
 {
-    /* Initialize StateMachine */
-    SmInitParms smParms = {
-        .rules = g_ble_context.m_rules,
-        .maxRules = sizeof(g_ble_context.m_rules)/sizeof(g_ble_context.m_rules[0]),
-        .context = NULL,
-        .initState = init_state,
-    };
+    UNUSED_PARAMETER(arg);
 
-    SM_Init(sm, &smParms);
+    mico_ble_worker_send(BLE_WORKER_TASK, mico_ble_rel_rtx_handler, NULL);
+}
 
-#if XA_DECODER == MICO_TRUE
-    SM_EnableDecode(sm, MICO_TRUE, "BLE", g_stateNameTab, g_eventTypeNameTabl);
-#endif 
+/* Start sequence tracking once both sides have announced BLE_CAPS_REL, stop if the peer dropped it. */
+static void mico_ble_rel_start(void)
+{
+    mico_ble_rel_t *rel = &g_ble_context.m_rel;
 
-    SM_OnEvent(sm, BLE_STATE_PERIPHERAL_ADVERTISING, BLE_SM_EVT_PERIPHERAL_CONNECTION_FAIL, BLE_STATE_PERIPHERAL_ADVERTISING, NULL);
-    SM_OnEvent(sm, BLE_STATE_PERIPHERAL_ADVERTISING, BLE_SM_EVT_PERIPHERAL_CONNECTED, BLE_STATE_PERIPHERAL_CONNECTED, NULL);
-    SM_OnEvent(sm, BLE_STATE_PERIPHERAL_ADVERTISING, BLE_SM_EVT_CENTRAL_LESCAN_CMD, BLE_STATE_CENTRAL_SCANNING, NULL);
-    
-    SM_OnEvent(sm, BLE_STATE_PERIPHERAL_CONNECTED, BLE_SM_EVT_PERIPHERAL_DISCONNECTED, BLE_STATE_PERIPHERAL_ADVERTISING, app_peripheral_start_advertising);
-    SM_OnEnter(sm, BLE_STATE_PERIPHERAL_CONNECTED, app_peripheral_connected);
-    SM_OnExit(sm, BLE_STATE_PERIPHERAL_CONNECTED, app_peripheral_disconnected);
-    
-    SM_OnEvent(sm, BLE_STATE_CENTRAL_SCANNING, BLE_SM_EVT_CENTRAL_SCANNED, BLE_STATE_IDLE, NULL);
-    SM_OnEvent(sm, BLE_STATE_CENTRAL_SCANNING, BLE_SM_EVT_PERIPHERAL_LEADV_CMD, BLE_STATE_PERIPHERAL_ADVERTISING, app_peripheral_start_advertising);
-    SM_OnEnter(sm, BLE_STATE_CENTRAL_SCANNING, app_central_start_scanning);
-    SM_OnExit(sm, BLE_STATE_CENTRAL_SCANNING, app_central_scanning_stoped);
-    
-    SM_OnEvent(sm, BLE_STATE_CENTRAL_CONNECTING, BLE_SM_EVT_CENTRAL_CONNECTION_FAIL, BLE_STATE_IDLE, NULL);
-    SM_OnEvent(sm, BLE_STATE_CENTRAL_CONNECTING, BLE_SM_EVT_CENTRAL_CONNECTED, BLE_STATE_CENTRAL_CONNECTED, NULL);
+    if (rel->m_active && !(g_ble_context.m_peer_caps & BLE_CAPS_REL)) {
+        mico_ble_rel_reset();
+        return;
+    }
 
-    SM_OnEvent(sm, BLE_STATE_CENTRAL_CONNECTED, BLE_SM_EVT_CENTRAL_DISCONNECTED, BLE_STATE_IDLE, NULL);
-    SM_OnEnter(sm, BLE_STATE_CENTRAL_CONNECTED, app_central_connected);
-    SM_OnExit(sm, BLE_STATE_CENTRAL_CONNECTED, app_central_disconnected);
-    
-    SM_OnEvent(sm, BLE_STATE_IDLE, BLE_SM_EVT_CENTRAL_LESCAN_CMD, BLE_STATE_CENTRAL_SCANNING, NULL);
-    SM_OnEvent(sm, BLE_STATE_IDLE, BLE_SM_EVT_CENTRAL_LECONN_CMD, BLE_STATE_CENTRAL_CONNECTING, NULL);
-    SM_OnEvent(sm, BLE_STATE_IDLE, BLE_SM_EVT_PERIPHERAL_LEADV_CMD, BLE_STATE_PERIPHERAL_ADVERTISING, app_peripheral_start_advertising);
-    
-    SM_Finalize(sm);
+    if (!g_ble_context.m_is_reliable || !rel->m_slots || rel->m_active
+        || !(g_ble_context.m_peer_caps & BLE_CAPS_REL)
+        || g_ble_context.m_transport == BLE_TRANSPORT_L2CAP_COC) {
+        return;
+    }
+
+    mico_rtos_lock_mutex(&rel->m_mutex);
+    if (g_ble_context.m_spp_owner == BLE_SPP_OWNER_CENTRAL) {
+        /* Tracking starts with the next fragment from the peripheral */
+        rel->m_base = g_ble_context.m_frame_rx.m_next_seq;
+    } else {
+        rel->m_base = g_ble_context.m_frame_tx_seq;
+    }
+    rel->m_active = MICO_TRUE;
+    mico_rtos_unlock_mutex(&rel->m_mutex);
+
+    if (g_ble_context.m_spp_owner == BLE_SPP_OWNER_CENTRAL) {
+        mico_ble_rel_sack_post();
+    }
 }
 
-/**
- *  mico_bluetooth_init
- *
- *  Initialize Bluetooth Sub-system.
- *
- * @param [in] context      : An pointer of The Application Context
- *             Structure.
- * @param [in] mico_context : An pointer of the MiCO Context structure.
- *
- * @param [in] cback        : An call back handler for the bluetooth
- *             for bluetooth sub-system.
- *
- * @return #mico_bt_result_t
- *
+/* Is there room in the TX window for one more fragment? */
+static mico_bool_t mico_ble_rel_tx_has_room(void)
+{
+    return REL_SEQ(g_ble_context.m_frame_tx_seq - g_ble_context.m_rel.m_base) < BLE_REL_WINDOW;
+}
+
+/* Keep a copy of a fragment accepted by the stack until it is acknowledged. */
+static void mico_ble_rel_tx_push(const uint8_t *chunk, uint16_t length)
+{
+    mico_ble_rel_t *rel = &g_ble_context.m_rel;
+    mico_ble_rel_slot_t *slot = REL_SLOT(REL_SEQ(chunk[0]));
+
+    mico_rtos_lock_mutex(&rel->m_mutex);
+    slot->m_used = MICO_TRUE;
+    slot->m_due = MICO_FALSE;
+    slot->m_seq = REL_SEQ(chunk[0]);
+    slot->m_retries = 0;
+    slot->m_length = length;
+    slot->m_sent_at = mico_rtos_get_time();
+    memcpy(slot->m_data, chunk, length);
+    mico_rtos_unlock_mutex(&rel->m_mutex);
+
+    if (!mico_rtos_is_timer_running(&rel->m_rtx_timer)) {
+        mico_rtos_start_timer(&rel->m_rtx_timer);
+    }
+}
+
+/*
+ * A SACK from the central: every fragment before next_seq has arrived, and
+ * bit i of bitmap is set if fragment next_seq + 1 + i has arrived as well.
+ * The fragments below the highest one reported are missing.
  */
-mico_bt_result_t mico_ble_init(const char *device_name, 
-                               const char *wl_name, 
-                               mico_bool_t is_central, 
-                               mico_ble_evt_cback_t cback) 
+static void mico_ble_rel_on_sack(uint8_t next_seq, uint8_t bitmap)
 {
-    mico_bt_result_t        err;
-    uint8_t                 init_state;
+    mico_ble_rel_t *rel = &g_ble_context.m_rel;
+    uint32_t now = mico_rtos_get_time();
+    mico_bool_t reported = MICO_FALSE;
+    uint8_t outstanding, acked, i;
 
-    /* Check */
-    if (!device_name || !cback) {
-        return MICO_BT_ERROR;
+    if (!rel->m_active || g_ble_context.m_spp_owner != BLE_SPP_OWNER_PERIPHERAL) {
+        return;
     }
 
-    if (g_ble_context.m_is_initialized) {
-        return MICO_BT_SUCCESS;
+    mico_rtos_lock_mutex(&rel->m_mutex);
+    outstanding = REL_SEQ(g_ble_context.m_frame_tx_seq - rel->m_base);
+    acked = REL_SEQ(next_seq - rel->m_base);
+    if (acked > outstanding) {
+        /* Stale SACK, overtaken by a newer one */
+        goto exit;
     }
 
-    memset(&g_ble_context, 0, sizeof(g_ble_context));
+    for (i = 0; i < acked; i++) {
+        REL_SLOT(REL_SEQ(rel->m_base + i))->m_used = MICO_FALSE;
+    }
+    rel->m_base = REL_SEQ(next_seq);
+    outstanding -= acked;
 
-    /* Initialize Bluetooth Stack & GAP Role. */
-    err = (mico_bt_result_t)mico_bt_init(MICO_BT_HCI_MODE, device_name, 1, 1);
-    require_string(err == MICO_BT_SUCCESS, exit, "Error initializing MiCO Bluetooth Framework");
+    /* Walk from the highest reported fragment down, marking the gaps */
+    for (i = 8; i > 0; i--) {
+        uint8_t seq = REL_SEQ(next_seq + i);
+        mico_ble_rel_slot_t *slot = REL_SLOT(seq);
 
-    err = mico_ble_central_device_init();
-    require_string(err == MICO_BT_SUCCESS, exit, "Error initializing MiCO Bluetooth Central Role");
+        if (i >= outstanding || !slot->m_used || slot->m_seq != seq) {
+            continue;
+        }
+        if (bitmap & (1 << (i - 1))) {
+            slot->m_used = MICO_FALSE;
+            reported = MICO_TRUE;
+        } else if (reported && now - slot->m_sent_at >= BLE_REL_RTO_MS / 4) {
+            slot->m_due = MICO_TRUE;
+        }
+    }
+    if (reported && REL_SLOT(rel->m_base)->m_used && now - REL_SLOT(rel->m_base)->m_sent_at >= BLE_REL_RTO_MS / 4) {
+        REL_SLOT(rel->m_base)->m_due = MICO_TRUE;
+    }
 
-    err = mico_ble_peripheral_device_init();
-    require_string(err == MICO_BT_SUCCESS, exit, "Error initializaing MiCO Bluetooth Peripheral Role");
+exit:
+    mico_rtos_unlock_mutex(&rel->m_mutex);
 
-    /* BT Mode to Peripheral */
-    if (is_central) {
-        init_state = BLE_STATE_CENTRAL_SCANNING;
-        err = mico_ble_set_device_scan(MICO_TRUE);
-        require_string(err == MICO_BT_SUCCESS, exit, "Error setting device to scanning");
+    /* Fast retransmit, the sender may be idle */
+    if (reported) {
+        mico_ble_worker_send(BLE_WORKER_TASK, mico_ble_rel_rtx_handler, NULL);
+    }
+}
+
+/*
+ * A notification fragment on the central: deliver in sequence order, holding
+ * out-of-order fragments until the gap is filled. Only this thread writes the
+ * slots, so fragments are delivered outside the lock.
+ */
+static void mico_ble_rel_rx(const uint8_t *p_data, uint16_t length)
+{
+    mico_ble_rel_t *rel = &g_ble_context.m_rel;
+    uint8_t seq, distance;
+    mico_bool_t sack_now = MICO_FALSE;
+    mico_ble_rel_slot_t *slot;
+
+    if (length < BLE_FRAME_HDR_SIZE || length > sizeof(slot->m_data)) {
+        return;
+    }
+    seq = REL_SEQ(p_data[0]);
+    distance = REL_SEQ(seq - rel->m_base);
+
+    if (distance == 0) {
+        mico_ble_frame_rx(p_data, length);
+
+        mico_rtos_lock_mutex(&rel->m_mutex);
+        rel->m_base = REL_SEQ(rel->m_base + 1);
+        rel->m_unacked++;
+        mico_rtos_unlock_mutex(&rel->m_mutex);
+
+        /* Release what the gap was holding back */
+        for (slot = REL_SLOT(rel->m_base); slot->m_used && slot->m_seq == rel->m_base; slot = REL_SLOT(rel->m_base)) {
+            mico_ble_frame_rx(slot->m_data, slot->m_length);
+
+            mico_rtos_lock_mutex(&rel->m_mutex);
+            slot->m_used = MICO_FALSE;
+            rel->m_base = REL_SEQ(rel->m_base + 1);
+            rel->m_unacked++;
+            mico_rtos_unlock_mutex(&rel->m_mutex);
+        }
+    } else if (distance < BLE_REL_WINDOW) {
+        slot = REL_SLOT(seq);
+        if (!slot->m_used) {
+            mico_rtos_lock_mutex(&rel->m_mutex);
+            slot->m_seq = seq;
+            slot->m_length = length;
+            memcpy(slot->m_data, p_data, length);
+            slot->m_used = MICO_TRUE;
+            mico_rtos_unlock_mutex(&rel->m_mutex);
+        }
+        sack_now = MICO_TRUE;
     } else {
-        init_state = BLE_STATE_PERIPHERAL_ADVERTISING;
-        err = mico_ble_set_device_discovery(MICO_TRUE);
-        require_string(err == MICO_BT_SUCCESS, exit, "Error setting device to discoverable");
+        /* Already delivered, the SACK for it was lost */
+        sack_now = MICO_TRUE;
     }
 
-    /* Initialize local storage information */
-    g_ble_context.m_is_central = is_central;
-    g_ble_context.m_cback = cback;
-    g_ble_context.m_is_initialized = MICO_TRUE;
-    mico_ble_set_device_whitelist_name(wl_name);
+    if (sack_now || rel->m_unacked >= BLE_REL_ACK_EVERY) {
+        mico_ble_rel_sack_post();
+    } else if (rel->m_unacked > 0 && !mico_rtos_is_timer_running(&rel->m_ack_timer)) {
+        mico_rtos_start_timer(&rel->m_ack_timer);
+    }
+}
 
-    /* Initialize StateMachine */
-    mico_ble_state_machine_init(&g_ble_context.m_sm, init_state);
+/*---------------------------------------------------------------------------------------------
+ * Connection parameter function definition
+ */
 
-    /* Post first event to user. */
-    if (init_state == BLE_STATE_CENTRAL_SCANNING) {
-        mico_ble_post_evt(BLE_EVT_CENTRAL_SCAN_START, NULL);
+/* Request the parameters of a profile on the current link. */
+static mico_bt_result_t mico_ble_conn_profile_apply(mico_ble_conn_profile_t profile)
+{
+    const mico_ble_conn_params_t *params = &g_conn_profiles[profile];
+    uint8_t *bd_addr = NULL;
+
+    /* The profile follows the SPP traffic */
+    if (g_ble_context.m_spp_owner == BLE_SPP_OWNER_CENTRAL) {
+        bd_addr = g_ble_context.m_primary->m_peer.address;
+    } else if (g_ble_context.m_spp_owner == BLE_SPP_OWNER_PERIPHERAL) {
+        bd_addr = g_ble_context.m_peripheral_socket.remote_device.address;
     } else {
-        mico_ble_post_evt(BLE_EVT_PERIPHREAL_ADV_START, NULL);
+        return MICO_BT_SUCCESS;
     }
 
-exit:
-    return err;
+    if (!mico_bt_l2cap_update_ble_conn_params(bd_addr,
+                                              params->interval_min,
+                                              params->interval_max,
+                                              params->latency,
+                                              params->supervision_timeout)) {
+        mico_ble_log("Connection parameter update rejected, profile %d", profile);
+        return MICO_BT_ERROR;
+    }
+
+    g_ble_context.m_conn_profile_active = profile;
+    return MICO_BT_SUCCESS;
 }
 
-/**
- *  bluetooth_send_data
- *
- *  Trigger an action for sending data over RFCOMM Channel.
- *
- * @param None
- *
- * @return None
+/* Fall back to the selected profile, runs on the worker thread. */
+static OSStatus mico_ble_conn_idle_handler(void *arg)
+{
+    UNUSED_PARAMETER(arg);
+
+    if (g_ble_context.m_conn_auto && g_ble_context.m_conn_profile_active != g_ble_context.m_conn_profile) {
+        mico_ble_conn_profile_apply(g_ble_context.m_conn_profile);
+    }
+    return kNoErr;
+}
+
+static void mico_ble_conn_idle_timeout(void *arg)
+{
+    UNUSED_PARAMETER(arg);
+
+    mico_rtos_stop_timer(&g_ble_context.m_conn_idle_timer);
+    mico_ble_worker_send(BLE_WORKER_TASK, mico_ble_conn_idle_handler, NULL);
+}
+
+/* Switch to the throughput profile if more than one connection event worth of data is queued. */
+static void mico_ble_conn_tx_activity(uint32_t backlog)
+{
+    if (!g_ble_context.m_conn_auto) {
+        return;
+    }
+
+    if (backlog > (uint32_t)BLE_TX_NOTIFY_CREDITS * (g_ble_context.m_att_mtu - BLE_ATT_HDR_SIZE)
+        && g_ble_context.m_conn_profile_active != BLE_CONN_PROFILE_THROUGHPUT) {
+        mico_ble_conn_profile_apply(BLE_CONN_PROFILE_THROUGHPUT);
+    }
+    mico_rtos_reload_timer(&g_ble_context.m_conn_idle_timer);
+}
+
+/*---------------------------------------------------------------------------------------------
+ * L2CAP CoC transport function definition
  */
-mico_bt_result_t mico_ble_get_dev_address(mico_bt_device_address_t bdaddr)
+
+/* Take the channel if the transport is selected and none is open yet. */
+static mico_bool_t mico_ble_coc_open(uint16_t local_cid, uint16_t peer_mtu)
 {
-    mico_bt_dev_read_local_addr(bdaddr);
-    return MICO_BT_SUCCESS;
+    if (g_ble_context.m_transport != BLE_TRANSPORT_L2CAP_COC || g_ble_context.m_coc_cid != 0) {
+        return MICO_FALSE;
+    }
+
+    mico_ble_log("L2CAP channel 0x%04x opened, peer MTU %d", local_cid, peer_mtu);
+    g_ble_context.m_coc_peer_mtu = peer_mtu;
+    g_ble_context.m_coc_congested = MICO_FALSE;
+    g_ble_context.m_coc_cid = local_cid;
+    return MICO_TRUE;
 }
 
-/**
- * Set local BT Device Name.
+/* Channel requested by the peer (acceptor side). */
+static void mico_ble_coc_connected_indication_cback(void *context, mico_bt_device_address_t bd_addr,
+                                                    uint16_t local_cid, uint16_t psm, uint8_t id, uint16_t mtu_peer)
+{
+    UNUSED_PARAMETER(context);
+    UNUSED_PARAMETER(psm);
+
+    /* Only the remote central of the SPP channel may open it */
+    mico_bt_l2cap_le_connect_rsp(bd_addr, id, local_cid,
+                                 g_ble_context.m_spp_owner == BLE_SPP_OWNER_PERIPHERAL
+                                 && mico_ble_coc_open(local_cid, mtu_peer) ? L2CAP_CONN_OK : L2CAP_LE_CONN_NO_RESOURCES,
+                                 BLE_COC_MTU, HCI_ACL_POOL_ID);
+}
+
+/* Result of our request (initiator side). */
+static void mico_ble_coc_connect_confirm_cback(void *context, uint16_t local_cid, uint16_t result, uint16_t mtu_peer)
+{
+    UNUSED_PARAMETER(context);
+
+    if (result != L2CAP_CONN_OK) {
+        mico_ble_log("L2CAP channel refused (%d), fall back to GATT", result);
+    } else if (!mico_ble_coc_open(local_cid, mtu_peer)) {
+        mico_bt_l2cap_le_disconnect_req(local_cid);
+    }
+}
+
+static void mico_ble_coc_disconnect_indication_cback(void *context, uint16_t local_cid, mico_bool_t ack)
+{
+    UNUSED_PARAMETER(context);
+    UNUSED_PARAMETER(ack);
+
+    if (local_cid == g_ble_context.m_coc_cid) {
+        mico_ble_log("L2CAP channel 0x%04x closed", local_cid);
+        g_ble_context.m_coc_cid = 0;
+    }
+}
+
+static void mico_ble_coc_data_indication_cback(void *context, uint16_t local_cid, uint8_t *p_data, uint16_t len)
+{
+    UNUSED_PARAMETER(context);
+
+    if (local_cid == g_ble_context.m_coc_cid) {
+        mico_ble_rx_input(p_data, len);
+    }
+}
+
+/* The peer has run us out of credits, or returned some. */
+static void mico_ble_coc_congestion_status_cback(void *context, uint16_t local_cid, mico_bool_t is_congested)
+{
+    UNUSED_PARAMETER(context);
+
+    if (local_cid == g_ble_context.m_coc_cid) {
+        g_ble_context.m_coc_congested = is_congested;
+    }
+}
+
+static mico_bt_l2cap_le_appl_information_t g_coc_appl_info = {
+    .connected_indication_cback = mico_ble_coc_connected_indication_cback,
+    .connect_confirm_cback = mico_ble_coc_connect_confirm_cback,
+    .disconnect_indication_cback = mico_ble_coc_disconnect_indication_cback,
+    .disconnect_confirm_cback = NULL,
+    .data_indication_cback = mico_ble_coc_data_indication_cback,
+    .congestion_status_cback = mico_ble_coc_congestion_status_cback,
+    .tx_complete_cback = NULL,
+};
+
+/* Open the channel as the initiator, the acceptor side only registers the PSM. */
+static void mico_ble_coc_connect(const mico_bt_smart_device_t *remote_device)
+{
+    if (g_ble_context.m_transport != BLE_TRANSPORT_L2CAP_COC) {
+        return;
+    }
+
+    if (mico_bt_l2cap_le_connect_req(BLE_COC_PSM,
+                                     (uint8_t *)remote_device->address,
+                                     (mico_bt_ble_address_type_t)remote_device->address_type,
+                                     BLE_CONN_MODE_HIGH_DUTY,
+                                     BLE_COC_MTU,
+                                     HCI_ACL_POOL_ID,
+                                     BTM_SEC_NONE,
+                                     0) == 0) {
+        mico_ble_log("L2CAP channel request failed, fall back to GATT");
+    }
+}
+
+/*
+ * Send a message over the L2CAP channel. Each chunk is one SDU, segmented and
+ * paced by the stack with LE credits; while the peer has not returned credits
+ * the stack reports congestion and we wait.
+ */
+static mico_bt_result_t mico_ble_coc_send_data(mico_ble_tx_msg_t *msg, uint32_t timeout_ms)
+{
+    OSStatus err = kNoErr;
+    uint32_t start = mico_rtos_get_time();
+    uint16_t sdu_size = MIN(g_ble_context.m_coc_peer_mtu, BLE_COC_MTU);
+    uint8_t  staging[BLE_COC_MTU];
+    const uint8_t *chunk = NULL;
+    uint16_t chunk_len = 0;
+    uint8_t  status;
+    mico_bool_t sent_any = MICO_FALSE;
+
+    while (msg->remaining > 0) {
+        while (g_ble_context.m_coc_congested) {
+            require_action(mico_rtos_get_time() - start < timeout_ms, exit, err = MICO_BT_TIMEOUT);
+            g_ble_context.m_tx_stats.retries++;
+            mico_rtos_thread_msleep(BLE_TX_CREDIT_WAIT_MS);
+        }
+        require_action(g_ble_context.m_coc_cid != 0, exit, err = MICO_BT_ERROR);
+
+        chunk = mico_ble_tx_next_chunk(msg, staging, sdu_size, &chunk_len);
+        require_action(chunk != NULL, exit, err = MICO_BT_BADOPTION);
+        status = mico_bt_l2cap_le_data_write(g_ble_context.m_coc_cid, (uint8_t *)chunk, chunk_len, 0);
+        if (status == L2CAP_DATA_WRITE_FAILED) {
+            err = MICO_BT_ERROR;
+            break;
+        } else if (status == L2CAP_DATA_WRITE_CONGESTED) {
+            /* Queued, but no more until the congestion callback clears it */
+            g_ble_context.m_coc_congested = MICO_TRUE;
+        }
+        sent_any = MICO_TRUE;
+        g_ble_context.m_tx_stats.bytes += chunk_len;
+        g_ble_context.m_tx_stats.packets++;
+    }
+
+exit:
+    mico_ble_tx_stats_account(start);
+
+    /* Only report TIMEOUT when nothing went out, so callers may safely re-send. */
+    if (err == MICO_BT_TIMEOUT && sent_any) {
+        err = MICO_BT_ERROR;
+    }
+    return (mico_bt_result_t)err;
+}
+
+/*---------------------------------------------------------------------------------------------
+ * Peripheral function definition 
+ */
+
+static void mico_ble_peripheral_create_attribute_db(void)
+{
+    extern mico_bt_cfg_settings_t   mico_bt_cfg_settings;
+
+    /* Create BLE GATT value database */
+    // ***** Primary service 'Generic Attribute'
+    mico_bt_peripheral_ext_attribute_add(HDLC_GENERIC_ATTRIBUTE_SERVICE_CHANGED_VALUE, 0, NULL, NULL);
+
+    // ***** Primary service 'Generic Access'
+    mico_bt_peripheral_ext_attribute_add(HDLC_GENERIC_ACCESS_DEVICE_NAME_VALUE, 
+                                         (uint16_t)strlen((char *)mico_bt_cfg_settings.device_name),
+                                         mico_bt_cfg_settings.device_name, 
+                                         NULL);
+    mico_bt_peripheral_ext_attribute_add(HDLC_GENERIC_ACCESS_APPEARANCE_VALUE, 
+                                         sizeof(g_peripheral_appearance_name), 
+                                         g_peripheral_appearance_name, 
+                                         NULL);
+
+    // ***** Primary service 'SPP' (Vender specific)
+    /* The value buffer takes the prepared segments of a long write at their offsets */
+    mico_bt_peripheral_ext_attribute_add(HDLC_SPP_IN_VALUE, BLE_PREP_WRITE_MAX_SIZE, NULL,
+                                         mico_ble_periphreal_spp_data_in_callback);
+    mico_bt_peripheral_ext_attribute_add(HDLC_SPP_IN_DESCRIPTION,
+                                         (uint16_t)strlen("SPP Data IN"),
+                                         (uint8_t *)"SPP Data IN", NULL);
+
+    g_ble_context.m_spp_out_attribute = mico_bt_peripheral_ext_attribute_add(HDLC_SPP_OUT_VALUE, 0, NULL,
+                                                                             mico_ble_periphreal_spp_out_callback);
+    mico_bt_peripheral_ext_attribute_add(HDLC_SPP_OUT_CCC_DESCRIPTION, 2,
+                                         (uint8_t *)&g_ble_context.m_spp_out_cccd_value,
+                                         mico_ble_periphreal_spp_cccd_callback);
+    mico_bt_peripheral_ext_attribute_add(HDLC_SPP_OUT_DESCRIPTION,
+                                         (uint16_t)strlen("SPP Data OUT"),
+                                         (uint8_t *)"SPP Data OUT",
+                                         NULL);
+
+    mico_bt_peripheral_ext_attribute_find_by_handle(HDLC_SPP_OUT_VALUE, &g_ble_context.m_spp_out_attribute);
+}
+
+static mico_bt_result_t mico_ble_peripheral_set_advertisement_data(void)
+{
+    OSStatus err;
+    mico_bt_ble_advert_data_t adv_data;
+
+     mico_bt_ble_128service_t adver_services_128 = {
+         .list_cmpl = false,
+         .uuid128 = { UUID_SPP_SERVICE },
+     };
+
+    adv_data.flag = BTM_BLE_GENERAL_DISCOVERABLE_FLAG | BTM_BLE_BREDR_NOT_SUPPORTED;
+    adv_data.p_services_128b = &adver_services_128;
+    
+    err = mico_bt_ble_set_advertisement_data(BTM_BLE_ADVERT_BIT_DEV_NAME 
+                                             | BTM_BLE_ADVERT_BIT_SERVICE_128
+                                             | BTM_BLE_ADVERT_BIT_FLAGS, 
+                                             &adv_data);
+    require_noerr_string(err, exit, "Set Advertisement Data failed");
+
+    err = mico_bt_ble_set_scan_response_data(BTM_BLE_ADVERT_BIT_DEV_NAME, &adv_data);
+    require_noerr_string(err, exit, "Set Advertisement ScanRsp Data failed");
+
+exit:
+    return (mico_bt_result_t)err;
+}
+
+static OSStatus mico_ble_peripheral_advertisement_complete_handler(void *arg)
+{
+    UNUSED_PARAMETER(arg);
+
+    /* Directed advertising falls back on its own, see mico_ble_reconn_directed_handler() */
+    if (SM_InState(&g_ble_context.m_periph_sm, BLE_STATE_PERIPHERAL_ADVERTISING)
+        && !g_ble_context.m_reconn.m_is_directed) {
+        return mico_ble_set_device_discovery(MICO_TRUE);
+    }
+    return kNoErr;
+}
+
+static OSStatus mico_ble_peripheral_connect_handler(mico_bt_peripheral_socket_t *socket)
+{
+    UNUSED_PARAMETER(socket);
+
+    mico_ble_log("Connection up [peripheral]");
+
+    mico_bt_peripheral_stop_advertisements();
+
+    if (SM_InState(&g_ble_context.m_periph_sm, BLE_STATE_PERIPHERAL_ADVERTISING)) {
+        SM_Handle(&g_ble_context.m_periph_sm, BLE_SM_EVT_PERIPHERAL_CONNECTED);
+    }
+
+    return kNoErr;
+}
+
+static OSStatus mico_ble_peripheral_disconnect_handler(mico_bt_peripheral_socket_t *socket)
+{
+    UNUSED_PARAMETER(socket);
+
+    mico_ble_log("Connection down [periphreal]");
+
+    if (SM_InState(&g_ble_context.m_periph_sm, BLE_STATE_PERIPHERAL_CONNECTED)) {
+        SM_Handle(&g_ble_context.m_periph_sm, BLE_SM_EVT_PERIPHERAL_DISCONNECTED);
+    }
+
+    return kNoErr;
+}
+
+/* Drop the prepared segments of an unfinished long write. */
+static void mico_ble_peripheral_prep_write_reset(void)
+{
+    if (g_ble_context.m_prep_buf) {
+        free(g_ble_context.m_prep_buf);
+        g_ble_context.m_prep_buf = NULL;
+    }
+    g_ble_context.m_prep_len = 0;
+}
+
+/*
+ * The peripheral layer has written a prepared segment into the attribute at
+ * its offset, value_length is where that segment ends. Segments may come in
+ * any order and overlap, so the attribute value up to that end is taken over
+ * as a whole and the bytes beyond it are kept from earlier segments.
+ */
+static mico_bt_gatt_status_t mico_ble_peripheral_prep_write(mico_bt_ext_attribute_value_t *attribute)
+{
+    uint16_t end = attribute->value_length;
+
+    if (end > BLE_PREP_WRITE_MAX_SIZE || end > attribute->value_buffer_length) {
+        mico_ble_peripheral_prep_write_reset();
+        return MICO_BT_GATT_PREPARE_Q_FULL;
+    }
+
+    if (!g_ble_context.m_prep_buf) {
+        g_ble_context.m_prep_buf = (uint8_t *)malloc(BLE_PREP_WRITE_MAX_SIZE);
+        if (!g_ble_context.m_prep_buf) {
+            return MICO_BT_GATT_INSUF_RESOURCE;
+        }
+        g_ble_context.m_prep_len = 0;
+    }
+
+    memcpy(g_ble_context.m_prep_buf, attribute->p_value, end);
+    if (end > g_ble_context.m_prep_len) {
+        g_ble_context.m_prep_len = end;
+    }
+    return MICO_BT_GATT_SUCCESS;
+}
+
+/* Data written by the remote central, it is on the SPP channel unless a central link has it. */
+static void mico_ble_peripheral_rx_input(const uint8_t *p_data, uint16_t length)
+{
+    if (g_ble_context.m_spp_owner == BLE_SPP_OWNER_PERIPHERAL) {
+        mico_ble_rx_input(p_data, length);
+    } else {
+        mico_ble_rx_raw_input(g_ble_context.m_peripheral_socket.connection_handle, p_data, length);
+    }
+}
+
+/* Execute Write request, its value is the flag: deliver the prepared value, or drop it on cancel. */
+static mico_bt_gatt_status_t mico_ble_peripheral_exec_write(mico_bt_ext_attribute_value_t *attribute)
+{
+    mico_bool_t execute = attribute->value_length >= 1 && attribute->p_value[0] == GATT_PREP_WRITE_EXEC;
+
+    if (execute && g_ble_context.m_prep_len > 0) {
+        mico_ble_peripheral_rx_input(g_ble_context.m_prep_buf, g_ble_context.m_prep_len);
+    }
+    mico_ble_peripheral_prep_write_reset();
+    return MICO_BT_GATT_SUCCESS;
+}
+
+static mico_bt_gatt_status_t mico_ble_periphreal_spp_data_in_callback(mico_bt_ext_attribute_value_t *attribute, 
+                                                                      mico_bt_gatt_request_type_t op)
+{
+    if (op == GATTS_REQ_TYPE_WRITE) {
+        mico_ble_peripheral_prep_write_reset();
+        mico_ble_peripheral_rx_input(attribute->p_value, attribute->value_length);
+        return MICO_BT_GATT_SUCCESS;
+    } else if (op == GATTS_REQ_TYPE_PREP_WRITE) {
+        return mico_ble_peripheral_prep_write(attribute);
+    } else if (op == GATTS_REQ_TYPE_WRITE_EXEC) {
+        return mico_ble_peripheral_exec_write(attribute);
+    } else {
+        return MICO_BT_GATT_ERROR;
+    }
+}
+
+static mico_bt_gatt_status_t mico_ble_periphreal_spp_out_callback(mico_bt_ext_attribute_value_t *attribute,
+                                                                  mico_bt_gatt_request_type_t op)
+{
+    UNUSED_PARAMETER(attribute);
+
+    /* The bearer is free for the next indication, see mico_ble_peripheral_send_data() */
+    if (op == GATTS_REQ_TYPE_CONF) {
+        mico_rtos_set_semaphore(&g_ble_context.m_spp_out_conf_sem);
+        return MICO_BT_GATT_SUCCESS;
+    }
+    return MICO_BT_GATT_ERROR;
+}
+
+static mico_bt_gatt_status_t mico_ble_periphreal_spp_cccd_callback(mico_bt_ext_attribute_value_t *attribute, 
+                                                                   mico_bt_gatt_request_type_t op)
+{
+    if (op == GATTS_REQ_TYPE_READ) {
+        return MICO_BT_GATT_SUCCESS;
+    } else if (op == GATTS_REQ_TYPE_WRITE) {
+        if (attribute->value_length != 2) {
+            return MICO_BT_GATT_INVALID_ATTR_LEN;
+        }
+        g_ble_context.m_spp_out_cccd_value = attribute->p_value[0] | (attribute->p_value[1] << 8);
+        if (g_ble_context.m_spp_out_cccd_value && g_ble_context.m_spp_owner == BLE_SPP_OWNER_PERIPHERAL) {
+            mico_ble_caps_exchange();
+        }
+        return MICO_BT_GATT_SUCCESS;
+    } else {
+        return MICO_BT_GATT_ERROR;
+    }
+}
+
+static mico_bt_result_t mico_ble_peripheral_device_init(void)
+{
+    OSStatus err = mico_bt_peripheral_init(&g_ble_context.m_peripheral_socket, 
+                                           &g_central_security_settings, 
+                                           mico_ble_peripheral_connect_handler,
+                                           mico_ble_peripheral_disconnect_handler,
+                                           NULL);
+    require_noerr(err, exit);
+
+    /* Build BT Stack layer GATT database */
+    err = mico_bt_gatt_db_init(g_peripheral_gatt_database, sizeof(g_peripheral_gatt_database));
+    require_noerr_action(err, exit, mico_bt_peripheral_deinit());
+
+    /* Build BT Application layer GATT database */
+    mico_ble_peripheral_create_attribute_db();
+
+    /* Set advertisement parameters and data payload */
+    mico_ble_peripheral_set_advertisement_data();
+
+exit:
+    return (mico_bt_result_t)err;
+}
+
+/* Push one chunk of SPP OUT data to the client, as a notification or an indication. */
+static OSStatus mico_ble_peripheral_send_chunk(const uint8_t *p_data, uint16_t length)
+{
+    OSStatus err = mico_bt_peripheral_ext_attribute_value_write(g_ble_context.m_spp_out_attribute, length, 0, p_data);
+    require_noerr(err, exit);
+
+    if (g_ble_context.m_spp_out_cccd_value & GATT_CLIENT_CONFIG_NOTIFICATION) {
+        err = mico_bt_peripheral_gatt_notify_attribute_value(&g_ble_context.m_peripheral_socket,
+                                                             g_ble_context.m_spp_out_attribute);
+    } else if (g_ble_context.m_spp_out_cccd_value & GATT_CLIENT_CONFIG_INDICATION) {
+        err = mico_bt_peripheral_gatt_indicate_attribute_value(&g_ble_context.m_peripheral_socket,
+                                                               g_ble_context.m_spp_out_attribute);
+    } else {
+        err = MICO_BT_BADOPTION;
+    }
+
+exit:
+    return err;
+}
+
+/*
+ * TX scheduler for the SPP OUT characteristic.
+ *
+ * The payload is split into (MTU - 3) sized chunks. In notification mode up to
+ * BLE_TX_NOTIFY_CREDITS chunks are queued back-to-back so that several packets
+ * go out in one connection event. ATT allows a single outstanding indication,
+ * so in indication mode the next chunk is built while the previous one is in
+ * flight and sent as soon as its confirmation arrives; the call returns once
+ * the last one is confirmed. A chunk refused by the stack is retried after one
+ * connection event until timeout_ms expires. With reliable notifications, sent chunks are kept in the
+ * retransmission window and no more than BLE_REL_WINDOW may be unacknowledged.
+ */
+static mico_bt_result_t mico_ble_peripheral_send_data(mico_ble_tx_msg_t *msg, uint32_t timeout_ms)
+{
+    OSStatus err = kNoErr;
+    uint32_t start = mico_rtos_get_time();
+    uint16_t chunk_size = (uint16_t)(g_ble_context.m_att_mtu - BLE_ATT_HDR_SIZE);
+    mico_bool_t is_indication = !(g_ble_context.m_spp_out_cccd_value & GATT_CLIENT_CONFIG_NOTIFICATION);
+    mico_bool_t is_confirming = MICO_FALSE;
+    uint8_t  in_flight = 0;
+    uint8_t  staging[BLE_ATT_MTU_MAX - BLE_ATT_HDR_SIZE];
+    const uint8_t *chunk = NULL;
+    uint16_t chunk_len = 0;
+    mico_bool_t sent_any = MICO_FALSE;
+    /* Raw messages of a peripheral connection not carrying the SPP channel bypass the window */
+    mico_bool_t rel = msg->is_framed && g_ble_context.m_rel.m_active;
+
+    if (!(g_ble_context.m_spp_out_cccd_value & (GATT_CLIENT_CONFIG_NOTIFICATION | GATT_CLIENT_CONFIG_INDICATION))) {
+        return MICO_BT_BADOPTION;
+    }
+
+    /* Confirmations left over from a send that timed out */
+    while (is_indication && mico_rtos_get_semaphore(&g_ble_context.m_spp_out_conf_sem, 0) == kNoErr) {
+    }
+
+    while (msg->remaining > 0 || chunk || is_confirming) {
+        if (!chunk && msg->remaining > 0) {
+            if (rel) {
+                /* Repair first, then wait for the central to open the window */
+                if (!mico_ble_rel_tx_resend()) {
+                    err = MICO_BT_ERROR;
+                    break;
+                }
+                if (!mico_ble_rel_tx_has_room()) {
+                    if (mico_rtos_get_time() - start >= timeout_ms) {
+                        err = MICO_BT_TIMEOUT;
+                        break;
+                    }
+                    mico_rtos_thread_msleep(BLE_TX_CREDIT_WAIT_MS);
+                    continue;
+                }
+            }
+            chunk = mico_ble_tx_next_chunk(msg, staging, chunk_size, &chunk_len);
+            if (!chunk) {
+                err = MICO_BT_BADOPTION;
+                break;
+            }
+        }
+
+        /* The next chunk is ready, the bearer is free once the previous indication is confirmed */
+        if (is_confirming) {
+            uint32_t elapsed = mico_rtos_get_time() - start;
+
+            if (elapsed >= timeout_ms
+                || mico_rtos_get_semaphore(&g_ble_context.m_spp_out_conf_sem, timeout_ms - elapsed) != kNoErr) {
+                err = MICO_BT_TIMEOUT;
+                break;
+            }
+            is_confirming = MICO_FALSE;
+            if (!chunk) {
+                break;
+            }
+        }
+
+        err = mico_ble_peripheral_send_chunk(chunk, chunk_len);
+        if (err == kNoErr) {
+            if (rel) {
+                mico_ble_rel_tx_push(chunk, chunk_len);
+            }
+            chunk = NULL;
+            sent_any = MICO_TRUE;
+            g_ble_context.m_tx_stats.bytes += chunk_len;
+            g_ble_context.m_tx_stats.packets++;
+            if (is_indication) {
+                is_confirming = MICO_TRUE;
+                continue;
+            }
+            if (++in_flight < BLE_TX_NOTIFY_CREDITS) {
+                continue;
+            }
+        } else if (err == MICO_BT_BADOPTION || mico_rtos_get_time() - start >= timeout_ms) {
+            break;
+        } else {
+            g_ble_context.m_tx_stats.retries++;
+        }
+
+        /* Out of credit: let the controller drain its buffers for one connection event. */
+        in_flight = 0;
+        if (msg->remaining > 0 || chunk) {
+            mico_rtos_thread_msleep(BLE_TX_CREDIT_WAIT_MS);
+        }
+    }
+
+    mico_ble_tx_stats_account(start);
+
+    if (err != kNoErr && err != MICO_BT_BADOPTION) {
+        /* Only report TIMEOUT when nothing went out, so callers may safely re-send. */
+        err = sent_any ? MICO_BT_ERROR : MICO_BT_TIMEOUT;
+    }
+    return (mico_bt_result_t)err;
+}
+
+/* State translate action. */
+static mico_bool_t app_peripheral_start_advertising(void *context)
+{
+    UNUSED_PARAMETER(context);
+
+    /* Start advertising proceudre, toward the lost central first */
+    if (!mico_ble_reconn_start_directed()) {
+        mico_bt_result_t err = mico_ble_set_device_discovery(MICO_TRUE);
+        if (err != MICO_BT_SUCCESS) {
+            return MICO_FALSE;
+        }
+    }
+    
+    /* notify user latyer */
+    mico_ble_post_evt(BLE_EVT_PERIPHREAL_ADV_START, NULL);
+
+    return MICO_TRUE;
+}
+
+static mico_bool_t app_peripheral_stop_advertising(void *context)
+{
+    mico_ble_reconn_t *reconn = &g_ble_context.m_reconn;
+
+    UNUSED_PARAMETER(context);
+
+    /* Also ends a directed advertising toward the lost central */
+    if (reconn->m_is_directed) {
+        reconn->m_is_directed = MICO_FALSE;
+        mico_rtos_stop_timer(&reconn->m_directed_timer);
+        mico_bt_start_advertisements(BTM_BLE_ADVERT_OFF, BLE_ADDR_PUBLIC, NULL);
+    } else if (mico_ble_set_device_discovery(MICO_FALSE) != MICO_BT_SUCCESS) {
+        return MICO_FALSE;
+    }
+
+    /* 发送LEADV=OFF消息 */
+    mico_ble_post_evt(BLE_EVT_PERIPHERAL_ADV_STOP, NULL);
+    return MICO_TRUE;
+}
+
+static mico_bool_t app_peripheral_connected(void *context)
+{
+    mico_ble_evt_params_t evt_params;
+
+    UNUSED_PARAMETER(context);
+
+    /* 发送LEADV=OFF消息 */
+    mico_ble_post_evt(BLE_EVT_PERIPHERAL_ADV_STOP, NULL);
+
+    /* Until the application sets the MTU exchanged with this central */
+    g_ble_context.m_att_mtu = BLE_ATT_MTU_DEFAULT;
+
+    if (g_ble_context.m_spp_owner == BLE_SPP_OWNER_NONE) {
+        mico_ble_spp_attach(NULL);
+    }
+    mico_ble_reconn_on_connected(BLE_ROLE_PERIPHERAL, g_ble_context.m_peripheral_socket.remote_device.address);
+
+    /* 发送LECONN=SLAVE,ON消息 */
+    memcpy(evt_params.bd_addr, g_ble_context.m_peripheral_socket.remote_device.address, 6);
+    evt_params.u.conn.handle = g_ble_context.m_peripheral_socket.connection_handle;
+    mico_ble_post_evt(BLE_EVT_PERIPHERAL_CONNECTED, &evt_params);
+    
+    return TRUE;
+}
+
+static mico_bool_t app_peripheral_disconnected(void *context)
+{
+    /* 发送LECONN=SLAVE,OFF消息 */
+    mico_ble_evt_params_t evt_params;
+
+    UNUSED_PARAMETER(context);
+
+    mico_ble_peripheral_prep_write_reset();
+    g_ble_context.m_att_mtu = BLE_ATT_MTU_DEFAULT;
+
+    /* No confirmation will come, wake a sender waiting for one */
+    mico_rtos_set_semaphore(&g_ble_context.m_spp_out_conf_sem);
+
+    if (g_ble_context.m_spp_owner == BLE_SPP_OWNER_PERIPHERAL) {
+        mico_ble_spp_detach(NULL);
+    }
+    if (!g_ble_context.m_reconn.m_is_closing) {
+        mico_ble_reconn_on_lost(BLE_ROLE_PERIPHERAL, g_ble_context.m_peripheral_socket.remote_device.address);
+    }
+    g_ble_context.m_reconn.m_is_closing = MICO_FALSE;
+
+    memcpy(evt_params.bd_addr, g_ble_context.m_peripheral_socket.remote_device.address, 6);
+    evt_params.u.disconn.handle = g_ble_context.m_peripheral_socket.connection_handle;
+    mico_ble_post_evt(BLE_EVT_PERIPHERAL_DISCONNECTED, &evt_params);
+    return TRUE;
+}
+
+/*----------------------------------------------------------------------------------------------
+ * Whitelist function definition
+ *
+ * Name prefixes are kept in a trie with first-child/next-sibling links in one
+ * node array. A name is matched by walking it from the root, so the cost does
+ * not depend on the number of prefixes. The caller holds m_wl.m_mutex.
+ */
+
+static uint16_t mico_ble_wl_find_child(const mico_ble_wl_t *wl, uint16_t node, uint8_t label)
+{
+    uint16_t child = wl->m_nodes[node].m_child;
+
+    while (child && wl->m_nodes[child].m_label != label) {
+        child = wl->m_nodes[child].m_sibling;
+    }
+    return child;
+}
+
+static mico_bool_t mico_ble_wl_grow(mico_ble_wl_t *wl)
+{
+    mico_ble_wl_node_t *nodes;
+    uint16_t capacity;
+
+    if (wl->m_capacity >= BLE_WL_NODE_MAX) {
+        return MICO_FALSE;
+    }
+    capacity = wl->m_capacity ? (uint16_t)(wl->m_capacity * 2) : BLE_WL_NODE_INIT;
+    nodes = (mico_ble_wl_node_t *)realloc(wl->m_nodes, capacity * sizeof(mico_ble_wl_node_t));
+    if (!nodes) {
+        return MICO_FALSE;
+    }
+    wl->m_nodes = nodes;
+    wl->m_capacity = capacity;
+    return MICO_TRUE;
+}
+
+static uint16_t mico_ble_wl_alloc_node(mico_ble_wl_t *wl)
+{
+    uint16_t node;
+
+    if (wl->m_free) {
+        node = wl->m_free;
+        wl->m_free = wl->m_nodes[node].m_sibling;
+    } else if (wl->m_used < wl->m_capacity || mico_ble_wl_grow(wl)) {
+        node = wl->m_used++;
+    } else {
+        return 0;
+    }
+    memset(&wl->m_nodes[node], 0, sizeof(mico_ble_wl_node_t));
+    return node;
+}
+
+/* Unlink and free the childless, non-terminal nodes at the end of path, bottom up. */
+static void mico_ble_wl_prune(mico_ble_wl_t *wl, const uint16_t *path, uint8_t depth)
+{
+    uint16_t node, parent, *link;
+
+    while (depth > 0) {
+        node = path[depth];
+        parent = path[depth - 1];
+        if (wl->m_nodes[node].m_flags || wl->m_nodes[node].m_child) {
+            break;
+        }
+        link = &wl->m_nodes[parent].m_child;
+        while (*link != node) {
+            link = &wl->m_nodes[*link].m_sibling;
+        }
+        *link = wl->m_nodes[node].m_sibling;
+        wl->m_nodes[node].m_sibling = wl->m_free;
+        wl->m_free = node;
+        depth--;
+    }
+}
+
+static mico_bt_result_t mico_ble_wl_insert(mico_ble_wl_t *wl, const char *prefix, uint8_t flag)
+{
+    uint16_t path[BLE_WL_PATTERN_MAX + 1];
+    uint16_t child;
+    uint8_t depth = 0;
+
+    if (wl->m_used == 0) {
+        if (!mico_ble_wl_grow(wl)) {
+            return MICO_BT_NO_RESOURCES;
+        }
+        memset(&wl->m_nodes[0], 0, sizeof(mico_ble_wl_node_t));
+        wl->m_used = 1;
+    }
+
+    path[0] = 0;
+    for (; *prefix; prefix++) {
+        child = mico_ble_wl_find_child(wl, path[depth], (uint8_t)*prefix);
+        if (!child) {
+            child = mico_ble_wl_alloc_node(wl);
+            if (!child) {
+                mico_ble_wl_prune(wl, path, depth);
+                return MICO_BT_NO_RESOURCES;
+            }
+            wl->m_nodes[child].m_label = (uint8_t)*prefix;
+            wl->m_nodes[child].m_sibling = wl->m_nodes[path[depth]].m_child;
+            wl->m_nodes[path[depth]].m_child = child;
+        }
+        path[++depth] = child;
+    }
+
+    if (!wl->m_nodes[path[depth]].m_flags) {
+        wl->m_patterns++;
+    }
+    wl->m_nodes[path[depth]].m_flags |= flag;
+    return MICO_BT_SUCCESS;
+}
+
+static mico_bt_result_t mico_ble_wl_remove(mico_ble_wl_t *wl, const char *prefix, uint8_t flag)
+{
+    uint16_t path[BLE_WL_PATTERN_MAX + 1];
+    uint8_t depth = 0;
+
+    if (wl->m_used == 0) {
+        return MICO_BT_BADARG;
+    }
+
+    path[0] = 0;
+    for (; *prefix; prefix++) {
+        path[depth + 1] = mico_ble_wl_find_child(wl, path[depth], (uint8_t)*prefix);
+        if (!path[depth + 1]) {
+            return MICO_BT_BADARG;
+        }
+        depth++;
+    }
+
+    if (!(wl->m_nodes[path[depth]].m_flags & flag)) {
+        return MICO_BT_BADARG;
+    }
+    wl->m_nodes[path[depth]].m_flags &= (uint8_t)~flag;
+    if (!wl->m_nodes[path[depth]].m_flags) {
+        wl->m_patterns--;
+        mico_ble_wl_prune(wl, path, depth);
+    }
+    return MICO_BT_SUCCESS;
+}
+
+/*
+ * Match an advertised name against the whitelist. Without any pattern, every
+ * named device matches, or every device if an empty whitelist name was set.
+ */
+static mico_bool_t mico_ble_wl_match(const char *name)
+{
+    mico_ble_wl_t *wl = &g_ble_context.m_wl;
+    mico_bool_t matched = MICO_FALSE;
+    uint16_t node = 0;
+
+    mico_rtos_lock_mutex(&wl->m_mutex);
+    if (wl->m_patterns == 0) {
+        /* Nameless devices, e.g. beacons, are only of use with their raw data. */
+        matched = g_ble_context.m_wl_name || name[0] != '\0' || g_ble_context.m_is_raw_report;
+    } else {
+        for (; *name; name++) {
+            node = mico_ble_wl_find_child(wl, node, (uint8_t)*name);
+            if (!node) {
+                break;
+            }
+            if (wl->m_nodes[node].m_flags) {
+                matched = MICO_TRUE;
+                break;
+            }
+        }
+    }
+    mico_rtos_unlock_mutex(&wl->m_mutex);
+    return matched;
+}
+
+/*----------------------------------------------------------------------------------------------
+ * Accept list function definition
+ *
+ * The known peers are mirrored into the controller filter accept list one
+ * entry at a time. The stack suspends and resumes scanning around each
+ * update, so this is safe while a scan is running.
+ */
+
+static int mico_ble_accept_list_find(const mico_bt_device_address_t addr)
+{
+    int i;
+
+    for (i = 0; i < g_ble_context.m_accept_count; i++) {
+        if (memcmp(g_ble_context.m_accept_list[i], addr, BD_ADDR_LEN) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+/*----------------------------------------------------------------------------------------------
+ * Central function definition 
+ */
+
+/* Seconds of the scan and rest parts of one duty cycle, rest is 0 without duty cycling. */
+static void mico_ble_scan_duty_split(const mico_ble_scan_config_t *cfg, uint16_t *scan_s, uint16_t *rest_s)
+{
+    uint32_t on;
+
+    if (cfg->duty_percent >= 100 || cfg->duty_period_second == 0) {
+        *scan_s = BLE_SCAN_CONTINUOUS_CHUNK_S;
+        *rest_s = 0;
+        return;
+    }
+    on = ((uint32_t)cfg->duty_period_second * cfg->duty_percent + 99) / 100;
+    on = MAX(on, 1);
+    *scan_s = (uint16_t)on;
+    *rest_s = (uint16_t)(cfg->duty_period_second - MIN(on, cfg->duty_period_second));
+}
+
+static mico_bt_result_t mico_ble_scan_start(void)
+{
+    const mico_ble_scan_config_t *cfg = &g_ble_context.m_scan_cfg;
+    mico_bt_smart_scan_settings_t settings = g_central_scan_settings;
+    uint16_t rest_s;
+
+    settings.type = cfg->is_active ? BT_SMART_ACTIVE_SCAN : BT_SMART_PASSIVE_SCAN;
+    settings.interval = cfg->interval;
+    settings.window = cfg->window;
+    settings.duration_second = cfg->duration_second;
+    if (cfg->duration_second == 0) {
+        mico_ble_scan_duty_split(cfg, &settings.duration_second, &rest_s);
+    }
+    if (g_ble_context.m_accept_filter) {
+        settings.filter_policy = FILTER_POLICY_WHITE_LIST;
+    }
+    /* The radio is shared with the peripheral role, leave it half of every interval */
+    if (!SM_InState(&g_ble_context.m_periph_sm, BLE_STATE_IDLE) && settings.window > settings.interval / 2) {
+        settings.window = settings.interval / 2;
+    }
+
+    return (mico_bt_result_t)mico_bt_smartbridge_start_scan(&settings,
+                                                            mico_ble_central_scan_complete_handler,
+                                                            mico_ble_central_scan_result_handler);
+}
+
+/* Whether a scan starts again when it completes: continuous, or an automatic connect is still looking. */
+static mico_bool_t mico_ble_scan_is_cycling(void)
+{
+    return g_ble_context.m_scan_cfg.duration_second == 0 || g_ble_context.m_auto_conn.m_is_armed;
+}
+
+/* Start the next scan of a continuous scan, unless scanning was stopped meanwhile. */
+static OSStatus mico_ble_scan_restart_handler(void *arg)
+{
+    UNUSED_PARAMETER(arg);
+
+    if (g_ble_context.m_scan_cycling
+        && SM_InState(&g_ble_context.m_central_sm, BLE_STATE_CENTRAL_SCANNING)
+        && !mico_bt_smartbridge_is_scanning()) {
+        mico_ble_scan_start();
+    }
+    return kNoErr;
+}
+
+static void mico_ble_scan_rest_timeout(void *arg)
+{
+    UNUSED_PARAMETER(arg);
+
+    mico_rtos_stop_timer(&g_ble_context.m_scan_rest_timer);
+    mico_ble_worker_send(BLE_WORKER_TASK, mico_ble_scan_restart_handler, NULL);
+}
+
+/* A scan is over, back to the links if some are up. */
+static void mico_ble_central_scan_end(void)
+{
+    SM_Handle(&g_ble_context.m_central_sm,
+              g_ble_context.m_link_count ? BLE_SM_EVT_CENTRAL_CONNECTED : BLE_SM_EVT_CENTRAL_SCANNED);
+}
+
+static OSStatus mico_ble_central_scan_complete_handler(void *arg)
+{
+    UNUSED_PARAMETER(arg);
+
+    /* A continuous scan stays in BLE_STATE_CENTRAL_SCANNING without any event. */
+    if (g_ble_context.m_scan_cycling) {
+        if (g_ble_context.m_scan_rest_ms) {
+            mico_rtos_start_timer(&g_ble_context.m_scan_rest_timer);
+        } else {
+            mico_ble_worker_send(BLE_WORKER_TASK, mico_ble_scan_restart_handler, NULL);
+        }
+        return kNoErr;
+    }
+
+    if (SM_InState(&g_ble_context.m_central_sm, BLE_STATE_CENTRAL_SCANNING)) {
+        mico_ble_central_scan_end();
+    }
+    return kNoErr;
+}
+
+/* Whether a UUID list of an AD structure holds the filter UUID, UUIDs are little endian on air. */
+static mico_bool_t mico_ble_ad_has_uuid(const uint8_t *p, uint8_t length, uint8_t uuid_len, const mico_bt_uuid_t *uuid)
+{
+    uint8_t i;
+
+    if (uuid->len != uuid_len) {
+        return MICO_FALSE;
+    }
+
+    for (i = 0; i + uuid_len <= length; i += uuid_len, p += uuid_len) {
+        if (uuid_len == LEN_UUID_16) {
+            if ((uint16_t)(p[0] | p[1] << 8) == uuid->uu.uuid16) {
+                return MICO_TRUE;
+            }
+        } else if (uuid_len == LEN_UUID_32) {
+            if (((uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24) == uuid->uu.uuid32) {
+                return MICO_TRUE;
+            }
+        } else if (memcmp(p, uuid->uu.uuid128, LEN_UUID_128) == 0) {
+            return MICO_TRUE;
+        }
+    }
+    return MICO_FALSE;
+}
+
+/*
+ * Walk the AD structures of an advertising or scan response payload once
+ * and check them against the filter. Each condition set in the filter must
+ * be met; parsing stops as soon as all are.
+ */
+static mico_bool_t mico_ble_ad_match(const uint8_t *p_data, uint8_t length, const mico_ble_ad_filter_t *filter)
+{
+    mico_bool_t need_uuid = filter->service_uuid.len != 0;
+    mico_bool_t need_company = filter->match_company;
+    const uint8_t *end = p_data + length;
+    const uint8_t *value;
+    uint8_t ad_len, i;
+
+    while ((need_uuid || need_company) && p_data < end) {
+        ad_len = p_data[0];
+        if (ad_len == 0) {
+            break;                      /* zero padding up to 31 bytes */
+        }
+        if (p_data + 1 + ad_len > end) {
+            break;                      /* truncated, ignore the rest */
+        }
+        value = p_data + 2;
+
+        switch (p_data[1]) {
+            case BLE_AD_TYPE_16BIT_UUID_INCOMPLETE:
+            case BLE_AD_TYPE_16BIT_UUID_COMPLETE:
+                need_uuid = need_uuid && !mico_ble_ad_has_uuid(value, ad_len - 1, LEN_UUID_16, &filter->service_uuid);
+                break;
+            case BLE_AD_TYPE_32BIT_UUID_INCOMPLETE:
+            case BLE_AD_TYPE_32BIT_UUID_COMPLETE:
+                need_uuid = need_uuid && !mico_ble_ad_has_uuid(value, ad_len - 1, LEN_UUID_32, &filter->service_uuid);
+                break;
+            case BLE_AD_TYPE_128BIT_UUID_INCOMPLETE:
+            case BLE_AD_TYPE_128BIT_UUID_COMPLETE:
+                need_uuid = need_uuid && !mico_ble_ad_has_uuid(value, ad_len - 1, LEN_UUID_128, &filter->service_uuid);
+                break;
+            case BLE_AD_TYPE_MANUFACTURER:
+                if (need_company && ad_len - 1 >= 2 + filter->data_length
+                    && (uint16_t)(value[0] | value[1] << 8) == filter->company_id) {
+                    for (i = 0; i < filter->data_length; i++) {
+                        if ((value[2 + i] ^ filter->data[i]) & filter->mask[i]) {
+                            break;
+                        }
+                    }
+                    need_company = i < filter->data_length;
+                }
+                break;
+            default:
+                break;
+        }
+        p_data += 1 + ad_len;
+    }
+    return !need_uuid && !need_company;
+}
+
+#define NEARBY_AT(t, i)     (&(t)->m_slots[(t)->m_heap[i]])
+
+/* Whether a ranks below b, i.e. is replaced first. */
+static mico_bool_t mico_ble_nearby_less(const mico_ble_nearby_table_t *t,
+                                        const mico_ble_nearby_slot_t *a,
+                                        const mico_ble_nearby_slot_t *b)
+{
+    if (t->m_order == BLE_NEARBY_BY_RECENT) {
+        return (int32_t)(a->m_last_seen - b->m_last_seen) < 0;
+    }
+    return a->m_rssi < b->m_rssi;
+}
+
+static void mico_ble_nearby_swap(mico_ble_nearby_table_t *t, uint8_t i, uint8_t j)
+{
+    uint8_t slot = t->m_heap[i];
+
+    t->m_heap[i] = t->m_heap[j];
+    t->m_heap[j] = slot;
+    t->m_pos[t->m_heap[i]] = i;
+    t->m_pos[t->m_heap[j]] = j;
+}
+
+static void mico_ble_nearby_sift_down(mico_ble_nearby_table_t *t, uint8_t i)
+{
+    uint8_t child;
+
+    for (;;) {
+        child = 2 * i + 1;
+        if (child >= t->m_count) {
+            break;
+        }
+        if (child + 1 < t->m_count && mico_ble_nearby_less(t, NEARBY_AT(t, child + 1), NEARBY_AT(t, child))) {
+            child++;
+        }
+        if (!mico_ble_nearby_less(t, NEARBY_AT(t, child), NEARBY_AT(t, i))) {
+            break;
+        }
+        mico_ble_nearby_swap(t, i, child);
+        i = child;
+    }
+}
+
+/* Restore the heap order around position i after its key changed. */
+static void mico_ble_nearby_sift(mico_ble_nearby_table_t *t, uint8_t i)
+{
+    while (i > 0 && mico_ble_nearby_less(t, NEARBY_AT(t, i), NEARBY_AT(t, (i - 1) / 2))) {
+        mico_ble_nearby_swap(t, i, (i - 1) / 2);
+        i = (i - 1) / 2;
+    }
+    mico_ble_nearby_sift_down(t, i);
+}
+
+/* Remove the device at heap position i. The caller holds m_nearby.m_mutex. */
+static void mico_ble_nearby_remove(mico_ble_nearby_table_t *t, uint8_t i)
+{
+    g_ble_context.m_scan_cache[NEARBY_AT(t, i)->m_entry].m_nearby = 0;
+
+    t->m_count--;
+    if (i != t->m_count) {
+        mico_ble_nearby_swap(t, i, t->m_count);
+        mico_ble_nearby_sift(t, i);
+    }
+}
+
+/* Remove the devices not seen for BLE_SCAN_ENTRY_TTL_MS. The caller holds m_nearby.m_mutex. */
+static void mico_ble_nearby_purge(mico_ble_nearby_table_t *t, uint32_t now)
+{
+    uint8_t i = 0;
+
+    while (i < t->m_count) {
+        if (now - NEARBY_AT(t, i)->m_last_seen >= BLE_SCAN_ENTRY_TTL_MS) {
+            /* The last device moves here, look at position i again. */
+            mico_ble_nearby_remove(t, i);
+        } else {
+            i++;
+        }
+    }
+    t->m_purged_at = now;
+}
+
+/* Forget the device of a scan cache entry that is about to be reused. */
+static void mico_ble_nearby_drop(mico_ble_scan_entry_t *entry)
+{
+    mico_ble_nearby_table_t *t = &g_ble_context.m_nearby;
+
+    mico_rtos_lock_mutex(&t->m_mutex);
+    if (entry->m_nearby) {
+        mico_ble_nearby_remove(t, t->m_pos[entry->m_nearby - 1]);
+    }
+    mico_rtos_unlock_mutex(&t->m_mutex);
+}
+
+/*
+ * Account an advertisement of a matching device in the nearby table. A
+ * device already in the table is updated in place; a new one takes a free
+ * slot, or replaces the root if it ranks above it.
+ */
+static void mico_ble_nearby_update(mico_ble_scan_entry_t *entry, const char *name, int8_t rssi)
+{
+    mico_ble_nearby_table_t *t = &g_ble_context.m_nearby;
+    mico_ble_nearby_slot_t candidate;
+    mico_ble_nearby_slot_t *slot;
+    uint32_t now = mico_rtos_get_time();
+    uint8_t i;
+
+    mico_rtos_lock_mutex(&t->m_mutex);
+
+    if (entry->m_nearby) {
+        slot = &t->m_slots[entry->m_nearby - 1];
+        strncpy(slot->m_name, name, sizeof(slot->m_name) - 1);
+        slot->m_rssi = rssi;
+        slot->m_last_seen = now;
+        mico_ble_nearby_sift(t, t->m_pos[entry->m_nearby - 1]);
+        goto exit;
+    }
+
+    if (t->m_count == BLE_NEARBY_MAX && now - t->m_purged_at >= BLE_NEARBY_PURGE_MS) {
+        mico_ble_nearby_purge(t, now);
+    }
+
+    if (t->m_count < BLE_NEARBY_MAX) {
+        i = t->m_count++;
+    } else {
+        candidate.m_rssi = rssi;
+        candidate.m_last_seen = now;
+        if (!mico_ble_nearby_less(t, NEARBY_AT(t, 0), &candidate)) {
+            goto exit;
+        }
+        i = 0;
+        g_ble_context.m_scan_cache[NEARBY_AT(t, 0)->m_entry].m_nearby = 0;
+    }
+
+    slot = NEARBY_AT(t, i);
+    memcpy(slot->m_addr, entry->m_addr, BD_ADDR_LEN);
+    strncpy(slot->m_name, name, sizeof(slot->m_name) - 1);
+    slot->m_rssi = rssi;
+    slot->m_last_seen = now;
+    slot->m_entry = (uint8_t)(entry - g_ble_context.m_scan_cache);
+    entry->m_nearby = t->m_heap[i] + 1;
+    mico_ble_nearby_sift(t, i);
+
+exit:
+    mico_rtos_unlock_mutex(&t->m_mutex);
+}
+
+static uint32_t mico_ble_scan_cache_hash(const mico_bt_device_address_t addr)
+{
+    uint32_t key = ((uint32_t)addr[0] << 24 | (uint32_t)addr[1] << 16 | (uint32_t)addr[2] << 8 | addr[3])
+                   ^ ((uint32_t)addr[4] << 8 | addr[5]);
+
+    return (key * 2654435761UL) >> 24;
+}
+
+/*
+ * Record an advertisement of a device and decide whether to report it. The
+ * controller duplicate filter is reset whenever scanning restarts and hides
+ * RSSI changes, so duplicates are filtered here instead. Open addressing with
+ * linear probing over at most BLE_SCAN_CACHE_PROBE_MAX slots; if none matches
+ * or is free, the least recently seen one is replaced.
+ *
+ * @param rssi
+ *          In: the RSSI of this advertisement. Out: the smoothed RSSI to report.
+ *
+ * @param ad_hash
+ *          Hash of the advertising data, a change is reported at once. 0 if not of interest.
+ *
+ * @param p_entry
+ *          Out: the cache entry of the device.
+ *
+ * @return
+ *      MICO_TRUE if the device should be reported.
+ */
+static mico_bool_t mico_ble_scan_cache_update(const mico_bt_device_address_t addr, int8_t *rssi, uint32_t ad_hash,
+                                              mico_ble_scan_entry_t **p_entry)
+{
+    uint32_t now = mico_rtos_get_time();
+    uint32_t index = mico_ble_scan_cache_hash(addr);
+    mico_ble_scan_entry_t *entry = NULL;
+    mico_ble_scan_entry_t *victim = NULL;
+    mico_bool_t victim_free = MICO_FALSE;
+    mico_ble_scan_entry_t *slot;
+    int8_t delta;
+    uint8_t i;
+
+    for (i = 0; i < BLE_SCAN_CACHE_PROBE_MAX; i++) {
+        slot = &g_ble_context.m_scan_cache[(index + i) & (BLE_SCAN_CACHE_SIZE - 1)];
+        if (slot->m_used && memcmp(slot->m_addr, addr, BD_ADDR_LEN) == 0) {
+            entry = slot;
+            break;
+        }
+        if (!slot->m_used || now - slot->m_last_seen >= BLE_SCAN_ENTRY_TTL_MS) {
+            /* Keep looking for a match, the device may sit further along. */
+            if (!victim_free) {
+                victim = slot;
+                victim_free = MICO_TRUE;
+            }
+        } else if (!victim_free && (!victim || now - slot->m_last_seen > now - victim->m_last_seen)) {
+            victim = slot;
+        }
+    }
+
+    if (!entry || now - entry->m_last_seen >= BLE_SCAN_ENTRY_TTL_MS) {
+        /* New (or forgotten) device, report at once. */
+        if (!entry) {
+            entry = victim;
+            mico_ble_nearby_drop(entry);
+        }
+        *p_entry = entry;
+        memcpy(entry->m_addr, addr, BD_ADDR_LEN);
+        entry->m_used = MICO_TRUE;
+        entry->m_rssi = (int16_t)(*rssi * (1 << BLE_SCAN_RSSI_SHIFT));
+        entry->m_reported_rssi = *rssi;
+        entry->m_last_seen = now;
+        entry->m_last_report = now;
+        entry->m_ad_hash = ad_hash;
+        return MICO_TRUE;
+    }
+
+    *p_entry = entry;
+    entry->m_rssi += (int16_t)(*rssi - (entry->m_rssi >> BLE_SCAN_RSSI_SHIFT));
+    entry->m_last_seen = now;
+    *rssi = (int8_t)(entry->m_rssi >> BLE_SCAN_RSSI_SHIFT);
+
+    delta = (int8_t)(*rssi - entry->m_reported_rssi);
+    if (delta >= BLE_SCAN_RSSI_DELTA || delta <= -BLE_SCAN_RSSI_DELTA
+        || now - entry->m_last_report >= BLE_SCAN_REFRESH_MS || ad_hash != entry->m_ad_hash) {
+        entry->m_reported_rssi = *rssi;
+        entry->m_last_report = now;
+        entry->m_ad_hash = ad_hash;
+        return MICO_TRUE;
+    }
+    return MICO_FALSE;
+}
+
+/* FNV-1a, to notice a change of the advertising data of a device */
+static uint32_t mico_ble_ad_hash(const uint8_t *p_data, uint8_t length)
+{
+    uint32_t hash = 2166136261UL;
+
+    while (length--) {
+        hash = (hash ^ *p_data++) * 16777619UL;
+    }
+    return hash ? hash : 1;
+}
+
+static OSStatus mico_ble_central_scan_result_handler(const mico_bt_smart_advertising_report_t *scan_result)
+{
+    char str_addr[BDADDR_NTOA_SIZE] = {0};
+    mico_ble_evt_params_t evt_params;
+    mico_ble_scan_entry_t *entry;
+    mico_bool_t report;
+    mico_bool_t is_filtered;
+    mico_bool_t is_raw = g_ble_context.m_is_raw_report;
+    uint8_t length = MIN(scan_result->eir_data_length, BLE_ADV_DATA_MAX);
+    uint8_t *p_adv = NULL;
+    int8_t rssi = scan_result->signal_strength;
+
+    if (scan_result->signal_strength >= 0) {
+        return kUnknownErr;
+    }
+
+    /*
+     * Connectable devices only, unless raw data is wanted: then beacons and
+     * other non-connectable advertisers too. Scan responses carry other data
+     * than the advertisement and would look like a change every time.
+     */
+    if (scan_result->event != BT_SMART_CONNECTABLE_UNDIRECTED_ADVERTISING_EVENT
+        && (!is_raw || (scan_result->event != BT_SMART_SCANNABLE_UNDIRECTED_ADVERTISING_EVENT
+                        && scan_result->event != BT_SMART_NON_CONNECTABLE_UNDIRECTED_ADVERTISING_EVENT))) {
+        return kNoErr;
+    }
+
+    if (g_ble_context.m_auto_conn.m_is_armed
+        && scan_result->event == BT_SMART_CONNECTABLE_UNDIRECTED_ADVERTISING_EVENT) {
+        mico_ble_auto_conn_check(scan_result);
+    }
+
+    /* Cheapest test first, before any name compare or event */
+    mico_rtos_lock_mutex(&g_ble_context.m_ad_filter_mutex);
+    is_filtered = g_ble_context.m_ad_filter_on
+                  && !mico_ble_ad_match(scan_result->eir_data, scan_result->eir_data_length, &g_ble_context.m_ad_filter);
+    mico_rtos_unlock_mutex(&g_ble_context.m_ad_filter_mutex);
+    if (is_filtered) {
+        return kNoErr;
+    }
+
+    if (!mico_ble_wl_match(scan_result->remote_device.name)) {
+        return kNoErr;
+    }
+
+    report = mico_ble_scan_cache_update(scan_result->remote_device.address, &rssi,
+                                        is_raw ? mico_ble_ad_hash(scan_result->eir_data, length) : 0,
+                                        &entry);
+    mico_ble_nearby_update(entry, scan_result->remote_device.name, rssi);
+    if (!report) {
+        return kNoErr;
+    }
+
+    mico_ble_log("Scan result: %s", bdaddr_ntoa(scan_result->remote_device.address, str_addr));
+    memset(&evt_params, 0, sizeof(evt_params));
+    memcpy(evt_params.bd_addr, scan_result->remote_device.address, 6);
+    strcpy(evt_params.u.report.name, scan_result->remote_device.name);
+    evt_params.u.report.rssi = rssi;
+    evt_params.u.report.addr_type = (uint8_t)scan_result->remote_device.address_type;
+    evt_params.u.report.adv_type = (uint8_t)scan_result->event;
+
+    /* The report is only valid in this callback, so the data is copied once into a block the event owns. */
+    if (is_raw && g_ble_context.m_cback) {
+        p_adv = mico_ble_pool_alloc(&g_ble_context.m_adv_pool);
+        if (p_adv) {
+            memcpy(p_adv, scan_result->eir_data, length);
+            evt_params.u.report.p_adv_data = p_adv;
+            evt_params.u.report.adv_data_length = length;
+        } else {
+            mico_ble_log("No free advertising data buffer, report without data");
+        }
+    }
+
+    if (!p_adv) {
+        mico_ble_post_evt(BLE_EVT_CENTRAL_REPORT, &evt_params);
+    } else if (!mico_ble_post_evt_msg(BLE_EVT_CENTRAL_REPORT, &evt_params, &g_ble_context.m_adv_pool)) {
+        mico_ble_pool_free(&g_ble_context.m_adv_pool, p_adv);
+    }
+    return kNoErr;
+}
+
+/*---------------------------------------------------------------------------------------------
+ * Central link function definition
+ *
+ * Each link runs its own instance of the link state machine. The global state
+ * machine stays in BLE_STATE_CENTRAL_CONNECTED while at least one link is up.
+ * Connected links are indexed by connection handle in a small chained hash.
+ */
+
+/* The link owning a smartbridge socket, NULL if the socket is not ours. */
+static mico_ble_link_t *mico_ble_link_of_socket(const mico_bt_smartbridge_socket_t *socket)
+{
+    uint8_t i;
+
+    for (i = 0; i < BLE_CENTRAL_LINK_MAX; i++) {
+        if (&g_ble_context.m_links[i].m_socket == socket) {
+            return &g_ble_context.m_links[i];
+        }
+    }
+    return NULL;
+}
+
+/* The first link in a state, to the given peer if bdaddr is not NULL. */
+static mico_ble_link_t *mico_ble_link_lookup(uint8_t state, const uint8_t *bdaddr)
+{
+    uint8_t i;
+
+    for (i = 0; i < BLE_CENTRAL_LINK_MAX; i++) {
+        mico_ble_link_t *link = &g_ble_context.m_links[i];
+
+        if (SM_InState(&link->m_sm, state)
+            && (!bdaddr || memcmp(link->m_peer.address, bdaddr, BD_ADDR_LEN) == 0)) {
+            return link;
+        }
+    }
+    return NULL;
+}
+
+/* A connected link by connection handle. */
+static mico_ble_link_t *mico_ble_link_find(uint16_t handle)
+{
+    uint8_t i = g_ble_context.m_link_buckets[handle & (BLE_LINK_HASH_SIZE - 1)];
+
+    while (i != 0) {
+        mico_ble_link_t *link = &g_ble_context.m_links[i - 1];
+
+        if (link->m_handle == handle) {
+            return link;
+        }
+        i = link->m_hash_next;
+    }
+    return NULL;
+}
+
+static void mico_ble_link_hash_insert(mico_ble_link_t *link)
+{
+    uint8_t *bucket = &g_ble_context.m_link_buckets[link->m_handle & (BLE_LINK_HASH_SIZE - 1)];
+
+    link->m_hash_next = *bucket;
+    *bucket = (uint8_t)(link - g_ble_context.m_links + 1);
+}
+
+static void mico_ble_link_hash_remove(mico_ble_link_t *link)
+{
+    uint8_t *next = &g_ble_context.m_link_buckets[link->m_handle & (BLE_LINK_HASH_SIZE - 1)];
+    uint8_t index = (uint8_t)(link - g_ble_context.m_links + 1);
+
+    while (*next != 0 && *next != index) {
+        next = &g_ble_context.m_links[*next - 1].m_hash_next;
+    }
+    if (*next == index) {
+        *next = link->m_hash_next;
+    }
+    link->m_hash_next = 0;
+}
+
+/* Connection handle of the connection carrying the SPP channel, 0 if none. */
+static uint16_t mico_ble_spp_handle(void)
+{
+    switch (g_ble_context.m_spp_owner) {
+        case BLE_SPP_OWNER_CENTRAL:
+            return g_ble_context.m_primary->m_handle;
+        case BLE_SPP_OWNER_PERIPHERAL:
+            return g_ble_context.m_peripheral_socket.connection_handle;
+        default:
+            return 0;
+    }
+}
+
+/* Start the SPP channel on a central link, or on the peripheral connection if link is NULL. */
+static void mico_ble_spp_attach(mico_ble_link_t *link)
+{
+    g_ble_context.m_primary = link;
+    g_ble_context.m_spp_owner = link ? BLE_SPP_OWNER_CENTRAL : BLE_SPP_OWNER_PERIPHERAL;
+    mico_ble_frame_reset();
+
+    /* Start a new throughput window for the connection carrying the channel */
+    memset(&g_ble_context.m_tx_stats, 0, sizeof(g_ble_context.m_tx_stats));
+    g_ble_context.m_tx_stats.handle = mico_ble_spp_handle();
+
+    if (link) {
+        mico_ble_log("SPP channel on central link 0x%04x", link->m_handle);
+        mico_ble_caps_exchange();
+
+        /* Connected with the parameters of the selected profile */
+        g_ble_context.m_conn_profile_active = g_ble_context.m_conn_profile;
+
+        mico_ble_coc_connect(&link->m_peer);
+    } else {
+        mico_ble_log("SPP channel on peripheral connection 0x%04x",
+                     g_ble_context.m_peripheral_socket.connection_handle);
+
+        /* The central picked the parameters, ask for ours */
+        g_ble_context.m_conn_profile_active = BLE_CONN_PROFILE_DEFAULT;
+        if (g_ble_context.m_conn_profile != BLE_CONN_PROFILE_DEFAULT) {
+            mico_ble_conn_profile_apply(g_ble_context.m_conn_profile);
+        }
+
+        /* Handed over from a central link, the remote central has subscribed already */
+        if (g_ble_context.m_spp_out_cccd_value) {
+            mico_ble_caps_exchange();
+        }
+    }
+}
+
+/*
+ * The connection carrying the SPP channel is going down, leaving is its link
+ * or NULL for the peripheral connection. The channel moves to another central
+ * link first, then to the peripheral connection.
+ */
+static void mico_ble_spp_detach(mico_ble_link_t *leaving)
+{
+    mico_ble_link_t *next = NULL;
+    uint8_t i;
+
+    mico_rtos_stop_timer(&g_ble_context.m_conn_idle_timer);
+    g_ble_context.m_coc_cid = 0;
+    g_ble_context.m_primary = NULL;
+    g_ble_context.m_spp_owner = BLE_SPP_OWNER_NONE;
+
+    for (i = 0; i < BLE_CENTRAL_LINK_MAX; i++) {
+        mico_ble_link_t *link = &g_ble_context.m_links[i];
+
+        if (link != leaving && SM_InState(&link->m_sm, BLE_LINK_STATE_CONNECTED)) {
+            next = link;
+            break;
+        }
+    }
+
+    if (next) {
+        mico_ble_spp_attach(next);
+    } else if (leaving && SM_InState(&g_ble_context.m_periph_sm, BLE_STATE_PERIPHERAL_CONNECTED)) {
+        mico_ble_spp_attach(NULL);
+    }
+}
+
+/* A connection attempt is over without a link, the other links may still be up. */
+static void mico_ble_link_connect_failed(mico_ble_link_t *link)
+{
+    SM_Handle(&link->m_sm, BLE_LINK_EVT_CONNECTION_FAIL);
+
+    if (SM_InState(&g_ble_context.m_central_sm, BLE_STATE_CENTRAL_CONNECTING)
+        && !mico_ble_link_lookup(BLE_LINK_STATE_CONNECTING, NULL)) {
+        SM_Handle(&g_ble_context.m_central_sm, g_ble_context.m_link_count ? BLE_SM_EVT_CENTRAL_CONNECTED
+                                                                          : BLE_SM_EVT_CENTRAL_CONNECTION_FAIL);
+    }
+}
+
+static OSStatus mico_ble_central_disconnection_handler(mico_bt_smartbridge_socket_t *socket)
+{
+    mico_ble_link_t *link = mico_ble_link_of_socket(socket);
+
+    mico_ble_log("smartbridge device disconnected.");
+
+    if (link && SM_InState(&link->m_sm, BLE_LINK_STATE_CONNECTED)) {
+        SM_Handle(&link->m_sm, BLE_LINK_EVT_DISCONNECTED);
+    }
+    return kNoErr;
+}
+
+/* Peer data from a notification or indication, called by the smartbridge with the cache updated. */
+static OSStatus mico_ble_central_notification_handler(mico_bt_smartbridge_socket_t *socket, uint16_t attribute_handle)
+{
+    OSStatus err = kNoErr;
+    uint8_t attribute_buffer[ATTR_CHARACTERISTIC_VALUE_SIZE(BLE_ATT_MTU_MAX - BLE_ATT_HDR_SIZE)];
+    mico_bt_smart_attribute_t *attribute = (mico_bt_smart_attribute_t *)attribute_buffer;
+    mico_ble_link_t *link = mico_ble_link_of_socket(socket);
+
+    if (!link || attribute_handle != link->m_notify_handle) {
+        return kNoErr;
+    }
+
+    err = mico_bt_smartbridge_get_attribute_cache_by_handle(socket, attribute_handle, attribute, sizeof(attribute_buffer));
+    require_noerr(err, exit);
+
+    if (link == g_ble_context.m_primary) {
+        mico_ble_rx_input(attribute->value.value, attribute->value_length);
+    } else {
+        mico_ble_rx_raw_input(link->m_handle, attribute->value.value, attribute->value_length);
+    }
+
+exit:
+    return err;
+}
+
+/*
+ * Write the CCCD of the subscribed characteristic, notification is preferred.
+ * Its descriptors follow the value handle up to the next declaration; the
+ * CCCDs of other cached characteristics are left alone.
+ */
+static void mico_ble_central_enable_notify(mico_ble_link_t *link, uint16_t value_handle, uint8_t properties)
+{
+    OSStatus err = MICO_BT_BADOPTION;
+    uint8_t attribute_buffer[ATTR_CHARACTERISTIC_VALUE_SIZE(BLE_ATT_MTU_MAX - BLE_ATT_HDR_SIZE)];
+    mico_bt_smart_attribute_t *descriptor = (mico_bt_smart_attribute_t *)attribute_buffer;
+    uint16_t handle;
+
+    link->m_notify_handle = value_handle;
+
+    for (handle = value_handle + 1; handle != 0; handle++) {
+        if (mico_bt_smartbridge_get_attribute_cache_by_handle(&link->m_socket, handle, descriptor,
+                                                              sizeof(attribute_buffer)) != kNoErr) {
+            break;
+        }
+        if (descriptor->type.len != LEN_UUID_16) {
+            continue;
+        }
+        if (descriptor->type.uu.uuid16 >= GATT_UUID_PRI_SERVICE && descriptor->type.uu.uuid16 <= GATT_UUID_CHAR_DECLARE) {
+            break;
+        }
+        if (descriptor->type.uu.uuid16 == GATT_UUID_CHAR_CLIENT_CONFIG) {
+            descriptor->value.value[0] = (properties & GATT_CHAR_PROP_BIT_NOTIFY) ? GATT_CLIENT_CONFIG_NOTIFICATION
+                                                                                  : GATT_CLIENT_CONFIG_INDICATION;
+            descriptor->value.value[1] = 0;
+            descriptor->value_length = 2;
+            err = mico_bt_smartbridge_write_attribute_cache_characteristic_value(&link->m_socket, descriptor);
+            break;
+        }
+    }
+    if (err != kNoErr) {
+        mico_ble_log("Enable notification failed, central RX is disabled.");
+        link->m_notify_handle = 0;
+    }
+}
+
+/* Subscribe to the notify characteristic of the service in [start_handle, end_handle], if any. */
+static void mico_ble_central_subscribe(mico_ble_link_t *link, uint16_t start_handle, uint16_t end_handle,
+                                       mico_ble_gatt_cache_entry_t *entry)
+{
+    OSStatus err;
+    uint8_t attribute_buffer[100];
+    mico_bt_smart_attribute_t *attribute = (mico_bt_smart_attribute_t *)attribute_buffer;
+
+    link->m_notify_handle = 0;
+    entry->notify_handle = 0;
+    entry->notify_properties = 0;
+
+    err = mico_bt_smartbridge_get_characteritics_from_attribute_cache_by_uuid(&link->m_socket,
+                                                                               &g_central_notify_char_uuid,
+                                                                               start_handle,
+                                                                               end_handle,
+                                                                               attribute,
+                                                                               sizeof(attribute_buffer));
+    require_noerr_string(err, exit, "The notify characteristic not found, central RX is disabled.");
+    require_string(attribute->value.characteristic.properties & (GATT_CHAR_PROP_BIT_NOTIFY | GATT_CHAR_PROP_BIT_INDICATE),
+                   exit, "The notify characteristic can not notify or indicate.");
+
+    entry->notify_handle = attribute->value.characteristic.value_handle;
+    entry->notify_properties = attribute->value.characteristic.properties;
+    mico_ble_central_enable_notify(link, entry->notify_handle, entry->notify_properties);
+
+exit:
+    return;
+}
+
+/*----------------------------------------------------------------------------------------------
+ * GATT cache function definition
+ *
+ * The smartbridge discovers the SPP service of every peer it connects to,
+ * inside mico_bt_smartbridge_connect(). The SPP handles found in its
+ * attribute cache are kept per peer address, so that a known peer is set up
+ * by checking its handles instead of searching the attribute cache for the
+ * service and both characteristics. The application keeps the table across
+ * reboots.
+ */
+
+static mico_bool_t mico_ble_uuid_equal(const mico_bt_uuid_t *a, const mico_bt_uuid_t *b)
+{
+    return a->len == b->len && memcmp(&a->uu, &b->uu, a->len) == 0;
+}
+
+/* Position of the entry of a peer, -1 if none. The caller holds m_gatt_cache.m_mutex. */
+static int mico_ble_gatt_cache_find(const uint8_t *bdaddr)
+{
+    mico_ble_gatt_cache_t *cache = &g_ble_context.m_gatt_cache;
+    uint8_t i;
+
+    for (i = 0; i < cache->m_count; i++) {
+        if (memcmp(cache->m_entries[i].bd_addr, bdaddr, BD_ADDR_LEN) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+/* Move the entry at position i to the front, or drop it if entry is NULL. The caller holds the mutex. */
+static void mico_ble_gatt_cache_take(int i, mico_ble_gatt_cache_entry_t *entry)
+{
+    mico_ble_gatt_cache_t *cache = &g_ble_context.m_gatt_cache;
+
+    if (entry) {
+        *entry = cache->m_entries[i];
+        memmove(&cache->m_entries[1], &cache->m_entries[0], i * sizeof(mico_ble_gatt_cache_entry_t));
+        cache->m_entries[0] = *entry;
+    } else {
+        memmove(&cache->m_entries[i], &cache->m_entries[i + 1],
+                (cache->m_count - i - 1) * sizeof(mico_ble_gatt_cache_entry_t));
+        cache->m_count--;
+    }
+}
+
+/* Insert or update the entry of a peer as the most recently used one, the last one is dropped if full. */
+static void mico_ble_gatt_cache_store(const mico_ble_gatt_cache_entry_t *entry)
+{
+    mico_ble_gatt_cache_t *cache = &g_ble_context.m_gatt_cache;
+    int i;
+
+    mico_rtos_lock_mutex(&cache->m_mutex);
+    i = mico_ble_gatt_cache_find(entry->bd_addr);
+    if (i < 0) {
+        i = (cache->m_count < BLE_GATT_CACHE_MAX) ? cache->m_count++ : BLE_GATT_CACHE_MAX - 1;
+    }
+    memmove(&cache->m_entries[1], &cache->m_entries[0], i * sizeof(mico_ble_gatt_cache_entry_t));
+    cache->m_entries[0] = *entry;
+    mico_rtos_unlock_mutex(&cache->m_mutex);
+
+    mico_ble_post_evt(BLE_EVT_GATT_CACHE_CHANGED, NULL);
+}
+
+/* Whether a handle of the freshly discovered attribute cache holds a characteristic value of the given UUID. */
+static mico_bool_t mico_ble_gatt_cache_check(mico_ble_link_t *link, uint16_t handle, const mico_bt_uuid_t *uuid)
+{
+    uint8_t attribute_buffer[ATTR_CHARACTERISTIC_VALUE_SIZE(BLE_ATT_MTU_MAX - BLE_ATT_HDR_SIZE)];
+    mico_bt_smart_attribute_t *attribute = (mico_bt_smart_attribute_t *)attribute_buffer;
+
+    return mico_bt_smartbridge_get_attribute_cache_by_handle(&link->m_socket, handle, attribute,
+                                                             sizeof(attribute_buffer)) == kNoErr
+           && mico_ble_uuid_equal(&attribute->type, uuid);
+}
+
+/*
+ * Take the SPP handles of a known peer. Its SPP IN handle, and its notify
+ * handle if any, must still hold these characteristics in the attribute
+ * cache just discovered, otherwise the entry is dropped and the handles are
+ * looked up again.
+ */
+static mico_bool_t mico_ble_gatt_cache_restore(mico_ble_link_t *link, mico_ble_gatt_cache_entry_t *entry)
+{
+    mico_ble_gatt_cache_t *cache = &g_ble_context.m_gatt_cache;
+    mico_ble_gatt_cache_entry_t *cached;
+    mico_bool_t valid = MICO_FALSE;
+    int i;
+
+    mico_rtos_lock_mutex(&cache->m_mutex);
+    i = mico_ble_gatt_cache_find(link->m_peer.address);
+    if (i >= 0) {
+        cached = &cache->m_entries[i];
+        valid = mico_ble_gatt_cache_check(link, cached->in_handle, &g_central_whitelist_char_uuid)
+                && (cached->notify_handle == 0
+                    || mico_ble_gatt_cache_check(link, cached->notify_handle, &g_central_notify_char_uuid));
+        mico_ble_gatt_cache_take(i, valid ? entry : NULL);
+    }
+    mico_rtos_unlock_mutex(&cache->m_mutex);
+
+    if (i >= 0 && !valid) {
+        mico_ble_log("GATT cache entry of the peer is out of date");
+        mico_ble_post_evt(BLE_EVT_GATT_CACHE_CHANGED, NULL);
+    } else if (i > 0) {
+        /* The hit moved to the front, the saved order decides what is dropped first */
+        mico_ble_post_evt(BLE_EVT_GATT_CACHE_CHANGED, NULL);
+    }
+    return valid;
+}
+
+/* Account the connect-to-ready time of a link set up with or without a cache entry. */
+static void mico_ble_gatt_cache_account(mico_bool_t hit, uint32_t start)
+{
+    mico_ble_gatt_cache_t *cache = &g_ble_context.m_gatt_cache;
+    uint32_t elapsed = mico_rtos_get_time() - start;
+
+    mico_rtos_lock_mutex(&cache->m_mutex);
+    if (hit) {
+        cache->m_hits++;
+        cache->m_hit_ms += elapsed;
+    } else {
+        cache->m_misses++;
+        cache->m_miss_ms += elapsed;
+    }
+    mico_rtos_unlock_mutex(&cache->m_mutex);
+
+    mico_ble_log("Link ready in %lu ms, GATT cache %s", (unsigned long)elapsed, hit ? "hit" : "miss");
+}
+
+/*
+ * Connect phase timing function definition
+ */
+
+/* Close the current phase of an attempt, the next one starts now. */
+static void mico_ble_conn_phase_next(mico_ble_conn_timing_t *timing, uint32_t *mark, mico_ble_conn_phase_t next)
+{
+    uint32_t now = mico_rtos_get_time();
+
+    timing->phase_ms[timing->last_phase] = now - *mark;
+    timing->last_phase = (uint8_t)next;
+    *mark = now;
+}
+
+/* Histogram bucket of a phase duration: the bit length of ms. */
+static uint8_t mico_ble_conn_hist_bucket(uint32_t ms)
+{
+    uint8_t b = 0;
+
+    while (ms && b < BLE_CONN_HIST_BUCKETS - 1) {
+        ms >>= 1;
+        b++;
+    }
+    return b;
+}
+
+/* Close the last phase of an attempt and log it. */
+static void mico_ble_conn_timing_record(mico_ble_link_t *link, mico_ble_conn_timing_t *timing,
+                                        uint32_t mark, mico_bool_t is_ready)
+{
+    mico_ble_conn_timing_log_t *history = &g_ble_context.m_conn_timing;
+    uint8_t i;
+
+    mico_ble_conn_phase_next(timing, &mark, (mico_ble_conn_phase_t)timing->last_phase);
+    memcpy(timing->bd_addr, link->m_peer.address, BD_ADDR_LEN);
+    timing->is_ready = is_ready;
+    timing->age_ms = link->m_request_time;
+
+    mico_rtos_lock_mutex(&history->m_mutex);
+    history->m_ring[history->m_next] = *timing;
+    history->m_next = (uint8_t)((history->m_next + 1) % BLE_CONN_TIMING_MAX);
+    if (history->m_count < BLE_CONN_TIMING_MAX) {
+        history->m_count++;
+    }
+    for (i = 0; i <= timing->last_phase; i++) {
+        uint16_t *count = &history->m_hist.counts[i][mico_ble_conn_hist_bucket(timing->phase_ms[i])];
+        if (*count < 0xFFFF) {
+            (*count)++;
+        }
+    }
+    mico_rtos_unlock_mutex(&history->m_mutex);
+
+    mico_ble_log("Connect %s: queue %lu, security %lu, connect %lu, service %lu, characteristic %lu ms",
+                 is_ready ? "ready" : "failed",
+                 (unsigned long)timing->phase_ms[BLE_CONN_PHASE_QUEUE],
+                 (unsigned long)timing->phase_ms[BLE_CONN_PHASE_SECURITY],
+                 (unsigned long)timing->phase_ms[BLE_CONN_PHASE_CONNECT],
+                 (unsigned long)timing->phase_ms[BLE_CONN_PHASE_SERVICE],
+                 (unsigned long)timing->phase_ms[BLE_CONN_PHASE_CHARACTERISTIC]);
+}
+
+/*
+ * Reconnect function definition
+ */
+
+/* Next backoff delay: doubled up to the maximum, less up to 25% of jitter. */
+static uint32_t mico_ble_reconn_next_delay(void)
+{
+    mico_ble_reconn_t *reconn = &g_ble_context.m_reconn;
+    uint32_t base = reconn->m_backoff_ms ? reconn->m_backoff_ms : reconn->m_cfg.backoff_min_ms;
+    uint32_t jitter = 0;
+
+    reconn->m_backoff_ms = MIN(base * 2, reconn->m_cfg.backoff_max_ms);
+    MicoRandomNumberRead(&jitter, sizeof(jitter));
+    return base - jitter % (base / 4 + 1);
+}
+
+/* Connect to the target again, on the worker thread. */
+static OSStatus mico_ble_reconn_handler(void *arg)
+{
+    mico_ble_reconn_t *reconn = &g_ble_context.m_reconn;
+
+    UNUSED_PARAMETER(arg);
+
+    if (!reconn->m_is_pending || !reconn->m_cfg.enable) {
+        return kNoErr;
+    }
+
+    /* Connected or being connected meanwhile */
+    if (mico_ble_link_lookup(BLE_LINK_STATE_CONNECTING, reconn->m_target)
+        || mico_ble_link_lookup(BLE_LINK_STATE_CONNECTED, reconn->m_target)) {
+        return kNoErr;
+    }
+
+    if (mico_ble_connect(reconn->m_target) != MICO_BT_SUCCESS) {
+        mico_ble_reconn_schedule();
+    }
+    return kNoErr;
+}
+
+static void mico_ble_reconn_timeout(void *arg)
+{
+    UNUSED_PARAMETER(arg);
+
+    mico_rtos_stop_timer(&g_ble_context.m_reconn.m_timer);
+    mico_ble_worker_send(BLE_WORKER_TASK, mico_ble_reconn_handler, NULL);
+}
+
+/* Try the target again after the next delay. */
+static void mico_ble_reconn_schedule(void)
+{
+    mico_ble_reconn_t *reconn = &g_ble_context.m_reconn;
+    uint32_t delay = mico_ble_reconn_next_delay();
+    OSStatus err = kNoErr;
+
+    if (!reconn->m_timer_ms) {
+        err = mico_rtos_init_timer(&reconn->m_timer, delay, mico_ble_reconn_timeout, NULL);
+    } else if (delay != reconn->m_timer_ms) {
+        err = mico_rtos_change_timer_period(&reconn->m_timer, delay);
+    }
+    if (err != kNoErr) {
+        mico_ble_log("Error setting reconnect timer, reconnect given up");
+        reconn->m_is_pending = MICO_FALSE;
+        return;
+    }
+    reconn->m_timer_ms = delay;
+    mico_rtos_start_timer(&reconn->m_timer);
+    mico_ble_log("Reconnect in %lu ms", (unsigned long)delay);
+}
+
+static void mico_ble_reconn_cancel(void)
+{
+    mico_ble_reconn_t *reconn = &g_ble_context.m_reconn;
+
+    reconn->m_is_pending = MICO_FALSE;
+    reconn->m_backoff_ms = 0;
+    if (reconn->m_timer_ms) {
+        mico_rtos_stop_timer(&reconn->m_timer);
+    }
+}
+
+/* Reconnect to the target right now, backing off from the next failure on. */
+static mico_bt_result_t mico_ble_reconn_start(const uint8_t *bdaddr)
+{
+    mico_ble_reconn_t *reconn = &g_ble_context.m_reconn;
+
+    mico_ble_reconn_cancel();
+    memcpy(reconn->m_target, bdaddr, BD_ADDR_LEN);
+    reconn->m_is_pending = MICO_TRUE;
+    return (mico_bt_result_t)mico_ble_worker_send(BLE_WORKER_TASK, mico_ble_reconn_handler, NULL);
+}
+
+/* A connect attempt failed, back off if it was a reconnect. */
+static void mico_ble_reconn_on_failed(const uint8_t *bdaddr)
+{
+    mico_ble_reconn_t *reconn = &g_ble_context.m_reconn;
+
+    if (reconn->m_is_pending && memcmp(reconn->m_target, bdaddr, BD_ADDR_LEN) == 0) {
+        mico_ble_reconn_schedule();
+    }
+}
+
+/* A connection is up: remember the peer, a reconnect to it is over. */
+static void mico_ble_reconn_on_connected(mico_ble_role_t role, const uint8_t *bdaddr)
+{
+    mico_ble_reconn_t *reconn = &g_ble_context.m_reconn;
+
+    if (!reconn->m_has_last || reconn->m_last.role != role
+        || memcmp(reconn->m_last.bd_addr, bdaddr, BD_ADDR_LEN) != 0) {
+        memcpy(reconn->m_last.bd_addr, bdaddr, BD_ADDR_LEN);
+        reconn->m_last.role = (uint8_t)role;
+        reconn->m_has_last = MICO_TRUE;
+        mico_ble_post_evt(BLE_EVT_LAST_PEER_CHANGED, NULL);
+    }
+
+    if (role == BLE_ROLE_CENTRAL) {
+        if (reconn->m_is_pending && memcmp(reconn->m_target, bdaddr, BD_ADDR_LEN) == 0) {
+            mico_ble_reconn_cancel();
+        }
+    } else {
+        reconn->m_is_closing = MICO_FALSE;
+        if (reconn->m_is_directed) {
+            reconn->m_is_directed = MICO_FALSE;
+            mico_rtos_stop_timer(&reconn->m_directed_timer);
+        }
+    }
+}
+
+/* A connection was lost without mico_ble_disconnect(). */
+static void mico_ble_reconn_on_lost(mico_ble_role_t role, const uint8_t *bdaddr)
+{
+    mico_ble_reconn_t *reconn = &g_ble_context.m_reconn;
+
+    if (!reconn->m_cfg.enable) {
+        return;
+    }
+
+    if (role == BLE_ROLE_CENTRAL) {
+        mico_ble_log("Link lost, reconnecting");
+        mico_ble_reconn_start(bdaddr);
+    } else {
+        /* Taken by app_peripheral_start_advertising() right after */
+        memcpy(reconn->m_direct_addr, bdaddr, BD_ADDR_LEN);
+        reconn->m_direct_next = MICO_TRUE;
+    }
+}
+
+/* Advertise toward the lost central if requested, it must be bonded to answer. */
+static mico_bool_t mico_ble_reconn_start_directed(void)
+{
+    mico_ble_reconn_t *reconn = &g_ble_context.m_reconn;
+
+    if (!reconn->m_direct_next) {
+        return MICO_FALSE;
+    }
+    reconn->m_direct_next = MICO_FALSE;
+
+    if (!mico_bt_dev_find_bonded_device(reconn->m_direct_addr)) {
+        return MICO_FALSE;
+    }
+    if (mico_bt_start_advertisements(BTM_BLE_ADVERT_DIRECTED_HIGH, BLE_ADDR_PUBLIC, reconn->m_direct_addr) != MICO_BT_SUCCESS) {
+        return MICO_FALSE;
+    }
+
+    reconn->m_is_directed = MICO_TRUE;
+    mico_rtos_start_timer(&reconn->m_directed_timer);
+    mico_ble_log("Directed advertising toward the bonded central");
+    return MICO_TRUE;
+}
+
+/* The directed advertising is over without a connection, advertise to everyone. */
+static OSStatus mico_ble_reconn_directed_handler(void *arg)
+{
+    mico_ble_reconn_t *reconn = &g_ble_context.m_reconn;
+
+    UNUSED_PARAMETER(arg);
+
+    if (reconn->m_is_directed) {
+        reconn->m_is_directed = MICO_FALSE;
+        if (SM_InState(&g_ble_context.m_periph_sm, BLE_STATE_PERIPHERAL_ADVERTISING)) {
+            mico_bt_start_advertisements(BTM_BLE_ADVERT_OFF, BLE_ADDR_PUBLIC, NULL);
+            mico_ble_set_device_discovery(MICO_TRUE);
+        }
+    }
+    return kNoErr;
+}
+
+static void mico_ble_reconn_directed_timeout(void *arg)
+{
+    UNUSED_PARAMETER(arg);
+
+    mico_rtos_stop_timer(&g_ble_context.m_reconn.m_directed_timer);
+    mico_ble_worker_send(BLE_WORKER_TASK, mico_ble_reconn_directed_handler, NULL);
+}
+
+/*
+ * Auto connect function definition
+ */
+
+/* Connect to the best match, on the worker thread. */
+static OSStatus mico_ble_auto_conn_handler(void *arg)
+{
+    mico_ble_auto_conn_state_t *auto_conn = &g_ble_context.m_auto_conn;
+    char str_addr[BDADDR_NTOA_SIZE] = {0};
+    mico_bt_device_address_t addr;
+
+    UNUSED_PARAMETER(arg);
+
+    /* Cancelled meanwhile */
+    if (!auto_conn->m_has_best) {
+        return kNoErr;
+    }
+    memcpy(addr, auto_conn->m_best, BD_ADDR_LEN);
+    auto_conn->m_is_armed = MICO_FALSE;
+    auto_conn->m_has_best = MICO_FALSE;
+
+    mico_ble_log("Auto connect to %s, rssi %d", bdaddr_ntoa(addr, str_addr), auto_conn->m_best_rssi);
+    if (mico_ble_connect(addr) != MICO_BT_SUCCESS) {
+        mico_ble_log("Auto connect failed");
+        /* The scan ends as configured */
+        if (SM_InState(&g_ble_context.m_central_sm, BLE_STATE_CENTRAL_SCANNING)) {
+            g_ble_context.m_scan_cycling = mico_ble_scan_is_cycling();
+        }
+    }
+    return kNoErr;
+}
+
+static void mico_ble_auto_conn_timeout(void *arg)
+{
+    UNUSED_PARAMETER(arg);
+
+    /* No more updates of the best match while it is being connected */
+    g_ble_context.m_auto_conn.m_is_armed = MICO_FALSE;
+    mico_rtos_stop_timer(&g_ble_context.m_auto_conn.m_timer);
+    mico_ble_worker_send(BLE_WORKER_TASK, mico_ble_auto_conn_handler, NULL);
+}
+
+/* A connectable device was seen, keep it if it matches and is the strongest so far. */
+static void mico_ble_auto_conn_check(const mico_bt_smart_advertising_report_t *scan_result)
+{
+    mico_ble_auto_conn_state_t *auto_conn = &g_ble_context.m_auto_conn;
+    const mico_ble_auto_conn_t *cond = &auto_conn->m_cond;
+
+    if (scan_result->signal_strength < cond->min_rssi) {
+        return;
+    }
+    if (cond->service_uuid.len != 0) {
+        if (!mico_ble_ad_match(scan_result->eir_data, scan_result->eir_data_length, &auto_conn->m_filter)) {
+            return;
+        }
+    } else if (strncmp(scan_result->remote_device.name, cond->name_prefix, strlen(cond->name_prefix)) != 0) {
+        return;
+    }
+    if (auto_conn->m_has_best && scan_result->signal_strength <= auto_conn->m_best_rssi) {
+        return;
+    }
+
+    memcpy(auto_conn->m_best, scan_result->remote_device.address, BD_ADDR_LEN);
+    auto_conn->m_best_rssi = scan_result->signal_strength;
+    if (auto_conn->m_has_best) {
+        return;
+    }
+    auto_conn->m_has_best = MICO_TRUE;
+
+    /* The window opens with the first match */
+    if (cond->window_ms == 0) {
+        auto_conn->m_is_armed = MICO_FALSE;
+        mico_ble_worker_send(BLE_WORKER_TASK, mico_ble_auto_conn_handler, NULL);
+    } else {
+        mico_rtos_start_timer(&auto_conn->m_timer);
+    }
+}
+
+static void mico_ble_auto_conn_cancel(void)
+{
+    mico_ble_auto_conn_state_t *auto_conn = &g_ble_context.m_auto_conn;
+
+    auto_conn->m_is_armed = MICO_FALSE;
+    auto_conn->m_has_best = MICO_FALSE;
+    if (auto_conn->m_timer_ms) {
+        mico_rtos_stop_timer(&auto_conn->m_timer);
+    }
+}
+
+static OSStatus mico_ble_central_connect_handler(void *arg)
+{
+    OSStatus ret = MICO_BT_BADOPTION;
+    mico_bt_smartbridge_socket_status_t status;
+    mico_ble_link_t *link = (mico_ble_link_t *)arg;
+    mico_bt_smart_connection_settings_t settings = g_central_connection_settings;
+    const mico_ble_conn_params_t *params = &g_conn_profiles[g_ble_context.m_conn_profile];
+    uint32_t start = mico_rtos_get_time();
+    uint32_t mark = link->m_request_time;
+    mico_ble_gatt_cache_entry_t entry;
+    mico_ble_conn_timing_t timing;
+
+    memset(&timing, 0, sizeof(timing));
+    timing.last_phase = BLE_CONN_PHASE_QUEUE;
+
+    if (SM_InState(&link->m_sm, BLE_LINK_STATE_CONNECTING)) {
+        mico_bt_smartbridge_get_socket_status(&link->m_socket, &status);
+        if (status == SMARTBRIDGE_SOCKET_DISCONNECTED) {
+            mico_ble_conn_phase_next(&timing, &mark, BLE_CONN_PHASE_SECURITY);
+            if (g_central_security_settings.authentication_requirements != BT_SMART_AUTH_REQ_NONE) {
+                if (mico_bt_dev_find_bonded_device((uint8_t *)link->m_peer.address) == MICO_FALSE) {
+                    mico_ble_log("Bond info not found. Initiate pairing request.");
+                    mico_bt_smartbridge_enable_pairing(&link->m_socket, &g_central_security_settings, NULL);
+                } else {
+                    mico_ble_log("Bond info found. Encrypt use bond info.");
+                    mico_bt_smartbridge_set_bond_info(&link->m_socket, &g_central_security_settings, NULL);
+                }
+            }
+
+            /* Connecting with the parameters of the selected profile */
+            settings.interval_min = params->interval_min;
+            settings.interval_max = params->interval_max;
+            settings.latency = params->latency;
+            settings.supervision_timeout = params->supervision_timeout;
+            settings.ce_length_min = params->ce_length_min;
+            settings.ce_length_max = params->ce_length_max;
+            mico_ble_conn_phase_next(&timing, &mark, BLE_CONN_PHASE_CONNECT);
+            ret = mico_bt_smartbridge_connect(&link->m_socket, 
+                                              &link->m_peer,
+                                              &settings, 
+                                              mico_ble_central_disconnection_handler, 
+                                              mico_ble_central_notification_handler);
+            require_noerr_string(ret, exit, "Connect to the peer device failed.");
+
+            /* A known peer with its SPP characteristics where they were */
+            mico_ble_conn_phase_next(&timing, &mark, BLE_CONN_PHASE_SERVICE);
+            if (mico_ble_gatt_cache_restore(link, &entry)) {
+                link->m_attr_handle = entry.in_handle;
+                if (entry.notify_handle) {
+                    mico_ble_central_enable_notify(link, entry.notify_handle, entry.notify_properties);
+                }
+                mico_ble_gatt_cache_account(MICO_TRUE, start);
+                goto exit;
+            }
+
+            /* Find service */
+            uint8_t attribute_buffer[100];
+            mico_bt_smart_attribute_t *attribute = (mico_bt_smart_attribute_t *)attribute_buffer;
+            ret = mico_bt_smartbridge_get_service_from_attribute_cache_by_uuid(&link->m_socket, 
+                                                                               &g_central_whitelist_serv_uuid, 
+                                                                               0x00, 0xffff, attribute, 100);
+            require_noerr_action_string(ret, exit, mico_bt_smartbridge_disconnect(&link->m_socket, MICO_FALSE), 
+                                         "The specified GATT Service not found, disconnect.");
+            uint16_t start_handle = attribute->value.service.start_handle;
+            uint16_t end_handle = attribute->value.service.end_handle;
+
+            /* Find characteristic, and save characteristic value handle */
+            mico_ble_conn_phase_next(&timing, &mark, BLE_CONN_PHASE_CHARACTERISTIC);
+            ret = mico_bt_smartbridge_get_characteritics_from_attribute_cache_by_uuid(&link->m_socket, 
+                                                                                       &g_central_whitelist_char_uuid, 
+                                                                                       start_handle, 
+                                                                                       end_handle, 
+                                                                                       (mico_bt_smart_attribute_t *)attribute_buffer, 
+                                                                                       100);
+            if (ret != kNoErr) {
+                mico_ble_log("The specified characteristic not found, remove cache and disconnect");
+                mico_bt_smartbridge_remove_attribute_cache(&link->m_socket);
+                mico_bt_smartbridge_disconnect(&link->m_socket, MICO_FALSE);
+                goto exit;
+            }
+            link->m_attr_handle = attribute->value.characteristic.value_handle;
+
+            /* Receive peer data without polling */
+            mico_ble_central_subscribe(link, start_handle, end_handle, &entry);
+
+            memcpy(entry.bd_addr, link->m_peer.address, BD_ADDR_LEN);
+            entry.start_handle = start_handle;
+            entry.end_handle = end_handle;
+            entry.in_handle = link->m_attr_handle;
+            mico_ble_gatt_cache_store(&entry);
+            mico_ble_gatt_cache_account(MICO_FALSE, start);
+        }
+    }
+
+exit:
+    mico_ble_conn_timing_record(link, &timing, mark, ret == MICO_BT_SUCCESS);
+    if (ret != MICO_BT_SUCCESS) {
+        mico_ble_link_connect_failed(link);
+        mico_ble_reconn_on_failed(link->m_peer.address);
+        /* 发送LECONN=CENTRAL,OFF消息 */
+        mico_ble_evt_params_t params;
+        memset(&params, 0, sizeof(params));
+        memcpy(params.bd_addr, link->m_peer.address, 6);
+        mico_ble_post_evt(BLE_EVT_CENTRAL_DISCONNECTED, &params);
+    } else {
+        SM_Handle(&link->m_sm, BLE_LINK_EVT_CONNECTED);
+    }
+    return ret;
+}
+
+/* A link is up: index it, it takes the SPP channel if no other connection has it. */
+static mico_bool_t app_link_connected(void *context)
+{
+    mico_ble_link_t *link = (mico_ble_link_t *)context;
+    mico_ble_evt_params_t params;
+
+    link->m_handle = link->m_socket.connection_handle;
+    mico_ble_link_hash_insert(link);
+    g_ble_context.m_link_count++;
+
+    if (SM_InState(&g_ble_context.m_central_sm, BLE_STATE_CENTRAL_CONNECTING)) {
+        SM_Handle(&g_ble_context.m_central_sm, BLE_SM_EVT_CENTRAL_CONNECTED);
+    }
+    if (g_ble_context.m_spp_owner == BLE_SPP_OWNER_NONE) {
+        mico_ble_spp_attach(link);
+    }
+    mico_ble_reconn_on_connected(BLE_ROLE_CENTRAL, link->m_peer.address);
+
+    /* 发送LECONN=CENTRAL,ON消息 */
+    memset(&params, 0, sizeof(params));
+    memcpy(params.bd_addr, link->m_peer.address, 6);
+    params.u.conn.handle = link->m_handle;
+    mico_ble_post_evt(BLE_EVT_CENTRAL_CONNECTED, &params);
+    return TRUE;
+}
+
+static mico_bool_t app_link_disconnected(void *context)
+{
+    mico_ble_link_t *link = (mico_ble_link_t *)context;
+    mico_ble_evt_params_t params;
+
+    mico_ble_link_hash_remove(link);
+    g_ble_context.m_link_count--;
+    link->m_notify_handle = 0;
+
+    /* 发送LECONN=CENTRAL,OFF消息 */
+    memset(&params, 0, sizeof(params));
+    memcpy(params.bd_addr, link->m_peer.address, 6);
+    params.u.disconn.handle = link->m_handle;
+    mico_ble_post_evt(BLE_EVT_CENTRAL_DISCONNECTED, &params);
+
+    if (link == g_ble_context.m_primary) {
+        mico_ble_spp_detach(link);
+    }
+
+    if (!link->m_is_closing) {
+        mico_ble_reconn_on_lost(BLE_ROLE_CENTRAL, link->m_peer.address);
+    }
+    link->m_is_closing = MICO_FALSE;
+
+    if (g_ble_context.m_link_count == 0) {
+        SM_Handle(&g_ble_context.m_central_sm, BLE_SM_EVT_CENTRAL_DISCONNECTED);
+        /* Another peer is still being connected */
+        if (mico_ble_link_lookup(BLE_LINK_STATE_CONNECTING, NULL)) {
+            SM_Handle(&g_ble_context.m_central_sm, BLE_SM_EVT_CENTRAL_LECONN_CMD);
+        }
+    }
+    return TRUE;
+}
+
+static void mico_ble_link_state_machine_init(StateMachine *sm)
+{
+    SmInitParms smParms = {
+        .rules = g_ble_context.m_link_rules,
+        .maxRules = sizeof(g_ble_context.m_link_rules)/sizeof(g_ble_context.m_link_rules[0]),
+        .context = NULL,
+        .initState = BLE_LINK_STATE_IDLE,
+    };
+
+    SM_Init(sm, &smParms);
+
+#if XA_DECODER == MICO_TRUE
+    SM_EnableDecode(sm, MICO_TRUE, "LINK", g_linkStateNameTab, g_linkEventTypeNameTab);
+#endif 
+
+    SM_OnEvent(sm, BLE_LINK_STATE_IDLE, BLE_LINK_EVT_CONNECT, BLE_LINK_STATE_CONNECTING, NULL);
+
+    SM_OnEvent(sm, BLE_LINK_STATE_CONNECTING, BLE_LINK_EVT_CONNECTED, BLE_LINK_STATE_CONNECTED, NULL);
+    SM_OnEvent(sm, BLE_LINK_STATE_CONNECTING, BLE_LINK_EVT_CONNECTION_FAIL, BLE_LINK_STATE_IDLE, NULL);
+
+    SM_OnEvent(sm, BLE_LINK_STATE_CONNECTED, BLE_LINK_EVT_DISCONNECTED, BLE_LINK_STATE_IDLE, NULL);
+    SM_OnEnter(sm, BLE_LINK_STATE_CONNECTED, app_link_connected);
+    SM_OnExit(sm, BLE_LINK_STATE_CONNECTED, app_link_disconnected);
+
+    SM_Finalize(sm);
+}
+
+/* Release the socket and TX mutex of the first links, see mico_ble_central_device_init() */
+static void mico_ble_central_links_deinit(uint8_t count)
+{
+    uint8_t i;
+
+    for (i = 0; i < count; i++) {
+        mico_rtos_deinit_mutex(&g_ble_context.m_links[i].m_tx_mutex);
+        mico_bt_smartbridge_delete_socket(&g_ble_context.m_links[i].m_socket);
+    }
+}
+
+static mico_bt_result_t mico_ble_central_device_init(void)
+{
+    uint8_t i;
+    OSStatus err = mico_bt_smartbridge_init(BLE_CENTRAL_LINK_MAX);
+    require_noerr(err, exit);
+
+    err = mico_bt_smartbridge_enable_attribute_cache(BLE_CENTRAL_LINK_MAX, &g_central_whitelist_serv_uuid, 1);
+    require_noerr(err, exit);
+
+    /* Every link is an instance of one finalized template */
+    mico_ble_link_state_machine_init(&g_ble_context.m_link_tmpl);
+    for (i = 0; i < BLE_CENTRAL_LINK_MAX; i++) {
+        mico_ble_link_t *link = &g_ble_context.m_links[i];
+
+        SM_InitFromTemplate(&link->m_sm, &g_ble_context.m_link_tmpl, link);
+
+        err = mico_bt_smartbridge_create_socket(&link->m_socket);
+        require_noerr(err, exit_links);
+
+        err = mico_rtos_init_mutex(&link->m_tx_mutex);
+        require_noerr_action(err, exit_links, mico_bt_smartbridge_delete_socket(&link->m_socket));
+    }
+    return MICO_BT_SUCCESS;
+
+exit_links:
+    mico_ble_central_links_deinit(i);
+    mico_bt_smartbridge_deinit();
+exit:
+    return (mico_bt_result_t)err;
+}
+
+static void mico_ble_central_device_deinit(void)
+{
+    mico_ble_central_links_deinit(BLE_CENTRAL_LINK_MAX);
+    mico_bt_smartbridge_deinit();
+}
+
+static mico_bool_t app_central_start_scanning(void *context)
+{
+    UNUSED_PARAMETER(context);
+
+    /* 如果没有SCAN，则开启SCAN */
+    if (!mico_bt_smartbridge_is_scanning()) {
+        mico_ble_set_device_scan(MICO_TRUE);
+    }
+    
+    /* 发送LESCAN=ON消息 */
+    mico_ble_post_evt(BLE_EVT_CENTRAL_SCAN_START, NULL);
+    return TRUE;
+}
+
+static mico_bool_t app_central_scanning_stoped(void *context)
+{
+    UNUSED_PARAMETER(context);
+
+    g_ble_context.m_scan_cycling = MICO_FALSE;
+    if (g_ble_context.m_scan_rest_timer_ms) {
+        mico_rtos_stop_timer(&g_ble_context.m_scan_rest_timer);
+    }
+    mico_ble_auto_conn_cancel();
+
+    /* 发送LESCAN=OFF消息 */
+    mico_ble_post_evt(BLE_EVT_CENTRAL_SCAN_STOP, NULL);
+    return TRUE;
+}
+
+static void mico_ble_state_machine_init(StateMachine *sm, SmRule *rules, uint16_t max_rules,
+                                       const char *name, uint8_t init_state)
+{
+    /* Initialize StateMachine */
+    SmInitParms smParms = {
+        .rules = rules,
+        .maxRules = max_rules,
+        .context = NULL,
+        .initState = init_state,
+    };
+
+    SM_Init(sm, &smParms);
+
+#if XA_DECODER == MICO_TRUE
+    SM_EnableDecode(sm, MICO_TRUE, name, g_stateNameTab, g_eventTypeNameTabl);
+#else
+    UNUSED_PARAMETER(name);
+#endif 
+}
+
+/* Peripheral region: BLE_STATE_IDLE, ADVERTISING and CONNECTED. */
+static void mico_ble_periph_state_machine_init(uint8_t init_state)
+{
+    StateMachine *sm = &g_ble_context.m_periph_sm;
+
+    mico_ble_state_machine_init(sm, g_ble_context.m_periph_rules,
+                                sizeof(g_ble_context.m_periph_rules)/sizeof(g_ble_context.m_periph_rules[0]),
+                                "BLE-P", init_state);
+
+    SM_OnEvent(sm, BLE_STATE_PERIPHERAL_ADVERTISING, BLE_SM_EVT_PERIPHERAL_ADV_STOPED, BLE_STATE_IDLE, app_peripheral_stop_advertising);
+    SM_OnEvent(sm, BLE_STATE_PERIPHERAL_ADVERTISING, BLE_SM_EVT_PERIPHERAL_CONNECTION_FAIL, BLE_STATE_PERIPHERAL_ADVERTISING, NULL);
+    SM_OnEvent(sm, BLE_STATE_PERIPHERAL_ADVERTISING, BLE_SM_EVT_PERIPHERAL_CONNECTED, BLE_STATE_PERIPHERAL_CONNECTED, NULL);
+    
+    SM_OnEvent(sm, BLE_STATE_PERIPHERAL_CONNECTED, BLE_SM_EVT_PERIPHERAL_DISCONNECTED, BLE_STATE_PERIPHERAL_ADVERTISING, app_peripheral_start_advertising);
+    SM_OnEnter(sm, BLE_STATE_PERIPHERAL_CONNECTED, app_peripheral_connected);
+    SM_OnExit(sm, BLE_STATE_PERIPHERAL_CONNECTED, app_peripheral_disconnected);
+    
+    SM_OnEvent(sm, BLE_STATE_IDLE, BLE_SM_EVT_PERIPHERAL_LEADV_CMD, BLE_STATE_PERIPHERAL_ADVERTISING, app_peripheral_start_advertising);
+    
+    SM_Finalize(sm);
+}
+
+/*
+ * Central region: BLE_STATE_IDLE, SCANNING, CONNECTING and CONNECTED, the links have their own machines.
+ * A scan or a connection attempt may run while links are up, it ends in CONNECTED then.
+ */
+static void mico_ble_central_state_machine_init(uint8_t init_state)
+{
+    StateMachine *sm = &g_ble_context.m_central_sm;
+
+    mico_ble_state_machine_init(sm, g_ble_context.m_central_rules,
+                                sizeof(g_ble_context.m_central_rules)/sizeof(g_ble_context.m_central_rules[0]),
+                                "BLE-C", init_state);
+
+    SM_OnEvent(sm, BLE_STATE_CENTRAL_SCANNING, BLE_SM_EVT_CENTRAL_SCANNED, BLE_STATE_IDLE, NULL);
+    SM_OnEvent(sm, BLE_STATE_CENTRAL_SCANNING, BLE_SM_EVT_CENTRAL_CONNECTED, BLE_STATE_CENTRAL_CONNECTED, NULL);
+    SM_OnEvent(sm, BLE_STATE_CENTRAL_SCANNING, BLE_SM_EVT_CENTRAL_LECONN_CMD, BLE_STATE_CENTRAL_CONNECTING, NULL);
+    SM_OnEnter(sm, BLE_STATE_CENTRAL_SCANNING, app_central_start_scanning);
+    SM_OnExit(sm, BLE_STATE_CENTRAL_SCANNING, app_central_scanning_stoped);
+    
+    SM_OnEvent(sm, BLE_STATE_CENTRAL_CONNECTING, BLE_SM_EVT_CENTRAL_CONNECTION_FAIL, BLE_STATE_IDLE, NULL);
+    SM_OnEvent(sm, BLE_STATE_CENTRAL_CONNECTING, BLE_SM_EVT_CENTRAL_CONNECTED, BLE_STATE_CENTRAL_CONNECTED, NULL);
+
+    SM_OnEvent(sm, BLE_STATE_CENTRAL_CONNECTED, BLE_SM_EVT_CENTRAL_DISCONNECTED, BLE_STATE_IDLE, NULL);
+    SM_OnEvent(sm, BLE_STATE_CENTRAL_CONNECTED, BLE_SM_EVT_CENTRAL_LESCAN_CMD, BLE_STATE_CENTRAL_SCANNING, NULL);
+    
+    SM_OnEvent(sm, BLE_STATE_IDLE, BLE_SM_EVT_CENTRAL_LESCAN_CMD, BLE_STATE_CENTRAL_SCANNING, NULL);
+    SM_OnEvent(sm, BLE_STATE_IDLE, BLE_SM_EVT_CENTRAL_LECONN_CMD, BLE_STATE_CENTRAL_CONNECTING, NULL);
+    
+    SM_Finalize(sm);
+}
+
+/*---------------------------------------------------------------------------------------------
+ * Worker function definition
+ */
+
+/* Own threads of the library, jobs are posted from timer and stack callbacks that must not create them. */
+static void mico_ble_worker_stop(void)
+{
+    uint8_t i;
+
+    for (i = 0; i < g_ble_context.m_thread_count; i++) {
+        mico_ble_worker_t *worker = &g_ble_context.m_workers[i];
+
+        if (worker->m_thread == &worker->m_own) {
+            mico_rtos_delete_worker_thread(&worker->m_own);
+            worker->m_thread = NULL;
+        }
+    }
+}
+
+/* Create the own worker threads at init, before the stack can call back. */
+static OSStatus mico_ble_worker_start(void)
+{
+    OSStatus err = kNoErr;
+    uint8_t i;
+
+    for (i = 0; i < g_ble_context.m_thread_count; i++) {
+        mico_ble_worker_t *worker = &g_ble_context.m_workers[i];
+
+        if (worker->m_thread) {
+            continue;
+        }
+        err = mico_rtos_create_worker_thread(&worker->m_own,
+                                             worker->m_cfg.priority,
+                                             worker->m_cfg.stack_size,
+                                             worker->m_cfg.queue_depth);
+        require_noerr_string(err, exit, "Error creating worker thread");
+        worker->m_thread = &worker->m_own;
+        mico_ble_log("Worker thread %d created, stack %lu bytes, queue %lu jobs", i,
+                     (unsigned long)worker->m_cfg.stack_size,
+                     (unsigned long)worker->m_cfg.queue_depth);
+    }
+    return kNoErr;
+
+exit:
+    mico_ble_worker_stop();
+    return err;
+}
+
+/* Run a job on a worker thread, a single thread runs the event callback too. */
+static OSStatus mico_ble_worker_send(mico_ble_worker_id_t id, event_handler_t handler, void *arg)
+{
+    mico_ble_worker_t *worker;
+    OSStatus err;
+
+    if (id >= g_ble_context.m_thread_count) {
+        id = BLE_WORKER_TASK;
+    }
+    worker = &g_ble_context.m_workers[id];
+
+    /* Not created, mico_ble_init_ex() has not run or failed */
+    if (!worker->m_thread) {
+        worker->m_dropped++;
+        mico_ble_log("Worker thread %d not running, job dropped", id);
+        return kStateErr;
+    }
+
+    err = mico_rtos_send_asynchronous_event(worker->m_thread, handler, arg);
+    if (err != kNoErr) {
+        worker->m_dropped++;
+    }
+    return err;
+}
+
+/**
+ *  mico_bluetooth_init
+ *
+ *  Initialize Bluetooth Sub-system.
+ *
+ * @param [in] context      : An pointer of The Application Context
+ *             Structure.
+ * @param [in] mico_context : An pointer of the MiCO Context structure.
+ *
+ * @param [in] cback        : An call back handler for the bluetooth
+ *             for bluetooth sub-system.
+ *
+ * @return #mico_bt_result_t
+ *
+ */
+mico_bt_result_t mico_ble_init(const char *device_name, 
+                               const char *wl_name, 
+                               mico_bool_t is_central, 
+                               mico_ble_evt_cback_t cback) 
+{
+    return mico_ble_init_ex(device_name, wl_name, is_central, cback, NULL);
+}
+
+/**
+ * Initialize Bluetooth Sub-system on the given worker threads.
+ *
+ * @param exec
+ *      The worker threads, NULL for the defaults.
+ *
+ * @return
+ *      MICO_BT_SUCCESS if successfully.
+ *      MICO_BT_BADARG -- No thread count of 1 or 2, or an own thread without stack or queue.
+ */
+mico_bt_result_t mico_ble_init_ex(const char *device_name,
+                                  const char *wl_name,
+                                  mico_bool_t is_central,
+                                  mico_ble_evt_cback_t cback,
+                                  const mico_ble_executor_config_t *exec)
+{
+    mico_bt_result_t        err;
+    uint8_t                 init_state;
+    uint8_t                 i;
+
+    /* Check */
+    if (!device_name || !cback) {
+        return MICO_BT_ERROR;
+    }
+
+    if (g_ble_context.m_is_initialized) {
+        return MICO_BT_SUCCESS;
+    }
+
+    if (!exec) {
+        exec = &g_executor_config_default;
+    }
+    if (exec->thread_count < 1 || exec->thread_count > BLE_WORKER_MAX) {
+        return MICO_BT_BADARG;
+    }
+    for (i = 0; i < exec->thread_count; i++) {
+        if (!exec->workers[i].shared && (exec->workers[i].stack_size == 0 || exec->workers[i].queue_depth == 0)) {
+            return MICO_BT_BADARG;
+        }
+    }
+
+    memset(&g_ble_context, 0, sizeof(g_ble_context));
+    g_ble_context.m_att_mtu = BLE_ATT_MTU_DEFAULT;
+    g_ble_context.m_scan_cfg = g_scan_config_default;
+    g_ble_context.m_reconn.m_cfg = g_reconn_config_default;
+
+    /* Own threads are created below, shared ones are the application's */
+    g_ble_context.m_thread_count = exec->thread_count;
+    g_ble_context.m_stack_free = exec->stack_free;
+    for (i = 0; i < exec->thread_count; i++) {
+        g_ble_context.m_workers[i].m_cfg = exec->workers[i];
+        g_ble_context.m_workers[i].m_thread = exec->workers[i].shared;
+    }
+
+    err = (mico_bt_result_t)mico_rtos_init_timer(&g_ble_context.m_conn_idle_timer,
+                                                 BLE_CONN_IDLE_TIMEOUT_MS,
+                                                 mico_ble_conn_idle_timeout,
+                                                 NULL);
+    require_string(err == MICO_BT_SUCCESS, exit, "Error initializing connection idle timer");
+
+    err = (mico_bt_result_t)mico_rtos_init_timer(&g_ble_context.m_reconn.m_directed_timer,
+                                                 BLE_RECONN_DIRECTED_MS,
+                                                 mico_ble_reconn_directed_timeout,
+                                                 NULL);
+    require_string(err == MICO_BT_SUCCESS, exit_idle_timer, "Error initializing directed advertising timer");
+
+    err = (mico_bt_result_t)mico_rtos_init_mutex(&g_ble_context.m_tx_mutex);
+    require_string(err == MICO_BT_SUCCESS, exit_directed_timer, "Error initializing TX mutex");
+
+    err = (mico_bt_result_t)mico_rtos_init_semaphore(&g_ble_context.m_spp_out_conf_sem, 1);
+    require_string(err == MICO_BT_SUCCESS, exit_tx_mutex, "Error initializing indication semaphore");
+
+    err = (mico_bt_result_t)mico_ble_ring_init(&g_ble_context.m_rx_ring, BLE_RX_RING_SIZE);
+    require_string(err == MICO_BT_SUCCESS, exit_conf_sem, "Error initializing RX ring");
+
+    err = (mico_bt_result_t)mico_rtos_init_mutex(&g_ble_context.m_wl.m_mutex);
+    require_string(err == MICO_BT_SUCCESS, exit_rx_ring, "Error initializing whitelist mutex");
+
+    for (i = 0; i < BLE_NEARBY_MAX; i++) {
+        g_ble_context.m_nearby.m_heap[i] = i;
+        g_ble_context.m_nearby.m_pos[i] = i;
+    }
+    err = (mico_bt_result_t)mico_rtos_init_mutex(&g_ble_context.m_nearby.m_mutex);
+    require_string(err == MICO_BT_SUCCESS, exit_wl_mutex, "Error initializing nearby table mutex");
+
+    err = (mico_bt_result_t)mico_rtos_init_mutex(&g_ble_context.m_ad_filter_mutex);
+    require_string(err == MICO_BT_SUCCESS, exit_nearby_mutex, "Error initializing AD filter mutex");
+
+    err = (mico_bt_result_t)mico_rtos_init_mutex(&g_ble_context.m_gatt_cache.m_mutex);
+    require_string(err == MICO_BT_SUCCESS, exit_ad_filter_mutex, "Error initializing GATT cache mutex");
+
+    err = (mico_bt_result_t)mico_rtos_init_mutex(&g_ble_context.m_conn_timing.m_mutex);
+    require_string(err == MICO_BT_SUCCESS, exit_gatt_cache_mutex, "Error initializing connect timing mutex");
+
+    /* Both threads serve both roles, they must run before the stack calls back */
+    err = (mico_bt_result_t)mico_ble_worker_start();
+    require_string(err == MICO_BT_SUCCESS, exit_conn_timing_mutex, "Error creating worker threads");
+
+    /* Initialize Bluetooth Stack & GAP Role. */
+    err = (mico_bt_result_t)mico_bt_init(MICO_BT_HCI_MODE, device_name, BLE_CENTRAL_LINK_MAX, 1);
+    require_string(err == MICO_BT_SUCCESS, exit_workers, "Error initializing MiCO Bluetooth Framework");
+
+    err = mico_ble_central_device_init();
+    require_string(err == MICO_BT_SUCCESS, exit_stack, "Error initializing MiCO Bluetooth Central Role");
+
+    err = mico_ble_peripheral_device_init();
+    require_string(err == MICO_BT_SUCCESS, exit_central, "Error initializaing MiCO Bluetooth Peripheral Role");
+
+    /* Accept L2CAP channels in either role, see mico_ble_set_transport() */
+    if (mico_bt_l2cap_le_register(BLE_COC_PSM, &g_coc_appl_info, NULL) == 0) {
+        mico_ble_log("Error registering L2CAP PSM 0x%04x", BLE_COC_PSM);
+    }
+
+    /* Start in one role, the other one is started on demand */
+    if (is_central) {
+        init_state = BLE_STATE_CENTRAL_SCANNING;
+        err = mico_ble_set_device_scan(MICO_TRUE);
+        require_string(err == MICO_BT_SUCCESS, exit_l2cap, "Error setting device to scanning");
+    } else {
+        init_state = BLE_STATE_PERIPHERAL_ADVERTISING;
+        err = mico_ble_set_device_discovery(MICO_TRUE);
+        require_string(err == MICO_BT_SUCCESS, exit_l2cap, "Error setting device to discoverable");
+    }
+
+    /* Initialize local storage information */
+    g_ble_context.m_is_central = is_central;
+    g_ble_context.m_cback = cback;
+    g_ble_context.m_is_initialized = MICO_TRUE;
+    mico_ble_set_device_whitelist_name(wl_name);
+
+    /* Initialize StateMachine */
+    mico_ble_periph_state_machine_init(is_central ? BLE_STATE_IDLE : BLE_STATE_PERIPHERAL_ADVERTISING);
+    mico_ble_central_state_machine_init(is_central ? BLE_STATE_CENTRAL_SCANNING : BLE_STATE_IDLE);
+
+    /* Post first event to user. */
+    if (init_state == BLE_STATE_CENTRAL_SCANNING) {
+        mico_ble_post_evt(BLE_EVT_CENTRAL_SCAN_START, NULL);
+    } else {
+        mico_ble_post_evt(BLE_EVT_PERIPHREAL_ADV_START, NULL);
+    }
+    return MICO_BT_SUCCESS;
+
+    /* Release what was created, the next attempt starts from a cleared context */
+exit_l2cap:
+    mico_bt_l2cap_le_deregister(BLE_COC_PSM);
+    mico_bt_peripheral_deinit();
+exit_central:
+    mico_ble_central_device_deinit();
+exit_stack:
+    mico_bt_deinit();
+exit_workers:
+    mico_ble_worker_stop();
+exit_conn_timing_mutex:
+    mico_rtos_deinit_mutex(&g_ble_context.m_conn_timing.m_mutex);
+exit_gatt_cache_mutex:
+    mico_rtos_deinit_mutex(&g_ble_context.m_gatt_cache.m_mutex);
+exit_ad_filter_mutex:
+    mico_rtos_deinit_mutex(&g_ble_context.m_ad_filter_mutex);
+exit_nearby_mutex:
+    mico_rtos_deinit_mutex(&g_ble_context.m_nearby.m_mutex);
+exit_wl_mutex:
+    mico_rtos_deinit_mutex(&g_ble_context.m_wl.m_mutex);
+exit_rx_ring:
+    mico_ble_ring_deinit(&g_ble_context.m_rx_ring);
+exit_conf_sem:
+    mico_rtos_deinit_semaphore(&g_ble_context.m_spp_out_conf_sem);
+exit_tx_mutex:
+    mico_rtos_deinit_mutex(&g_ble_context.m_tx_mutex);
+exit_directed_timer:
+    mico_rtos_deinit_timer(&g_ble_context.m_reconn.m_directed_timer);
+exit_idle_timer:
+    mico_rtos_deinit_timer(&g_ble_context.m_conn_idle_timer);
+exit:
+    return err;
+}
+
+/**
+ *  bluetooth_send_data
+ *
+ *  Trigger an action for sending data over RFCOMM Channel.
+ *
+ * @param None
+ *
+ * @return None
+ */
+mico_bt_result_t mico_ble_get_dev_address(mico_bt_device_address_t bdaddr)
+{
+    mico_bt_dev_read_local_addr(bdaddr);
+    return MICO_BT_SUCCESS;
+}
+
+/**
+ * Get the usage of a worker thread.
+ *
+ * @param id
+ *      The worker.
+ *
+ * @param stats
+ *      A pointer of the statistics buffer.
+ *
+ * @return
+ *      MICO_BT_SUCCESS if successfully.
+ *      MICO_BT_BADARG -- Invalid parameter.
+ *      MICO_BT_BADOPTION -- The worker runs on the task worker.
+ */
+mico_bt_result_t mico_ble_get_worker_stats(mico_ble_worker_id_t id, mico_ble_worker_stats_t *stats)
+{
+    const mico_ble_worker_t *worker;
+
+    if (id >= BLE_WORKER_MAX || !stats) {
+        return MICO_BT_BADARG;
+    }
+    if (id >= g_ble_context.m_thread_count) {
+        return MICO_BT_BADOPTION;
+    }
+
+    worker = &g_ble_context.m_workers[id];
+    memset(stats, 0, sizeof(mico_ble_worker_stats_t));
+    stats->is_running = (worker->m_thread != NULL);
+    stats->is_shared = (worker->m_cfg.shared != NULL);
+    if (!stats->is_shared) {
+        stats->stack_size = worker->m_cfg.stack_size;
+        stats->queue_depth = worker->m_cfg.queue_depth;
+    }
+    stats->stack_free = BLE_WORKER_STACK_UNKNOWN;
+    if (stats->is_running && g_ble_context.m_stack_free) {
+        stats->stack_free = g_ble_context.m_stack_free(worker->m_thread);
+    }
+    stats->dropped = worker->m_dropped;
+    return MICO_BT_SUCCESS;
+}
+
+/**
+ * Set local BT Device Name.
+ *
+ * @param name
+ *          An new name for BT Controller.
+ *
+ * @return MICO_BT_PENDING if successfully.
+ */
+mico_bt_result_t mico_ble_set_device_name(const char *name)
+{
+    /* Update BT Controller Name */
+    extern mico_bt_result_t BTM_SetLocalDeviceName(char *);
+    extern mico_bt_cfg_settings_t mico_bt_cfg_settings;
+
+    mico_bt_cfg_settings.device_name = (uint8_t *)name;
+    return BTM_SetLocalDeviceName((char *)mico_bt_cfg_settings.device_name);
+}
+
+/**
+ * Get local BT Device Name
+ *
+ * @return A c-style string of local device name.
+ */
+const char *mico_ble_get_device_name(void)
+{
+    extern mico_bt_cfg_settings_t mico_bt_cfg_settings;
+    return (const char *)mico_bt_cfg_settings.device_name;
+}
+
+/**
+ * Set passkey for BT Security process.
+ *
+ * @param key
+ *      a c-style string of the passkey.
+ *
+ * @return
+ *      MICO_BT_SUCCESS if successfully.
+ */
+mico_bt_result_t mico_ble_set_device_whitelist_name(const char *name)
+{
+    mico_bt_result_t ret = MICO_BT_BADARG;
+
+    if (name && strlen(name) <= BLE_WL_PATTERN_MAX) {
+        mico_rtos_lock_mutex(&g_ble_context.m_wl.m_mutex);
+        if (!g_ble_context.m_wl_name) {
+            g_ble_context.m_wl_name = (char *)malloc(31);
+            require_action(g_ble_context.m_wl_name, exit, ret = MICO_BT_NO_RESOURCES);
+        } else if (g_ble_context.m_wl_name[0]) {
+            mico_ble_wl_remove(&g_ble_context.m_wl, g_ble_context.m_wl_name, BLE_WL_FLAG_NAME);
+        }
+        memset(g_ble_context.m_wl_name, 0, 31);
+        strcpy(g_ble_context.m_wl_name, name);
+        ret = MICO_BT_SUCCESS;
+        if (name[0]) {
+            ret = mico_ble_wl_insert(&g_ble_context.m_wl, name, BLE_WL_FLAG_NAME);
+        }
+exit:
+        mico_rtos_unlock_mutex(&g_ble_context.m_wl.m_mutex);
+    }
+    return ret;
+}
+
+/**
+ * Get passkey for BT Security process.
+ *
+ * @return
+ *  A c-style string of local device passkey.
+ */
+const char *mico_ble_get_device_whitelist_name(void)
+{
+    return (const char *)g_ble_context.m_wl_name;
+}
+
+/**
+ * Add a device name prefix to the scan whitelist.
+ *
+ * @param prefix
+ *          a c-style string, 1 to 30 characters.
+ *
+ * @return
+ *      MICO_BT_SUCCESS if successfully.
+ *      MICO_BT_NO_RESOURCES -- The whitelist is full.
+ */
+mico_bt_result_t mico_ble_whitelist_add(const char *prefix)
+{
+    mico_bt_result_t ret;
+
+    if (!prefix || prefix[0] == '\0' || strlen(prefix) > BLE_WL_PATTERN_MAX) {
+        return MICO_BT_BADARG;
+    }
+
+    mico_rtos_lock_mutex(&g_ble_context.m_wl.m_mutex);
+    ret = mico_ble_wl_insert(&g_ble_context.m_wl, prefix, BLE_WL_FLAG_USER);
+    mico_rtos_unlock_mutex(&g_ble_context.m_wl.m_mutex);
+    return ret;
+}
+
+/**
+ * Remove a device name prefix from the scan whitelist.
+ *
+ * @param prefix
+ *          a prefix added by mico_ble_whitelist_add().
+ *
+ * @return
+ *      MICO_BT_SUCCESS if successfully.
+ *      MICO_BT_BADARG -- The prefix is not in the whitelist.
+ */
+mico_bt_result_t mico_ble_whitelist_remove(const char *prefix)
+{
+    mico_bt_result_t ret;
+
+    if (!prefix || strlen(prefix) > BLE_WL_PATTERN_MAX) {
+        return MICO_BT_BADARG;
+    }
+
+    mico_rtos_lock_mutex(&g_ble_context.m_wl.m_mutex);
+    ret = mico_ble_wl_remove(&g_ble_context.m_wl, prefix, BLE_WL_FLAG_USER);
+    mico_rtos_unlock_mutex(&g_ble_context.m_wl.m_mutex);
+    return ret;
+}
+
+/**
+ * Remove all prefixes added by mico_ble_whitelist_add(). The whitelist name
+ * is kept.
+ *
+ * @return
+ *      MICO_BT_SUCCESS if successfully.
+ */
+mico_bt_result_t mico_ble_whitelist_clear(void)
+{
+    mico_ble_wl_t *wl = &g_ble_context.m_wl;
+    mico_bt_result_t ret = MICO_BT_SUCCESS;
+
+    mico_rtos_lock_mutex(&wl->m_mutex);
+    if (wl->m_nodes) {
+        free(wl->m_nodes);
+        wl->m_nodes = NULL;
+    }
+    wl->m_capacity = 0;
+    wl->m_used = 0;
+    wl->m_free = 0;
+    wl->m_patterns = 0;
+    if (g_ble_context.m_wl_name && g_ble_context.m_wl_name[0]) {
+        ret = mico_ble_wl_insert(wl, g_ble_context.m_wl_name, BLE_WL_FLAG_NAME);
+    }
+    mico_rtos_unlock_mutex(&wl->m_mutex);
+    return ret;
+}
+
+/**
+ * Get the number of distinct prefixes in the scan whitelist, including the
+ * whitelist name.
+ *
+ * @return
+ *      The number of prefixes.
+ */
+uint16_t mico_ble_whitelist_count(void)
+{
+    return g_ble_context.m_wl.m_patterns;
+}
+
+/**
+ * Set the characteristic subscribed for peer data in central mode.
+ *
+ * @param uuid
+ *      UUID of a characteristic in the whitelist service.
+ *
+ * @return
+ *      MICO_BT_SUCCESS if successfully.
+ */
+mico_bt_result_t mico_ble_set_central_notify_uuid(const mico_bt_uuid_t *uuid)
+{
+    if (!uuid || (uuid->len != LEN_UUID_16 && uuid->len != LEN_UUID_32 && uuid->len != LEN_UUID_128)) {
+        return MICO_BT_BADARG;
+    }
+    memcpy(&g_central_notify_char_uuid, uuid, sizeof(mico_bt_uuid_t));
+    return MICO_BT_SUCCESS;
+}
+
+/**
+ * Configure the scan engine, takes effect from the next scan.
+ *
+ * @param cfg
+ *      The scan configuration.
+ *
+ * @return
+ *      MICO_BT_SUCCESS if successfully.
+ *      MICO_BT_BADARG -- Invalid parameter.
+ *      MICO_BT_NO_RESOURCES -- No resource for the duty cycle timer.
+ */
+mico_bt_result_t mico_ble_set_scan_config(const mico_ble_scan_config_t *cfg)
+{
+    uint16_t scan_s, rest_s;
+    uint32_t rest_ms;
+    OSStatus err;
+
+    if (!cfg || cfg->interval < 4 || cfg->interval > 16384
+        || cfg->window < 4 || cfg->window > cfg->interval
+        || cfg->duty_percent == 0 || cfg->duty_percent > 100) {
+        return MICO_BT_BADARG;
+    }
+
+    mico_ble_scan_duty_split(cfg, &scan_s, &rest_s);
+    rest_ms = (cfg->duration_second == 0) ? (uint32_t)rest_s * 1000 : 0;
+
+    if (rest_ms && rest_ms != g_ble_context.m_scan_rest_timer_ms) {
+        if (!g_ble_context.m_scan_rest_timer_ms) {
+            err = mico_rtos_init_timer(&g_ble_context.m_scan_rest_timer, rest_ms, mico_ble_scan_rest_timeout, NULL);
+        } else {
+            /* A period change starts the timer too, a rest under way is restarted below */
+            err = mico_rtos_change_timer_period(&g_ble_context.m_scan_rest_timer, rest_ms);
+            mico_rtos_stop_timer(&g_ble_context.m_scan_rest_timer);
+        }
+        if (err != kNoErr) {
+            return MICO_BT_NO_RESOURCES;
+        }
+        g_ble_context.m_scan_rest_timer_ms = rest_ms;
+    }
+    g_ble_context.m_scan_rest_ms = rest_ms;
+
+    memcpy(&g_ble_context.m_scan_cfg, cfg, sizeof(mico_ble_scan_config_t));
+
+    /* A running scan continues, or ends, according to the new mode. */
+    if (SM_InState(&g_ble_context.m_central_sm, BLE_STATE_CENTRAL_SCANNING)) {
+        g_ble_context.m_scan_cycling = mico_ble_scan_is_cycling();
+
+        /* Resting between two scans: rest for the new period, or end as a completed scan does */
+        if (!mico_bt_smartbridge_is_scanning()) {
+            if ((!g_ble_context.m_scan_cycling || !g_ble_context.m_scan_rest_ms) && g_ble_context.m_scan_rest_timer_ms) {
+                mico_rtos_stop_timer(&g_ble_context.m_scan_rest_timer);
+            }
+            if (!g_ble_context.m_scan_rest_timer_ms || !mico_rtos_is_timer_running(&g_ble_context.m_scan_rest_timer)) {
+                mico_ble_worker_send(BLE_WORKER_TASK, mico_ble_central_scan_complete_handler, NULL);
+            }
+        }
+    }
+    return MICO_BT_SUCCESS;
+}
+
+/**
+ * Get the scan engine configuration.
+ *
+ * @param cfg
+ *      A pointer of configuration buffer.
+ *
+ * @return
+ *      MICO_BT_SUCCESS if successfully.
+ */
+mico_bt_result_t mico_ble_get_scan_config(mico_ble_scan_config_t *cfg)
+{
+    if (!cfg) {
+        return MICO_BT_BADARG;
+    }
+    memcpy(cfg, &g_ble_context.m_scan_cfg, sizeof(mico_ble_scan_config_t));
+    return MICO_BT_SUCCESS;
+}
+
+/**
+ * Set the ranking of the nearby device table. The table is re-ordered at
+ * once; devices dropped under the old ranking return with their next
+ * advertisement.
+ *
+ * @param order
+ *      BLE_NEARBY_BY_RSSI or BLE_NEARBY_BY_RECENT.
+ *
+ * @return
+ *      MICO_BT_SUCCESS if successfully.
+ */
+mico_bt_result_t mico_ble_set_nearby_order(mico_ble_nearby_order_t order)
+{
+    mico_ble_nearby_table_t *t = &g_ble_context.m_nearby;
+    int i;
+
+    if (order != BLE_NEARBY_BY_RSSI && order != BLE_NEARBY_BY_RECENT) {
+        return MICO_BT_BADARG;
+    }
+
+    mico_rtos_lock_mutex(&t->m_mutex);
+    if (t->m_order != order) {
+        t->m_order = order;
+        for (i = t->m_count / 2 - 1; i >= 0; i--) {
+            mico_ble_nearby_sift_down(t, (uint8_t)i);
+        }
+    }
+    mico_rtos_unlock_mutex(&t->m_mutex);
+    return MICO_BT_SUCCESS;
+}
+
+/**
+ * Enable or disable raw advertising data in BLE_EVT_CENTRAL_REPORT.
+ *
+ * @param enable
+ *      MICO_TRUE to enable.
+ *
+ * @return
+ *      MICO_BT_SUCCESS if successfully.
+ *      MICO_BT_NO_RESOURCES -- No resource for the advertising data pool.
+ */
+mico_bt_result_t mico_ble_set_raw_report(mico_bool_t enable)
+{
+    if (enable && mico_ble_pool_init(&g_ble_context.m_adv_pool,
+                                     BLE_ADV_DATA_MAX,
+                                     BLE_ADV_POOL_BLOCK_COUNT) != kNoErr) {
+        return MICO_BT_NO_RESOURCES;
+    }
+
+    g_ble_context.m_is_raw_report = enable;
+    return MICO_BT_SUCCESS;
+}
+
+/**
+ * Get whether raw advertising data is reported.
+ *
+ * @return
+ *      MICO_TRUE if enabled.
+ */
+mico_bool_t mico_ble_get_raw_report(void)
+{
+    return g_ble_context.m_is_raw_report;
+}
+
+/**
+ * Get the ranking of the nearby device table.
+ *
+ * @return
+ *      BLE_NEARBY_BY_RSSI or BLE_NEARBY_BY_RECENT.
+ */
+mico_ble_nearby_order_t mico_ble_get_nearby_order(void)
+{
+    return g_ble_context.m_nearby.m_order;
+}
+
+/**
+ * Take a snapshot of the nearby device table, best ranked first. Devices
+ * not seen for 30 s are left out.
+ *
+ * @param list
+ *      An array of at most BLE_NEARBY_MAX devices to fill in.
+ *
+ * @param max
+ *      The number of elements in list.
+ *
+ * @return
+ *      The number of devices filled in.
+ */
+uint8_t mico_ble_get_nearby(mico_ble_nearby_t *list, uint8_t max)
+{
+    mico_ble_nearby_table_t *t = &g_ble_context.m_nearby;
+    const mico_ble_nearby_slot_t *slot;
+    uint32_t now = mico_rtos_get_time();
+    uint8_t count = 0;
+    uint8_t i, j;
+
+    if (!list || !max) {
+        return 0;
+    }
+
+    mico_rtos_lock_mutex(&t->m_mutex);
+    mico_ble_nearby_purge(t, now);
+
+    /* Insertion into the sorted list, keeping the best max devices. */
+    for (i = 0; i < t->m_count; i++) {
+        slot = NEARBY_AT(t, i);
+        for (j = count; j > 0; j--) {
+            if (t->m_order == BLE_NEARBY_BY_RECENT ? list[j - 1].age_ms <= now - slot->m_last_seen
+                                                   : list[j - 1].rssi >= slot->m_rssi) {
+                break;
+            }
+            if (j < max) {
+                list[j] = list[j - 1];
+            }
+        }
+        if (j >= max) {
+            continue;
+        }
+        memcpy(list[j].bd_addr, slot->m_addr, BD_ADDR_LEN);
+        memcpy(list[j].name, slot->m_name, sizeof(list[j].name));
+        list[j].rssi = slot->m_rssi;
+        list[j].age_ms = now - slot->m_last_seen;
+        if (count < max) {
+            count++;
+        }
+    }
+
+    mico_rtos_unlock_mutex(&t->m_mutex);
+    return count;
+}
+
+/**
+ * Empty the nearby device table.
+ *
+ * @return
+ *      MICO_BT_SUCCESS if successfully.
+ */
+mico_bt_result_t mico_ble_nearby_clear(void)
+{
+    mico_ble_nearby_table_t *t = &g_ble_context.m_nearby;
+
+    mico_rtos_lock_mutex(&t->m_mutex);
+    while (t->m_count) {
+        mico_ble_nearby_remove(t, t->m_count - 1);
+    }
+    mico_rtos_unlock_mutex(&t->m_mutex);
+    return MICO_BT_SUCCESS;
+}
+
+/**
+ * Load the GATT cache, e.g. saved in flash before a reboot.
+ *
+ * @param entries
+ *      An array of entries, most recently used first.
+ *
+ * @param count
+ *      The number of entries, at most BLE_GATT_CACHE_MAX.
+ *
+ * @return
+ *      MICO_BT_SUCCESS if successfully.
+ */
+mico_bt_result_t mico_ble_set_gatt_cache(const mico_ble_gatt_cache_entry_t *entries, uint8_t count)
+{
+    mico_ble_gatt_cache_t *cache = &g_ble_context.m_gatt_cache;
+
+    if (count > BLE_GATT_CACHE_MAX || (count && !entries)) {
+        return MICO_BT_BADARG;
+    }
+
+    mico_rtos_lock_mutex(&cache->m_mutex);
+    memcpy(cache->m_entries, entries, count * sizeof(mico_ble_gatt_cache_entry_t));
+    cache->m_count = count;
+    mico_rtos_unlock_mutex(&cache->m_mutex);
+    return MICO_BT_SUCCESS;
+}
+
+/**
+ * Take a snapshot of the GATT cache, most recently used first.
+ *
+ * @param entries
+ *      An array of entries to fill in.
+ *
+ * @param max
+ *      The number of elements in entries.
+ *
+ * @return
+ *      The number of entries filled in.
+ */
+uint8_t mico_ble_get_gatt_cache(mico_ble_gatt_cache_entry_t *entries, uint8_t max)
+{
+    mico_ble_gatt_cache_t *cache = &g_ble_context.m_gatt_cache;
+    uint8_t count;
+
+    if (!entries) {
+        return 0;
+    }
+
+    mico_rtos_lock_mutex(&cache->m_mutex);
+    count = MIN(max, cache->m_count);
+    memcpy(entries, cache->m_entries, count * sizeof(mico_ble_gatt_cache_entry_t));
+    mico_rtos_unlock_mutex(&cache->m_mutex);
+    return count;
+}
+
+/**
+ * Empty the GATT cache and reset its statistics.
+ *
+ * @return
+ *      MICO_BT_SUCCESS if successfully.
+ */
+mico_bt_result_t mico_ble_clear_gatt_cache(void)
+{
+    mico_ble_gatt_cache_t *cache = &g_ble_context.m_gatt_cache;
+
+    mico_rtos_lock_mutex(&cache->m_mutex);
+    cache->m_count = 0;
+    cache->m_hits = 0;
+    cache->m_misses = 0;
+    cache->m_hit_ms = 0;
+    cache->m_miss_ms = 0;
+    mico_rtos_unlock_mutex(&cache->m_mutex);
+    return MICO_BT_SUCCESS;
+}
+
+/**
+ * Get the GATT cache statistics.
+ *
+ * @param stats
+ *      A pointer of statistics buffer.
+ *
+ * @return
+ *      MICO_BT_SUCCESS if successfully.
+ */
+mico_bt_result_t mico_ble_get_gatt_cache_stats(mico_ble_gatt_cache_stats_t *stats)
+{
+    mico_ble_gatt_cache_t *cache = &g_ble_context.m_gatt_cache;
+
+    if (!stats) {
+        return MICO_BT_BADARG;
+    }
+
+    mico_rtos_lock_mutex(&cache->m_mutex);
+    stats->entries = cache->m_count;
+    stats->hits = cache->m_hits;
+    stats->misses = cache->m_misses;
+    stats->hit_ready_ms = cache->m_hits ? cache->m_hit_ms / cache->m_hits : 0;
+    stats->miss_ready_ms = cache->m_misses ? cache->m_miss_ms / cache->m_misses : 0;
+    mico_rtos_unlock_mutex(&cache->m_mutex);
+    return MICO_BT_SUCCESS;
+}
+
+/**
+ * Take the phase timing of the recent central connect attempts, most recent first.
+ *
+ * @param timings
+ *      An array of attempts to fill in.
+ *
+ * @param max
+ *      The number of elements in timings.
+ *
+ * @return
+ *      The number of attempts filled in.
+ */
+uint8_t mico_ble_get_conn_timing(mico_ble_conn_timing_t *timings, uint8_t max)
+{
+    mico_ble_conn_timing_log_t *history = &g_ble_context.m_conn_timing;
+    uint32_t now = mico_rtos_get_time();
+    uint8_t count, i;
+
+    if (!timings) {
+        return 0;
+    }
+
+    mico_rtos_lock_mutex(&history->m_mutex);
+    count = MIN(max, history->m_count);
+    for (i = 0; i < count; i++) {
+        timings[i] = history->m_ring[(history->m_next + BLE_CONN_TIMING_MAX - 1 - i) % BLE_CONN_TIMING_MAX];
+        timings[i].age_ms = now - timings[i].age_ms;
+    }
+    mico_rtos_unlock_mutex(&history->m_mutex);
+    return count;
+}
+
+/**
+ * Get the histograms of the phase durations of all central connect attempts.
+ *
+ * @param hist
+ *      A pointer of histogram buffer.
+ *
+ * @return
+ *      MICO_BT_SUCCESS if successfully.
+ */
+mico_bt_result_t mico_ble_get_conn_hist(mico_ble_conn_hist_t *hist)
+{
+    mico_ble_conn_timing_log_t *history = &g_ble_context.m_conn_timing;
+
+    if (!hist) {
+        return MICO_BT_BADARG;
+    }
+
+    mico_rtos_lock_mutex(&history->m_mutex);
+    *hist = history->m_hist;
+    mico_rtos_unlock_mutex(&history->m_mutex);
+    return MICO_BT_SUCCESS;
+}
+
+/**
+ * Forget the recent connect attempts and empty the histograms.
+ *
+ * @return
+ *      MICO_BT_SUCCESS if successfully.
+ */
+mico_bt_result_t mico_ble_clear_conn_timing(void)
+{
+    mico_ble_conn_timing_log_t *history = &g_ble_context.m_conn_timing;
+
+    mico_rtos_lock_mutex(&history->m_mutex);
+    history->m_next = 0;
+    history->m_count = 0;
+    memset(&history->m_hist, 0, sizeof(history->m_hist));
+    mico_rtos_unlock_mutex(&history->m_mutex);
+    return MICO_BT_SUCCESS;
+}
+
+/**
+ * Set the automatic reconnect policy.
+ *
+ * @param cfg
+ *      The policy.
+ *
+ * @return
+ *      MICO_BT_SUCCESS if successfully.
+ *      MICO_BT_BADARG -- The backoff range is empty.
+ */
+mico_bt_result_t mico_ble_set_reconnect(const mico_ble_reconn_config_t *cfg)
+{
+    mico_ble_reconn_t *reconn = &g_ble_context.m_reconn;
+
+    if (!cfg || cfg->backoff_min_ms == 0 || cfg->backoff_min_ms > cfg->backoff_max_ms) {
+        return MICO_BT_BADARG;
+    }
+
+    reconn->m_cfg = *cfg;
+    if (!cfg->enable) {
+        mico_ble_reconn_cancel();
+        reconn->m_direct_next = MICO_FALSE;
+    }
+    return MICO_BT_SUCCESS;
+}
+
+/**
+ * Get the automatic reconnect policy.
+ *
+ * @param cfg
+ *      A pointer of the policy buffer.
+ */
+void mico_ble_get_reconnect(mico_ble_reconn_config_t *cfg)
+{
+    if (cfg) {
+        *cfg = g_ble_context.m_reconn.m_cfg;
+    }
+}
+
+/**
+ * Restore the peer of the last connection.
+ *
+ * @param peer
+ *      The peer, NULL to forget it.
+ *
+ * @return
+ *      MICO_BT_SUCCESS if successfully.
+ */
+mico_bt_result_t mico_ble_set_last_peer(const mico_ble_peer_t *peer)
+{
+    mico_ble_reconn_t *reconn = &g_ble_context.m_reconn;
+
+    if (peer && peer->role != BLE_ROLE_PERIPHERAL && peer->role != BLE_ROLE_CENTRAL) {
+        return MICO_BT_BADARG;
+    }
+
+    reconn->m_has_last = (peer != NULL);
+    if (peer) {
+        reconn->m_last = *peer;
+    }
+    return MICO_BT_SUCCESS;
+}
+
+/**
+ * Get the peer of the last connection.
+ *
+ * @param peer
+ *      A pointer of the peer buffer.
+ *
+ * @return
+ *      MICO_BT_SUCCESS if successfully.
+ *      MICO_BT_BADOPTION -- No connection yet.
+ */
+mico_bt_result_t mico_ble_get_last_peer(mico_ble_peer_t *peer)
+{
+    if (!peer) {
+        return MICO_BT_BADARG;
+    }
+    if (!g_ble_context.m_reconn.m_has_last) {
+        return MICO_BT_BADOPTION;
+    }
+    *peer = g_ble_context.m_reconn.m_last;
+    return MICO_BT_SUCCESS;
+}
+
+/**
+ * Reconnect to the peer of the last connection.
+ *
+ * @return
+ *      MICO_BT_SUCCESS if successfully.
+ *      MICO_BT_BADOPTION -- Reconnect is disabled, no last peer or the role is busy.
+ */
+mico_bt_result_t mico_ble_reconnect(void)
+{
+    mico_ble_reconn_t *reconn = &g_ble_context.m_reconn;
+
+    if (!reconn->m_cfg.enable || !reconn->m_has_last) {
+        return MICO_BT_BADOPTION;
+    }
+
+    if (reconn->m_last.role == BLE_ROLE_CENTRAL) {
+        return mico_ble_reconn_start(reconn->m_last.bd_addr);
+    }
+
+    /* Directed advertising replaces the undirected one for a while */
+    if (!SM_InState(&g_ble_context.m_periph_sm, BLE_STATE_PERIPHERAL_ADVERTISING)
+        || reconn->m_is_directed
+        || !mico_bt_dev_find_bonded_device(reconn->m_last.bd_addr)) {
+        return MICO_BT_BADOPTION;
+    }
+    mico_ble_set_device_discovery(MICO_FALSE);
+    memcpy(reconn->m_direct_addr, reconn->m_last.bd_addr, BD_ADDR_LEN);
+    reconn->m_direct_next = MICO_TRUE;
+    if (!mico_ble_reconn_start_directed()) {
+        mico_ble_set_device_discovery(MICO_TRUE);
+        return MICO_BT_ERROR;
+    }
+    return MICO_BT_SUCCESS;
+}
+
+/**
+ * Add a known peer to the controller filter accept list.
+ *
+ * @param addr
+ *      Device address of the peer.
+ *
+ * @return
+ *      MICO_BT_SUCCESS if successfully.
+ *      MICO_BT_NO_RESOURCES -- The accept list is full.
+ *      MICO_BT_ERROR -- The controller rejected the address.
+ */
+mico_bt_result_t mico_ble_accept_list_add(const mico_bt_device_address_t addr)
+{
+    uint8_t size = MIN(BLE_ACCEPT_LIST_MAX, mico_bt_ble_get_white_list_size());
+
+    if (!addr) {
+        return MICO_BT_BADARG;
+    }
+    if (mico_ble_accept_list_find(addr) >= 0) {
+        return MICO_BT_SUCCESS;
+    }
+    if (g_ble_context.m_accept_count >= size) {
+        return MICO_BT_NO_RESOURCES;
+    }
+
+    memcpy(g_ble_context.m_accept_list[g_ble_context.m_accept_count], addr, BD_ADDR_LEN);
+    if (!mico_bt_ble_update_background_connection_device(MICO_TRUE, g_ble_context.m_accept_list[g_ble_context.m_accept_count])) {
+        return MICO_BT_ERROR;
+    }
+    g_ble_context.m_accept_count++;
+    return MICO_BT_SUCCESS;
+}
+
+/**
+ * Remove a known peer from the controller filter accept list.
+ *
+ * @param addr
+ *      Device address of the peer.
+ *
+ * @return
+ *      MICO_BT_SUCCESS if successfully.
+ *      MICO_BT_BADARG -- The peer is not in the accept list.
+ */
+mico_bt_result_t mico_ble_accept_list_remove(const mico_bt_device_address_t addr)
+{
+    int index = addr ? mico_ble_accept_list_find(addr) : -1;
+    uint8_t last;
+
+    if (index < 0) {
+        return MICO_BT_BADARG;
+    }
+
+    mico_bt_ble_update_background_connection_device(MICO_FALSE, g_ble_context.m_accept_list[index]);
+    last = (uint8_t)(g_ble_context.m_accept_count - 1);
+    if (index != last) {
+        memcpy(g_ble_context.m_accept_list[index], g_ble_context.m_accept_list[last], BD_ADDR_LEN);
+    }
+    g_ble_context.m_accept_count = last;
+    return MICO_BT_SUCCESS;
+}
+
+/**
+ * Remove all peers from the controller filter accept list.
+ *
+ * @return
+ *      MICO_BT_SUCCESS if successfully.
+ */
+mico_bt_result_t mico_ble_accept_list_clear(void)
+{
+    while (g_ble_context.m_accept_count > 0) {
+        g_ble_context.m_accept_count--;
+        mico_bt_ble_update_background_connection_device(MICO_FALSE, g_ble_context.m_accept_list[g_ble_context.m_accept_count]);
+    }
+    return MICO_BT_SUCCESS;
+}
+
+/**
+ * Get the number of peers in the controller filter accept list.
+ *
+ * @return
+ *      The number of peers.
+ */
+uint8_t mico_ble_accept_list_count(void)
+{
+    return g_ble_context.m_accept_count;
+}
+
+/**
+ * Get the peers in the controller filter accept list.
+ *
+ * @param addrs
+ *      An array of addresses to fill in.
+ *
+ * @param max
+ *      The number of elements in addrs.
+ *
+ * @return
+ *      The number of addresses filled in.
+ */
+uint8_t mico_ble_get_accept_list(mico_bt_device_address_t *addrs, uint8_t max)
+{
+    uint8_t count;
+
+    if (!addrs) {
+        return 0;
+    }
+
+    count = MIN(max, g_ble_context.m_accept_count);
+    memcpy(addrs, g_ble_context.m_accept_list, count * sizeof(mico_bt_device_address_t));
+    return count;
+}
+
+/**
+ * Let the controller drop advertisements of devices not in the accept list.
+ * Takes effect from the next scan.
+ *
+ * @param enable
+ *      MICO_TRUE to scan with the accept list filter policy.
+ *
+ * @return
+ *      MICO_BT_SUCCESS if successfully.
+ */
+mico_bt_result_t mico_ble_set_accept_list_filter(mico_bool_t enable)
+{
+    g_ble_context.m_accept_filter = enable;
+    return MICO_BT_SUCCESS;
+}
+
+/**
+ * Get whether scans use the accept list filter policy.
+ *
+ * @return
+ *      MICO_TRUE if enabled.
+ */
+mico_bool_t mico_ble_get_accept_list_filter(void)
+{
+    return g_ble_context.m_accept_filter;
+}
+
+/**
+ * Set the advertising data filter of scan results.
+ *
+ * @param filter
+ *      The filter, NULL to report devices regardless of advertising data.
+ *
+ * @return
+ *      MICO_BT_SUCCESS if successfully.
+ *      MICO_BT_BADARG -- Invalid UUID or data length.
+ */
+mico_bt_result_t mico_ble_set_ad_filter(const mico_ble_ad_filter_t *filter)
+{
+    if (filter && ((filter->service_uuid.len != 0 && !mico_ble_check_uuid(&filter->service_uuid))
+                   || filter->data_length > BLE_AD_FILTER_DATA_MAX
+                   || (filter->data_length > 0 && !filter->match_company))) {
+        return MICO_BT_BADARG;
+    }
+
+    /* The scan result handler may run meanwhile, never let it see a half copied filter. */
+    mico_rtos_lock_mutex(&g_ble_context.m_ad_filter_mutex);
+    g_ble_context.m_ad_filter_on = MICO_FALSE;
+    if (filter) {
+        memcpy(&g_ble_context.m_ad_filter, filter, sizeof(mico_ble_ad_filter_t));
+        g_ble_context.m_ad_filter_on = MICO_TRUE;
+    }
+    mico_rtos_unlock_mutex(&g_ble_context.m_ad_filter_mutex);
+    return MICO_BT_SUCCESS;
+}
+
+/**
+ * Get the advertising data filter of scan results.
+ *
+ * @param filter
+ *      A pointer of filter buffer.
+ *
+ * @return
+ *      MICO_TRUE if a filter is set.
+ */
+mico_bool_t mico_ble_get_ad_filter(mico_ble_ad_filter_t *filter)
+{
+    mico_bool_t is_on;
+
+    mico_rtos_lock_mutex(&g_ble_context.m_ad_filter_mutex);
+    is_on = g_ble_context.m_ad_filter_on;
+    if (filter && is_on) {
+        memcpy(filter, &g_ble_context.m_ad_filter, sizeof(mico_ble_ad_filter_t));
+    }
+    mico_rtos_unlock_mutex(&g_ble_context.m_ad_filter_mutex);
+    return is_on;
+}
+
+/**
+ *
+ * @param start
+ * @return
+ */
+static mico_bt_result_t mico_ble_set_device_scan(mico_bool_t start)
+{
+    OSStatus err = kNoErr;
+
+    if (start) {
+        g_ble_context.m_scan_cycling = mico_ble_scan_is_cycling();
+        err = mico_ble_scan_start();
+    } else {
+        /* Also ends the rest period of a duty cycle */
+        g_ble_context.m_scan_cycling = MICO_FALSE;
+        if (g_ble_context.m_scan_rest_timer_ms) {
+            mico_rtos_stop_timer(&g_ble_context.m_scan_rest_timer);
+        }
+        if (mico_bt_smartbridge_is_scanning()) {
+            err = mico_bt_smartbridge_stop_scan();
+        }
+    }
+    return (mico_bt_result_t)err;
+}
+
+/* The peripheral role keeps advertising or stays connected while scanning, so do central links. */
+mico_bt_result_t mico_ble_start_device_scan(void)
+{
+    if (SM_InState(&g_ble_context.m_central_sm, BLE_STATE_IDLE)
+        || SM_InState(&g_ble_context.m_central_sm, BLE_STATE_CENTRAL_CONNECTED)) {
+        mico_bt_result_t ret = mico_ble_set_device_scan(MICO_TRUE);
+        if (ret == MICO_BT_PENDING) {
+            SM_Handle(&g_ble_context.m_central_sm, BLE_SM_EVT_CENTRAL_LESCAN_CMD);
+            ret = MICO_BT_SUCCESS;
+        }
+        return ret;
+    }
+    return MICO_BT_BADOPTION;
+}
+
+/**
+ * Stop a scan started by mico_ble_start_device_scan(), e.g. a continuous one.
+ *
+ * @return
+ *      MICO_BT_SUCCESS if succesfully, MICO_BT_BADOPTION if not scanning.
+ */
+mico_bt_result_t mico_ble_stop_device_scan(void)
+{
+    if (!SM_InState(&g_ble_context.m_central_sm, BLE_STATE_CENTRAL_SCANNING)) {
+        return MICO_BT_BADOPTION;
+    }
+
+    mico_ble_set_device_scan(MICO_FALSE);
+    mico_ble_central_scan_end();
+    return MICO_BT_SUCCESS;
+}
+
+/**
+ * Connect to the first, or the strongest within a window, connectable device
+ * matching a name prefix or a service UUID. A scan is started if none is
+ * running, and goes on until a match is found.
+ *
+ * @param cond
+ *      The device to look for.
+ *
+ * @return
+ *      MICO_BT_SUCCESS if successfully.
+ *      MICO_BT_BADARG -- Neither a name prefix nor a service UUID.
+ *      MICO_BT_BADOPTION -- The central role is connecting.
+ *      MICO_BT_NO_RESOURCES -- No resource for the window timer.
+ */
+mico_bt_result_t mico_ble_auto_connect(const mico_ble_auto_conn_t *cond)
+{
+    mico_ble_auto_conn_state_t *auto_conn = &g_ble_context.m_auto_conn;
+    mico_bt_result_t ret;
+    OSStatus err;
+
+    if (!cond
+        || (cond->service_uuid.len == 0 && cond->name_prefix[0] == '\0')
+        || (cond->service_uuid.len != 0 && !mico_ble_check_uuid(&cond->service_uuid))) {
+        return MICO_BT_BADARG;
+    }
+    if (SM_InState(&g_ble_context.m_central_sm, BLE_STATE_CENTRAL_CONNECTING)) {
+        return MICO_BT_BADOPTION;
+    }
+
+    mico_ble_auto_conn_cancel();
+
+    /* The window opens with the first match, see mico_ble_auto_conn_check() */
+    if (cond->window_ms && cond->window_ms != auto_conn->m_timer_ms) {
+        if (!auto_conn->m_timer_ms) {
+            err = mico_rtos_init_timer(&auto_conn->m_timer, cond->window_ms, mico_ble_auto_conn_timeout, NULL);
+        } else {
+            err = mico_rtos_change_timer_period(&auto_conn->m_timer, cond->window_ms);
+            mico_rtos_stop_timer(&auto_conn->m_timer);
+        }
+        if (err != kNoErr) {
+            return MICO_BT_NO_RESOURCES;
+        }
+        auto_conn->m_timer_ms = cond->window_ms;
+    }
+
+    auto_conn->m_cond = *cond;
+    auto_conn->m_cond.name_prefix[BLE_AUTO_CONN_NAME_MAX] = '\0';
+    memset(&auto_conn->m_filter, 0, sizeof(mico_ble_ad_filter_t));
+    auto_conn->m_filter.service_uuid = cond->service_uuid;
+    auto_conn->m_is_armed = MICO_TRUE;
+
+    /* A running scan goes on until the device is found */
+    if (SM_InState(&g_ble_context.m_central_sm, BLE_STATE_CENTRAL_SCANNING)) {
+        g_ble_context.m_scan_cycling = MICO_TRUE;
+        return MICO_BT_SUCCESS;
+    }
+
+    ret = mico_ble_start_device_scan();
+    if (ret != MICO_BT_SUCCESS) {
+        mico_ble_auto_conn_cancel();
+    }
+    return ret;
+}
+
+/**
+ * Stop looking for the device of mico_ble_auto_connect(), the scan goes on
+ * as configured.
+ *
+ * @return
+ *      MICO_BT_SUCCESS if successfully, MICO_BT_BADOPTION if not looking.
+ */
+mico_bt_result_t mico_ble_cancel_auto_connect(void)
+{
+    if (!g_ble_context.m_auto_conn.m_is_armed) {
+        return MICO_BT_BADOPTION;
+    }
+
+    mico_ble_auto_conn_cancel();
+    if (SM_InState(&g_ble_context.m_central_sm, BLE_STATE_CENTRAL_SCANNING)) {
+        g_ble_context.m_scan_cycling = mico_ble_scan_is_cycling();
+    }
+    return MICO_BT_SUCCESS;
+}
+
+/**
+ * Get the device being looked for by mico_ble_auto_connect().
+ *
+ * @param cond
+ *      A pointer of the condition buffer.
+ *
+ * @return
+ *      MICO_TRUE if looking for a device.
+ */
+mico_bool_t mico_ble_get_auto_connect(mico_ble_auto_conn_t *cond)
+{
+    if (!g_ble_context.m_auto_conn.m_is_armed) {
+        return MICO_FALSE;
+    }
+    if (cond) {
+        *cond = g_ble_context.m_auto_conn.m_cond;
+    }
+    return MICO_TRUE;
+}
+
+/**
+ * Start or stop a device discoverable procedure.
+ *
+ * @param start
+ *      A boolean value of start or stop.
+ *
+ * @return
+ *      MICO_BT_SUCCESS if succesfully.
+ */
+static mico_bt_result_t mico_ble_set_device_discovery(mico_bool_t start)
+{
+    OSStatus err;
+    if (start) {
+        err = mico_bt_peripheral_start_advertisements((mico_bt_smart_advertising_settings_t *)&g_peripheral_advertising_settings,
+                                                      mico_ble_peripheral_advertisement_complete_handler);
+    } else {
+        err = mico_bt_peripheral_stop_advertisements();
+    }
+    return (mico_bt_result_t)err;
+}
+
+/* The central role keeps scanning or its links while advertising. */
+mico_bt_result_t mico_ble_start_device_discovery(void)
+{
+    if (SM_InState(&g_ble_context.m_periph_sm, BLE_STATE_IDLE)) {
+        mico_bt_result_t ret = mico_ble_set_device_discovery(MICO_TRUE);
+        if (ret == MICO_BT_SUCCESS) {
+            SM_Handle(&g_ble_context.m_periph_sm, BLE_SM_EVT_PERIPHERAL_LEADV_CMD);
+        }
+        return ret;
+    }
+    return MICO_BT_BADOPTION;
+}
+
+/* The peripheral role goes back to idle, the central role is not affected. */
+mico_bt_result_t mico_ble_stop_device_discovery(void)
+{
+    if (!SM_InState(&g_ble_context.m_periph_sm, BLE_STATE_PERIPHERAL_ADVERTISING)) {
+        return MICO_BT_BADOPTION;
+    }
+    return SM_Handle(&g_ble_context.m_periph_sm, BLE_SM_EVT_PERIPHERAL_ADV_STOPED) ? MICO_BT_SUCCESS : MICO_BT_ERROR;
+}
+
+/**
  *
- * @param name
- *          An new name for BT Controller.
+ * @param bdaddr
+ * @return
+ */
+mico_bt_result_t mico_ble_connect(mico_bt_device_address_t bdaddr)
+{
+    mico_bt_result_t ret = MICO_BT_BADOPTION;
+    mico_ble_link_t *link;
+
+    if (SM_InState(&g_ble_context.m_central_sm, BLE_STATE_CENTRAL_CONNECTING)) {
+        return MICO_BT_BADOPTION;
+    }
+
+    /* One link per peer */
+    if (mico_ble_link_lookup(BLE_LINK_STATE_CONNECTING, bdaddr)
+        || mico_ble_link_lookup(BLE_LINK_STATE_CONNECTED, bdaddr)) {
+        return MICO_BT_BADOPTION;
+    }
+
+    link = mico_ble_link_lookup(BLE_LINK_STATE_IDLE, NULL);
+    require_action_string(link != NULL, exit, ret = MICO_BT_NO_RESOURCES, "All central links are in use");
+
+    memcpy(link->m_peer.address, bdaddr, 6);
+    link->m_peer.address_type = BT_SMART_ADDR_TYPE_PUBLIC;
+    link->m_request_time = mico_rtos_get_time();
+
+    /* Handle Event, a running scan ends here */
+    if (SM_InState(&g_ble_context.m_central_sm, BLE_STATE_CENTRAL_SCANNING)) {
+        mico_ble_set_device_scan(MICO_FALSE);
+    }
+    SM_Handle(&link->m_sm, BLE_LINK_EVT_CONNECT);
+    if (!SM_InState(&g_ble_context.m_central_sm, BLE_STATE_CENTRAL_CONNECTED)) {
+        SM_Handle(&g_ble_context.m_central_sm, BLE_SM_EVT_CENTRAL_LECONN_CMD);
+    }
+
+    /* Connecting... */
+    ret = (mico_bt_result_t)mico_ble_worker_send(BLE_WORKER_TASK,
+                                                 mico_ble_central_connect_handler,
+                                                 link);
+    require_noerr_action_string(ret, exit, mico_ble_link_connect_failed(link), "Send asynchronous event failed");
+
+exit:
+    return ret;
+}
+
+/**
  *
- * @return MICO_BT_PENDING if successfully.
+ * @param connect_handle
+ * @return
+ */
+mico_bt_result_t mico_ble_disconnect(uint16_t connect_handle)
+{
+    mico_bt_result_t ret = MICO_BT_BADOPTION;
+    mico_ble_link_t *link;
+
+    /* The peripheral connection, also by any handle while no central link is up */
+    if (SM_InState(&g_ble_context.m_periph_sm, BLE_STATE_PERIPHERAL_CONNECTED)
+        && (connect_handle == g_ble_context.m_peripheral_socket.connection_handle
+            || g_ble_context.m_link_count == 0)) {
+        g_ble_context.m_reconn.m_is_closing = MICO_TRUE;
+        ret = (mico_bt_result_t)mico_bt_peripheral_disconnect();
+        if (ret == MICO_BT_SUCCESS) {
+            SM_Handle(&g_ble_context.m_periph_sm, BLE_SM_EVT_PERIPHERAL_DISCONNECTED);
+        } else {
+            g_ble_context.m_reconn.m_is_closing = MICO_FALSE;
+        }
+    } else if (g_ble_context.m_link_count > 0) {
+        link = mico_ble_link_find(connect_handle);
+        if (!link) {
+            return MICO_BT_BADARG;
+        }
+        link->m_is_closing = MICO_TRUE;
+        ret = (mico_bt_result_t)mico_bt_smartbridge_disconnect(&link->m_socket, MICO_FALSE);
+        if (ret == MICO_BT_SUCCESS && SM_InState(&link->m_sm, BLE_LINK_STATE_CONNECTED)) {
+            SM_Handle(&link->m_sm, BLE_LINK_EVT_DISCONNECTED);
+        } else if (ret != MICO_BT_SUCCESS) {
+            link->m_is_closing = MICO_FALSE;
+        }
+    }
+
+    return ret;
+}
+
+/**
+ * Get local BT RF State.
+ *
+ * @return
+ *      a value of local BT RF State. See details @mico_ble_state_t
+ */
+mico_ble_state_t mico_ble_get_device_state(void)
+{
+    uint8_t central = SM_GetState(&g_ble_context.m_central_sm);
+    uint8_t periph = SM_GetState(&g_ble_context.m_periph_sm);
+
+    /* Both roles may be active, a connection outranks a procedure, the central role outranks the peripheral one */
+    if (g_ble_context.m_link_count > 0 || periph == BLE_STATE_PERIPHERAL_CONNECTED) {
+        return (mico_ble_state_t)(g_ble_context.m_link_count > 0 ? BLE_STATE_CENTRAL_CONNECTED : periph);
+    }
+    return (mico_ble_state_t)(central != BLE_STATE_IDLE ? central : periph);
+}
+
+/**
+ * Get the state of one role.
+ *
+ * @param role
+ *      BLE_ROLE_PERIPHERAL or BLE_ROLE_CENTRAL.
+ *
+ * @return
+ *      BLE_STATE_IDLE or a state of the role. See details @mico_ble_state_t
+ */
+mico_ble_state_t mico_ble_get_role_state(mico_ble_role_t role)
+{
+    if (role == BLE_ROLE_CENTRAL) {
+        return (mico_ble_state_t)SM_GetState(&g_ble_context.m_central_sm);
+    }
+    return (mico_ble_state_t)SM_GetState(&g_ble_context.m_periph_sm);
+}
+
+/**
+ * Get the connection handle of the SPP channel.
+ *
+ * @return
+ *      Handle of the primary central link or of the peripheral connection, 0 if not connected.
+ */
+uint16_t mico_ble_get_spp_handle(void)
+{
+    return mico_ble_spp_handle();
+}
+
+/**
+ * Send a packet synchronously over BT RFCOMM Channel.
+ *
+ * @param p_data
+ *          A pointer of packet.
+ *
+ * @param length
+ *          the size of packet.
+ *
+ * @param timeout_ms
+ *          Timeout of synchronously.
+ *
+ * @return
+ *      MICO_BT_SUCCESS  -- sending completily.
+ *      MICO_BT_NO_RESOURCES -- No resource for malloc()
+ *      MICO_BT_ILLEGAL_ACTION -- Illegal action (RFCOMM Channel is not opened).
+ *      MICO_BT_TIMEOUT -- Timeout, nothing has been sent.
+ *      MICO_BT_ERROR -- The packet was only partially sent.
+ */
+mico_bt_result_t mico_ble_send_data(const uint8_t *p_data, uint32_t length, uint32_t timeout_ms)
+{
+    mico_ble_iovec_t vec = {
+        .p_data = p_data,
+        .length = length,
+    };
+
+    if (!p_data || length == 0 || length >= (uint16_t)-1) {
+        return (mico_bt_result_t)kParamErr;
+    }
+    return mico_ble_send_datav(&vec, 1, timeout_ms);
+}
+
+/**
+ * Send a packet gathered from several fragments synchronously.
+ *
+ * The fragments are copied straight into MTU-sized chunks, so the caller does
+ * not need to assemble them in a contiguous buffer first.
+ *
+ * @param vec
+ *          An array of fragments.
+ *
+ * @param count
+ *          the number of fragments.
+ *
+ * @param timeout_ms
+ *          Timeout of synchronously.
+ *
+ * @return
+ *      Same as mico_ble_send_data().
+ */
+mico_bt_result_t mico_ble_send_datav(const mico_ble_iovec_t *vec, uint32_t count, uint32_t timeout_ms)
+{
+    mico_bt_result_t ret = MICO_BT_NO_RESOURCES;
+    mico_ble_iovec_t packed;
+    uint8_t *in = NULL, *out = NULL;
+    uint32_t length = mico_ble_iov_length(vec, count);
+
+    if (length == 0) {
+        return (mico_bt_result_t)kParamErr;
+    }
+    if (!mico_ble_compress_is_active()) {
+        return mico_ble_send_msg(BLE_FRAME_TYPE_DATA, vec, count, timeout_ms);
+    }
+    if (length > BLE_FRAME_POOL_BLOCK_SIZE) {
+        return MICO_BT_BADARG;
+    }
+
+    /* The codec needs a contiguous input */
+    if (count == 1) {
+        packed.p_data = vec[0].p_data;
+    } else {
+        mico_ble_iov_cursor_t cursor = {
+            .vec = vec,
+            .count = count,
+        };
+        in = (uint8_t *)malloc(length);
+        require(in, exit);
+        mico_ble_iov_copy(&cursor, in, length);
+        packed.p_data = in;
+    }
+
+    /* Send as is if the data does not shrink */
+    out = (uint8_t *)malloc(length);
+    require(out, exit);
+    packed.length = mico_ble_lz_compress(packed.p_data, length, out, length - 1);
+    if (packed.length > 0) {
+        packed.p_data = out;
+        ret = mico_ble_send_msg(BLE_FRAME_TYPE_DATA_LZ, &packed, 1, timeout_ms);
+    } else {
+        packed.length = length;
+        ret = mico_ble_send_msg(BLE_FRAME_TYPE_DATA, &packed, 1, timeout_ms);
+    }
+
+exit:
+    if (in) free(in);
+    if (out) free(out);
+    return ret;
+}
+
+/**
+ * Send a packet synchronously to one connection.
+ *
+ * @param handle
+ *          Connection handle, see BLE_EVT_CENTRAL_CONNECTED.
+ *
+ * @param p_data
+ *          A pointer of packet.
+ *
+ * @param length
+ *          the size of packet.
+ *
+ * @param timeout_ms
+ *          Timeout of synchronously.
+ *
+ * @return
+ *      Same as mico_ble_send_data().
+ *      MICO_BT_BADARG -- No connection with this handle.
+ */
+mico_bt_result_t mico_ble_send_data_to(uint16_t handle, const uint8_t *p_data, uint32_t length, uint32_t timeout_ms)
+{
+    mico_ble_iovec_t vec = {
+        .p_data = p_data,
+        .length = length,
+    };
+
+    if (!p_data || length == 0 || length >= (uint16_t)-1) {
+        return (mico_bt_result_t)kParamErr;
+    }
+    return mico_ble_send_datav_to(handle, &vec, 1, timeout_ms);
+}
+
+/**
+ * Send a packet gathered from several fragments synchronously to one connection.
+ *
+ * @param handle
+ *          Connection handle, see BLE_EVT_CENTRAL_CONNECTED.
+ *
+ * @param vec
+ *          An array of fragments.
+ *
+ * @param count
+ *          the number of fragments.
+ *
+ * @param timeout_ms
+ *          Timeout of synchronously.
+ *
+ * @return
+ *      Same as mico_ble_send_data_to().
+ */
+mico_bt_result_t mico_ble_send_datav_to(uint16_t handle, const mico_ble_iovec_t *vec, uint32_t count, uint32_t timeout_ms)
+{
+    mico_bt_result_t ret;
+    mico_ble_link_t *link = mico_ble_link_find(handle);
+    mico_bool_t is_peripheral = !link && SM_InState(&g_ble_context.m_periph_sm, BLE_STATE_PERIPHERAL_CONNECTED)
+                                && handle == g_ble_context.m_peripheral_socket.connection_handle;
+    mico_ble_tx_msg_t msg = {
+        .cursor = {
+            .vec = vec,
+            .count = count,
+        },
+    };
+
+    if ((link && link == g_ble_context.m_primary)
+        || (is_peripheral && g_ble_context.m_spp_owner == BLE_SPP_OWNER_PERIPHERAL)) {
+        return mico_ble_send_datav(vec, count, timeout_ms);
+    }
+    if (!link && !is_peripheral) {
+        return MICO_BT_BADARG;
+    }
+
+    msg.length = mico_ble_iov_length(vec, count);
+    if (msg.length == 0) {
+        return (mico_bt_result_t)kParamErr;
+    }
+    msg.remaining = msg.length;
+
+    /* Raw data, the writes of one connection are serialized */
+    if (link) {
+        mico_rtos_lock_mutex(&link->m_tx_mutex);
+        ret = mico_ble_link_write(link, &msg);
+        mico_rtos_unlock_mutex(&link->m_tx_mutex);
+    } else {
+        mico_rtos_lock_mutex(&g_ble_context.m_tx_mutex);
+        ret = mico_ble_peripheral_send_data(&msg, timeout_ms);
+        mico_rtos_unlock_mutex(&g_ble_context.m_tx_mutex);
+    }
+    return ret;
+}
+
+/* Send a message of the given frame type, type is ignored if framing is disabled. */
+static mico_bt_result_t mico_ble_send_msg(uint8_t type, const mico_ble_iovec_t *vec, uint32_t count, uint32_t timeout_ms)
+{
+    mico_bt_result_t ret;
+
+    /* Fragments of two messages must not interleave, e.g. a SACK from the worker thread */
+    mico_rtos_lock_mutex(&g_ble_context.m_tx_mutex);
+    ret = mico_ble_do_send_msg(type, vec, count, timeout_ms);
+    mico_rtos_unlock_mutex(&g_ble_context.m_tx_mutex);
+    return ret;
+}
+
+static mico_bt_result_t mico_ble_do_send_msg(uint8_t type, const mico_ble_iovec_t *vec, uint32_t count, uint32_t timeout_ms)
+{
+    OSStatus err = kParamErr;
+    mico_ble_tx_msg_t msg = {
+        .cursor = {
+            .vec = vec,
+            .count = count,
+        },
+        .type = type,
+        .is_framed = g_ble_context.m_is_framing,
+        .length = mico_ble_iov_length(vec, count),
+    };
+
+    require(msg.length > 0, exit);
+    require_action(!g_ble_context.m_is_framing || msg.length <= BLE_FRAME_POOL_BLOCK_SIZE, exit, err = MICO_BT_BADARG);
+    msg.remaining = msg.length;
+
+    mico_ble_conn_tx_activity(msg.length);
+
+    if (g_ble_context.m_coc_cid != 0) {
+        err = mico_ble_coc_send_data(&msg, timeout_ms);
+    } else if (g_ble_context.m_spp_owner == BLE_SPP_OWNER_CENTRAL) {
+        err = mico_ble_link_write(g_ble_context.m_primary, &msg);
+    } else if (g_ble_context.m_spp_owner == BLE_SPP_OWNER_PERIPHERAL) {
+        err = mico_ble_peripheral_send_data(&msg, timeout_ms);
+    }
+
+exit:
+    return (mico_bt_result_t)err;
+}
+
+/* Write a message to the SPP IN of a central link, one chunk per write. */
+static mico_bt_result_t mico_ble_link_write(mico_ble_link_t *link, mico_ble_tx_msg_t *msg)
+{
+    OSStatus err;
+    mico_bt_smart_attribute_t *characteristic_value = NULL;
+    uint16_t attr_cap_size;
+    uint16_t actual_len = 0;
+
+    err = mico_bt_smart_attribute_create(&characteristic_value, MICO_ATTRIBUTE_TYPE_CHARACTERISTIC_VALUE,
+                                         (uint16_t)MIN(msg->length + BLE_FRAME_FIRST_HDR_SIZE,
+                                                       BLE_ATT_MTU_MAX - BLE_ATT_HDR_SIZE));
+    require_noerr(err, exit);
+    err = mico_bt_smartbridge_get_attribute_cache_by_handle(&link->m_socket, 
+                                                             link->m_attr_handle, 
+                                                             characteristic_value, 
+                                                             ATTR_CHARACTERISTIC_VALUE_SIZE(20));
+    require_noerr(err, exit);
+
+    attr_cap_size = characteristic_value->value_length;
+    require_action(attr_cap_size > (msg->is_framed ? BLE_FRAME_FIRST_HDR_SIZE : 0), exit, err = MICO_BT_BADOPTION);
+
+    while (msg->remaining > 0 && err == kNoErr) {
+        const uint8_t *chunk = mico_ble_tx_next_chunk(msg, characteristic_value->value.value,
+                                                      attr_cap_size, &actual_len);
+        if (!chunk) {
+            err = MICO_BT_BADOPTION;
+            break;
+        }
+        if (chunk != characteristic_value->value.value) {
+            memcpy(characteristic_value->value.value, chunk, actual_len);
+        }
+        characteristic_value->value_length = actual_len;
+        err = (mico_bt_result_t)mico_bt_smartbridge_write_attribute_cache_characteristic_value(&link->m_socket, 
+                                                                                                characteristic_value);
+    }
+
+exit:
+    if (characteristic_value) {
+        mico_bt_smart_attribute_delete(characteristic_value);
+    }
+    return (mico_bt_result_t)err;
+}
+
+/* Total length of the fragments, 0 if there are none or one without data pointer has a length. */
+static uint32_t mico_ble_iov_length(const mico_ble_iovec_t *vec, uint32_t count)
+{
+    uint32_t length = 0;
+    uint32_t i;
+
+    if (!vec) {
+        return 0;
+    }
+    for (i = 0; i < count; i++) {
+        if (!vec[i].p_data && vec[i].length > 0) {
+            return 0;
+        }
+        length += vec[i].length;
+    }
+    return length;
+}
+
+/* Return a contiguous view of the next length bytes, copying into staging only if they span fragments. */
+static const uint8_t *mico_ble_iov_gather(const mico_ble_iov_cursor_t *cursor, uint8_t *staging, uint32_t length)
+{
+    mico_ble_iov_cursor_t peek = *cursor;
+
+    while (peek.index < peek.count && peek.offset == peek.vec[peek.index].length) {
+        peek.index++;
+        peek.offset = 0;
+    }
+    if (peek.index < peek.count && peek.vec[peek.index].length - peek.offset >= length) {
+        return peek.vec[peek.index].p_data + peek.offset;
+    }
+
+    mico_ble_iov_copy(&peek, staging, length);
+    return staging;
+}
+
+/* Copy up to length bytes out of the fragment list and advance the cursor. */
+static uint32_t mico_ble_iov_copy(mico_ble_iov_cursor_t *cursor, uint8_t *dst, uint32_t length)
+{
+    uint32_t copied = 0;
+
+    while (copied < length && cursor->index < cursor->count) {
+        const mico_ble_iovec_t *v = &cursor->vec[cursor->index];
+        uint32_t n = MIN(v->length - cursor->offset, length - copied);
+
+        memcpy(dst + copied, v->p_data + cursor->offset, n);
+        copied += n;
+        cursor->offset += n;
+        if (cursor->offset == v->length) {
+            cursor->index++;
+            cursor->offset = 0;
+        }
+    }
+    return copied;
+}
+
+static void mico_ble_iov_advance(mico_ble_iov_cursor_t *cursor, uint32_t length)
+{
+    while (length > 0 && cursor->index < cursor->count) {
+        uint32_t n = MIN(cursor->vec[cursor->index].length - cursor->offset, length);
+
+        length -= n;
+        cursor->offset += n;
+        if (cursor->offset == cursor->vec[cursor->index].length) {
+            cursor->index++;
+            cursor->offset = 0;
+        }
+    }
+}
+
+/**
+ * Set the ATT MTU used to fragment outgoing data of the peripheral connection.
+ *
+ * @param mtu
+ *          ATT MTU negotiated with the peer, in [23, 247].
+ *
+ * @return
+ *      MICO_BT_SUCCESS if successfully.
  */
-mico_bt_result_t mico_ble_set_device_name(const char *name)
+mico_bt_result_t mico_ble_set_att_mtu(uint16_t mtu)
 {
-    /* Update BT Controller Name */
-    extern mico_bt_result_t BTM_SetLocalDeviceName(char *);
-    extern mico_bt_cfg_settings_t mico_bt_cfg_settings;
-
-    mico_bt_cfg_settings.device_name = (uint8_t *)name;
-    return BTM_SetLocalDeviceName((char *)mico_bt_cfg_settings.device_name);
+    if (mtu < BLE_ATT_MTU_DEFAULT || mtu > BLE_ATT_MTU_MAX) {
+        return MICO_BT_BADARG;
+    }
+    g_ble_context.m_att_mtu = mtu;
+    return MICO_BT_SUCCESS;
 }
 
 /**
- * Get local BT Device Name
+ * Get TX throughput statistics of the current peripheral connection.
  *
- * @return A c-style string of local device name.
+ * @param stats
+ *          A pointer of statistics buffer.
+ *
+ * @return
+ *      MICO_BT_SUCCESS if successfully.
  */
-const char *mico_ble_get_device_name(void)
+mico_bt_result_t mico_ble_get_tx_stats(mico_ble_tx_stats_t *stats)
 {
-    extern mico_bt_cfg_settings_t mico_bt_cfg_settings;
-    return (const char *)mico_bt_cfg_settings.device_name;
+    if (!stats) {
+        return MICO_BT_BADARG;
+    }
+    memcpy(stats, &g_ble_context.m_tx_stats, sizeof(mico_ble_tx_stats_t));
+    return MICO_BT_SUCCESS;
 }
 
 /**
- * Set passkey for BT Security process.
+ * Select how inbound SPP data is delivered. Data not consumed yet is discarded.
  *
- * @param key
- *      a c-style string of the passkey.
+ * @param mode
+ *          BLE_RX_MODE_EVENT or BLE_RX_MODE_STREAM.
  *
  * @return
  *      MICO_BT_SUCCESS if successfully.
  */
-mico_bt_result_t mico_ble_set_device_whitelist_name(const char *name)
+mico_bt_result_t mico_ble_set_rx_mode(mico_ble_rx_mode_t mode)
 {
-    mico_bt_result_t ret = MICO_BT_BADARG;
+    mico_ble_ring_t *ring = &g_ble_context.m_rx_ring;
 
-    if (name) {
-        if (!g_ble_context.m_wl_name) {
-            g_ble_context.m_wl_name = (char *)malloc(31);
-            require_action(g_ble_context.m_wl_name, exit, ret = MICO_BT_NO_RESOURCES);
-        }
-        memset(g_ble_context.m_wl_name, 0, 31);
-        strcpy(g_ble_context.m_wl_name, name);
-        ret = MICO_BT_SUCCESS;
+    if (mode != BLE_RX_MODE_EVENT && mode != BLE_RX_MODE_STREAM) {
+        return MICO_BT_BADARG;
     }
 
-exit:
-    return ret;
+    mico_rtos_lock_mutex(&ring->m_mutex);
+    if (mode != g_ble_context.m_rx_mode) {
+        g_ble_context.m_rx_mode = mode;
+        /* Only the tail moves, so the BT stack may keep writing meanwhile. */
+        if (ring->m_busy) {
+            /* Called back with a record in use, ble_post_rx_evt_handler() moves it on return */
+            ring->m_reset = MICO_TRUE;
+            ring->m_reset_tail = ring->m_head;
+        } else {
+            ring->m_tail = ring->m_head;
+        }
+    }
+    mico_rtos_unlock_mutex(&ring->m_mutex);
+    return MICO_BT_SUCCESS;
 }
 
 /**
- * Get passkey for BT Security process.
+ * Get how inbound SPP data is delivered.
  *
  * @return
- *  A c-style string of local device passkey.
+ *      The current mode.
  */
-const char *mico_ble_get_device_whitelist_name(void)
+mico_ble_rx_mode_t mico_ble_get_rx_mode(void)
 {
-    return (const char *)g_ble_context.m_wl_name;
+    return g_ble_context.m_rx_mode;
 }
 
 /**
- * Set passkey for BT Security process.
+ * Read inbound SPP data in BLE_RX_MODE_STREAM. Only one thread may read.
  *
- * @param key
- *      a c-style string of the passkey.
+ * @param buf
+ *          Destination buffer.
+ *
+ * @param length
+ *          Size of the buffer.
+ *
+ * @param timeout_ms
+ *          The longest time to wait when no data is available.
  *
  * @return
- *      MICO_BT_SUCCESS if successfully.
+ *      The number of bytes read, 0 on timeout.
  */
-// mico_bt_result_t mico_ble_set_device_whitelist_uuid(const mico_bt_uuid_t *uuid)
-// {
-//     mico_bt_result_t ret = MICO_BT_BADARG;
+uint32_t mico_ble_read(uint8_t *buf, uint32_t length, uint32_t timeout_ms)
+{
+    mico_ble_ring_t *ring = &g_ble_context.m_rx_ring;
+    uint32_t start = mico_rtos_get_time();
+    uint32_t elapsed;
+    uint32_t n = 0;
+
+    if (!buf || length == 0 || !ring->m_buf) {
+        return 0;
+    }
 
-//     if (uuid && mico_ble_check_uuid(uuid)) {
-//         if (!g_ble_context.m_wl_serv_uuid) {
-//             g_ble_context.m_wl_serv_uuid = (mico_bt_uuid_t *)malloc(sizeof(mico_bt_uuid_t));
-//             require_action(g_ble_context.m_wl_serv_uuid, exit, ret = MICO_BT_NO_RESOURCES);
-//         }
-//         memset(g_ble_context.m_wl_serv_uuid, 0, sizeof(mico_bt_uuid_t));
-//         memcpy(g_ble_context.m_wl_serv_uuid, uuid, sizeof(mico_bt_uuid_t));
-//     } 
+    for (;;) {
+        mico_rtos_lock_mutex(&ring->m_mutex);
+        /* Nothing to read before the tail is released by a pending mode switch */
+        if (g_ble_context.m_rx_mode == BLE_RX_MODE_STREAM && !ring->m_reset) {
+            n = mico_ble_ring_read(ring, buf, length);
+        }
+        mico_rtos_unlock_mutex(&ring->m_mutex);
+        if (n > 0 || g_ble_context.m_rx_mode != BLE_RX_MODE_STREAM) {
+            break;
+        }
 
-// exit:
-//     return ret;
-// }
+        elapsed = mico_rtos_get_time() - start;
+        if (elapsed >= timeout_ms) {
+            break;
+        }
+        mico_rtos_get_semaphore(&ring->m_sem, timeout_ms - elapsed);
+    }
+    return n;
+}
 
 /**
- * Get passkey for BT Security process.
+ * Enable or disable the length-prefixed framing on the SPP data channel.
+ *
+ * @param enable
+ *          MICO_TRUE to enable.
  *
  * @return
- *  A c-style string of local device passkey.
+ *      MICO_BT_SUCCESS if successfully.
+ *      MICO_BT_NO_RESOURCES -- No resource for the reassembly pool.
  */
-// const mico_bt_uuid_t *mico_ble_get_device_whitelist_uuid(void)
-// {
-//     return (const mico_bt_uuid_t *)g_ble_context.m_wl_serv_uuid;
-// }
+mico_bt_result_t mico_ble_set_framing(mico_bool_t enable)
+{
+    if (enable && mico_ble_pool_init(&g_ble_context.m_frame_pool,
+                                     BLE_FRAME_POOL_BLOCK_SIZE,
+                                     BLE_FRAME_POOL_BLOCK_COUNT) != kNoErr) {
+        return MICO_BT_NO_RESOURCES;
+    }
+
+    mico_ble_frame_reset();
+    g_ble_context.m_is_framing = enable;
+    return MICO_BT_SUCCESS;
+}
 
 /**
+ * Get whether the length-prefixed framing is enabled.
  *
- * @param start
  * @return
+ *      MICO_TRUE if enabled.
  */
-static mico_bt_result_t mico_ble_set_device_scan(mico_bool_t start)
+mico_bool_t mico_ble_get_framing(void)
 {
-    OSStatus err;
-    if (start) {
-        err = mico_bt_smartbridge_start_scan(&g_central_scan_settings,
-                                             mico_ble_central_scan_complete_handler,
-                                             mico_ble_central_scan_result_handler);
-    } else {
-        err = mico_bt_smartbridge_stop_scan();
-    }
-    return (mico_bt_result_t)err;
+    return g_ble_context.m_is_framing;
 }
 
-mico_bt_result_t mico_ble_start_device_scan(void)
+/**
+ * Enable or disable compression on the framed SPP data channel.
+ *
+ * @param enable
+ *          MICO_TRUE to enable.
+ *
+ * @return
+ *      MICO_BT_SUCCESS if successfully.
+ *      MICO_BT_BADOPTION -- Enabling while framing is disabled.
+ */
+mico_bt_result_t mico_ble_set_compression(mico_bool_t enable)
 {
-    if (SM_InState(&g_ble_context.m_sm, BLE_STATE_IDLE)
-        || SM_InState(&g_ble_context.m_sm, BLE_STATE_PERIPHERAL_ADVERTISING)) {
+    if (enable && !g_ble_context.m_is_framing) {
+        return MICO_BT_BADOPTION;
+    }
 
-        mico_ble_set_device_discovery(MICO_FALSE);
+    g_ble_context.m_is_compress = enable;
 
-        mico_bt_result_t ret = mico_ble_set_device_scan(MICO_TRUE);
-        if (ret == MICO_BT_PENDING) {
-            SM_Handle(&g_ble_context.m_sm, BLE_SM_EVT_CENTRAL_LESCAN_CMD);
-            ret = MICO_BT_SUCCESS;
-        } else {
-            mico_ble_set_device_discovery(MICO_TRUE);
-        }
-        return ret;
+    /* Let the peer know if a connection is already up. */
+    g_ble_context.m_caps_sent = MICO_FALSE;
+    if (g_ble_context.m_spp_owner != BLE_SPP_OWNER_NONE) {
+        mico_ble_caps_exchange();
     }
-    return MICO_BT_BADOPTION;
+    return MICO_BT_SUCCESS;
 }
 
 /**
- * Start or stop a device discoverable procedure.
+ * Get the compression state.
  *
- * @param start
- *      A boolean value of start or stop.
+ * @param active
+ *          Set to MICO_TRUE if both sides agreed on compression. Could be NULL.
  *
  * @return
- *      MICO_BT_SUCCESS if succesfully.
+ *      MICO_TRUE if compression is enabled locally.
  */
-static mico_bt_result_t mico_ble_set_device_discovery(mico_bool_t start)
+mico_bool_t mico_ble_get_compression(mico_bool_t *active)
 {
-    OSStatus err;
-    if (start) {
-        err = mico_bt_peripheral_start_advertisements((mico_bt_smart_advertising_settings_t *)&g_peripheral_advertising_settings,
-                                                      mico_ble_peripheral_advertisement_complete_handler);
-    } else {
-        err = mico_bt_peripheral_stop_advertisements();
+    if (active) {
+        *active = mico_ble_compress_is_active();
     }
-    return (mico_bt_result_t)err;
+    return g_ble_context.m_is_compress;
 }
 
-mico_bt_result_t mico_ble_start_device_discovery(void)
+/**
+ * Select the connection parameter profile.
+ *
+ * @param profile
+ *          The profile to use, or to fall back to in automatic mode.
+ *
+ * @param is_auto
+ *          MICO_TRUE to switch profiles automatically.
+ *
+ * @return
+ *      MICO_BT_SUCCESS if successfully.
+ *      MICO_BT_BADARG -- Unknown profile.
+ *      MICO_BT_ERROR -- The update request was rejected by the stack.
+ */
+mico_bt_result_t mico_ble_set_conn_profile(mico_ble_conn_profile_t profile, mico_bool_t is_auto)
 {
-    if (SM_InState(&g_ble_context.m_sm, BLE_STATE_IDLE)
-        || SM_InState(&g_ble_context.m_sm, BLE_STATE_CENTRAL_SCANNING)) {
+    if (profile >= BLE_CONN_PROFILE_MAX) {
+        return MICO_BT_BADARG;
+    }
 
-        /* Stop scanning */
-        if (mico_bt_smartbridge_is_scanning()) {
-            mico_bt_smartbridge_stop_scan();
-        }
+    g_ble_context.m_conn_profile = profile;
+    g_ble_context.m_conn_auto = is_auto;
+    if (!is_auto) {
+        mico_rtos_stop_timer(&g_ble_context.m_conn_idle_timer);
+    }
 
-        mico_bt_result_t ret = mico_ble_set_device_discovery(MICO_TRUE);
-        if (ret == MICO_BT_SUCCESS) {
-            SM_Handle(&g_ble_context.m_sm, BLE_SM_EVT_PERIPHERAL_LEADV_CMD);
-        } else {
-            mico_ble_set_device_scan(MICO_TRUE);
-        }
-        return ret;
+    if (g_ble_context.m_conn_profile_active == profile) {
+        return MICO_BT_SUCCESS;
     }
-    return MICO_BT_BADOPTION;
+    return mico_ble_conn_profile_apply(profile);
 }
 
 /**
+ * Get the connection parameter profile.
+ *
+ * @param is_auto
+ *          Set to MICO_TRUE if profiles are switched automatically. Could be NULL.
+ *
+ * @param active
+ *          Set to the profile last requested on the current link. Could be NULL.
  *
- * @param bdaddr
  * @return
+ *      The profile selected by mico_ble_set_conn_profile().
  */
-mico_bt_result_t mico_ble_connect(mico_bt_device_address_t bdaddr)
+mico_ble_conn_profile_t mico_ble_get_conn_profile(mico_bool_t *is_auto, mico_ble_conn_profile_t *active)
 {
-    mico_bt_result_t ret = MICO_BT_BADOPTION;
-    mico_bt_smartbridge_socket_status_t status;
-    mico_bt_smart_device_t *remote_device = NULL;
-
-    if (SM_InState(&g_ble_context.m_sm, BLE_STATE_IDLE)) {
-        mico_bt_smartbridge_get_socket_status(&g_ble_context.m_central_socket, &status);
-        if (status == SMARTBRIDGE_SOCKET_DISCONNECTED) {
-            /* Construct mico_bt_smart_device_t */
-            remote_device = (mico_bt_smart_device_t *)malloc(sizeof(mico_bt_smart_device_t));
-            require_action_string(remote_device != NULL, exit, ret = MICO_BT_NO_RESOURCES, "Malloc failed");
-            memcpy(remote_device->address, bdaddr, 6);
-            remote_device->address_type = BT_SMART_ADDR_TYPE_PUBLIC;
-            /* Connecting... */
-            ret = (mico_bt_result_t)mico_rtos_send_asynchronous_event(&g_ble_context.m_worker_thread,
-                                                                      mico_ble_central_connect_handler,
-                                                                      remote_device);
-            require_noerr_string(ret, exit, "Send asynchronous event failed");
-            /* Handle Event */
-            SM_Handle(&g_ble_context.m_sm, BLE_SM_EVT_CENTRAL_LECONN_CMD);
-        } 
+    if (is_auto) {
+        *is_auto = g_ble_context.m_conn_auto;
     }
-
-exit:
-    if (ret != MICO_BT_SUCCESS && remote_device) {
-        free(remote_device);
+    if (active) {
+        *active = g_ble_context.m_conn_profile_active;
     }
-    return ret;
+    return g_ble_context.m_conn_profile;
 }
 
 /**
+ * Enable or disable reliable notifications on the framed SPP data channel.
+ *
+ * @param enable
+ *          MICO_TRUE to enable.
  *
- * @param connect_handle
  * @return
+ *      MICO_BT_SUCCESS if successfully.
+ *      MICO_BT_NO_RESOURCES -- No resource for the retransmission window.
  */
-mico_bt_result_t mico_ble_disconnect(uint16_t connect_handle)
+mico_bt_result_t mico_ble_set_reliable(mico_bool_t enable)
 {
-    mico_bt_result_t ret = MICO_BT_BADOPTION;
-
-    UNUSED_PARAMETER(connect_handle);
+    OSStatus err = kNoErr;
+    mico_ble_rel_t *rel = &g_ble_context.m_rel;
 
-    if (SM_InState(&g_ble_context.m_sm, BLE_STATE_PERIPHERAL_CONNECTED)) {
-        ret = (mico_bt_result_t)mico_bt_peripheral_disconnect();
-        if (ret == MICO_BT_SUCCESS) {
-            SM_Handle(&g_ble_context.m_sm, BLE_SM_EVT_PERIPHERAL_DISCONNECTED);
-        }
+    if (enable && !rel->m_slots) {
+        err = mico_rtos_init_mutex(&rel->m_mutex);
+        require_noerr(err, exit);
+        err = mico_rtos_init_timer(&rel->m_rtx_timer, BLE_REL_RTO_MS, mico_ble_rel_rtx_timeout, NULL);
+        require_noerr(err, exit);
+        err = mico_rtos_init_timer(&rel->m_ack_timer, BLE_REL_ACK_DELAY_MS, mico_ble_rel_ack_timeout, NULL);
+        require_noerr(err, exit);
+        rel->m_slots = (mico_ble_rel_slot_t *)calloc(BLE_REL_WINDOW, sizeof(mico_ble_rel_slot_t));
+        require_action(rel->m_slots, exit, err = kNoMemoryErr);
     }
 
-    if (SM_InState(&g_ble_context.m_sm, BLE_STATE_CENTRAL_CONNECTED)) {
-        ret = (mico_bt_result_t)mico_bt_smartbridge_disconnect(&g_ble_context.m_central_socket,
-                                                               MICO_FALSE);
-        if (ret == MICO_BT_SUCCESS) {
-            SM_Handle(&g_ble_context.m_sm, BLE_SM_EVT_CENTRAL_DISCONNECTED);
-        }
+    mico_rtos_lock_mutex(&g_ble_context.m_tx_mutex);
+    mico_ble_rel_reset();
+    g_ble_context.m_is_reliable = enable;
+    mico_rtos_unlock_mutex(&g_ble_context.m_tx_mutex);
+
+    /* Let the peer know if a connection is already up. */
+    g_ble_context.m_caps_sent = MICO_FALSE;
+    if (g_ble_context.m_spp_owner != BLE_SPP_OWNER_NONE) {
+        mico_ble_caps_exchange();
     }
 
-    return ret;
+exit:
+    return err == kNoErr ? MICO_BT_SUCCESS : MICO_BT_NO_RESOURCES;
 }
 
 /**
- * Get local BT RF State.
+ * Get the reliable notification state.
+ *
+ * @param active
+ *          Set to MICO_TRUE if both sides agreed on reliable notifications. Could be NULL.
  *
  * @return
- *      a value of local BT RF State. See details @mico_ble_state_t
+ *      MICO_TRUE if reliable notifications are enabled locally.
  */
-mico_ble_state_t mico_ble_get_device_state(void)
+mico_bool_t mico_ble_get_reliable(mico_bool_t *active)
 {
-    return (mico_ble_state_t)SM_GetState(&g_ble_context.m_sm);
+    if (active) {
+        *active = g_ble_context.m_rel.m_active;
+    }
+    return g_ble_context.m_is_reliable;
 }
 
 /**
- * Send a packet synchronously over BT RFCOMM Channel.
+ * Select the transport of the SPP data channel.
  *
- * @param p_data
- *          A pointer of packet.
+ * @param transport
+ *          BLE_TRANSPORT_GATT or BLE_TRANSPORT_L2CAP_COC.
  *
- * @param length
- *          the size of packet.
+ * @return
+ *      MICO_BT_SUCCESS if successfully.
+ *      MICO_BT_BADARG -- Unknown transport.
+ */
+mico_bt_result_t mico_ble_set_transport(mico_ble_transport_t transport)
+{
+    if (transport != BLE_TRANSPORT_GATT && transport != BLE_TRANSPORT_L2CAP_COC) {
+        return MICO_BT_BADARG;
+    }
+    g_ble_context.m_transport = transport;
+    return MICO_BT_SUCCESS;
+}
+
+/**
+ * Get the transport of the SPP data channel.
  *
- * @param timeout_ms
- *          Timeout of synchronously.
+ * @param is_open
+ *          Set to MICO_TRUE if an L2CAP channel is open. Could be NULL.
  *
  * @return
- *      MICO_BT_SUCCESS  -- sending completily.
- *      MICO_BT_NO_RESOURCES -- No resource for malloc()
- *      MICO_BT_ILLEGAL_ACTION -- Illegal action (RFCOMM Channel is not opened).
- *      MICO_BT_TIMEOUT -- Timeout
+ *      The transport selected by mico_ble_set_transport().
  */
-mico_bt_result_t mico_ble_send_data(const uint8_t *p_data, uint32_t length, uint32_t timeout_ms)
+mico_ble_transport_t mico_ble_get_transport(mico_bool_t *is_open)
 {
-    OSStatus err = kParamErr;
-    mico_bt_smart_attribute_t *characteristic_value = NULL;
+    if (is_open) {
+        *is_open = g_ble_context.m_coc_cid != 0 ? MICO_TRUE : MICO_FALSE;
+    }
+    return g_ble_context.m_transport;
+}
 
-    UNUSED_PARAMETER(timeout_ms);
+/* Handle an event for POST EVENT To User Layer. */
+static OSStatus ble_post_evt_handler(void *arg)
+{
+    mico_ble_evt_msg_t *msg = (mico_ble_evt_msg_t *)arg;
 
-    require(p_data != NULL && length > 0 && length < (uint16_t)-1, exit);
+    if (g_ble_context.m_cback) {
+        g_ble_context.m_cback(msg->evt, &msg->params);
+    }
 
-    if (SM_InState(&g_ble_context.m_sm, BLE_STATE_CENTRAL_CONNECTED)) {
-        err = mico_bt_smart_attribute_create(&characteristic_value, MICO_ATTRIBUTE_TYPE_CHARACTERISTIC_VALUE, (uint16_t)length);
-        require_noerr(err, exit);
-        err = mico_bt_smartbridge_get_attribute_cache_by_handle(&g_ble_context.m_central_socket, 
-                                                                 g_ble_context.m_central_attr_handle, 
-                                                                 characteristic_value, 
-                                                                 ATTR_CHARACTERISTIC_VALUE_SIZE(20));
-        require_noerr_action(err, exit, mico_bt_smart_attribute_delete(characteristic_value));
-
-        const uint32_t attr_cap_size = characteristic_value->value_length;
-        uint32_t actual_len = 0;
-
-        while (length > 0 && err == kNoErr) {
-            actual_len = MIN(attr_cap_size, length);
-            memcpy(characteristic_value->value.value, p_data, actual_len);
-            characteristic_value->value_length = actual_len;
-            err = (mico_bt_result_t)mico_bt_smartbridge_write_attribute_cache_characteristic_value(&g_ble_context.m_central_socket, 
-                                                                                                    characteristic_value);
-            p_data += actual_len;
-            length -= actual_len;
-        }
-        mico_bt_smart_attribute_delete(characteristic_value);
-    } else if (SM_InState(&g_ble_context.m_sm, BLE_STATE_PERIPHERAL_CONNECTED)) {
-        err = mico_bt_peripheral_ext_attribute_value_write(g_ble_context.m_spp_out_attribute, (uint16_t)length, 0, p_data);
-        require_noerr(err, exit);
-        if (g_ble_context.m_spp_out_cccd_value & GATT_CLIENT_CONFIG_NOTIFICATION) {
-            err = mico_bt_peripheral_gatt_notify_attribute_value(&g_ble_context.m_peripheral_socket,
-                                                                 g_ble_context.m_spp_out_attribute);
-        } else if (g_ble_context.m_spp_out_cccd_value & GATT_CLIENT_CONFIG_INDICATION) {
-            err = mico_bt_peripheral_gatt_indicate_attribute_value(&g_ble_context.m_peripheral_socket,
-                                                                   g_ble_context.m_spp_out_attribute);
-        } else {
-            err = MICO_BT_BADOPTION;
-        }
+    if (msg->pool) {
+        mico_ble_pool_free(msg->pool, msg->evt == BLE_EVT_DATA ? msg->params.u.data.p_data
+                                                               : (uint8_t *)msg->params.u.report.p_adv_data);
     }
+    free(msg);
 
-exit:
-    return (mico_bt_result_t)err;
+    return kNoErr;
 }
 
-/* Handle an event for POST EVENT To User Layer. */
-static OSStatus ble_post_evt_handler(void *arg)
+/* Handle a BLE_EVT_DATA whose data is a record in the RX ring, arg is its offset. */
+static OSStatus ble_post_rx_evt_handler(void *arg)
 {
-    mico_ble_event_t evt;
-    mico_ble_evt_params_t *parms =
-        (mico_ble_evt_params_t *)((uint8_t *)arg + sizeof(mico_ble_event_t));
+    mico_ble_ring_t *ring = &g_ble_context.m_rx_ring;
+    uint32_t offset = (uint32_t)(uintptr_t)arg;
+    uint8_t *rec = ring->m_buf + (offset & (ring->m_size - 1));
+    mico_ble_evt_params_t params;
 
-    memcpy(&evt, arg, sizeof(mico_ble_event_t));
-    
-    if (g_ble_context.m_cback) {
-        g_ble_context.m_cback(evt, parms);
+    mico_rtos_lock_mutex(&ring->m_mutex);
+
+    /* Discarded by mico_ble_set_rx_mode() while the event was queued */
+    if (g_ble_context.m_rx_mode != BLE_RX_MODE_EVENT || (int32_t)(offset - ring->m_tail) < 0) {
+        mico_rtos_unlock_mutex(&ring->m_mutex);
+        return kNoErr;
     }
 
-    if (evt == BLE_EVT_DATA) {
-        free(parms->u.data.p_data);
+    memset(&params, 0, sizeof(params));
+    params.u.data.length = (uint16_t)(rec[0] | (rec[1] << 8));
+    params.u.data.handle = (uint16_t)(rec[2] | (rec[3] << 8));
+    params.u.data.p_data = rec + BLE_RX_RING_REC_HDR_SIZE;
+    ring->m_busy = MICO_TRUE;
+    mico_rtos_unlock_mutex(&ring->m_mutex);
+
+    /* Unlocked, the callback may switch the mode or read */
+    if (g_ble_context.m_cback) {
+        g_ble_context.m_cback(BLE_EVT_DATA, &params);
     }
-    free(arg);
 
+    mico_rtos_lock_mutex(&ring->m_mutex);
+    ring->m_busy = MICO_FALSE;
+    if (ring->m_reset) {
+        ring->m_reset = MICO_FALSE;
+        ring->m_tail = ring->m_reset_tail;
+        /* Wake mico_ble_read() for what came in after the switch */
+        if (ring->m_tail != ring->m_head) {
+            mico_rtos_set_semaphore(&ring->m_sem);
+        }
+    } else {
+        /* Records are released in order, this also releases the skipped end of the ring. */
+        ring->m_tail = offset + BLE_RX_RING_REC_HDR_SIZE + params.u.data.length;
+    }
+    mico_rtos_unlock_mutex(&ring->m_mutex);
     return kNoErr;
 }
 
+/* Package an event and post it to user layer, data buffer (if any) is owned by the event. */
+static mico_bool_t mico_ble_post_evt_msg(mico_ble_event_t evt, mico_ble_evt_params_t *parms, mico_ble_pool_t *pool)
+{
+    mico_ble_evt_msg_t *msg = (mico_ble_evt_msg_t *)malloc(sizeof(mico_ble_evt_msg_t));
+
+    if (!msg) {
+        mico_ble_log("%s: malloc failed", __FUNCTION__);
+        return MICO_FALSE;
+    }
+
+    msg->evt = evt;
+    msg->pool = pool;
+    if (parms) {
+        memcpy(&msg->params, parms, sizeof(mico_ble_evt_params_t));
+    } else {
+        memset(&msg->params, 0, sizeof(mico_ble_evt_params_t));
+    }
+
+    if (kNoErr != mico_ble_worker_send(BLE_WORKER_EVENT,
+                                       ble_post_evt_handler, 
+                                       msg)) {
+        mico_ble_log("%s: send asyn event failed", __FUNCTION__);
+        free(msg);
+        return MICO_FALSE;
+    }
+    return MICO_TRUE;
+}
+
 /* Post event to user layer. */
 static mico_bool_t mico_ble_post_evt(mico_ble_event_t evt, mico_ble_evt_params_t *parms)
 {
-    uint8_t                     *arg = NULL;
-    mico_ble_evt_params_t       *p = NULL;
-    
-    if (g_ble_context.m_cback) {
+    if (!g_ble_context.m_cback) {
+        return MICO_TRUE;
+    }
 
-        /* Package an event parameters packet. */
-        arg = malloc(sizeof(mico_ble_event_t) + sizeof(mico_ble_evt_params_t));
-        if (!arg) {
-            mico_ble_log("%s: malloc failed", __FUNCTION__);
-            return MICO_FALSE;
-        }
-        memcpy(arg, &evt, sizeof(mico_ble_event_t));
-        if (parms) {
-            memcpy(arg + sizeof(mico_ble_event_t), parms, sizeof(mico_ble_evt_params_t));
-        } else {
-            memset(arg + sizeof(mico_ble_event_t), 0, sizeof(mico_ble_evt_params_t));
-        }
+    return mico_ble_post_evt_msg(evt, parms, NULL);
+}
 
-        /* Otherwise */
-        if (evt == BLE_EVT_DATA && parms) {
-            p = (mico_ble_evt_params_t *)(arg + sizeof(mico_ble_event_t));
-            p->u.data.p_data = malloc(parms->u.data.length);
-            if (!p->u.data.p_data) {
-                mico_ble_log("%s: malloc failed", __FUNCTION__);
-                free(arg);
-                return MICO_FALSE;
-            }
-            memcpy(p->u.data.p_data, parms->u.data.p_data, parms->u.data.length);
-        } 
-
-        /* Post */
-        if (kNoErr != mico_rtos_send_asynchronous_event(&g_ble_context.m_evt_worker_thread,
-                                                        ble_post_evt_handler, 
-                                                        arg)) {
-            mico_ble_log("%s: send asyn event failed", __FUNCTION__);
-            if (p) free(p->u.data.p_data);
-            free(arg);
-            return MICO_FALSE;
-        }
+/*
+ * Post a BLE_EVT_DATA from the BT stack callback. The data is copied into the
+ * RX ring and only its offset travels with the event, so nothing is allocated.
+ */
+static mico_bool_t mico_ble_post_rx_evt(uint16_t handle, const uint8_t *p_data, uint16_t length)
+{
+    mico_ble_ring_t *ring = &g_ble_context.m_rx_ring;
+    uint32_t head = ring->m_head;
+    uint32_t offset;
+
+    if (!g_ble_context.m_cback) {
+        return MICO_TRUE;
+    }
+
+    if (!mico_ble_ring_put_record(ring, handle, p_data, length, &offset)) {
+        ring->m_dropped += length;
+        mico_ble_log("RX ring full, %u bytes dropped", length);
+        return MICO_FALSE;
     }
 
+    if (kNoErr != mico_ble_worker_send(BLE_WORKER_EVENT,
+                                       ble_post_rx_evt_handler,
+                                       (void *)(uintptr_t)offset)) {
+        mico_ble_log("%s: send asyn event failed", __FUNCTION__);
+        /* Not seen by the consumer yet, take it back unless a mode switch released it already. */
+        if ((int32_t)(ring->m_tail - head) <= 0) {
+            ring->m_head = head;
+        }
+        return MICO_FALSE;
+    }
     return MICO_TRUE;
 }
 
+/* Post a BLE_EVT_DATA whose buffer is a pool block, no copy is made. */
+static mico_bool_t mico_ble_post_data_evt(uint8_t *p_data, uint16_t length, mico_ble_pool_t *pool)
+{
+    mico_ble_evt_params_t params;
+
+    /* Stream mode: the message is copied into the RX ring, the caller keeps the block. */
+    if (g_ble_context.m_rx_mode == BLE_RX_MODE_STREAM) {
+        mico_ble_rx_stream_put(p_data, length);
+        return MICO_FALSE;
+    }
+
+    if (!g_ble_context.m_cback) {
+        return MICO_FALSE;
+    }
+
+    memset(&params, 0, sizeof(params));
+    params.u.data.p_data = p_data;
+    params.u.data.length = length;
+    params.u.data.handle = mico_ble_spp_handle();
+    return mico_ble_post_evt_msg(BLE_EVT_DATA, &params, pool);
+}
+
 uint8_t *bdaddr_aton(const char *addr, uint8_t *out_addr)
 {
     uint8_t val = 0, i = BD_ADDR_LEN;
@@ -1229,21 +6433,21 @@ char *bdaddr_ntoa(const uint8_t *addr, char *addr_str)
  *      MICO_FALSE -- invalid
  *      MICO_TRUE  -- valid 
  */
-// static mico_bool_t mico_ble_check_uuid(const mico_bt_uuid_t *uuid)
-// {
-//     if (!uuid) {
-//         return MICO_FALSE;
-//     }
-
-//     if (uuid->len == LEN_UUID_16) {
-//         return (uuid->uu.uuid16 > (uint16_t)0 && uuid->uu.uuid16 < (uint16_t)(-1));
-//     } else if (uuid->len == LEN_UUID_32) {
-//         return (uuid->uu.uuid32 > (uint32_t)0 && uuid->uu.uuid32 < (uint32_t)(-1));
-//     } else if (uuid->len == LEN_UUID_128) {
-//         const uint8_t *p = uuid->uu.uuid128;
-//         while (p < &uuid->uu.uuid128[LEN_UUID_128] && *p++ == 0);
-//         return (p != &uuid->uu.uuid128[LEN_UUID_128]);
-//     } else {
-//         return MICO_FALSE;
-//     }
-// }
+static mico_bool_t mico_ble_check_uuid(const mico_bt_uuid_t *uuid)
+{
+    if (!uuid) {
+        return MICO_FALSE;
+    }
+
+    if (uuid->len == LEN_UUID_16) {
+        return (uuid->uu.uuid16 > (uint16_t)0 && uuid->uu.uuid16 < (uint16_t)(-1));
+    } else if (uuid->len == LEN_UUID_32) {
+        return (uuid->uu.uuid32 > (uint32_t)0 && uuid->uu.uuid32 < (uint32_t)(-1));
+    } else if (uuid->len == LEN_UUID_128) {
+        const uint8_t *p = uuid->uu.uuid128;
+        while (p < &uuid->uu.uuid128[LEN_UUID_128] && *p++ == 0);
+        return (p != &uuid->uu.uuid128[LEN_UUID_128]);
+    } else {
+        return MICO_FALSE;
+    }
+}
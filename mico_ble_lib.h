@@ -61,6 +61,15 @@ extern "C" {
 #define BLE_STATE_IDLE					 6
 typedef uint8_t mico_ble_state_t;
 
+/* The peripheral and the central roles run concurrently, see mico_ble_get_role_state() */
+typedef enum {
+    BLE_ROLE_PERIPHERAL,
+    BLE_ROLE_CENTRAL,
+} mico_ble_role_t;
+
+/* Central links connected at once, see mico_ble_connect() */
+#define BLE_CENTRAL_LINK_MAX    4
+
 /* Bluetooth event type */
 typedef enum {
     BLE_EVT_INIT,
@@ -75,6 +84,8 @@ typedef enum {
     BLE_EVT_CENTRAL_CONNECTING,
     BLE_EVT_CENTRAL_CONNECTED,
     BLE_EVT_CENTRAL_DISCONNECTED,
+    BLE_EVT_GATT_CACHE_CHANGED,         /* save mico_ble_get_gatt_cache() to keep it across reboots */
+    BLE_EVT_LAST_PEER_CHANGED,          /* save mico_ble_get_last_peer() to reconnect after a reboot */
 } mico_ble_event_t;
 
 /* Bluetooth event callback parameters. */
@@ -104,19 +115,202 @@ typedef struct {
         struct {
             uint8_t *p_data;
             uint16_t length;
+            uint16_t handle;                /* connection the data came from */
         } data;
 
         /* valid if BLE_EVT_CENTRAL_REPORT */
         struct { 
             char   name[31];
             int8_t rssi;
+            uint8_t addr_type;              /* mico_bt_smart_address_type_t */
+            uint8_t adv_type;               /* mico_bt_smart_advertising_event_t */
+            const uint8_t *p_adv_data;      /* raw AD structures, see mico_ble_set_raw_report() */
+            uint8_t adv_data_length;
         } report;
     } u;
 } mico_ble_evt_params_t;
 
+/* A fragment of an outgoing packet, see mico_ble_send_datav() */
+typedef struct {
+    const uint8_t *p_data;
+    uint32_t       length;
+} mico_ble_iovec_t;
+
+/* TX throughput statistics of a connection */
+typedef struct {
+    uint16_t handle;        /* connection handle */
+    uint32_t bytes;         /* payload bytes accepted by the stack */
+    uint32_t packets;       /* notifications/indications sent */
+    uint32_t retries;       /* chunks re-tried because the controller had no free buffer */
+    uint32_t retransmits;   /* fragments sent again because the peer did not acknowledge them */
+    uint32_t elapsed_ms;    /* time spent in transmitting */
+    uint32_t bytes_per_sec; /* achieved throughput */
+} mico_ble_tx_stats_t;
+
+/* Connection parameter profiles, see mico_ble_set_conn_profile() */
+typedef enum {
+    BLE_CONN_PROFILE_DEFAULT,       /* MICO_BT_CFG_DEFAULT_CONN_* parameters */
+    BLE_CONN_PROFILE_THROUGHPUT,    /* short interval and long connection event, for bulk transfer */
+    BLE_CONN_PROFILE_IDLE,          /* long interval with slave latency, for low power */
+    BLE_CONN_PROFILE_MAX,
+} mico_ble_conn_profile_t;
+
+/* Transport of the SPP data channel, see mico_ble_set_transport() */
+typedef enum {
+    BLE_TRANSPORT_GATT,             /* SPP IN/OUT characteristics */
+    BLE_TRANSPORT_L2CAP_COC,        /* LE credit based L2CAP channel */
+} mico_ble_transport_t;
+
+/* Scan engine configuration, see mico_ble_set_scan_config() */
+typedef struct {
+    mico_bool_t is_active;              /* send scan requests to get scan responses */
+    uint16_t    interval;               /* 0.625 ms, 4 ~ 16384 */
+    uint16_t    window;                 /* 0.625 ms, 4 ~ interval */
+    uint16_t    duration_second;        /* length of one scan, 0 to scan continuously */
+    uint8_t     duty_percent;           /* continuous scan: share of each period spent scanning, 1 ~ 100 */
+    uint16_t    duty_period_second;     /* continuous scan: length of a duty cycle, 0 for no rest */
+} mico_ble_scan_config_t;
+
+/* Advertising data filter of scan results, see mico_ble_set_ad_filter() */
+#define BLE_AD_FILTER_DATA_MAX  8
+typedef struct {
+    mico_bt_uuid_t service_uuid;                    /* 16, 32 or 128-bit service UUID, len 0 for any */
+    mico_bool_t    match_company;                   /* require manufacturer specific data of company_id */
+    uint16_t       company_id;
+    uint8_t        data_length;                     /* manufacturer data bytes after the company ID to compare */
+    uint8_t        data[BLE_AD_FILTER_DATA_MAX];
+    uint8_t        mask[BLE_AD_FILTER_DATA_MAX];    /* bits of data to compare */
+} mico_ble_ad_filter_t;
+
+/* Ranking of the nearby device table, see mico_ble_set_nearby_order() */
+typedef enum {
+    BLE_NEARBY_BY_RSSI,             /* strongest smoothed RSSI first */
+    BLE_NEARBY_BY_RECENT,           /* most recently seen first */
+} mico_ble_nearby_order_t;
+
+/* A device in the nearby device table, see mico_ble_get_nearby() */
+#define BLE_NEARBY_MAX          16
+typedef struct {
+    mico_bt_device_address_t bd_addr;
+    char     name[31];
+    int8_t   rssi;                  /* smoothed */
+    uint32_t age_ms;                /* since its last advertisement */
+} mico_ble_nearby_t;
+
+/* Known peers mirrored into the controller filter accept list, bounded by the controller too */
+#define BLE_ACCEPT_LIST_MAX     8
+
+/* GATT handles of a known peer, see mico_ble_set_gatt_cache() */
+#define BLE_GATT_CACHE_MAX      4
+typedef struct {
+    mico_bt_device_address_t bd_addr;
+    uint16_t    start_handle;                   /* range of the SPP service */
+    uint16_t    end_handle;
+    uint16_t    in_handle;                      /* value handle of SPP IN */
+    uint16_t    notify_handle;                  /* value handle of the notify characteristic, 0 if none */
+    uint8_t     notify_properties;
+} mico_ble_gatt_cache_entry_t;
+
+/* Use of the GATT cache, see mico_ble_get_gatt_cache_stats() */
+typedef struct {
+    uint8_t  entries;
+    uint32_t hits;                  /* connections set up from a cache entry */
+    uint32_t misses;                /* connections set up by looking the handles up */
+    uint32_t hit_ready_ms;          /* average time from connect request to ready, on a hit */
+    uint32_t miss_ready_ms;         /* same on a miss */
+} mico_ble_gatt_cache_stats_t;
+
+/* Phases of a central connect attempt, see mico_ble_get_conn_timing() */
+typedef enum {
+    BLE_CONN_PHASE_QUEUE,           /* request queued to the worker thread */
+    BLE_CONN_PHASE_SECURITY,        /* bond lookup and pairing setup */
+    BLE_CONN_PHASE_CONNECT,         /* link up, pairing and discovery by the stack */
+    BLE_CONN_PHASE_SERVICE,         /* SPP service lookup, or GATT cache validation */
+    BLE_CONN_PHASE_CHARACTERISTIC,  /* SPP characteristic lookup and subscription */
+    BLE_CONN_PHASE_MAX,
+} mico_ble_conn_phase_t;
+
+/* A recent connect attempt, phases not reached are 0 ms */
+#define BLE_CONN_TIMING_MAX     8
+typedef struct {
+    mico_bt_device_address_t bd_addr;
+    mico_bool_t is_ready;                       /* the link came up */
+    uint8_t     last_phase;                     /* phase it ended in */
+    uint32_t    age_ms;                         /* since the connect request */
+    uint32_t    phase_ms[BLE_CONN_PHASE_MAX];
+} mico_ble_conn_timing_t;
+
+/* Bucket b of a phase counts the attempts taking [2^(b-1), 2^b) ms, the last one is open */
+#define BLE_CONN_HIST_BUCKETS   14
+typedef struct {
+    uint16_t    counts[BLE_CONN_PHASE_MAX][BLE_CONN_HIST_BUCKETS];
+} mico_ble_conn_hist_t;
+
+/* The peer of the last connection, see mico_ble_set_last_peer() */
+typedef struct {
+    mico_bt_device_address_t bd_addr;
+    uint8_t     role;                           /* mico_ble_role_t of the local device on that connection */
+} mico_ble_peer_t;
+
+/* Automatic reconnect, see mico_ble_set_reconnect() */
+typedef struct {
+    mico_bool_t enable;
+    uint32_t    backoff_min_ms;                 /* delay after the immediate attempt failed */
+    uint32_t    backoff_max_ms;                 /* the delay doubles up to this, less up to 25% of jitter */
+} mico_ble_reconn_config_t;
+
+/* Automatic connect to a device found by scanning, see mico_ble_auto_connect() */
+#define BLE_AUTO_CONN_NAME_MAX  30
+typedef struct {
+    char        name_prefix[BLE_AUTO_CONN_NAME_MAX + 1];    /* used if service_uuid.len is 0 */
+    mico_bt_uuid_t service_uuid;                    /* 16, 32 or 128-bit service UUID advertised */
+    int8_t      min_rssi;                           /* weaker devices are ignored */
+    uint16_t    window_ms;                          /* 0 for the first match, else the strongest match within it */
+} mico_ble_auto_conn_t;
+
+/* Delivery of inbound SPP data, see mico_ble_set_rx_mode() */
+typedef enum {
+    BLE_RX_MODE_EVENT,              /* BLE_EVT_DATA per write/notification or framed message */
+    BLE_RX_MODE_STREAM,             /* queued as a byte stream for mico_ble_read() */
+} mico_ble_rx_mode_t;
+
 /* Bluetooth event handler in user layer application */
 typedef OSStatus (*mico_ble_evt_cback_t)(mico_ble_event_t event, const mico_ble_evt_params_t *p_params);
 
+/* Worker threads of the library */
+typedef enum {
+    BLE_WORKER_TASK,                /* connects, scans, retransmits and other deferred work */
+    BLE_WORKER_EVENT,               /* calls of the event callback */
+    BLE_WORKER_MAX,
+} mico_ble_worker_id_t;
+
+/* One worker thread, see mico_ble_executor_config_t */
+typedef struct {
+    mico_worker_thread_t *shared;               /* a worker thread of the application to run on, NULL for an own one */
+    uint8_t     priority;                       /* of an own thread */
+    uint32_t    stack_size;
+    uint32_t    queue_depth;
+} mico_ble_worker_config_t;
+
+/* Worker threads, see mico_ble_init_ex(). Own threads are created at init and serve both roles. */
+typedef struct {
+    uint8_t     thread_count;                   /* 1 calls the event callback on the task worker, else 2 */
+    mico_ble_worker_config_t workers[BLE_WORKER_MAX];
+    uint32_t  (*stack_free)(mico_worker_thread_t *thread);  /* least free stack ever in bytes, NULL if the RTOS cannot tell */
+} mico_ble_executor_config_t;
+
+#define BLE_WORKER_STACK_UNKNOWN    0xFFFFFFFF
+
+/* Usage of a worker thread, see mico_ble_get_worker_stats() */
+typedef struct {
+    mico_bool_t is_running;                     /* created, or shared */
+    mico_bool_t is_shared;
+    uint32_t    stack_size;                     /* 0 if shared */
+    uint32_t    stack_free;                     /* least free stack ever in bytes, BLE_WORKER_STACK_UNKNOWN if unknown */
+    uint32_t    queue_depth;                    /* 0 if shared */
+    uint32_t    dropped;                        /* jobs not queued, usually on a full queue */
+} mico_ble_worker_stats_t;
+
 
 /*****************************************************************************
  * Globals
@@ -151,6 +345,47 @@ mico_bt_result_t mico_ble_init(const char *name,
                                mico_bool_t is_central, 
                                mico_ble_evt_cback_t cback);
 
+/**
+ * Initialize Bluetooth Sub-system like mico_ble_init(), on the given worker
+ * threads instead of two own threads of 2048 bytes of stack and 10 jobs of
+ * queue at MICO_APPLICATION_PRIORITY.
+ *
+ * A thread shared with the application also runs the application's jobs
+ * between the library's, so the event callback must not wait there for
+ * the library, e.g. for a reliable send to be acknowledged. The same goes
+ * for a single thread.
+ *
+ * @param exec
+ *      The worker threads, NULL for the defaults.
+ *
+ * @return
+ *      MICO_BT_SUCCESS if successfully.
+ *      MICO_BT_BADARG -- No thread count of 1 or 2, or an own thread without stack or queue.
+ *      Others -- The own threads, a timer or the stack cannot be set up.
+ *      What was created is released again, so init may be retried.
+ */
+mico_bt_result_t mico_ble_init_ex(const char *name,
+                                  const char *whitelist_name,
+                                  mico_bool_t is_central,
+                                  mico_ble_evt_cback_t cback,
+                                  const mico_ble_executor_config_t *exec);
+
+/**
+ * Get the usage of a worker thread, to size its stack and queue.
+ *
+ * @param id
+ *      The worker.
+ *
+ * @param stats
+ *      A pointer of the statistics buffer.
+ *
+ * @return
+ *      MICO_BT_SUCCESS if successfully.
+ *      MICO_BT_BADARG -- Invalid parameter.
+ *      MICO_BT_BADOPTION -- The worker runs on the task worker, see thread_count.
+ */
+mico_bt_result_t mico_ble_get_worker_stats(mico_ble_worker_id_t id, mico_ble_worker_stats_t *stats);
+
 /**
  *  bluetooth_send_data
  *
@@ -199,63 +434,570 @@ mico_bt_result_t mico_ble_set_device_whitelist_name(const char *name);
 const char *mico_ble_get_device_whitelist_name(void);
 
 /**
- * Set passkey for BT Security process.
+ * Add a device name prefix to the scan whitelist. A scanned device is
+ * reported if its name starts with any prefix in the whitelist, including
+ * the whitelist name. Hundreds of prefixes are matched in one pass over the
+ * name.
  *
- * @param key
- *      a c-style string of the passkey.
+ * @param prefix
+ *          a c-style string, 1 to 30 characters.
  *
  * @return
  *      MICO_BT_SUCCESS if successfully.
+ *      MICO_BT_NO_RESOURCES -- The whitelist is full.
  */
-// mico_bt_result_t mico_ble_set_device_whitelist_uuid(const mico_bt_uuid_t *uuid);
+mico_bt_result_t mico_ble_whitelist_add(const char *prefix);
 
 /**
- * Get passkey for BT Security process.
+ * Remove a device name prefix from the scan whitelist.
+ *
+ * @param prefix
+ *          a prefix added by mico_ble_whitelist_add().
  *
  * @return
- *  A c-style string of local device passkey.
+ *      MICO_BT_SUCCESS if successfully.
+ *      MICO_BT_BADARG -- The prefix is not in the whitelist.
+ */
+mico_bt_result_t mico_ble_whitelist_remove(const char *prefix);
+
+/**
+ * Remove all prefixes added by mico_ble_whitelist_add(). The whitelist name
+ * is kept.
+ *
+ * @return
+ *      MICO_BT_SUCCESS if successfully.
+ */
+mico_bt_result_t mico_ble_whitelist_clear(void);
+
+/**
+ * Get the number of distinct prefixes in the scan whitelist, including the
+ * whitelist name.
+ *
+ * @return
+ *      The number of prefixes.
+ */
+uint16_t mico_ble_whitelist_count(void);
+
+/**
+ * Set the characteristic subscribed for peer data in central mode.
+ *
+ * After connection the central enables notification (or indication if
+ * notification is not supported) on this characteristic, and the values
+ * received are delivered as BLE_EVT_DATA. Takes effect on next connection.
+ * Default is 0x2AF0.
+ *
+ * @param uuid
+ *      UUID of a characteristic in the whitelist service.
+ *
+ * @return
+ *      MICO_BT_SUCCESS if successfully.
+ */
+mico_bt_result_t mico_ble_set_central_notify_uuid(const mico_bt_uuid_t *uuid);
+
+/**
+ * Configure the scan engine, takes effect from the next scan. Default is a
+ * 5 second passive scan with interval 128 and window 64.
+ *
+ * A scan of duration_second ends with BLE_EVT_CENTRAL_SCAN_STOP. With
+ * duration_second 0, scanning restarts by itself without any event until
+ * stopped, e.g. by advertising. In that mode a duty cycle can be set, e.g.
+ * duty_percent 30 and duty_period_second 10 scan for 3 s and rest for 7 s.
+ * A rest under way when the configuration changes starts over with the new
+ * rest period, or the scan ends at once if it no longer restarts by itself.
+ *
+ * @param cfg
+ *      The scan configuration.
+ *
+ * @return
+ *      MICO_BT_SUCCESS if successfully.
+ *      MICO_BT_BADARG -- Invalid parameter.
+ *      MICO_BT_NO_RESOURCES -- No resource for the duty cycle timer.
+ */
+mico_bt_result_t mico_ble_set_scan_config(const mico_ble_scan_config_t *cfg);
+
+/**
+ * Get the scan engine configuration.
+ *
+ * @param cfg
+ *      A pointer of configuration buffer.
+ *
+ * @return
+ *      MICO_BT_SUCCESS if successfully.
+ */
+mico_bt_result_t mico_ble_get_scan_config(mico_ble_scan_config_t *cfg);
+
+/**
+ * Set the ranking of the nearby device table.
+ *
+ * The library keeps the BLE_NEARBY_MAX best ranked devices that passed the
+ * scan filters, whether or not a BLE_EVT_CENTRAL_REPORT was raised for
+ * their last advertisement, so that they can be polled instead.
+ *
+ * @param order
+ *      BLE_NEARBY_BY_RSSI (default) or BLE_NEARBY_BY_RECENT.
+ *
+ * @return
+ *      MICO_BT_SUCCESS if successfully.
+ */
+mico_bt_result_t mico_ble_set_nearby_order(mico_ble_nearby_order_t order);
+
+/**
+ * Enable or disable raw advertising data in BLE_EVT_CENTRAL_REPORT.
+ *
+ * When enabled, p_adv_data of a report points to the advertising data of
+ * the device, up to 31 bytes of AD structures. The buffer belongs to the
+ * library and is only valid in the event callback. It is NULL if all
+ * buffers are in use by queued reports. Non-connectable and scannable
+ * advertisers, such as beacons, and devices without a name are reported
+ * too. A device is reported again as soon as its advertising data changes.
+ *
+ * @param enable
+ *      MICO_TRUE to enable.
+ *
+ * @return
+ *      MICO_BT_SUCCESS if successfully.
+ *      MICO_BT_NO_RESOURCES -- No resource for the advertising data pool.
+ */
+mico_bt_result_t mico_ble_set_raw_report(mico_bool_t enable);
+
+/**
+ * Get whether raw advertising data is reported.
+ *
+ * @return
+ *      MICO_TRUE if enabled.
+ */
+mico_bool_t mico_ble_get_raw_report(void);
+
+/**
+ * Get the ranking of the nearby device table.
+ *
+ * @return
+ *      The ranking.
+ */
+mico_ble_nearby_order_t mico_ble_get_nearby_order(void);
+
+/**
+ * Take a snapshot of the nearby device table, best ranked first. Devices
+ * not seen for 30 s are left out.
+ *
+ * @param list
+ *      An array of devices to fill in.
+ *
+ * @param max
+ *      The number of elements in list.
+ *
+ * @return
+ *      The number of devices filled in.
+ */
+uint8_t mico_ble_get_nearby(mico_ble_nearby_t *list, uint8_t max);
+
+/**
+ * Empty the nearby device table.
+ *
+ * @return
+ *      MICO_BT_SUCCESS if successfully.
+ */
+mico_bt_result_t mico_ble_nearby_clear(void);
+
+/**
+ * Load the GATT cache, e.g. saved in flash before a reboot. A central link
+ * to a peer in the cache takes the SPP handles from its entry instead of
+ * looking them up, as long as the handles still hold the SPP characteristics.
+ * Other peers are added once connected, replacing the least recently used
+ * entry. BLE_EVT_GATT_CACHE_CHANGED is raised whenever the entries or their
+ * order change, including a hit on an entry other than the first. The
+ * service discovery itself still runs while connecting, only the lookups are
+ * saved.
+ *
+ * @param entries
+ *      An array of entries, most recently used first.
+ *
+ * @param count
+ *      The number of entries, at most BLE_GATT_CACHE_MAX.
+ *
+ * @return
+ *      MICO_BT_SUCCESS if successfully.
+ *      MICO_BT_BADARG -- Too many entries.
+ */
+mico_bt_result_t mico_ble_set_gatt_cache(const mico_ble_gatt_cache_entry_t *entries, uint8_t count);
+
+/**
+ * Take a snapshot of the GATT cache, most recently used first.
+ *
+ * @param entries
+ *      An array of entries to fill in.
+ *
+ * @param max
+ *      The number of elements in entries.
+ *
+ * @return
+ *      The number of entries filled in.
+ */
+uint8_t mico_ble_get_gatt_cache(mico_ble_gatt_cache_entry_t *entries, uint8_t max);
+
+/**
+ * Empty the GATT cache and reset its statistics.
+ *
+ * @return
+ *      MICO_BT_SUCCESS if successfully.
+ */
+mico_bt_result_t mico_ble_clear_gatt_cache(void);
+
+/**
+ * Get the GATT cache statistics, including the connect-to-ready time with
+ * and without a cache entry.
+ *
+ * @param stats
+ *      A pointer of statistics buffer.
+ *
+ * @return
+ *      MICO_BT_SUCCESS if successfully.
+ */
+mico_bt_result_t mico_ble_get_gatt_cache_stats(mico_ble_gatt_cache_stats_t *stats);
+
+/**
+ * Take the phase timing of the recent central connect attempts, most recent first.
+ *
+ * @param timings
+ *      An array of attempts to fill in.
+ *
+ * @param max
+ *      The number of elements in timings.
+ *
+ * @return
+ *      The number of attempts filled in.
+ */
+uint8_t mico_ble_get_conn_timing(mico_ble_conn_timing_t *timings, uint8_t max);
+
+/**
+ * Get the histograms of the phase durations of all central connect attempts.
+ *
+ * @param hist
+ *      A pointer of histogram buffer.
+ *
+ * @return
+ *      MICO_BT_SUCCESS if successfully.
+ */
+mico_bt_result_t mico_ble_get_conn_hist(mico_ble_conn_hist_t *hist);
+
+/**
+ * Forget the recent connect attempts and empty the histograms.
+ *
+ * @return
+ *      MICO_BT_SUCCESS if successfully.
+ */
+mico_bt_result_t mico_ble_clear_conn_timing(void);
+
+/**
+ * Set the automatic reconnect policy.
+ *
+ * When a connection is lost without mico_ble_disconnect(), a central link is
+ * connected again at once and then with a jittered exponential backoff until
+ * it comes up. A peripheral connection starts high duty directed advertising
+ * toward the central if it is bonded, and then falls back to undirected
+ * advertising.
+ *
+ * @param cfg
+ *      The policy.
+ *
+ * @return
+ *      MICO_BT_SUCCESS if successfully.
+ *      MICO_BT_BADARG -- The backoff range is empty.
+ */
+mico_bt_result_t mico_ble_set_reconnect(const mico_ble_reconn_config_t *cfg);
+
+/**
+ * Get the automatic reconnect policy.
+ *
+ * @param cfg
+ *      A pointer of the policy buffer.
+ */
+void mico_ble_get_reconnect(mico_ble_reconn_config_t *cfg);
+
+/**
+ * Restore the peer of the last connection, saved on BLE_EVT_LAST_PEER_CHANGED.
+ *
+ * @param peer
+ *      The peer, NULL to forget it.
+ *
+ * @return
+ *      MICO_BT_SUCCESS if successfully.
+ */
+mico_bt_result_t mico_ble_set_last_peer(const mico_ble_peer_t *peer);
+
+/**
+ * Get the peer of the last connection.
+ *
+ * @param peer
+ *      A pointer of the peer buffer.
+ *
+ * @return
+ *      MICO_BT_SUCCESS if successfully.
+ *      MICO_BT_BADOPTION -- No connection yet.
+ */
+mico_bt_result_t mico_ble_get_last_peer(mico_ble_peer_t *peer);
+
+/**
+ * Reconnect to the peer of the last connection, typically after a reboot.
+ * A central connects to it, a peripheral which is advertising directs its
+ * advertising toward it.
+ *
+ * @return
+ *      MICO_BT_SUCCESS if successfully.
+ *      MICO_BT_BADOPTION -- Reconnect is disabled, no last peer or the role is busy.
+ *      MICO_BT_NO_RESOURCES -- The worker threads cannot be created.
+ */
+mico_bt_result_t mico_ble_reconnect(void);
+
+/**
+ * Connect to a device found by scanning, without a round trip through the
+ * application. The device must advertise connectable and match a name
+ * prefix or a service UUID. The first match is connected at once, or with
+ * a window the strongest match seen from the first one on. The scan goes on
+ * until a match is found, whatever its duration.
+ *
+ * The scan filters of mico_ble_set_ad_filter() and the whitelist do not
+ * apply, the scan results are reported as usual.
+ *
+ * @param cond
+ *      The device to look for.
+ *
+ * @return
+ *      MICO_BT_SUCCESS if successfully.
+ *      MICO_BT_BADARG -- Neither a name prefix nor a service UUID.
+ *      MICO_BT_BADOPTION -- The central role is connecting.
+ *      MICO_BT_NO_RESOURCES -- No resource for the window timer.
+ */
+mico_bt_result_t mico_ble_auto_connect(const mico_ble_auto_conn_t *cond);
+
+/**
+ * Stop looking for the device of mico_ble_auto_connect(), the scan goes on
+ * as configured. Stopping the scan also ends an automatic connect.
+ *
+ * @return
+ *      MICO_BT_SUCCESS if successfully, MICO_BT_BADOPTION if not looking.
+ */
+mico_bt_result_t mico_ble_cancel_auto_connect(void);
+
+/**
+ * Get the device being looked for by mico_ble_auto_connect().
+ *
+ * @param cond
+ *      A pointer of the condition buffer.
+ *
+ * @return
+ *      MICO_TRUE if looking for a device.
+ */
+mico_bool_t mico_ble_get_auto_connect(mico_ble_auto_conn_t *cond);
+
+/**
+ * Add a known peer to the controller filter accept list. Adds and removes
+ * are passed to the controller one by one, also while scanning.
+ *
+ * @param addr
+ *      Device address of the peer.
+ *
+ * @return
+ *      MICO_BT_SUCCESS if successfully.
+ *      MICO_BT_NO_RESOURCES -- The accept list is full.
+ *      MICO_BT_ERROR -- The controller rejected the address.
+ */
+mico_bt_result_t mico_ble_accept_list_add(const mico_bt_device_address_t addr);
+
+/**
+ * Remove a known peer from the controller filter accept list.
+ *
+ * @param addr
+ *      Device address of the peer.
+ *
+ * @return
+ *      MICO_BT_SUCCESS if successfully.
+ *      MICO_BT_BADARG -- The peer is not in the accept list.
+ */
+mico_bt_result_t mico_ble_accept_list_remove(const mico_bt_device_address_t addr);
+
+/**
+ * Remove all peers from the controller filter accept list.
+ *
+ * @return
+ *      MICO_BT_SUCCESS if successfully.
+ */
+mico_bt_result_t mico_ble_accept_list_clear(void);
+
+/**
+ * Get the number of peers in the controller filter accept list.
+ *
+ * @return
+ *      The number of peers.
+ */
+uint8_t mico_ble_accept_list_count(void);
+
+/**
+ * Get the peers in the controller filter accept list, e.g. to add them again
+ * after a reboot.
+ *
+ * @param addrs
+ *      An array of addresses to fill in.
+ *
+ * @param max
+ *      The number of elements in addrs, BLE_ACCEPT_LIST_MAX holds them all.
+ *
+ * @return
+ *      The number of addresses filled in.
+ */
+uint8_t mico_ble_get_accept_list(mico_bt_device_address_t *addrs, uint8_t max);
+
+/**
+ * Let the controller drop advertisements of devices not in the accept list,
+ * before they reach the host. Takes effect from the next scan. Connecting
+ * is always directed to one address and filtered by the controller anyway.
+ *
+ * @param enable
+ *      MICO_TRUE to scan with the accept list filter policy.
+ *
+ * @return
+ *      MICO_BT_SUCCESS if successfully.
+ */
+mico_bt_result_t mico_ble_set_accept_list_filter(mico_bool_t enable);
+
+/**
+ * Get whether scans use the accept list filter policy.
+ *
+ * @return
+ *      MICO_TRUE if enabled.
  */
-// const mico_bt_uuid_t *mico_ble_get_device_whitelist_uuid(void);
+mico_bool_t mico_ble_get_accept_list_filter(void);
 
 /**
+ * Set the advertising data filter of scan results. A device is reported only
+ * if its advertising data carries the service UUID (if any) and manufacturer
+ * specific data of the company (if requested) whose first bytes match data
+ * under mask. The filter is applied before the whitelist.
+ *
+ * @param filter
+ *      The filter, NULL to report devices regardless of advertising data.
+ *
+ * @return
+ *      MICO_BT_SUCCESS if successfully.
+ *      MICO_BT_BADARG -- Invalid UUID or data length.
+ */
+mico_bt_result_t mico_ble_set_ad_filter(const mico_ble_ad_filter_t *filter);
+
+/**
+ * Get the advertising data filter of scan results.
+ *
+ * @param filter
+ *      A pointer of filter buffer, filled in if a filter is set.
  *
- * @param start
  * @return
+ *      MICO_TRUE if a filter is set.
+ */
+mico_bool_t mico_ble_get_ad_filter(mico_ble_ad_filter_t *filter);
+
+/**
+ * Start a scan in the central role. Advertising or a peripheral connection
+ * is kept, the scan window is then limited to half of the scan interval.
+ * Central links are kept too, to look for more peripherals.
+ *
+ * @return
+ *      MICO_BT_SUCCESS if succesfully.
+ *      MICO_BT_BADOPTION -- The central role is scanning or connecting.
+ *      MICO_BT_NO_RESOURCES -- The worker threads cannot be created.
  */
 mico_bt_result_t mico_ble_start_device_scan(void);
 
 /**
- * Start or stop a device discoverable procedure.
+ * Stop the scan of the central role.
  *
- * @param start
- *      A boolean value of start or stop.
+ * @return
+ *      MICO_BT_SUCCESS if succesfully.
+ *      MICO_BT_BADOPTION -- Not scanning.
+ */
+mico_bt_result_t mico_ble_stop_device_scan(void);
+
+/**
+ * Start advertising in the peripheral role. A scan or central links are kept.
  *
  * @return
  *      MICO_BT_SUCCESS if succesfully.
+ *      MICO_BT_BADOPTION -- The peripheral role is not idle.
+ *      MICO_BT_NO_RESOURCES -- The worker threads cannot be created.
  */
 mico_bt_result_t mico_ble_start_device_discovery(void);
+
+/**
+ * Stop advertising in the peripheral role, a directed advertising toward
+ * the last central included. A scan or central links are kept.
+ *
+ * @return
+ *      MICO_BT_SUCCESS if succesfully.
+ *      MICO_BT_BADOPTION -- Not advertising.
+ */
+mico_bt_result_t mico_ble_stop_device_discovery(void);
+
 /**
+ * Connect to a peripheral. Up to BLE_CENTRAL_LINK_MAX peripherals can be
+ * connected at once, each reported by BLE_EVT_CENTRAL_CONNECTED with its own
+ * connection handle. A running scan is stopped first.
+ *
+ * The first connection to come up, in either role, carries the SPP channel:
+ * mico_ble_send_data() and framing, compression, reliable notifications and
+ * the L2CAP transport apply to it only. If it goes down, another central link,
+ * or else the peripheral connection, takes over. Data of the other connections
+ * is raw, sent with mico_ble_send_data_to() and received as BLE_EVT_DATA with
+ * their handle; it is dropped in BLE_RX_MODE_STREAM.
  *
  * @param bdaddr
+ *      Address of the peer.
+ *
  * @return
+ *      MICO_BT_SUCCESS if the connection is in progress.
+ *      MICO_BT_BADOPTION -- Another connection is in progress, or the peer is already connected.
+ *      MICO_BT_NO_RESOURCES -- All links are in use, or the worker threads cannot be created.
  */
 mico_bt_result_t mico_ble_connect(mico_bt_device_address_t bdaddr);
 
 /**
+ * Disconnect a connection.
  *
  * @param connect_handle
+ *      Connection handle of a central link or of the peripheral connection.
+ *      Ignored if the peripheral connection is the only one.
+ *
  * @return
+ *      MICO_BT_SUCCESS if successfully.
+ *      MICO_BT_BADARG -- No central link with this handle.
  */
 mico_bt_result_t mico_ble_disconnect(uint16_t connect_handle);
 
 /**
- * Get local BT RF State.
+ * Get local BT RF State. With both roles active, a connected role is reported
+ * first and the central role before the peripheral one.
  *
  * @return
  *      a value of local BT RF State. See details @mico_ble_state_t
  */
 mico_ble_state_t mico_ble_get_device_state(void);
 
+/**
+ * Get the state of one role.
+ *
+ * @param role
+ *      BLE_ROLE_PERIPHERAL or BLE_ROLE_CENTRAL.
+ *
+ * @return
+ *      BLE_STATE_IDLE or a state of the role. See details @mico_ble_state_t
+ */
+mico_ble_state_t mico_ble_get_role_state(mico_ble_role_t role);
+
+/**
+ * Get the connection handle of the SPP channel, see mico_ble_connect().
+ *
+ * @return
+ *      Handle of a central link or of the peripheral connection, 0 if not connected.
+ */
+uint16_t mico_ble_get_spp_handle(void);
+
 /**
  * Send a packet synchronously over BT RFCOMM Channel.
  *
@@ -272,10 +1014,290 @@ mico_ble_state_t mico_ble_get_device_state(void);
  *      MICO_BT_SUCCESS  -- sending completily.
  *      MICO_BT_NO_RESOURCES -- No resource for malloc()
  *      MICO_BT_ILLEGAL_ACTION -- Illegal action (RFCOMM Channel is not opened).
- *      MICO_BT_TIMEOUT -- Timeout
+ *      MICO_BT_TIMEOUT -- Timeout, nothing has been sent.
+ *      MICO_BT_ERROR -- The packet was only partially sent.
  */
 mico_bt_result_t mico_ble_send_data(const uint8_t *p_data, uint32_t length, uint32_t timeout_ms);
 
+/**
+ * Send a packet gathered from several fragments synchronously, e.g. a
+ * header, a body and a CRC, without assembling them first.
+ *
+ * @param vec
+ *          An array of fragments.
+ *
+ * @param count
+ *          the number of fragments.
+ *
+ * @param timeout_ms
+ *          Timeout of synchronously.
+ *
+ * @return
+ *      Same as mico_ble_send_data().
+ */
+mico_bt_result_t mico_ble_send_datav(const mico_ble_iovec_t *vec, uint32_t count, uint32_t timeout_ms);
+
+/**
+ * Send a packet synchronously to one connection. The primary link and the
+ * peripheral connection are the same as mico_ble_send_data(), other central
+ * links get the packet as is.
+ *
+ * @param handle
+ *          Connection handle, see BLE_EVT_CENTRAL_CONNECTED.
+ *
+ * @param p_data
+ *          A pointer of packet.
+ *
+ * @param length
+ *          the size of packet.
+ *
+ * @param timeout_ms
+ *          Timeout of synchronously.
+ *
+ * @return
+ *      Same as mico_ble_send_data().
+ *      MICO_BT_BADARG -- No connection with this handle.
+ */
+mico_bt_result_t mico_ble_send_data_to(uint16_t handle, const uint8_t *p_data, uint32_t length, uint32_t timeout_ms);
+
+/**
+ * Send a packet gathered from several fragments synchronously to one connection.
+ *
+ * @param handle
+ *          Connection handle, see BLE_EVT_CENTRAL_CONNECTED.
+ *
+ * @param vec
+ *          An array of fragments.
+ *
+ * @param count
+ *          the number of fragments.
+ *
+ * @param timeout_ms
+ *          Timeout of synchronously.
+ *
+ * @return
+ *      Same as mico_ble_send_data_to().
+ */
+mico_bt_result_t mico_ble_send_datav_to(uint16_t handle, const mico_ble_iovec_t *vec, uint32_t count, uint32_t timeout_ms);
+
+/**
+ * Set the ATT MTU used to fragment outgoing data of the peripheral connection.
+ * It goes back to the default of 23 whenever a peripheral connection comes up
+ * or goes down, so set it for each central once the MTU is exchanged.
+ *
+ * @param mtu
+ *          ATT MTU negotiated with the peer, in [23, 247].
+ *
+ * @return
+ *      MICO_BT_SUCCESS if successfully.
+ */
+mico_bt_result_t mico_ble_set_att_mtu(uint16_t mtu);
+
+/**
+ * Enable or disable the length-prefixed framing on the SPP data channel.
+ *
+ * When enabled, every outgoing packet is sent as one framed message and
+ * incoming fragments are reassembled inside the library, so that
+ * BLE_EVT_DATA is delivered once per complete message. A message must not
+ * exceed 512 bytes.
+ *
+ * @param enable
+ *          MICO_TRUE to enable.
+ *
+ * @return
+ *      MICO_BT_SUCCESS if successfully.
+ *      MICO_BT_NO_RESOURCES -- No resource for the reassembly pool.
+ */
+mico_bt_result_t mico_ble_set_framing(mico_bool_t enable);
+
+/**
+ * Get whether the length-prefixed framing is enabled.
+ *
+ * @return
+ *      MICO_TRUE if enabled.
+ */
+mico_bool_t mico_ble_get_framing(void);
+
+/**
+ * Enable or disable compression on the framed SPP data channel.
+ *
+ * Both sides exchange a capability byte after connection; packets are
+ * compressed only if the peer supports it too, and only when framing is
+ * enabled. A packet that does not shrink is sent uncompressed.
+ *
+ * @param enable
+ *          MICO_TRUE to enable.
+ *
+ * @return
+ *      MICO_BT_SUCCESS if successfully.
+ *      MICO_BT_BADOPTION -- Enabling while framing is disabled.
+ */
+mico_bt_result_t mico_ble_set_compression(mico_bool_t enable);
+
+/**
+ * Get the compression state.
+ *
+ * @param active
+ *          Set to MICO_TRUE if both sides agreed on compression. Could be NULL.
+ *
+ * @return
+ *      MICO_TRUE if compression is enabled locally.
+ */
+mico_bool_t mico_ble_get_compression(mico_bool_t *active);
+
+/**
+ * Select the connection parameter profile.
+ *
+ * The profile is used when the central connects, and an update is requested
+ * right away if a connection is already up (either role). In automatic mode
+ * the library switches to BLE_CONN_PROFILE_THROUGHPUT while more than one
+ * connection event worth of data is queued for sending, and falls back to
+ * the given profile once the link has been idle for a while.
+ *
+ * @param profile
+ *          The profile to use, or to fall back to in automatic mode.
+ *
+ * @param is_auto
+ *          MICO_TRUE to switch profiles automatically.
+ *
+ * @return
+ *      MICO_BT_SUCCESS if successfully.
+ *      MICO_BT_BADARG -- Unknown profile.
+ *      MICO_BT_ERROR -- The update request was rejected by the stack.
+ */
+mico_bt_result_t mico_ble_set_conn_profile(mico_ble_conn_profile_t profile, mico_bool_t is_auto);
+
+/**
+ * Get the connection parameter profile.
+ *
+ * @param is_auto
+ *          Set to MICO_TRUE if profiles are switched automatically. Could be NULL.
+ *
+ * @param active
+ *          Set to the profile last requested on the current link. Could be NULL.
+ *
+ * @return
+ *      The profile selected by mico_ble_set_conn_profile().
+ */
+mico_ble_conn_profile_t mico_ble_get_conn_profile(mico_bool_t *is_auto, mico_ble_conn_profile_t *active);
+
+/**
+ * Enable or disable reliable notifications on the framed SPP data channel.
+ *
+ * Both sides exchange a capability byte after connection. If both enable it,
+ * the central acknowledges the peripheral's notifications with selective
+ * ACKs over SPP IN, and the peripheral retransmits the missing ones. At most
+ * 8 fragments may be unacknowledged. The peripheral disconnects if a
+ * fragment is still not acknowledged after 10 retransmissions. Requires
+ * framing, and does not apply to the L2CAP transport.
+ *
+ * @param enable
+ *          MICO_TRUE to enable.
+ *
+ * @return
+ *      MICO_BT_SUCCESS if successfully.
+ *      MICO_BT_NO_RESOURCES -- No resource for the retransmission window.
+ */
+mico_bt_result_t mico_ble_set_reliable(mico_bool_t enable);
+
+/**
+ * Get the reliable notification state.
+ *
+ * @param active
+ *          Set to MICO_TRUE if both sides agreed on reliable notifications. Could be NULL.
+ *
+ * @return
+ *      MICO_TRUE if reliable notifications are enabled locally.
+ */
+mico_bool_t mico_ble_get_reliable(mico_bool_t *active);
+
+/**
+ * Select the transport of the SPP data channel.
+ *
+ * With BLE_TRANSPORT_L2CAP_COC the central opens an LE credit based L2CAP
+ * channel right after connection, and the peripheral accepts it. While the
+ * channel is open mico_ble_send_data() and BLE_EVT_DATA go over it, with
+ * L2CAP credits instead of ATT for flow control; otherwise GATT is used.
+ * Both sides must select it. Takes effect on next connection.
+ *
+ * @param transport
+ *          BLE_TRANSPORT_GATT or BLE_TRANSPORT_L2CAP_COC.
+ *
+ * @return
+ *      MICO_BT_SUCCESS if successfully.
+ *      MICO_BT_BADARG -- Unknown transport.
+ */
+mico_bt_result_t mico_ble_set_transport(mico_ble_transport_t transport);
+
+/**
+ * Get the transport of the SPP data channel.
+ *
+ * @param is_open
+ *          Set to MICO_TRUE if an L2CAP channel is open. Could be NULL.
+ *
+ * @return
+ *      The transport selected by mico_ble_set_transport().
+ */
+mico_ble_transport_t mico_ble_get_transport(mico_bool_t *is_open);
+
+/**
+ * Get TX throughput statistics of the connection carrying the SPP channel.
+ * They are reset when the channel is set up or moves to another connection.
+ *
+ * @param stats
+ *          A pointer of statistics buffer.
+ *
+ * @return
+ *      MICO_BT_SUCCESS if successfully.
+ */
+mico_bt_result_t mico_ble_get_tx_stats(mico_ble_tx_stats_t *stats);
+
+/**
+ * Select how inbound SPP data is delivered, default is BLE_RX_MODE_EVENT.
+ *
+ * Both modes copy data into a fixed ring buffer inside the library. In
+ * BLE_RX_MODE_EVENT, p_data of BLE_EVT_DATA points into the ring and is only
+ * valid during the callback. In BLE_RX_MODE_STREAM no BLE_EVT_DATA is
+ * delivered, read the data with mico_ble_read() instead. Data that does not
+ * fit into the ring is dropped. Data not consumed yet is discarded.
+ *
+ * The BLE_EVT_DATA callback may call this function. The data being delivered
+ * stays valid until the callback returns, and mico_ble_read() returns nothing
+ * before that.
+ *
+ * @param mode
+ *          BLE_RX_MODE_EVENT or BLE_RX_MODE_STREAM.
+ *
+ * @return
+ *      MICO_BT_SUCCESS if successfully.
+ */
+mico_bt_result_t mico_ble_set_rx_mode(mico_ble_rx_mode_t mode);
+
+/**
+ * Get how inbound SPP data is delivered.
+ *
+ * @return
+ *      The current mode.
+ */
+mico_ble_rx_mode_t mico_ble_get_rx_mode(void);
+
+/**
+ * Read inbound SPP data in BLE_RX_MODE_STREAM. Only one thread may read.
+ *
+ * @param buf
+ *          Destination buffer.
+ *
+ * @param length
+ *          Size of the buffer.
+ *
+ * @param timeout_ms
+ *          The longest time to wait when no data is available.
+ *
+ * @return
+ *      The number of bytes read, 0 on timeout or in BLE_RX_MODE_EVENT.
+ */
+uint32_t mico_ble_read(uint8_t *buf, uint32_t length, uint32_t timeout_ms);
+
 #define BDADDR_NTOA_SIZE 18
 uint8_t *bdaddr_aton(const char *addr, uint8_t *out_addr);
 char *bdaddr_ntoa(const uint8_t *addr, char *addr_str);
@@ -0,0 +1,167 @@
+/**
+ ******************************************************************************
+ * @file    mico_ble_lz.c
+ * @author
+ * @version V1.0.0
+ * @date
+ * @brief   Small-footprint LZ codec for the BLE SPP data channel
+ ******************************************************************************
+ *
+ *  The MIT License
+ *  Copyright (c) 2016 MXCHIP Inc.
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is furnished
+ *  to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ *  WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR
+ *  IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ ******************************************************************************
+ */
+
+#include <string.h>
+
+#include "mico_ble_lz.h"
+
+#define LZ_HASH_LOG         8
+#define LZ_HASH_SIZE        (1 << LZ_HASH_LOG)
+#define LZ_MAX_LITERAL      (1 << 5)
+#define LZ_MIN_MATCH        3
+#define LZ_MAX_MATCH        (7 + 255 + 2)
+
+#define LZ_HASH(p)          ((uint8_t)((((p)[0] << 8) ^ ((p)[1] << 4) ^ (p)[2]) * 2654435761UL >> (32 - LZ_HASH_LOG)))
+
+uint32_t mico_ble_lz_compress(const uint8_t *in, uint32_t in_len, uint8_t *out, uint32_t out_len)
+{
+    uint16_t       htab[LZ_HASH_SIZE];
+    const uint8_t *ip = in;
+    const uint8_t *in_end = in + in_len;
+    uint8_t       *op = out;
+    uint8_t       *out_end = out + out_len;
+    uint8_t       *lit_ctrl = NULL;     /* control byte of the open literal run */
+    uint8_t        lit = 0;
+
+    if (in_len == 0 || in_len > 0xFFFF) {
+        return 0;
+    }
+
+    /* Slot value is (position + 1), 0 means empty */
+    memset(htab, 0, sizeof(htab));
+
+    while (ip < in_end) {
+        if (ip + LZ_MIN_MATCH <= in_end) {
+            uint8_t        h = LZ_HASH(ip);
+            const uint8_t *ref = htab[h] ? in + htab[h] - 1 : NULL;
+
+            htab[h] = (uint16_t)(ip - in + 1);
+
+            if (ref && (uint32_t)(ip - ref) <= MICO_BLE_LZ_WINDOW_SIZE
+                && ref[0] == ip[0] && ref[1] == ip[1] && ref[2] == ip[2]) {
+                uint32_t off = (uint32_t)(ip - ref - 1);
+                uint32_t max = (uint32_t)((in_end - ip) < LZ_MAX_MATCH ? (in_end - ip) : LZ_MAX_MATCH);
+                uint32_t len = LZ_MIN_MATCH;
+
+                while (len < max && ref[len] == ip[len]) {
+                    len++;
+                }
+
+                if (op + 3 > out_end) {
+                    return 0;
+                }
+                len -= 2;
+                if (len < 7) {
+                    *op++ = (uint8_t)((off >> 8) | (len << 5));
+                } else {
+                    *op++ = (uint8_t)((off >> 8) | (7 << 5));
+                    *op++ = (uint8_t)(len - 7);
+                }
+                *op++ = (uint8_t)off;
+
+                lit_ctrl = NULL;
+                lit = 0;
+                ip += len + 2;
+                continue;
+            }
+        }
+
+        /* Literal */
+        if (!lit_ctrl) {
+            if (op >= out_end) {
+                return 0;
+            }
+            lit_ctrl = op++;
+        }
+        if (op >= out_end) {
+            return 0;
+        }
+        *op++ = *ip++;
+        *lit_ctrl = lit++;
+        if (lit == LZ_MAX_LITERAL) {
+            lit_ctrl = NULL;
+            lit = 0;
+        }
+    }
+
+    return (uint32_t)(op - out);
+}
+
+uint32_t mico_ble_lz_decompress(const uint8_t *in, uint32_t in_len, uint8_t *out, uint32_t out_len)
+{
+    const uint8_t *ip = in;
+    const uint8_t *in_end = in + in_len;
+    uint8_t       *op = out;
+    uint8_t       *out_end = out + out_len;
+
+    while (ip < in_end) {
+        uint32_t ctrl = *ip++;
+
+        if (ctrl < LZ_MAX_LITERAL) {
+            uint32_t len = ctrl + 1;
+
+            if ((uint32_t)(in_end - ip) < len || (uint32_t)(out_end - op) < len) {
+                return 0;
+            }
+            memcpy(op, ip, len);
+            op += len;
+            ip += len;
+        } else {
+            uint32_t len = ctrl >> 5;
+            uint32_t off = (ctrl & 0x1F) << 8;
+            const uint8_t *ref;
+
+            if (len == 7) {
+                if (ip >= in_end) {
+                    return 0;
+                }
+                len += *ip++;
+            }
+            if (ip >= in_end) {
+                return 0;
+            }
+            off += *ip++;
+            len += 2;
+
+            if (off >= (uint32_t)(op - out) || (uint32_t)(out_end - op) < len) {
+                return 0;
+            }
+            /* Byte-wise copy, the reference may overlap the output */
+            ref = op - off - 1;
+            while (len--) {
+                *op++ = *ref++;
+            }
+        }
+    }
+
+    return (uint32_t)(op - out);
+}
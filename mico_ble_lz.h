@@ -0,0 +1,82 @@
+/**
+ ******************************************************************************
+ * @file    mico_ble_lz.h
+ * @author
+ * @version V1.0.0
+ * @date
+ * @brief   Small-footprint LZ codec for the BLE SPP data channel
+ ******************************************************************************
+ *
+ *  The MIT License
+ *  Copyright (c) 2016 MXCHIP Inc.
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is furnished
+ *  to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ *  WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR
+ *  IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ ******************************************************************************
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * The stream is a sequence of tokens, each starting with a control byte:
+ *
+ *   000lllll                      -- literal run of (l + 1) bytes follows
+ *   LLLooooo [LLLLLLLL] oooooooo  -- back reference, offset (o + 1),
+ *                                    length (L + 2); L == 7 means that an
+ *                                    extension byte is added to L
+ *
+ * Matches are searched within a bounded window of 8 KB through a 256-entry
+ * hash table kept on the stack (512 bytes), decompression needs no extra RAM.
+ */
+#define MICO_BLE_LZ_WINDOW_SIZE     (1 << 13)
+
+/**
+ * Compress a buffer.
+ *
+ * @param in        data to compress, at most 65535 bytes.
+ * @param in_len    size of data.
+ * @param out       output buffer.
+ * @param out_len   size of output buffer.
+ *
+ * @return
+ *      size of compressed data, 0 if it does not fit in out_len.
+ */
+uint32_t mico_ble_lz_compress(const uint8_t *in, uint32_t in_len, uint8_t *out, uint32_t out_len);
+
+/**
+ * Decompress a buffer.
+ *
+ * @param in        compressed data.
+ * @param in_len    size of compressed data.
+ * @param out       output buffer.
+ * @param out_len   size of output buffer.
+ *
+ * @return
+ *      size of decompressed data, 0 if the data is corrupted or too large.
+ */
+uint32_t mico_ble_lz_decompress(const uint8_t *in, uint32_t in_len, uint8_t *out, uint32_t out_len);
+
+#ifdef __cplusplus
+}
+#endif
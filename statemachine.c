@@ -165,7 +165,7 @@ static void smTransition(StateMachine *sm, SmRule *oldState, SmRule *newState)
             if (sm->rules[pos].type == SMR_EXIT) {
 #if XA_DECODER == MICO_TRUE
                 if (sm->decode) {
-                    Report("%s(%lx): Exiting %s, calling %s", sm->prefix, (uint32_t)sm->context,
+                    Report("%s(%lx): Exiting %s, calling %s", sm->prefix, (unsigned long)sm->context,
                            sm->stateNameTab[oldState->state],
                            sm->rules[pos].u.enterExit.actionName);
                 }
@@ -239,7 +239,7 @@ static void smTransition(StateMachine *sm, SmRule *oldState, SmRule *newState)
 
 #if XA_DECODER == MICO_TRUE
         if (sm->decode) {
-            Report("%s(%lx): Entering %s, calling %s", sm->prefix, (uint32_t)sm->context,
+            Report("%s(%lx): Entering %s, calling %s", sm->prefix, (unsigned long)sm->context,
                    sm->stateNameTab[newState->state],
                    sm->rules[superChain[superChainPos - 1]].u.enterExit.actionName);
         }
@@ -550,7 +550,7 @@ mico_bool_t SM_Handle(StateMachine *sm, uint32_t eventType)
 
 #if XA_DECODER == MICO_TRUE
         if (sm->decode) {
-            Report("%s(%lx): %s unexpected during %s, rejecting", sm->prefix, (uint32_t)sm->context,
+            Report("%s(%lx): %s unexpected during %s, rejecting", sm->prefix, (unsigned long)sm->context,
                    sm->eventTypeNameTab[eventType], sm->stateNameTab[state->state]);
         }
 #endif /* XA_DECODER == MICO_TRUE */
@@ -568,7 +568,7 @@ mico_bool_t SM_Handle(StateMachine *sm, uint32_t eventType)
 
 #if XA_DECODER == MICO_TRUE
     if (sm->decode && state != nextState) {
-        Report("%s(%lx): On %s, state goes from %s to %s", sm->prefix, (uint32_t)sm->context,
+        Report("%s(%lx): On %s, state goes from %s to %s", sm->prefix, (unsigned long)sm->context,
                sm->eventTypeNameTab[eventType], sm->stateNameTab[state->state], sm->stateNameTab[nextState->state]);
     }
 #endif /* XA_DECODER == MICO_TRUE */
@@ -580,7 +580,7 @@ mico_bool_t SM_Handle(StateMachine *sm, uint32_t eventType)
 
 #if XA_DECODER == MICO_TRUE
     if (sm->decode) {
-        Report("%s(%lx): On %s, calling %s()", sm->prefix, (uint32_t)sm->context,
+        Report("%s(%lx): On %s, calling %s()", sm->prefix, (unsigned long)sm->context,
                sm->eventTypeNameTab[eventType], r->u.evt.actionName);
     }
 #endif /* XA_DECODER == MICO_TRUE */
@@ -598,7 +598,7 @@ mico_bool_t SM_Handle(StateMachine *sm, uint32_t eventType)
 
 #if XA_DECODER == MICO_TRUE
         if (sm->decode) {
-            Report("%s(%lx): %s() failed, rollback to %s", sm->prefix, (uint32_t)sm->context,
+            Report("%s(%lx): %s() failed, rollback to %s", sm->prefix, (unsigned long)sm->context,
                    r->u.evt.actionName, sm->stateNameTab[nextState->state]);
         }
 #endif /* XA_DECODER == MICO_TRUE */
@@ -675,7 +675,7 @@ void SM_GotoState(StateMachine *sm, uint8_t newStateVal)
 
 #if XA_DECODER == MICO_TRUE
     if (sm->decode) {
-        Report("%s(%lx): Manual state change from %s to %s", sm->prefix, (uint32_t)sm->context,
+        Report("%s(%lx): Manual state change from %s to %s", sm->prefix, (unsigned long)sm->context,
                sm->stateNameTab[sm->state->state], sm->stateNameTab[newState->state]);
     }
 #endif /* XA_DECODER == MICO_TRUE */
@@ -0,0 +1,109 @@
+/**
+ ******************************************************************************
+ * @file    lz_bench.c
+ * @brief   Host round trip, fuzz and speed test of mico_ble_lz.
+ *
+ * Build and run on the host from the component directory:
+ *
+ *     gcc -O2 -std=gnu99 -I. test/lz_bench.c mico_ble_lz.c -o lz_bench && ./lz_bench
+ ******************************************************************************
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "mico_ble_lz.h"
+
+#define BENCH_MAX_SIZE      512     /* BLE_FRAME_POOL_BLOCK_SIZE */
+#define BENCH_TRIALS        200000
+#define BENCH_ITERATIONS    200000
+
+static double bench_now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/* Random, small alphabet and periodic inputs must come back unchanged, corrupted input must not crash. */
+static int bench_round_trip(void)
+{
+    uint8_t in[BENCH_MAX_SIZE], packed[BENCH_MAX_SIZE * 2], out[BENCH_MAX_SIZE];
+    uint32_t packed_len, out_len;
+    int trial, i, n, no_fit = 0;
+
+    srand(1);
+    for (trial = 0; trial < BENCH_TRIALS; trial++) {
+        n = 1 + rand() % BENCH_MAX_SIZE;
+        for (i = 0; i < n; i++) {
+            switch (trial % 3) {
+                case 0:  in[i] = (uint8_t)rand(); break;
+                case 1:  in[i] = (uint8_t)"abcab"[rand() % 5]; break;
+                default: in[i] = (uint8_t)((i % 7) * 3); break;
+            }
+        }
+
+        packed_len = mico_ble_lz_compress(in, n, packed, sizeof(packed));
+        if (packed_len == 0) {
+            no_fit++;
+            continue;
+        }
+        out_len = mico_ble_lz_decompress(packed, packed_len, out, sizeof(out));
+        if (out_len != (uint32_t)n || memcmp(in, out, n) != 0) {
+            printf("FAIL: round trip of trial %d, %d bytes\n", trial, n);
+            return 1;
+        }
+
+        packed[rand() % packed_len] ^= (uint8_t)(1 + rand() % 255);
+        mico_ble_lz_decompress(packed, packed_len, out, sizeof(out));
+    }
+
+    printf("round trip: %d trials ok, %d did not fit\n", BENCH_TRIALS, no_fit);
+    return 0;
+}
+
+/* Ratio and speed on telemetry-like JSON lines. */
+static void bench_speed(void)
+{
+    char telemetry[BENCH_MAX_SIZE + 64];
+    uint8_t packed[BENCH_MAX_SIZE * 2], out[BENCH_MAX_SIZE];
+    uint32_t packed_len;
+    double t0, t1, t2;
+    int length = 0, size, i;
+
+    while (length < 400) {
+        length += sprintf(telemetry + length, "{\"t\":%d,\"temp\":%d.%d,\"hum\":%d,\"st\":\"ok\"}\n",
+                          1000 + length, 20 + rand() % 5, rand() % 10, 40 + rand() % 10);
+    }
+
+    for (size = 64; size <= length; size *= 2) {
+        packed_len = mico_ble_lz_compress((const uint8_t *)telemetry, size, packed, sizeof(packed));
+
+        t0 = bench_now();
+        for (i = 0; i < BENCH_ITERATIONS; i++) {
+            mico_ble_lz_compress((const uint8_t *)telemetry, size, packed, sizeof(packed));
+        }
+        t1 = bench_now();
+        for (i = 0; i < BENCH_ITERATIONS; i++) {
+            mico_ble_lz_decompress(packed, packed_len, out, sizeof(out));
+        }
+        t2 = bench_now();
+
+        printf("%3d B -> %3u B (%2.0f%%), compress %.0f MB/s, decompress %.0f MB/s\n",
+               size, packed_len, 100.0 * packed_len / size,
+               (double)size * BENCH_ITERATIONS / (t1 - t0) / 1e6,
+               (double)size * BENCH_ITERATIONS / (t2 - t1) / 1e6);
+    }
+}
+
+int main(void)
+{
+    if (bench_round_trip() != 0) {
+        return 1;
+    }
+    bench_speed();
+    return 0;
+}
@@ -0,0 +1,215 @@
+/**
+ ******************************************************************************
+ * @file    prep_write_test.c
+ * @brief   Host test of long writes (Prepare/Execute Write) to SPP IN.
+ *
+ * The library is compiled in with the SDK stand-ins of test/stubs, the
+ * peripheral layer is scripted: it writes each prepared segment into the
+ * attribute at its offset and calls the attribute callback, as the SDK does.
+ * Build and run from the component directory:
+ *
+ *     gcc -std=gnu99 -Itest/stubs -I. test/prep_write_test.c test/stubs/stub_sdk.c statemachine.c mico_ble_lz.c \
+ *         -o prep_write_test && ./prep_write_test
+ ******************************************************************************
+ */
+
+#include "../mico_ble_lib.c"
+
+/*---------------------------------------------------------------------------------------------
+ * SDK stand-ins scripted for the tested paths, test/stubs/stub_sdk.c has the rest
+ */
+
+typedef struct {
+    event_handler_t handler;
+    void           *arg;
+} test_job_t;
+
+static test_job_t g_jobs[64];
+static int g_job_count;
+
+OSStatus mico_rtos_send_asynchronous_event(mico_worker_thread_t *worker, event_handler_t handler, void *arg)
+{
+    g_jobs[g_job_count].handler = handler;
+    g_jobs[g_job_count].arg = arg;
+    g_job_count++;
+    return kNoErr;
+}
+
+/*---------------------------------------------------------------------------------------------
+ * Test helpers
+ */
+
+#define CHECK(cond)                                                             \
+    do {                                                                        \
+        if (!(cond)) {                                                          \
+            printf("FAIL %s:%d: %s\n", __FILE__, __LINE__, #cond);              \
+            exit(1);                                                            \
+        }                                                                       \
+    } while (0)
+
+static mico_worker_thread_t g_app_worker;
+static mico_bt_ext_attribute_value_t *g_spp_in;
+
+static uint8_t g_received[BLE_PREP_WRITE_MAX_SIZE];  /* data of the last BLE_EVT_DATA */
+static uint16_t g_received_len;
+static int g_received_count;
+
+static OSStatus test_evt_cback(mico_ble_event_t event, const mico_ble_evt_params_t *p_params)
+{
+    if (event == BLE_EVT_DATA) {
+        memcpy(g_received, p_params->u.data.p_data, p_params->u.data.length);
+        g_received_len = p_params->u.data.length;
+        g_received_count++;
+    }
+    return kNoErr;
+}
+
+static void test_pump(void)
+{
+    int i;
+
+    for (i = 0; i < g_job_count; i++) {
+        g_jobs[i].handler(g_jobs[i].arg);
+    }
+    g_job_count = 0;
+}
+
+/* A peripheral connection, SPP data is handed over unframed in BLE_EVT_DATA. */
+static void test_connect(void)
+{
+    static mico_bool_t db_created;
+
+    if (!db_created) {
+        mico_ble_peripheral_create_attribute_db();
+        db_created = MICO_TRUE;
+    }
+    CHECK(mico_bt_peripheral_ext_attribute_find_by_handle(HDLC_SPP_IN_VALUE, &g_spp_in) == kNoErr);
+    CHECK(g_spp_in->value_buffer_length == BLE_PREP_WRITE_MAX_SIZE);
+
+    mico_ble_peripheral_prep_write_reset();
+    free(g_ble_context.m_rx_ring.m_buf);
+    memset(&g_ble_context, 0, sizeof(g_ble_context));
+    g_ble_context.m_thread_count = 1;
+    g_ble_context.m_workers[BLE_WORKER_TASK].m_thread = &g_app_worker;
+    g_ble_context.m_cback = test_evt_cback;
+    g_ble_context.m_spp_owner = BLE_SPP_OWNER_PERIPHERAL;
+    g_ble_context.m_rx_mode = BLE_RX_MODE_EVENT;
+    CHECK(mico_ble_ring_init(&g_ble_context.m_rx_ring, BLE_RX_RING_SIZE) == kNoErr);
+    g_received_count = 0;
+}
+
+/* Prepare Write Request: the segment lands in the attribute at its offset. */
+static mico_bt_gatt_status_t test_prep_write(uint16_t offset, const uint8_t *p_data, uint16_t length)
+{
+    if (offset + length > g_spp_in->value_buffer_length) {
+        return MICO_BT_GATT_INVALID_OFFSET;
+    }
+    memcpy(g_spp_in->p_value + offset, p_data, length);
+    g_spp_in->value_length = offset + length;
+    return mico_ble_periphreal_spp_data_in_callback(g_spp_in, GATTS_REQ_TYPE_PREP_WRITE);
+}
+
+/* Execute Write Request, the flag is the value. */
+static mico_bt_gatt_status_t test_exec_write(uint8_t flag)
+{
+    g_spp_in->p_value[0] = flag;
+    g_spp_in->value_length = 1;
+    return mico_ble_periphreal_spp_data_in_callback(g_spp_in, GATTS_REQ_TYPE_WRITE_EXEC);
+}
+
+static void test_fill(uint8_t *p_data, uint16_t length)
+{
+    uint16_t i;
+
+    for (i = 0; i < length; i++) {
+        p_data[i] = (uint8_t)(i * 7 + 3);
+    }
+}
+
+/*---------------------------------------------------------------------------------------------
+ * Tests
+ */
+
+/* Segments in order, as a client splits a value longer than the ATT MTU. */
+static void test_in_order(void)
+{
+    uint8_t value[300];
+    uint16_t offset;
+
+    test_connect();
+    test_fill(value, sizeof(value));
+    for (offset = 0; offset < sizeof(value); offset += 18) {
+        CHECK(test_prep_write(offset, value + offset, MIN(18, sizeof(value) - offset)) == MICO_BT_GATT_SUCCESS);
+    }
+    test_pump();
+    CHECK(g_received_count == 0);
+
+    CHECK(test_exec_write(GATT_PREP_WRITE_EXEC) == MICO_BT_GATT_SUCCESS);
+    test_pump();
+    CHECK(g_received_count == 1);
+    CHECK(g_received_len == sizeof(value) && memcmp(g_received, value, sizeof(value)) == 0);
+    printf("segments in order: ok\n");
+}
+
+/* Segments out of order and overlapping, the value is what the offsets make of them. */
+static void test_out_of_order(void)
+{
+    uint8_t value[100];
+
+    test_connect();
+    test_fill(value, sizeof(value));
+    CHECK(test_prep_write(60, value + 60, 40) == MICO_BT_GATT_SUCCESS);
+    CHECK(test_prep_write(0, value, 30) == MICO_BT_GATT_SUCCESS);
+    CHECK(test_prep_write(20, value + 20, 45) == MICO_BT_GATT_SUCCESS);
+
+    CHECK(test_exec_write(GATT_PREP_WRITE_EXEC) == MICO_BT_GATT_SUCCESS);
+    test_pump();
+    CHECK(g_received_count == 1);
+    CHECK(g_received_len == sizeof(value) && memcmp(g_received, value, sizeof(value)) == 0);
+    printf("segments out of order: ok\n");
+}
+
+/* A cancelled long write is dropped, the next write is delivered alone. */
+static void test_cancel(void)
+{
+    uint8_t value[40];
+
+    test_connect();
+    test_fill(value, sizeof(value));
+    CHECK(test_prep_write(0, value, sizeof(value)) == MICO_BT_GATT_SUCCESS);
+    CHECK(test_exec_write(GATT_PREP_WRITE_CANCEL) == MICO_BT_GATT_SUCCESS);
+    test_pump();
+    CHECK(g_received_count == 0);
+
+    memcpy(g_spp_in->p_value, "abc", 3);
+    g_spp_in->value_length = 3;
+    CHECK(mico_ble_periphreal_spp_data_in_callback(g_spp_in, GATTS_REQ_TYPE_WRITE) == MICO_BT_GATT_SUCCESS);
+    test_pump();
+    CHECK(g_received_count == 1 && g_received_len == 3 && memcmp(g_received, "abc", 3) == 0);
+    printf("cancel: ok\n");
+}
+
+/* A segment past the attribute buffer is refused and the long write dropped. */
+static void test_too_long(void)
+{
+    uint8_t value[20] = { 0 };
+
+    test_connect();
+    CHECK(test_prep_write(0, value, sizeof(value)) == MICO_BT_GATT_SUCCESS);
+    g_spp_in->value_length = BLE_PREP_WRITE_MAX_SIZE + 1;
+    CHECK(mico_ble_periphreal_spp_data_in_callback(g_spp_in, GATTS_REQ_TYPE_PREP_WRITE) == MICO_BT_GATT_PREPARE_Q_FULL);
+
+    CHECK(test_exec_write(GATT_PREP_WRITE_EXEC) == MICO_BT_GATT_SUCCESS);
+    test_pump();
+    CHECK(g_received_count == 0);
+    printf("too long: ok\n");
+}
+
+int main(void)
+{
+    test_in_order();
+    test_out_of_order();
+    test_cancel();
+    test_too_long();
+    return 0;
+}
@@ -0,0 +1,201 @@
+/**
+ ******************************************************************************
+ * @file    rel_test.c
+ * @brief   Host test of reliable notifications enabled on a live connection.
+ *
+ * The library is compiled in with the SDK stand-ins of test/stubs, the peer
+ * is scripted. Build and run from the component directory:
+ *
+ *     gcc -std=gnu99 -Itest/stubs -I. test/rel_test.c test/stubs/stub_sdk.c statemachine.c mico_ble_lz.c \
+ *         -o rel_test && ./rel_test
+ ******************************************************************************
+ */
+
+#include "../mico_ble_lib.c"
+
+/*---------------------------------------------------------------------------------------------
+ * SDK stand-ins scripted for the tested paths, test/stubs/stub_sdk.c has the rest
+ */
+
+typedef struct {
+    event_handler_t handler;
+    void           *arg;
+} test_job_t;
+
+static test_job_t g_jobs[64];
+static int g_job_count;
+
+static uint8_t g_sent[BLE_ATT_MTU_MAX];     /* last fragment sent to the peer */
+static uint16_t g_sent_len;
+static int g_sent_count;
+
+OSStatus mico_rtos_send_asynchronous_event(mico_worker_thread_t *worker, event_handler_t handler, void *arg)
+{
+    g_jobs[g_job_count].handler = handler;
+    g_jobs[g_job_count].arg = arg;
+    g_job_count++;
+    return kNoErr;
+}
+
+OSStatus mico_bt_peripheral_ext_attribute_value_write(mico_bt_ext_attribute_value_t *attribute, uint16_t length,
+                                                      uint16_t offset, const uint8_t *value)
+{
+    memcpy(g_sent, value, length);
+    g_sent_len = length;
+    return kNoErr;
+}
+
+OSStatus mico_bt_peripheral_gatt_notify_attribute_value(mico_bt_peripheral_socket_t *socket,
+                                                        mico_bt_ext_attribute_value_t *attribute)
+{
+    g_sent_count++;
+    return kNoErr;
+}
+
+OSStatus mico_bt_smartbridge_get_attribute_cache_by_handle(mico_bt_smartbridge_socket_t *socket, uint16_t handle,
+                                                           mico_bt_smart_attribute_t *attribute, uint16_t size)
+{
+    attribute->handle = handle;
+    attribute->value_length = 20;
+    return kNoErr;
+}
+
+OSStatus mico_bt_smartbridge_write_attribute_cache_characteristic_value(mico_bt_smartbridge_socket_t *socket,
+                                                                        const mico_bt_smart_attribute_t *attribute)
+{
+    memcpy(g_sent, attribute->value.value, attribute->value_length);
+    g_sent_len = attribute->value_length;
+    g_sent_count++;
+    return kNoErr;
+}
+
+/*---------------------------------------------------------------------------------------------
+ * Test helpers
+ */
+
+#define CHECK(cond)                                                             \
+    do {                                                                        \
+        if (!(cond)) {                                                          \
+            printf("FAIL %s:%d: %s\n", __FILE__, __LINE__, #cond);              \
+            exit(1);                                                            \
+        }                                                                       \
+    } while (0)
+
+static mico_worker_thread_t g_app_worker;
+static mico_bt_ext_attribute_value_t g_spp_out;
+
+static void test_pump(void)
+{
+    int i;
+
+    for (i = 0; i < g_job_count; i++) {
+        g_jobs[i].handler(g_jobs[i].arg);
+    }
+    g_job_count = 0;
+}
+
+/* A connection carrying the framed SPP channel, capabilities not exchanged yet. */
+static void test_connect(mico_ble_spp_owner_t owner)
+{
+    memset(&g_ble_context, 0, sizeof(g_ble_context));
+    g_ble_context.m_thread_count = 1;
+    g_ble_context.m_workers[BLE_WORKER_TASK].m_thread = &g_app_worker;
+    g_ble_context.m_att_mtu = BLE_ATT_MTU_DEFAULT;
+    g_ble_context.m_spp_out_attribute = &g_spp_out;
+    g_ble_context.m_spp_out_cccd_value = GATT_CLIENT_CONFIG_NOTIFICATION;
+    g_ble_context.m_spp_owner = owner;
+    g_ble_context.m_primary = &g_ble_context.m_links[0];
+    CHECK(mico_ble_set_framing(MICO_TRUE) == MICO_BT_SUCCESS);
+    g_sent_count = 0;
+}
+
+/* The peer announces its capabilities in a single fragment. */
+static void test_peer_caps(uint8_t seq, uint8_t caps)
+{
+    uint8_t fragment[BLE_FRAME_FIRST_HDR_SIZE + 1] = { BLE_FRAME_HDR_FIRST | seq, BLE_FRAME_TYPE_CAPS, 1, 0, caps };
+
+    mico_ble_rx_input(fragment, sizeof(fragment));
+    test_pump();
+}
+
+/* Send one data message of three fragments. */
+static void test_send(void)
+{
+    uint8_t payload[40] = { 0 };
+    mico_ble_iovec_t vec = { payload, sizeof(payload) };
+
+    CHECK(mico_ble_send_msg(BLE_FRAME_TYPE_DATA, &vec, 1, 100) == MICO_BT_SUCCESS);
+}
+
+/*---------------------------------------------------------------------------------------------
+ * Tests
+ */
+
+/*
+ * Peripheral enables reliable mode after the exchange. The central had it
+ * on from the start and does not answer the new capabilities, it tracks
+ * from the fragment after the one carrying them.
+ */
+static void test_peripheral_enable_mid_connection(void)
+{
+    uint8_t caps_seq;
+
+    test_connect(BLE_SPP_OWNER_PERIPHERAL);
+    mico_ble_caps_exchange();
+    test_pump();
+    CHECK(g_sent_count == 1 && g_sent[1] == BLE_FRAME_TYPE_CAPS && g_sent[4] == 0);
+    test_peer_caps(0, BLE_CAPS_REL);
+    CHECK(!g_ble_context.m_rel.m_active);
+
+    CHECK(mico_ble_set_reliable(MICO_TRUE) == MICO_BT_SUCCESS);
+    test_pump();
+    CHECK(g_sent_count == 2 && g_sent[1] == BLE_FRAME_TYPE_CAPS && g_sent[4] == BLE_CAPS_REL);
+    caps_seq = g_sent[0] & BLE_FRAME_HDR_SEQ_MASK;
+
+    CHECK(g_ble_context.m_rel.m_active);
+    CHECK(g_ble_context.m_rel.m_base == REL_SEQ(caps_seq + 1));
+
+    /* Data fragments from now on are held until the central acknowledges them */
+    test_send();
+    CHECK(REL_SEQ(g_ble_context.m_frame_tx_seq - g_ble_context.m_rel.m_base) == 3);
+    mico_ble_rel_on_sack(REL_SEQ(g_ble_context.m_frame_tx_seq), 0);
+    CHECK(g_ble_context.m_rel.m_base == REL_SEQ(g_ble_context.m_frame_tx_seq));
+    printf("peripheral enables mid-connection: ok\n");
+}
+
+/* Central enables reliable mode after the exchange, the peripheral had it on from the start. */
+static void test_central_enable_mid_connection(void)
+{
+    test_connect(BLE_SPP_OWNER_CENTRAL);
+    test_peer_caps(5, BLE_CAPS_REL);
+    test_pump();
+    CHECK(g_sent_count == 1 && g_sent[4] == 0);
+    CHECK(!g_ble_context.m_rel.m_active);
+
+    CHECK(mico_ble_set_reliable(MICO_TRUE) == MICO_BT_SUCCESS);
+    test_pump();
+    CHECK(g_sent_count >= 2);
+    CHECK(g_ble_context.m_rel.m_active);
+    CHECK(g_ble_context.m_rel.m_base == 6);
+    printf("central enables mid-connection: ok\n");
+}
+
+/* Disabling mid-connection stops tracking on this side at once, the peer stops on the announcement. */
+static void test_disable_mid_connection(void)
+{
+    test_peripheral_enable_mid_connection();
+
+    CHECK(mico_ble_set_reliable(MICO_FALSE) == MICO_BT_SUCCESS);
+    test_pump();
+    CHECK(!g_ble_context.m_rel.m_active);
+    CHECK(g_sent[1] == BLE_FRAME_TYPE_CAPS && g_sent[4] == 0);
+    printf("disable mid-connection: ok\n");
+}
+
+int main(void)
+{
+    test_peripheral_enable_mid_connection();
+    test_central_enable_mid_connection();
+    test_disable_mid_connection();
+    return 0;
+}
@@ -0,0 +1,228 @@
+/**
+ ******************************************************************************
+ * @file    scan_config_test.c
+ * @brief   Host test of scan configuration changes during a duty cycle rest.
+ *
+ * The library is compiled in with the SDK stand-ins of test/stubs, the scan
+ * engine and the rest timer are scripted. Build and run from the component
+ * directory:
+ *
+ *     gcc -std=gnu99 -Itest/stubs -I. test/scan_config_test.c test/stubs/stub_sdk.c statemachine.c mico_ble_lz.c \
+ *         -o scan_config_test && ./scan_config_test
+ ******************************************************************************
+ */
+
+#include "../mico_ble_lib.c"
+
+/*---------------------------------------------------------------------------------------------
+ * SDK stand-ins scripted for the tested paths, test/stubs/stub_sdk.c has the rest
+ */
+
+typedef struct {
+    event_handler_t handler;
+    void           *arg;
+} test_job_t;
+
+static test_job_t g_jobs[64];
+static int g_job_count;
+
+static mico_bool_t g_scanning;      /* the radio is scanning */
+static int g_scan_count;            /* scans started */
+static mico_bool_t g_rest_running;  /* the rest timer is running */
+static uint32_t g_rest_period;      /* its period */
+
+OSStatus mico_rtos_send_asynchronous_event(mico_worker_thread_t *worker, event_handler_t handler, void *arg)
+{
+    g_jobs[g_job_count].handler = handler;
+    g_jobs[g_job_count].arg = arg;
+    g_job_count++;
+    return kNoErr;
+}
+
+OSStatus mico_bt_smartbridge_start_scan(const mico_bt_smart_scan_settings_t *settings,
+                                        mico_bt_smart_scan_complete_callback_t complete,
+                                        mico_bt_smart_advertising_report_callback_t report)
+{
+    g_scanning = MICO_TRUE;
+    g_scan_count++;
+    return kNoErr;
+}
+
+mico_bool_t mico_bt_smartbridge_is_scanning(void)
+{
+    return g_scanning;
+}
+
+OSStatus mico_rtos_init_timer(mico_timer_t *timer, uint32_t ms, timer_handler_t handler, void *arg)
+{
+    if (timer == &g_ble_context.m_scan_rest_timer) {
+        g_rest_period = ms;
+    }
+    return kNoErr;
+}
+
+/* Like the RTOS, a period change starts the timer */
+OSStatus mico_rtos_change_timer_period(mico_timer_t *timer, uint32_t ms)
+{
+    if (timer == &g_ble_context.m_scan_rest_timer) {
+        g_rest_period = ms;
+        g_rest_running = MICO_TRUE;
+    }
+    return kNoErr;
+}
+
+OSStatus mico_rtos_start_timer(mico_timer_t *timer)
+{
+    if (timer == &g_ble_context.m_scan_rest_timer) {
+        g_rest_running = MICO_TRUE;
+    }
+    return kNoErr;
+}
+
+OSStatus mico_rtos_stop_timer(mico_timer_t *timer)
+{
+    if (timer == &g_ble_context.m_scan_rest_timer) {
+        g_rest_running = MICO_FALSE;
+    }
+    return kNoErr;
+}
+
+mico_bool_t mico_rtos_is_timer_running(mico_timer_t *timer)
+{
+    return timer == &g_ble_context.m_scan_rest_timer && g_rest_running;
+}
+
+/*---------------------------------------------------------------------------------------------
+ * Test helpers
+ */
+
+#define CHECK(cond)                                                             \
+    do {                                                                        \
+        if (!(cond)) {                                                          \
+            printf("FAIL %s:%d: %s\n", __FILE__, __LINE__, #cond);              \
+            exit(1);                                                            \
+        }                                                                       \
+    } while (0)
+
+static mico_worker_thread_t g_app_worker;
+
+static void test_pump(void)
+{
+    int i;
+
+    for (i = 0; i < g_job_count; i++) {
+        g_jobs[i].handler(g_jobs[i].arg);
+    }
+    g_job_count = 0;
+}
+
+static mico_ble_scan_config_t test_config(uint16_t duration_second, uint8_t duty_percent, uint16_t duty_period_second)
+{
+    mico_ble_scan_config_t cfg = g_scan_config_default;
+
+    cfg.duration_second = duration_second;
+    cfg.duty_percent = duty_percent;
+    cfg.duty_period_second = duty_period_second;
+    return cfg;
+}
+
+/* A continuous scan of 3 s every 10 s, resting after its first scan. */
+static void test_resting(void)
+{
+    mico_ble_scan_config_t cfg = test_config(0, 30, 10);
+
+    memset(&g_ble_context, 0, sizeof(g_ble_context));
+    g_ble_context.m_thread_count = 1;
+    g_ble_context.m_workers[BLE_WORKER_TASK].m_thread = &g_app_worker;
+    g_scanning = MICO_FALSE;
+    g_rest_running = MICO_FALSE;
+
+    mico_ble_central_state_machine_init(BLE_STATE_CENTRAL_SCANNING);
+    mico_ble_periph_state_machine_init(BLE_STATE_IDLE);
+    CHECK(mico_ble_set_scan_config(&cfg) == MICO_BT_SUCCESS);
+    g_ble_context.m_scan_cycling = mico_ble_scan_is_cycling();
+    CHECK(mico_ble_scan_start() == MICO_BT_SUCCESS && g_scanning);
+
+    g_scanning = MICO_FALSE;
+    mico_ble_central_scan_complete_handler(NULL);
+    CHECK(g_rest_running && g_rest_period == 7000);
+    g_scan_count = 0;
+    g_job_count = 0;
+}
+
+/* The rest timer fires */
+static void test_rest_over(void)
+{
+    g_rest_running = MICO_FALSE;
+    mico_ble_scan_rest_timeout(NULL);
+    test_pump();
+}
+
+/*---------------------------------------------------------------------------------------------
+ * Tests
+ */
+
+/* A new rest period restarts the rest with it, the scan goes on after. */
+static void test_new_rest_period(void)
+{
+    mico_ble_scan_config_t cfg = test_config(0, 50, 10);
+
+    test_resting();
+    CHECK(mico_ble_set_scan_config(&cfg) == MICO_BT_SUCCESS);
+    test_pump();
+    CHECK(g_rest_running && g_rest_period == 5000);
+    CHECK(g_scan_count == 0);
+
+    test_rest_over();
+    CHECK(g_scan_count == 1 && g_scanning);
+    printf("new rest period: ok\n");
+}
+
+/* The same rest period leaves the rest under way alone. */
+static void test_same_rest_period(void)
+{
+    mico_ble_scan_config_t cfg = test_config(0, 30, 10);
+
+    test_resting();
+    cfg.is_active = !cfg.is_active;
+    CHECK(mico_ble_set_scan_config(&cfg) == MICO_BT_SUCCESS);
+    test_pump();
+    CHECK(g_rest_running && g_rest_period == 7000);
+    CHECK(g_scan_count == 0);
+    printf("same rest period: ok\n");
+}
+
+/* Without a rest, scanning starts again at once. */
+static void test_no_rest(void)
+{
+    mico_ble_scan_config_t cfg = test_config(0, 100, 0);
+
+    test_resting();
+    CHECK(mico_ble_set_scan_config(&cfg) == MICO_BT_SUCCESS);
+    test_pump();
+    CHECK(g_scan_count == 1 && g_scanning);
+    printf("no rest: ok\n");
+}
+
+/* A scan of fixed duration does not restart, the rest ends the scan. */
+static void test_not_cycling(void)
+{
+    mico_ble_scan_config_t cfg = test_config(5, 100, 0);
+
+    test_resting();
+    CHECK(mico_ble_set_scan_config(&cfg) == MICO_BT_SUCCESS);
+    CHECK(!g_rest_running);
+    test_pump();
+    CHECK(g_scan_count == 0);
+    CHECK(!SM_InState(&g_ble_context.m_central_sm, BLE_STATE_CENTRAL_SCANNING));
+    printf("not cycling: ok\n");
+}
+
+int main(void)
+{
+    test_new_rest_period();
+    test_same_rest_period();
+    test_no_rest();
+    test_not_cycling();
+    return 0;
+}
@@ -0,0 +1,22 @@
+#pragma once
+#include "stub_all.h"
+#define AT_PROMPT "\r\n"
+#define AT_RESPONSE_OK "\r\nOK\r\n"
+#define AT_RESPONSE_ERR "\r\nERROR\r\n"
+#define AT_RESPONSE_SEND "\r\n>"
+#define at_log(N, M, ...) printf(M, ##__VA_ARGS__)
+typedef struct { int dummy; } at_cmd_config_t;
+typedef struct { int para_num; void *para; } at_cmd_para_t;
+typedef struct { OSStatus (*write)(uint8_t *, uint32_t); OSStatus (*ioctl)(int, void *); } at_cmd_driver_t;
+enum { AT_SET_AT_COMMAND, AT_GET_ROW_DATA_READ_LENGTH, AT_GET_ROW_DATA_READ_TIMEOUT, AT_GET_CMD_READ_TIMEOUT };
+struct at_cmd_command { const char *name; void (*get)(at_cmd_driver_t *); void (*set)(at_cmd_driver_t *, at_cmd_para_t *); void (*query)(at_cmd_driver_t *); void (*exec)(at_cmd_driver_t *); };
+OSStatus at_cmd_register_config(at_cmd_config_t *h, uint32_t size);
+void *at_cmd_config_data_read(at_cmd_config_t *h);
+OSStatus at_cmd_config_data_write(void);
+OSStatus at_cmd_register_commands(const struct at_cmd_command *c, int n);
+char *at_cmd_parse_get_string(void *p, int idx);
+int at_cmd_parse_get_digital(void *p, int idx);
+at_cmd_driver_t *uart_driver_struct_get(void);
+uint32_t at_cmd_driver_read(at_cmd_driver_t *d, uint8_t *b, uint32_t len, uint32_t to);
+char *DataToHexStringWithColons(const uint8_t *d, int len);
+char *DataToHexString(const uint8_t *d, int len);
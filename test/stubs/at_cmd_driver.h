@@ -0,0 +1 @@
+#include "at_cmd.h"
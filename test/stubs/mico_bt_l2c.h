@@ -0,0 +1 @@
+#include "stub_all.h"
@@ -0,0 +1,251 @@
+/*
+ * Host stand-ins for the MiCO SDK types and functions used by the library,
+ * just enough to compile it into the tests next to this directory. Every
+ * other SDK header in here includes this file.
+ */
+#ifndef STUB_ALL_H
+#define STUB_ALL_H
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+typedef int OSStatus;
+typedef int mico_bool_t;
+#define MICO_TRUE 1
+#define MICO_FALSE 0
+#define TRUE 1
+#define FALSE 0
+#ifndef true
+#define true 1
+#define false 0
+#endif
+enum { kNoErr=0, kUnknownErr=-6700, kParamErr=-6705, kNoMemoryErr=-6728, kTimeoutErr=-6722, kGeneralErr=-6718, kInProgressErr=-6712, kUnsupportedErr=-6735, kNotFoundErr=-6727, kNoResourcesErr=-6729, kStateErr=-6709, kSizeErr=-6743 };
+#define MIN(a,b) ((a)<(b)?(a):(b))
+#define MAX(a,b) ((a)>(b)?(a):(b))
+#define UNUSED_PARAMETER(x) (void)(x)
+#define custom_log(N, M, ...) printf(N M "\n", ##__VA_ARGS__)
+#define require(X, L) do { if (!(X)) goto L; } while (0)
+#define require_string(X, L, S) do { if (!(X)) goto L; } while (0)
+#define require_action(X, L, A) do { if (!(X)) { A; goto L; } } while (0)
+#define require_action_string(X, L, A, S) do { if (!(X)) { A; goto L; } } while (0)
+#define require_noerr(E, L) do { if ((E)!=0) goto L; } while (0)
+#define require_noerr_string(E, L, S) do { if ((E)!=0) goto L; } while (0)
+#define require_noerr_action(E, L, A) do { if ((E)!=0) { A; goto L; } } while (0)
+#define require_noerr_action_string(E, L, A, S) do { if ((E)!=0) { A; goto L; } } while (0)
+#define check(X) (void)(X)
+#define check_string(X, S) (void)(X)
+#define MICO_APPLICATION_PRIORITY 7
+#define MICO_NETWORK_WORKER_PRIORITY 3
+#define MICO_WAIT_FOREVER 0xffffffff
+#define MICO_NO_WAIT 0
+typedef uint32_t mico_time_t;
+typedef uint32_t mico_utc_time_ms_t;
+typedef void * mico_mutex_t;
+typedef void * mico_semaphore_t;
+typedef void * mico_thread_t;
+typedef void * mico_queue_t;
+typedef struct { void *t; } mico_timer_t;
+typedef struct { void *thread; void *queue; } mico_worker_thread_t;
+typedef OSStatus (*event_handler_t)(void *arg);
+typedef void (*timer_handler_t)(void *arg);
+OSStatus mico_rtos_create_worker_thread(mico_worker_thread_t *w, uint8_t prio, uint32_t stack, uint32_t qsize);
+OSStatus mico_rtos_delete_worker_thread(mico_worker_thread_t *w);
+OSStatus mico_rtos_send_asynchronous_event(mico_worker_thread_t *w, event_handler_t f, void *arg);
+OSStatus mico_rtos_init_mutex(mico_mutex_t *m);
+OSStatus mico_rtos_lock_mutex(mico_mutex_t *m);
+OSStatus mico_rtos_unlock_mutex(mico_mutex_t *m);
+OSStatus mico_rtos_deinit_mutex(mico_mutex_t *m);
+OSStatus mico_rtos_init_semaphore(mico_semaphore_t *s, int count);
+OSStatus mico_rtos_get_semaphore(mico_semaphore_t *s, uint32_t timeout);
+OSStatus mico_rtos_set_semaphore(mico_semaphore_t *s);
+OSStatus mico_rtos_deinit_semaphore(mico_semaphore_t *s);
+OSStatus mico_rtos_init_timer(mico_timer_t *t, uint32_t ms, timer_handler_t f, void *arg);
+OSStatus mico_rtos_start_timer(mico_timer_t *t);
+OSStatus mico_rtos_stop_timer(mico_timer_t *t);
+OSStatus mico_rtos_reload_timer(mico_timer_t *t);
+OSStatus mico_rtos_change_timer_period(mico_timer_t *t, uint32_t ms);
+OSStatus mico_rtos_deinit_timer(mico_timer_t *t);
+mico_bool_t mico_rtos_is_timer_running(mico_timer_t *t);
+uint32_t mico_rtos_get_time(void);
+void mico_rtos_thread_msleep(uint32_t ms);
+void mico_rtos_enter_critical(void);
+void mico_rtos_exit_critical(void);
+OSStatus MicoRandomNumberRead(void *buf, int len);
+uint32_t mico_rtos_get_free_heap(void);
+
+/* BT */
+typedef int mico_bt_result_t;
+enum { MICO_BT_SUCCESS=0, MICO_BT_PENDING=8100, MICO_BT_TIMEOUT, MICO_BT_BADARG, MICO_BT_BADOPTION, MICO_BT_UNSUPPORTED, MICO_BT_ERROR, MICO_BT_NO_RESOURCES, MICO_BT_ILLEGAL_ACTION, MICO_BT_BUSY, MICO_BT_UNKNOWN_EVENT, MICO_BT_LIST_FULL, MICO_BT_ITEM_NOT_IN_LIST };
+#define BD_ADDR_LEN 6
+typedef uint8_t mico_bt_device_address_t[6];
+typedef uint8_t *mico_bt_device_address_ptr_t;
+#define LEN_UUID_16 2
+#define LEN_UUID_32 4
+#define LEN_UUID_128 16
+typedef struct { uint16_t len; union { uint16_t uuid16; uint32_t uuid32; uint8_t uuid128[16]; } uu; } mico_bt_uuid_t;
+typedef enum { BT_SMART_ADDR_TYPE_PUBLIC, BT_SMART_ADDR_TYPE_RANDOM } mico_bt_smart_address_type_t;
+typedef struct { mico_bt_device_address_t address; mico_bt_smart_address_type_t address_type; char name[31]; } mico_bt_smart_device_t;
+typedef enum { BT_SMART_CONNECTABLE_UNDIRECTED_ADVERTISING_EVENT, BT_SMART_CONNECTABLE_DIRECTED_ADVERTISING_EVENT, BT_SMART_SCANNABLE_UNDIRECTED_ADVERTISING_EVENT, BT_SMART_NON_CONNECTABLE_UNDIRECTED_ADVERTISING_EVENT, BT_SMART_SCAN_RESPONSE_EVENT } mico_bt_smart_advertising_event_t;
+typedef struct { mico_bt_smart_device_t remote_device; int8_t signal_strength; int8_t tx_power; mico_bt_smart_advertising_event_t event; uint8_t eir_data[31]; uint8_t eir_data_length; } mico_bt_smart_advertising_report_t;
+typedef enum { BT_SMART_PASSIVE_SCAN, BT_SMART_ACTIVE_SCAN } mico_bt_smart_scan_type_t;
+typedef enum { FILTER_POLICY_NONE, FILTER_POLICY_WHITE_LIST } mico_bt_smart_filter_policy_t;
+typedef enum { DUPLICATES_FILTER_DISABLED, DUPLICATES_FILTER_ENABLED } mico_bt_smart_filter_duplicates_t;
+typedef struct { mico_bt_smart_scan_type_t type; mico_bt_smart_filter_policy_t filter_policy; mico_bt_smart_filter_duplicates_t filter_duplicates; uint16_t interval; uint16_t window; uint16_t duration_second; } mico_bt_smart_scan_settings_t;
+typedef struct { uint16_t timeout_second; mico_bt_smart_filter_policy_t filter_policy; uint16_t interval_min, interval_max, latency, supervision_timeout, ce_length_min, ce_length_max; uint32_t attribute_protocol_timeout_ms; } mico_bt_smart_connection_settings_t;
+typedef enum { BT_SMART_IO_NO_INPUT_NO_OUTPUT } mico_bt_smart_io_cap_t;
+typedef enum { BT_SMART_AUTH_REQ_NONE, BT_SMART_AUTH_REQ_BONDING } mico_bt_smart_auth_req_t;
+typedef enum { BT_SMART_OOB_AUTH_NONE } mico_bt_smart_oob_t;
+enum { BT_SMART_DISTRIBUTE_ENCRYPTION_AND_SIGN_KEYS=5, BT_SMART_DISTRIBUTE_ALL_KEYS=7 };
+typedef struct { uint16_t timeout_second; int io_capabilities; int authentication_requirements; int oob_authentication; uint8_t max_encryption_key_size; int master_key_distribution; int slave_key_distribution; } mico_bt_smart_security_settings_t;
+typedef enum { BT_SMART_UNDIRECTED_ADVERTISING, BT_SMART_DIRECTED_ADVERTISING } mico_bt_smart_advertising_type_t;
+typedef struct { mico_bt_smart_advertising_type_t type; mico_bool_t use_high_duty; uint16_t high_duty_interval, high_duty_duration, low_duty_interval, low_duty_duration; } mico_bt_smart_advertising_settings_t;
+#define MICO_BT_CFG_DEFAULT_CONN_MIN_INTERVAL 24
+#define MICO_BT_CFG_DEFAULT_CONN_MAX_INTERVAL 40
+#define MICO_BT_CFG_DEFAULT_CONN_LATENCY 0
+#define MICO_BT_CFG_DEFAULT_CONN_SUPERVISION_TIMEOUT 700
+#define MICO_BT_CFG_DEFAULT_HIGH_DUTY_ADV_MIN_INTERVAL 48
+#define MICO_BT_CFG_DEFAULT_LOW_DUTY_ADV_MIN_INTERVAL 2048
+typedef struct { uint8_t *device_name; } mico_bt_cfg_settings_t;
+extern mico_bt_cfg_settings_t mico_bt_cfg_settings;
+mico_bt_result_t BTM_SetLocalDeviceName(char *name);
+typedef struct { mico_bt_smart_device_t remote_device; uint16_t connection_handle; int state; } mico_bt_smartbridge_socket_t;
+typedef struct { mico_bt_smart_device_t remote_device; uint16_t connection_handle; } mico_bt_peripheral_socket_t;
+typedef enum { SMARTBRIDGE_SOCKET_DISCONNECTED, SMARTBRIDGE_SOCKET_CONNECTING, SMARTBRIDGE_SOCKET_CONNECTED } mico_bt_smartbridge_socket_status_t;
+typedef enum { MICO_ATTRIBUTE_TYPE_CHARACTERISTIC_VALUE, MICO_ATTRIBUTE_TYPE_CHARACTERISTIC } mico_bt_smart_attribute_type_t;
+typedef struct { uint16_t start_handle, end_handle; mico_bt_uuid_t uuid; } mico_bt_smart_attr_service_t;
+typedef struct { uint8_t properties; uint16_t value_handle; mico_bt_uuid_t uuid; uint16_t descriptor_start_handle, descriptor_end_handle; } mico_bt_smart_attr_characteristic_t;
+typedef struct mico_bt_smart_attribute { struct mico_bt_smart_attribute *next; uint16_t handle; mico_bt_uuid_t type; uint16_t value_length; uint16_t value_struct_size; union { uint8_t value[1]; mico_bt_smart_attr_service_t service; mico_bt_smart_attr_characteristic_t characteristic; } value; } mico_bt_smart_attribute_t;
+#define ATTR_CHARACTERISTIC_VALUE_SIZE(n) (n)
+typedef struct { uint16_t handle; uint16_t value_length; uint16_t value_buffer_length; uint8_t *p_value; void *attribute_callback; } mico_bt_ext_attribute_value_t;
+typedef enum { GATTS_REQ_TYPE_READ=1, GATTS_REQ_TYPE_WRITE, GATTS_REQ_TYPE_PREP_WRITE, GATTS_REQ_TYPE_WRITE_EXEC, GATTS_REQ_TYPE_MTU, GATTS_REQ_TYPE_CONF } mico_bt_gatt_request_type_t;
+typedef enum { MICO_BT_GATT_SUCCESS=0, MICO_BT_GATT_INVALID_HANDLE, MICO_BT_GATT_INVALID_ATTR_LEN=0x0d, MICO_BT_GATT_INVALID_OFFSET=0x07, MICO_BT_GATT_PREPARE_Q_FULL=0x09, MICO_BT_GATT_INSUF_RESOURCE=0x11, MICO_BT_GATT_ERROR=0x85, MICO_BT_GATT_BUSY=0x84 } mico_bt_gatt_status_t;
+typedef mico_bt_gatt_status_t (*mico_bt_peripheral_attribute_handler)(mico_bt_ext_attribute_value_t *, mico_bt_gatt_request_type_t);
+#define GATT_CLIENT_CONFIG_NOTIFICATION 1
+#define GATT_CLIENT_CONFIG_INDICATION 2
+#define GATT_CHAR_PROP_BIT_NOTIFY 0x10
+#define GATT_CHAR_PROP_BIT_INDICATE 0x20
+#define GATT_DEF_BLE_MTU_SIZE 23
+#define MICO_BT_HCI_MODE 0
+#define BIT16_TO_8(v) (uint8_t)(v), (uint8_t)((v)>>8)
+#define APPEARANCE_GENERIC_TAG 512
+#define UUID_SERVCLASS_GATT_SERVER 0x1801
+#define UUID_SERVCLASS_GAP_SERVER 0x1800
+#define GATT_UUID_GATT_SRV_CHGD 0x2a05
+#define GATT_UUID_GAP_DEVICE_NAME 0x2a00
+#define GATT_UUID_GAP_ICON 0x2a01
+#define GATT_UUID_CHAR_DESCRIPTION 0x2901
+#define GATT_UUID_CHAR_CLIENT_CONFIG 0x2902
+#define GATT_UUID_PRI_SERVICE 0x2800
+#define GATT_UUID_CHAR_DECLARE 0x2803
+#define GATT_PREP_WRITE_CANCEL 0x00
+#define GATT_PREP_WRITE_EXEC 0x01
+#define LEGATTDB_CHAR_PROP_INDICATE 0x20
+#define LEGATTDB_CHAR_PROP_NOTIFY 0x10
+#define LEGATTDB_CHAR_PROP_READ 0x02
+#define LEGATTDB_CHAR_PROP_WRITE 0x08
+#define LEGATTDB_CHAR_PROP_WRITE_NO_RESPONSE 0x04
+#define LEGATTDB_PERM_NONE 0
+#define LEGATTDB_PERM_READABLE 1
+#define LEGATTDB_PERM_WRITE_CMD 2
+#define LEGATTDB_PERM_WRITE_REQ 4
+#define LEGATTDB_PERM_RELIABLE_WRITE 0x40
+#define LEGATTDB_PERM_VARIABLE_LENGTH 0x80
+#define PRIMARY_SERVICE_UUID16(h, u) 1,(uint8_t)(h)
+#define PRIMARY_SERVICE_UUID128(h, ...) 2,(uint8_t)(h)
+#define CHARACTERISTIC_UUID16(h, v, u, p, m) 3,(uint8_t)(h)
+#define CHARACTERISTIC_UUID128(h, v, u, p, m) 4,(uint8_t)(h),(uint8_t)(p),(uint8_t)(m)
+#define CHARACTERISTIC_UUID128_WRITABLE(h, v, u, p, m) 5,(uint8_t)(h),(uint8_t)(p),(uint8_t)(m)
+#define CHAR_DESCRIPTOR_UUID16(h, u, m) 6,(uint8_t)(h)
+#define CHAR_DESCRIPTOR_UUID16_WRITABLE(h, u, m) 7,(uint8_t)(h)
+typedef struct { uint8_t list_cmpl; uint8_t uuid128[16]; } mico_bt_ble_128service_t;
+typedef struct { uint8_t flag; mico_bt_ble_128service_t *p_services_128b; } mico_bt_ble_advert_data_t;
+#define BTM_BLE_GENERAL_DISCOVERABLE_FLAG 2
+#define BTM_BLE_BREDR_NOT_SUPPORTED 4
+#define BTM_BLE_ADVERT_BIT_DEV_NAME 1
+#define BTM_BLE_ADVERT_BIT_SERVICE_128 2
+#define BTM_BLE_ADVERT_BIT_FLAGS 4
+typedef enum { BTM_BLE_ADVERT_OFF, BTM_BLE_ADVERT_DIRECTED_HIGH, BTM_BLE_ADVERT_DIRECTED_LOW, BTM_BLE_ADVERT_UNDIRECTED_HIGH } mico_bt_ble_advert_mode_t;
+typedef enum { BLE_ADDR_PUBLIC, BLE_ADDR_RANDOM } mico_bt_ble_address_type_t;
+typedef OSStatus (*mico_bt_smart_scan_complete_callback_t)(void *);
+typedef OSStatus (*mico_bt_smart_advertising_report_callback_t)(const mico_bt_smart_advertising_report_t *);
+typedef OSStatus (*mico_bt_smartbridge_disconnection_callback_t)(mico_bt_smartbridge_socket_t *);
+typedef OSStatus (*mico_bt_smartbridge_notification_callback_t)(mico_bt_smartbridge_socket_t *, uint16_t);
+typedef OSStatus (*mico_bt_peripheral_connection_callback_t)(mico_bt_peripheral_socket_t *);
+typedef OSStatus (*mico_bt_smart_advertising_complete_callback_t)(void *);
+OSStatus mico_bt_init(int mode, const char *name, int a, int b);
+OSStatus mico_bt_deinit(void);
+OSStatus mico_bt_smartbridge_init(uint8_t n);
+OSStatus mico_bt_smartbridge_deinit(void);
+OSStatus mico_bt_smartbridge_enable_attribute_cache(uint32_t n, mico_bt_uuid_t *uuids, uint32_t count);
+OSStatus mico_bt_smartbridge_create_socket(mico_bt_smartbridge_socket_t *s);
+OSStatus mico_bt_smartbridge_delete_socket(mico_bt_smartbridge_socket_t *s);
+OSStatus mico_bt_smartbridge_get_socket_status(mico_bt_smartbridge_socket_t *s, mico_bt_smartbridge_socket_status_t *st);
+OSStatus mico_bt_smartbridge_enable_pairing(mico_bt_smartbridge_socket_t *s, const mico_bt_smart_security_settings_t *, void *);
+OSStatus mico_bt_smartbridge_set_bond_info(mico_bt_smartbridge_socket_t *s, const mico_bt_smart_security_settings_t *, void *);
+OSStatus mico_bt_smartbridge_connect(mico_bt_smartbridge_socket_t *s, const mico_bt_smart_device_t *d, const mico_bt_smart_connection_settings_t *c, mico_bt_smartbridge_disconnection_callback_t dc, mico_bt_smartbridge_notification_callback_t nc);
+OSStatus mico_bt_smartbridge_disconnect(mico_bt_smartbridge_socket_t *s, mico_bool_t remove_cache);
+OSStatus mico_bt_smartbridge_get_service_from_attribute_cache_by_uuid(mico_bt_smartbridge_socket_t *s, const mico_bt_uuid_t *u, uint16_t a, uint16_t b, mico_bt_smart_attribute_t *attr, uint32_t size);
+OSStatus mico_bt_smartbridge_get_characteritics_from_attribute_cache_by_uuid(mico_bt_smartbridge_socket_t *s, const mico_bt_uuid_t *u, uint16_t a, uint16_t b, mico_bt_smart_attribute_t *attr, uint32_t size);
+OSStatus mico_bt_smartbridge_remove_attribute_cache(mico_bt_smartbridge_socket_t *s);
+OSStatus mico_bt_smartbridge_get_attribute_cache_by_handle(mico_bt_smartbridge_socket_t *s, uint16_t h, mico_bt_smart_attribute_t *attr, uint16_t size);
+OSStatus mico_bt_smartbridge_write_attribute_cache_characteristic_value(mico_bt_smartbridge_socket_t *s, const mico_bt_smart_attribute_t *attr);
+OSStatus mico_bt_smartbridge_enable_attribute_cache_notification(mico_bt_smartbridge_socket_t *s, mico_bool_t is_notification);
+OSStatus mico_bt_smartbridge_disable_attribute_cache_notification(mico_bt_smartbridge_socket_t *s);
+OSStatus mico_bt_smartbridge_start_scan(const mico_bt_smart_scan_settings_t *, mico_bt_smart_scan_complete_callback_t, mico_bt_smart_advertising_report_callback_t);
+OSStatus mico_bt_smartbridge_stop_scan(void);
+mico_bool_t mico_bt_smartbridge_is_scanning(void);
+OSStatus mico_bt_smart_attribute_create(mico_bt_smart_attribute_t **a, mico_bt_smart_attribute_type_t t, uint16_t len);
+OSStatus mico_bt_smart_attribute_delete(mico_bt_smart_attribute_t *a);
+OSStatus mico_bt_peripheral_deinit(void);
+OSStatus mico_bt_peripheral_init(mico_bt_peripheral_socket_t *s, const mico_bt_smart_security_settings_t *, mico_bt_peripheral_connection_callback_t, mico_bt_peripheral_connection_callback_t, void *);
+mico_bt_ext_attribute_value_t *mico_bt_peripheral_ext_attribute_add(uint16_t h, uint16_t len, const uint8_t *v, mico_bt_peripheral_attribute_handler cb);
+OSStatus mico_bt_peripheral_ext_attribute_find_by_handle(uint16_t h, mico_bt_ext_attribute_value_t **a);
+OSStatus mico_bt_peripheral_ext_attribute_value_write(mico_bt_ext_attribute_value_t *a, uint16_t len, uint16_t off, const uint8_t *v);
+OSStatus mico_bt_peripheral_gatt_notify_attribute_value(mico_bt_peripheral_socket_t *s, mico_bt_ext_attribute_value_t *a);
+OSStatus mico_bt_peripheral_gatt_indicate_attribute_value(mico_bt_peripheral_socket_t *s, mico_bt_ext_attribute_value_t *a);
+OSStatus mico_bt_peripheral_start_advertisements(mico_bt_smart_advertising_settings_t *, mico_bt_smart_advertising_complete_callback_t);
+OSStatus mico_bt_peripheral_stop_advertisements(void);
+OSStatus mico_bt_peripheral_disconnect(void);
+OSStatus mico_bt_gatt_db_init(const uint8_t *db, uint16_t len);
+OSStatus mico_bt_ble_set_advertisement_data(uint32_t mask, mico_bt_ble_advert_data_t *d);
+OSStatus mico_bt_ble_set_scan_response_data(uint32_t mask, mico_bt_ble_advert_data_t *d);
+mico_bt_result_t mico_bt_start_advertisements(mico_bt_ble_advert_mode_t mode, mico_bt_ble_address_type_t t, mico_bt_device_address_ptr_t a);
+void mico_bt_dev_read_local_addr(mico_bt_device_address_t a);
+mico_bool_t mico_bt_dev_find_bonded_device(uint8_t *a);
+mico_bool_t mico_bt_l2cap_update_ble_conn_params(mico_bt_device_address_t a, uint16_t min, uint16_t max, uint16_t lat, uint16_t to);
+mico_bool_t mico_bt_ble_update_background_connection_device(mico_bool_t add, mico_bt_device_address_t a);
+uint8_t mico_bt_ble_get_white_list_size(void);
+mico_bool_t mico_bt_ble_clear_white_list(void);
+/* l2cap le */
+typedef void (*mico_bt_l2cap_le_connected_indication_cback_t)(void *context, mico_bt_device_address_t bd_addr, uint16_t local_cid, uint16_t psm, uint8_t id, uint16_t mtu_peer);
+typedef void (*mico_bt_l2cap_le_connect_confirm_cback_t)(void *context, uint16_t local_cid, uint16_t result, uint16_t mtu_peer);
+typedef void (*mico_bt_l2cap_le_disconnect_indication_cback_t)(void *context, uint16_t local_cid, mico_bool_t ack);
+typedef void (*mico_bt_l2cap_le_disconnect_confirm_cback_t)(void *context, uint16_t local_cid, uint16_t result);
+typedef void (*mico_bt_l2cap_le_data_indication_cback_t)(void *context, uint16_t local_cid, uint8_t *p_data, uint16_t len);
+typedef void (*mico_bt_l2cap_le_tx_complete_cback_t)(void *context, uint16_t local_cid, uint16_t buf_count);
+typedef struct {
+    mico_bt_l2cap_le_connected_indication_cback_t connected_indication_cback;
+    mico_bt_l2cap_le_connect_confirm_cback_t connect_confirm_cback;
+    mico_bt_l2cap_le_disconnect_indication_cback_t disconnect_indication_cback;
+    mico_bt_l2cap_le_disconnect_confirm_cback_t disconnect_confirm_cback;
+    mico_bt_l2cap_le_data_indication_cback_t data_indication_cback;
+    void (*congestion_status_cback)(void *context, uint16_t local_cid, mico_bool_t is_congested);
+    mico_bt_l2cap_le_tx_complete_cback_t tx_complete_cback;
+} mico_bt_l2cap_le_appl_information_t;
+#define L2CAP_CONN_OK 0
+#define L2CAP_LE_CONN_NO_RESOURCES 4
+#define L2CAP_DATA_WRITE_SUCCESS 0
+#define L2CAP_DATA_WRITE_CONGESTED 1
+#define L2CAP_DATA_WRITE_FAILED 2
+#define BTM_SEC_NONE 0
+#define HCI_ACL_POOL_ID 2
+uint16_t mico_bt_l2cap_le_register(uint16_t psm, mico_bt_l2cap_le_appl_information_t *cb, void *context);
+mico_bool_t mico_bt_l2cap_le_deregister(uint16_t psm);
+uint16_t mico_bt_l2cap_le_connect_req(uint16_t psm, mico_bt_device_address_t a, mico_bt_ble_address_type_t t, int conn_mode, uint16_t rx_mtu, uint16_t pool, uint16_t sec, uint8_t key);
+mico_bool_t mico_bt_l2cap_le_connect_rsp(mico_bt_device_address_t a, uint8_t id, uint16_t lcid, uint16_t result, uint16_t rx_mtu, uint16_t pool);
+mico_bool_t mico_bt_l2cap_le_disconnect_req(uint16_t lcid);
+uint8_t mico_bt_l2cap_le_data_write(uint16_t cid, uint8_t *p, uint16_t len, uint16_t flags);
+#define BLE_CONN_MODE_HIGH_DUTY 1
+typedef int mico_partition_t;
+#endif
@@ -0,0 +1,193 @@
+/*
+ * Host stand-ins for the MiCO SDK functions declared in stub_all.h. Every
+ * one is weak and does nothing beyond reporting success, a test defines its
+ * own copy of the ones it scripts. Link it next to the test so a symbol
+ * missing here fails the build instead of surfacing at run time.
+ */
+#include "stub_all.h"
+
+#define STUB_WEAK __attribute__((weak))
+
+#define STUB_ATTRIBUTE_MAX 32
+
+/* Local attribute database, filled by mico_bt_peripheral_ext_attribute_add() */
+static mico_bt_ext_attribute_value_t g_stub_attributes[STUB_ATTRIBUTE_MAX];
+static int g_stub_attribute_count;
+
+STUB_WEAK mico_bt_cfg_settings_t mico_bt_cfg_settings = { (uint8_t *)"MiCO" };
+
+/* RTOS */
+STUB_WEAK OSStatus mico_rtos_create_worker_thread(mico_worker_thread_t *w, uint8_t prio, uint32_t stack, uint32_t qsize) { return kNoErr; }
+STUB_WEAK OSStatus mico_rtos_delete_worker_thread(mico_worker_thread_t *w) { return kNoErr; }
+STUB_WEAK OSStatus mico_rtos_send_asynchronous_event(mico_worker_thread_t *w, event_handler_t f, void *arg) { return kNoErr; }
+STUB_WEAK OSStatus mico_rtos_init_mutex(mico_mutex_t *m) { return kNoErr; }
+STUB_WEAK OSStatus mico_rtos_lock_mutex(mico_mutex_t *m) { return kNoErr; }
+STUB_WEAK OSStatus mico_rtos_unlock_mutex(mico_mutex_t *m) { return kNoErr; }
+STUB_WEAK OSStatus mico_rtos_deinit_mutex(mico_mutex_t *m) { return kNoErr; }
+STUB_WEAK OSStatus mico_rtos_init_semaphore(mico_semaphore_t *s, int count) { return kNoErr; }
+STUB_WEAK OSStatus mico_rtos_get_semaphore(mico_semaphore_t *s, uint32_t timeout) { return kNoErr; }
+STUB_WEAK OSStatus mico_rtos_set_semaphore(mico_semaphore_t *s) { return kNoErr; }
+STUB_WEAK OSStatus mico_rtos_deinit_semaphore(mico_semaphore_t *s) { return kNoErr; }
+STUB_WEAK OSStatus mico_rtos_init_timer(mico_timer_t *t, uint32_t ms, timer_handler_t f, void *arg) { return kNoErr; }
+STUB_WEAK OSStatus mico_rtos_start_timer(mico_timer_t *t) { return kNoErr; }
+STUB_WEAK OSStatus mico_rtos_stop_timer(mico_timer_t *t) { return kNoErr; }
+STUB_WEAK OSStatus mico_rtos_reload_timer(mico_timer_t *t) { return kNoErr; }
+STUB_WEAK OSStatus mico_rtos_change_timer_period(mico_timer_t *t, uint32_t ms) { return kNoErr; }
+STUB_WEAK OSStatus mico_rtos_deinit_timer(mico_timer_t *t) { return kNoErr; }
+STUB_WEAK mico_bool_t mico_rtos_is_timer_running(mico_timer_t *t) { return MICO_FALSE; }
+STUB_WEAK uint32_t mico_rtos_get_time(void) { return 0; }
+STUB_WEAK void mico_rtos_thread_msleep(uint32_t ms) { }
+STUB_WEAK void mico_rtos_enter_critical(void) { }
+STUB_WEAK void mico_rtos_exit_critical(void) { }
+STUB_WEAK uint32_t mico_rtos_get_free_heap(void) { return 0; }
+
+STUB_WEAK OSStatus MicoRandomNumberRead(void *buf, int len)
+{
+    memset(buf, 0x5a, len);
+    return kNoErr;
+}
+
+/* BT stack */
+STUB_WEAK OSStatus mico_bt_init(int mode, const char *name, int a, int b) { return kNoErr; }
+STUB_WEAK OSStatus mico_bt_deinit(void) { return kNoErr; }
+STUB_WEAK mico_bt_result_t BTM_SetLocalDeviceName(char *name) { return MICO_BT_SUCCESS; }
+STUB_WEAK void mico_bt_dev_read_local_addr(mico_bt_device_address_t a) { memset(a, 0, BD_ADDR_LEN); }
+STUB_WEAK mico_bool_t mico_bt_dev_find_bonded_device(uint8_t *a) { return MICO_FALSE; }
+STUB_WEAK OSStatus mico_bt_gatt_db_init(const uint8_t *db, uint16_t len) { return kNoErr; }
+STUB_WEAK OSStatus mico_bt_ble_set_advertisement_data(uint32_t mask, mico_bt_ble_advert_data_t *d) { return kNoErr; }
+STUB_WEAK OSStatus mico_bt_ble_set_scan_response_data(uint32_t mask, mico_bt_ble_advert_data_t *d) { return kNoErr; }
+STUB_WEAK mico_bt_result_t mico_bt_start_advertisements(mico_bt_ble_advert_mode_t mode, mico_bt_ble_address_type_t t,
+                                                        mico_bt_device_address_ptr_t a) { return MICO_BT_SUCCESS; }
+STUB_WEAK mico_bool_t mico_bt_l2cap_update_ble_conn_params(mico_bt_device_address_t a, uint16_t min, uint16_t max,
+                                                           uint16_t lat, uint16_t to) { return MICO_TRUE; }
+STUB_WEAK mico_bool_t mico_bt_ble_update_background_connection_device(mico_bool_t add, mico_bt_device_address_t a) { return MICO_TRUE; }
+STUB_WEAK uint8_t mico_bt_ble_get_white_list_size(void) { return 8; }
+STUB_WEAK mico_bool_t mico_bt_ble_clear_white_list(void) { return MICO_TRUE; }
+
+/* SmartBridge (central) */
+STUB_WEAK OSStatus mico_bt_smartbridge_init(uint8_t n) { return kNoErr; }
+STUB_WEAK OSStatus mico_bt_smartbridge_deinit(void) { return kNoErr; }
+STUB_WEAK OSStatus mico_bt_smartbridge_enable_attribute_cache(uint32_t n, mico_bt_uuid_t *uuids, uint32_t count) { return kNoErr; }
+STUB_WEAK OSStatus mico_bt_smartbridge_create_socket(mico_bt_smartbridge_socket_t *s) { return kNoErr; }
+STUB_WEAK OSStatus mico_bt_smartbridge_delete_socket(mico_bt_smartbridge_socket_t *s) { return kNoErr; }
+
+STUB_WEAK OSStatus mico_bt_smartbridge_get_socket_status(mico_bt_smartbridge_socket_t *s,
+                                                         mico_bt_smartbridge_socket_status_t *st)
+{
+    *st = SMARTBRIDGE_SOCKET_DISCONNECTED;
+    return kNoErr;
+}
+
+STUB_WEAK OSStatus mico_bt_smartbridge_enable_pairing(mico_bt_smartbridge_socket_t *s,
+                                                      const mico_bt_smart_security_settings_t *c, void *k) { return kNoErr; }
+STUB_WEAK OSStatus mico_bt_smartbridge_set_bond_info(mico_bt_smartbridge_socket_t *s,
+                                                     const mico_bt_smart_security_settings_t *c, void *k) { return kNoErr; }
+STUB_WEAK OSStatus mico_bt_smartbridge_connect(mico_bt_smartbridge_socket_t *s, const mico_bt_smart_device_t *d,
+                                               const mico_bt_smart_connection_settings_t *c,
+                                               mico_bt_smartbridge_disconnection_callback_t dc,
+                                               mico_bt_smartbridge_notification_callback_t nc) { return kNoErr; }
+STUB_WEAK OSStatus mico_bt_smartbridge_disconnect(mico_bt_smartbridge_socket_t *s, mico_bool_t remove_cache) { return kNoErr; }
+STUB_WEAK OSStatus mico_bt_smartbridge_get_service_from_attribute_cache_by_uuid(mico_bt_smartbridge_socket_t *s,
+                                                                                const mico_bt_uuid_t *u, uint16_t a,
+                                                                                uint16_t b, mico_bt_smart_attribute_t *attr,
+                                                                                uint32_t size) { return kNotFoundErr; }
+STUB_WEAK OSStatus mico_bt_smartbridge_get_characteritics_from_attribute_cache_by_uuid(mico_bt_smartbridge_socket_t *s,
+                                                                                       const mico_bt_uuid_t *u, uint16_t a,
+                                                                                       uint16_t b, mico_bt_smart_attribute_t *attr,
+                                                                                       uint32_t size) { return kNotFoundErr; }
+STUB_WEAK OSStatus mico_bt_smartbridge_remove_attribute_cache(mico_bt_smartbridge_socket_t *s) { return kNoErr; }
+STUB_WEAK OSStatus mico_bt_smartbridge_get_attribute_cache_by_handle(mico_bt_smartbridge_socket_t *s, uint16_t h,
+                                                                     mico_bt_smart_attribute_t *attr, uint16_t size) { return kNotFoundErr; }
+STUB_WEAK OSStatus mico_bt_smartbridge_write_attribute_cache_characteristic_value(mico_bt_smartbridge_socket_t *s,
+                                                                                  const mico_bt_smart_attribute_t *attr) { return kNoErr; }
+STUB_WEAK OSStatus mico_bt_smartbridge_enable_attribute_cache_notification(mico_bt_smartbridge_socket_t *s,
+                                                                           mico_bool_t is_notification) { return kNoErr; }
+STUB_WEAK OSStatus mico_bt_smartbridge_disable_attribute_cache_notification(mico_bt_smartbridge_socket_t *s) { return kNoErr; }
+STUB_WEAK OSStatus mico_bt_smartbridge_start_scan(const mico_bt_smart_scan_settings_t *settings,
+                                                  mico_bt_smart_scan_complete_callback_t complete,
+                                                  mico_bt_smart_advertising_report_callback_t report) { return kNoErr; }
+STUB_WEAK OSStatus mico_bt_smartbridge_stop_scan(void) { return kNoErr; }
+STUB_WEAK mico_bool_t mico_bt_smartbridge_is_scanning(void) { return MICO_FALSE; }
+
+STUB_WEAK OSStatus mico_bt_smart_attribute_create(mico_bt_smart_attribute_t **a, mico_bt_smart_attribute_type_t t, uint16_t len)
+{
+    *a = calloc(1, sizeof(mico_bt_smart_attribute_t) + len);
+    return *a ? kNoErr : kNoMemoryErr;
+}
+
+STUB_WEAK OSStatus mico_bt_smart_attribute_delete(mico_bt_smart_attribute_t *a)
+{
+    free(a);
+    return kNoErr;
+}
+
+/* Peripheral */
+STUB_WEAK OSStatus mico_bt_peripheral_deinit(void) { return kNoErr; }
+STUB_WEAK OSStatus mico_bt_peripheral_init(mico_bt_peripheral_socket_t *s, const mico_bt_smart_security_settings_t *c,
+                                           mico_bt_peripheral_connection_callback_t connected,
+                                           mico_bt_peripheral_connection_callback_t disconnected, void *k) { return kNoErr; }
+
+/* Like the SDK, the value buffer is allocated at the given length and the value copied in if there is one. */
+STUB_WEAK mico_bt_ext_attribute_value_t *mico_bt_peripheral_ext_attribute_add(uint16_t h, uint16_t len, const uint8_t *v,
+                                                                              mico_bt_peripheral_attribute_handler cb)
+{
+    mico_bt_ext_attribute_value_t *attribute;
+
+    if (g_stub_attribute_count == STUB_ATTRIBUTE_MAX) {
+        return NULL;
+    }
+    attribute = &g_stub_attributes[g_stub_attribute_count++];
+    attribute->handle = h;
+    attribute->value_length = len;
+    attribute->value_buffer_length = len;
+    attribute->p_value = len ? calloc(1, len) : NULL;
+    attribute->attribute_callback = (void *)cb;
+    if (v && attribute->p_value) {
+        memcpy(attribute->p_value, v, len);
+    }
+    return attribute;
+}
+
+STUB_WEAK OSStatus mico_bt_peripheral_ext_attribute_find_by_handle(uint16_t h, mico_bt_ext_attribute_value_t **a)
+{
+    int i;
+
+    for (i = 0; i < g_stub_attribute_count; i++) {
+        if (g_stub_attributes[i].handle == h) {
+            *a = &g_stub_attributes[i];
+            return kNoErr;
+        }
+    }
+    return kNotFoundErr;
+}
+
+STUB_WEAK OSStatus mico_bt_peripheral_ext_attribute_value_write(mico_bt_ext_attribute_value_t *a, uint16_t len,
+                                                                uint16_t off, const uint8_t *v)
+{
+    if (off + len > a->value_buffer_length) {
+        return kSizeErr;
+    }
+    memcpy(a->p_value + off, v, len);
+    a->value_length = off + len;
+    return kNoErr;
+}
+
+STUB_WEAK OSStatus mico_bt_peripheral_gatt_notify_attribute_value(mico_bt_peripheral_socket_t *s,
+                                                                  mico_bt_ext_attribute_value_t *a) { return kNoErr; }
+STUB_WEAK OSStatus mico_bt_peripheral_gatt_indicate_attribute_value(mico_bt_peripheral_socket_t *s,
+                                                                    mico_bt_ext_attribute_value_t *a) { return kNoErr; }
+STUB_WEAK OSStatus mico_bt_peripheral_start_advertisements(mico_bt_smart_advertising_settings_t *settings,
+                                                           mico_bt_smart_advertising_complete_callback_t complete) { return kNoErr; }
+STUB_WEAK OSStatus mico_bt_peripheral_stop_advertisements(void) { return kNoErr; }
+STUB_WEAK OSStatus mico_bt_peripheral_disconnect(void) { return kNoErr; }
+
+/* L2CAP LE */
+STUB_WEAK uint16_t mico_bt_l2cap_le_register(uint16_t psm, mico_bt_l2cap_le_appl_information_t *cb, void *context) { return psm; }
+STUB_WEAK mico_bool_t mico_bt_l2cap_le_deregister(uint16_t psm) { return MICO_TRUE; }
+STUB_WEAK uint16_t mico_bt_l2cap_le_connect_req(uint16_t psm, mico_bt_device_address_t a, mico_bt_ble_address_type_t t,
+                                                int conn_mode, uint16_t rx_mtu, uint16_t pool, uint16_t sec,
+                                                uint8_t key) { return 0; }
+STUB_WEAK mico_bool_t mico_bt_l2cap_le_connect_rsp(mico_bt_device_address_t a, uint8_t id, uint16_t lcid, uint16_t result,
+                                                   uint16_t rx_mtu, uint16_t pool) { return MICO_TRUE; }
+STUB_WEAK mico_bool_t mico_bt_l2cap_le_disconnect_req(uint16_t lcid) { return MICO_TRUE; }
+STUB_WEAK uint8_t mico_bt_l2cap_le_data_write(uint16_t cid, uint8_t *p, uint16_t len, uint16_t flags) { return L2CAP_DATA_WRITE_SUCCESS; }